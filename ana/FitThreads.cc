@@ -0,0 +1,72 @@
+#include <vector>
+
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include "FitThreads.hh"
+
+using namespace std;
+
+// ----------------------------------------------------------------------
+FitThreads::FitThreads(int nthreads, unsigned int block) :
+  fNThreads(nthreads), fBlock(block > 0 ? block : 1), fTask(0), fN(0), fNext(0) {
+#ifndef WIN32
+  if (fNThreads < 1) fNThreads = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+  pthread_mutex_init(&fMutex, NULL);
+#else
+  fNThreads = 1;
+#endif
+  if (fNThreads < 1) fNThreads = 1;
+}
+
+// ----------------------------------------------------------------------
+FitThreads::~FitThreads() {
+#ifndef WIN32
+  pthread_mutex_destroy(&fMutex);
+#endif
+}
+
+// ----------------------------------------------------------------------
+void FitThreads::run(task &t, unsigned int n) {
+  fTask = &t;
+  fN    = n;
+  fNext = 0;
+
+  // -- not worth starting threads for less than two blocks
+  int nthreads = fNThreads;
+  if (n < 2*fBlock) nthreads = 1;
+#ifndef WIN32
+  vector<pthread_t> threads;
+  for (int i = 1; i < nthreads; ++i) {
+    pthread_t th;
+    if (0 == pthread_create(&th, NULL, &FitThreads::worker, this)) threads.push_back(th);
+  }
+#endif
+  // -- the calling thread takes part
+  worker(this);
+#ifndef WIN32
+  for (unsigned int i = 0; i < threads.size(); ++i) pthread_join(threads[i], NULL);
+#endif
+  fTask = 0;
+}
+
+// ----------------------------------------------------------------------
+void* FitThreads::worker(void *p) {
+  FitThreads *self = static_cast<FitThreads*>(p);
+  while (true) {
+#ifndef WIN32
+    pthread_mutex_lock(&self->fMutex);
+#endif
+    unsigned int first = self->fNext;
+    if (first < self->fN) self->fNext += self->fBlock;
+#ifndef WIN32
+    pthread_mutex_unlock(&self->fMutex);
+#endif
+    if (first >= self->fN) break;
+    unsigned int last = first + self->fBlock;
+    if (last > self->fN) last = self->fN;
+    self->fTask->run(first, last);
+  }
+  return 0;
+}
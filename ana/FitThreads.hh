@@ -0,0 +1,49 @@
+#ifndef FITTHREADS_H
+#define FITTHREADS_H
+
+#include "pxardllexport.h"
+
+#ifndef WIN32
+#include <pthread.h>
+#endif
+
+/** Pool of threads for many independent fits.
+ *
+ *  run() hands out blocks of consecutive indices to the threads until all n are
+ *  done; the calling thread takes part. Each index is processed exactly once, so
+ *  the results do not depend on the number of threads. Without pthreads (WIN32)
+ *  everything runs in the calling thread.
+ */
+class DLLEXPORT FitThreads {
+public:
+  /** the work: fit the items first .. last-1 */
+  class task {
+  public:
+    virtual ~task() {}
+    virtual void run(unsigned int first, unsigned int last) = 0;
+  };
+
+  /** nthreads = 0: one thread per online CPU */
+  FitThreads(int nthreads = 0, unsigned int block = 64);
+  ~FitThreads();
+
+  /** process n items, returns when all are done */
+  void run(task &t, unsigned int n);
+
+  int getNThreads() {return fNThreads;}
+
+private:
+  static void* worker(void *);
+
+  int fNThreads;
+  unsigned int fBlock;
+
+  // -- work distribution of the current run()
+  task        *fTask;
+  unsigned int fN, fNext;
+#ifndef WIN32
+  pthread_mutex_t fMutex;
+#endif
+};
+
+#endif
@@ -0,0 +1,225 @@
+#include <cmath>
+#include <algorithm>
+
+#include "GainPedestalFitter.hh"
+
+using namespace std;
+
+namespace {
+  const int NPAR(4);
+  const int BLOCK(64);
+
+  // -- solve a x = b for a symmetric NPAR x NPAR matrix, returns false if singular
+  bool solve(const double *a, const double *b, double *x) {
+    double m[NPAR][NPAR+1];
+    for (int i = 0; i < NPAR; ++i) {
+      for (int j = 0; j < NPAR; ++j) m[i][j] = a[i*NPAR + j];
+      m[i][NPAR] = b[i];
+    }
+    for (int k = 0; k < NPAR; ++k) {
+      int ipiv(k);
+      for (int i = k+1; i < NPAR; ++i) if (fabs(m[i][k]) > fabs(m[ipiv][k])) ipiv = i;
+      if (m[ipiv][k] == 0.) return false;
+      if (ipiv != k) for (int j = 0; j <= NPAR; ++j) swap(m[k][j], m[ipiv][j]);
+      for (int i = k+1; i < NPAR; ++i) {
+	double f = m[i][k]/m[k][k];
+	for (int j = k; j <= NPAR; ++j) m[i][j] -= f*m[k][j];
+      }
+    }
+    for (int i = NPAR-1; i >= 0; --i) {
+      double s = m[i][NPAR];
+      for (int j = i+1; j < NPAR; ++j) s -= m[i][j]*x[j];
+      x[i] = s/m[i][i];
+    }
+    return true;
+  }
+}
+
+// ----------------------------------------------------------------------
+GainPedestalFitter::GainPedestalFitter(int model, int nthreads) :
+  fModel(model), fXmax(TANH == model ? 1700. : 1800.), fThreads(nthreads, BLOCK),
+  fCurves(0), fResults(0) {
+}
+
+// ----------------------------------------------------------------------
+GainPedestalFitter::~GainPedestalFitter() {
+}
+
+// ----------------------------------------------------------------------
+double GainPedestalFitter::chi2(const curve &c, const double *p, double *jtj, double *jtr) {
+  const double c2pi = 1.1283791670955126; // 2/sqrt(pi)
+  double sum(0.), d[NPAR];
+  if (jtj) {
+    for (int i = 0; i < NPAR*NPAR; ++i) jtj[i] = 0.;
+    for (int i = 0; i < NPAR; ++i) jtr[i] = 0.;
+  }
+  for (unsigned int i = 0; i < c.x.size(); ++i) {
+    if (c.e[i] <= 0. || c.x[i] < 0. || c.x[i] > fXmax) continue;
+    double x = c.x[i], f(0.);
+    if (ERR == fModel) {
+      double u = (x - p[0])/p[1];
+      double erfu = erf(u);
+      f = p[3]*(erfu + p[2]);
+      if (jtj) {
+	double g = p[3]*c2pi*exp(-u*u)/p[1];
+	d[0] = -g;
+	d[1] = -g*u;
+	d[2] = p[3];
+	d[3] = erfu + p[2];
+      }
+    } else {
+      double t = tanh(p[0]*x - p[1]);
+      f = p[3] + p[2]*t;
+      if (jtj) {
+	double s = p[2]*(1. - t*t);
+	d[0] = s*x;
+	d[1] = -s;
+	d[2] = t;
+	d[3] = 1.;
+      }
+    }
+    double w = 1./(c.e[i]*c.e[i]);
+    double r = c.y[i] - f;
+    sum += w*r*r;
+    if (jtj) {
+      for (int k = 0; k < NPAR; ++k) {
+	jtr[k] += w*d[k]*r;
+	for (int l = 0; l < NPAR; ++l) jtj[k*NPAR + l] += w*d[k]*d[l];
+      }
+    }
+  }
+  return sum;
+}
+
+// ----------------------------------------------------------------------
+GainPedestalFitter::result GainPedestalFitter::fit(const curve &c) {
+  result r;
+  for (int i = 0; i < NPAR; ++i) r.p[i] = r.e[i] = 0.;
+  r.chi2   = 0.;
+  r.ndf    = 0;
+  r.fitted = false;
+
+  // -- starting values and limits of PixInitFunc::gpErr() and PixInitFunc::gpTanH()
+  int npoints(0);
+  double ymax(0.), ymin(0.), xhalf(0.);
+  for (unsigned int i = 0; i < c.x.size(); ++i) {
+    if (c.y[i] > ymax) ymax = c.y[i];
+    if (c.y[i] < ymin) ymin = c.y[i];
+    if (c.e[i] > 0. && c.x[i] >= 0. && c.x[i] <= fXmax) ++npoints;
+  }
+  bool first(true);
+  for (unsigned int i = 0; i < c.x.size(); ++i) {
+    if (c.y[i] > 0.5*ymax && (first || c.x[i] < xhalf)) {
+      xhalf = c.x[i];
+      first = false;
+    }
+  }
+
+  double p[NPAR], lo[NPAR], hi[NPAR];
+  for (int i = 0; i < NPAR; ++i) {
+    lo[i] = -HUGE_VAL;
+    hi[i] = HUGE_VAL;
+  }
+  if (ERR == fModel) {
+    p[0] = xhalf;
+    p[1] = 250.;
+    p[2] = 1.;
+    p[3] = 0.5*ymax;
+    lo[1] = 50.;
+    hi[1] = 1000.;
+  } else {
+    double middle = ymax - ymin;
+    p[0] = 1.4e-3;
+    p[1] = 0.8;
+    p[2] = middle;
+    p[3] = ymax - middle;
+    lo[0] = 1.e-3; hi[0] = 2.e-3;
+    lo[1] = 0.;    hi[1] = 20.;
+    if (middle > 0.) {
+      lo[2] = 0.;  hi[2] = 2*middle;
+    }
+  }
+
+  r.ndf = npoints - NPAR;
+  if (npoints < NPAR) {
+    for (int i = 0; i < NPAR; ++i) r.p[i] = p[i];
+    return r;
+  }
+
+  // -- Levenberg-Marquardt, steps are clipped at the parameter limits
+  double jtj[NPAR*NPAR], jtr[NPAR], a[NPAR*NPAR], delta[NPAR], q[NPAR];
+  double lambda(1.e-3);
+  double c2 = chi2(c, p, jtj, jtr);
+  for (int iter = 0; iter < 500; ++iter) {
+    bool improved(false);
+    double c2new(c2);
+    while (lambda < 1.e10) {
+      // -- parameters at a limit which the step would cross are kept fixed
+      bool fixed[NPAR] = {false, false, false, false};
+      bool ok(false);
+      for (int pass = 0; pass < NPAR; ++pass) {
+	double b[NPAR];
+	for (int i = 0; i < NPAR; ++i) {
+	  for (int j = 0; j < NPAR; ++j) a[i*NPAR + j] = ((fixed[i] || fixed[j]) ? 0. : jtj[i*NPAR + j]);
+	  a[i*NPAR + i] = (fixed[i] ? 1. : jtj[i*NPAR + i]*(1. + lambda));
+	  b[i] = (fixed[i] ? 0. : jtr[i]);
+	}
+	ok = solve(a, b, delta);
+	if (!ok) break;
+	bool again(false);
+	for (int i = 0; i < NPAR; ++i) {
+	  if (fixed[i]) continue;
+	  if ((p[i] <= lo[i] && delta[i] < 0.) || (p[i] >= hi[i] && delta[i] > 0.)) {
+	    fixed[i] = true;
+	    again = true;
+	  }
+	}
+	if (!again) break;
+      }
+      if (ok) {
+	for (int i = 0; i < NPAR; ++i) q[i] = min(hi[i], max(lo[i], p[i] + delta[i]));
+	if (ERR != fModel || q[1] != 0.) {
+	  c2new = chi2(c, q);
+	  if (c2new < c2) {
+	    for (int i = 0; i < NPAR; ++i) p[i] = q[i];
+	    lambda *= 0.1;
+	    improved = true;
+	    break;
+	  }
+	}
+      }
+      lambda *= 10.;
+    }
+    if (!improved) break;
+    bool converged = (c2 - c2new < 1.e-9*c2 + 1.e-12);
+    c2 = chi2(c, p, jtj, jtr);
+    if (converged) break;
+  }
+
+  // -- parabolic errors from the inverse of the curvature matrix
+  for (int k = 0; k < NPAR; ++k) {
+    double unit[NPAR], column[NPAR];
+    for (int i = 0; i < NPAR; ++i) unit[i] = (i == k ? 1. : 0.);
+    if (solve(jtj, unit, column) && column[k] > 0.) r.e[k] = sqrt(column[k]);
+  }
+
+  for (int i = 0; i < NPAR; ++i) r.p[i] = p[i];
+  r.chi2   = c2;
+  r.fitted = true;
+  return r;
+}
+
+// ----------------------------------------------------------------------
+void GainPedestalFitter::fit(const vector<curve> &curves, vector<result> &results) {
+  results.resize(curves.size());
+  fCurves  = &curves;
+  fResults = &results;
+  fThreads.run(*this, curves.size());
+  fCurves  = 0;
+  fResults = 0;
+}
+
+// ----------------------------------------------------------------------
+void GainPedestalFitter::run(unsigned int first, unsigned int last) {
+  for (unsigned int i = first; i < last; ++i) (*fResults)[i] = fit((*fCurves)[i]);
+}
@@ -0,0 +1,63 @@
+#ifndef GAINPEDESTALFITTER_H
+#define GAINPEDESTALFITTER_H
+
+#include "pxardllexport.h"
+
+#include <vector>
+
+#include "FitThreads.hh"
+
+/** Fit of pulse height vs. vcal curves without ROOT.
+ *
+ *  The two models of PHCalibration, with the starting values, parameter limits and
+ *  fit ranges of PixInitFunc::gpErr() and PixInitFunc::gpTanH():
+ *    ERR:  p3*(erf((x-p0)/p1) + p2)
+ *    TANH: p3 + p2*tanh(p0*x - p1)
+ *  The chi2 is minimized with Levenberg-Marquardt with analytic derivatives, the
+ *  parameters are kept inside their limits. Many curves are fitted in parallel on a
+ *  pool of threads. The parameters are not identical to the ROOT fit, tools/fitcheck
+ *  checks that they agree within 0.1 of the ROOT parameter errors, or that the
+ *  native chi2 is not larger.
+ */
+class DLLEXPORT GainPedestalFitter : private FitThreads::task {
+public:
+  enum {ERR = 0, TANH = 1};
+
+  /** one curve: points (x, y, error), points with error <= 0 are not used (as in TH1::Fit) */
+  struct curve {
+    std::vector<double> x, y, e;
+    void add(double xp, double yp, double ep) {x.push_back(xp); y.push_back(yp); e.push_back(ep);}
+  };
+
+  struct result {
+    double p[4], e[4];
+    double chi2;
+    int    ndf;
+    bool   fitted;  ///< false if there were not enough points
+  };
+
+  /** nthreads = 0: one thread per online CPU */
+  GainPedestalFitter(int model, int nthreads = 0);
+  ~GainPedestalFitter();
+
+  result fit(const curve &c);
+  /** fit all curves, results in the same order */
+  void fit(const std::vector<curve> &curves, std::vector<result> &results);
+
+  int getModel() {return fModel;}
+  int getNThreads() {return fThreads.getNThreads();}
+
+private:
+  void run(unsigned int first, unsigned int last);
+  double chi2(const curve &c, const double *p, double *jtj = 0, double *jtr = 0);
+
+  int fModel;
+  double fXmax; ///< upper end of the fit range
+  FitThreads fThreads;
+
+  // -- the curves and results of the current fit()
+  const std::vector<curve> *fCurves;
+  std::vector<result>      *fResults;
+};
+
+#endif
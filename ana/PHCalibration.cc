@@ -7,7 +7,7 @@
 using namespace std;
 
 // ----------------------------------------------------------------------
-PHCalibration::PHCalibration(int mode): fMode(mode) {
+PHCalibration::PHCalibration(int mode): fMode(mode), fLookupTable(false) {
 
 }
 
@@ -19,6 +19,49 @@ PHCalibration::~PHCalibration() {
 
 // ----------------------------------------------------------------------
 double PHCalibration::vcal(int iroc, int icol, int irow, double ph) {
+  if (fLookupTable) {
+    int iph = static_cast<int>(ph); 
+    if (iph == ph && iph >= 0 && iph < 256 && iroc >= 0 && iroc < static_cast<int>(fParameters.size())
+	&& icol >= 0 && icol < 52 && irow >= 0 && irow < 80) {
+      int ipix = iroc*4160 + icol*80 + irow; 
+      if (!fTableFilled[ipix]) fillTable(ipix); 
+      return fTable[ipix*256 + iph]; 
+    }
+  }
+  return vcalDirect(iroc, icol, irow, ph); 
+}
+
+// ----------------------------------------------------------------------
+void PHCalibration::vcal(const pxar::pixel *hits, size_t n, double *out) {
+  for (size_t i = 0; i < n; ++i) {
+    out[i] = vcal(hits[i].roc(), hits[i].column(), hits[i].row(), hits[i].value()); 
+  }
+}
+
+// ----------------------------------------------------------------------
+void PHCalibration::setLookupTable(bool x) {
+  fLookupTable = x; 
+  fTable.clear(); 
+  fTableFilled.clear(); 
+  if (fLookupTable) {
+    fTable.resize(fParameters.size()*4160*256); 
+    fTableFilled.resize(fParameters.size()*4160, false); 
+  }
+}
+
+// ----------------------------------------------------------------------
+void PHCalibration::fillTable(int ipix) {
+  int iroc = ipix/4160; 
+  int icol = (ipix%4160)/80; 
+  int irow = ipix%80; 
+  for (int iph = 0; iph < 256; ++iph) {
+    fTable[ipix*256 + iph] = static_cast<float>(vcalDirect(iroc, icol, irow, iph)); 
+  }
+  fTableFilled[ipix] = true; 
+}
+
+// ----------------------------------------------------------------------
+double PHCalibration::vcalDirect(int iroc, int icol, int irow, double ph) {
   if (0 == fMode) {
     return vcalErr(iroc, icol, irow, ph); 
   } else if (1 == fMode) {
@@ -94,6 +137,7 @@ double PHCalibration::phErr(int iroc, int icol, int irow, double vcal) {
 // ----------------------------------------------------------------------
 void PHCalibration::setPHParameters(std::vector<std::vector<gainPedestalParameters> >v) {
   fParameters = v; 
+  setLookupTable(fLookupTable); 
 } 
 
 // ----------------------------------------------------------------------
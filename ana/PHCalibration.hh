@@ -20,6 +20,12 @@ public:
 
   double vcal(int iroc, int icol, int irow, double ph);
   double ph(int iroc, int icol, int irow, double vcal);
+  /// out[i] = vcal(roc, column, row, value) of hits[i]
+  void vcal(const pxar::pixel *hits, size_t n, double *out);
+
+  /// tabulate vcal(ph) for ph = 0..255, filled per pixel on its first use (4 MB per ROC)
+  void setLookupTable(bool x); 
+  bool lookupTable() {return fLookupTable;}
 
   double vcalErr(int iroc, int icol, int irow, double ph);
   double phErr(int iroc, int icol, int irow, double vcal);
@@ -32,8 +38,15 @@ public:
   std::string getParameters(int iroc, int icol, int irow); 
 
  private: 
+  double vcalDirect(int iroc, int icol, int irow, double ph);
+  void   fillTable(int ipix); 
+
   int fMode; 
   std::vector<std::vector<gainPedestalParameters> > fParameters;
+
+  bool               fLookupTable; 
+  std::vector<float> fTable;       ///< 256 entries per pixel, pixel index = iroc*4160 + icol*80 + irow
+  std::vector<bool>  fTableFilled; 
   
 };
 
@@ -17,9 +17,26 @@
 
 #include "PixUtil.hh"
 #include "PixInitFunc.hh"
+#include "GainPedestalFitter.hh"
 
 using namespace std;
 
+namespace {
+  // -- fit all histograms in parallel, with the points TH1::Fit() would use (bins with errors)
+  void fitAll(int model, const vector<TH1D*> &hists, vector<GainPedestalFitter::result> &results) {
+    vector<GainPedestalFitter::curve> curves(hists.size()); 
+    for (unsigned int i = 0; i < hists.size(); ++i) {
+      for (int ib = 1; ib <= hists[i]->GetNbinsX(); ++ib) {
+	if (hists[i]->GetBinError(ib) > 0.) {
+	  curves[i].add(hists[i]->GetBinCenter(ib), hists[i]->GetBinContent(ib), hists[i]->GetBinError(ib)); 
+	}
+      }
+    }
+    GainPedestalFitter fitter(model); 
+    fitter.fit(curves, results); 
+  }
+}
+
 // ----------------------------------------------------------------------
 anaGainPedestal::anaGainPedestal(string dir, int nrocs): fNrocs(nrocs), fDirectory(dir) {
   cout << "anaGainPedestal ctor, nrocs = " << fNrocs << " directory = " << fDirectory << endl;
@@ -94,7 +111,7 @@ void anaGainPedestal::test(double y0, double y1) {
 
 // ----------------------------------------------------------------------
 void anaGainPedestal::fitTanH(int roc, int col, int row, bool draw) {
-  int lroc, lcol, lrow; 
+  int lroc; 
 
   PixInitFunc pif; 
   TF1 *f(0); 
@@ -106,22 +123,27 @@ void anaGainPedestal::fitTanH(int roc, int col, int row, bool draw) {
     hsummary.insert(make_pair(Form("cd_C%d", i), h)); 
   }
 
-  for (unsigned int ihist = 0; ihist < fHists.size(); ++ihist) {
-    PixUtil::str2rcr(fHists[ihist].first, lroc, lcol, lrow); 
-    if (roc > -1 && lroc != roc) continue;
-    if (col > -1 && lcol != col) continue;
-    if (row > -1 && lrow != row) continue;
+  vector<pair<int, TH1D*> > selected = select(roc, col, row); 
+  vector<GainPedestalFitter::result> fits; 
+  if (!draw) {
+    vector<TH1D*> hists; 
+    for (unsigned int i = 0; i < selected.size(); ++i) hists.push_back(selected[i].second); 
+    fitAll(GainPedestalFitter::TANH, hists, fits); 
+  }
 
-    h = fHists[ihist].second;
-    if (0 == h) break;
+  for (unsigned int i = 0; i < selected.size(); ++i) {
+    lroc = selected[i].first; 
+    h = selected[i].second;
+    if (!draw) {
+      hsummary[Form("cd_C%d", lroc)]->Fill(fits[i].chi2/fits[i].ndf); 
+      continue;
+    }
     f = pif.gpTanH(h);
     h->Fit(f);
 
     hsummary[Form("cd_C%d", lroc)]->Fill(f->GetChisquare()/f->GetNDF()); 
-    if (draw) {
-      c0->Modified();
-      c0->Update();
-    }
+    c0->Modified();
+    c0->Update();
   }
 
   // -- plot summary
@@ -138,7 +160,7 @@ void anaGainPedestal::fitTanH(int roc, int col, int row, bool draw) {
 
 // ----------------------------------------------------------------------
 void anaGainPedestal::fitErr(int roc, int col, int row, bool draw) {
-  int lroc, lcol, lrow; 
+  int lroc; 
 
   PixInitFunc pif; 
   TF1 *f(0); 
@@ -162,29 +184,45 @@ void anaGainPedestal::fitErr(int roc, int col, int row, bool draw) {
     hsummary.insert(make_pair(Form("p3_C%d", i), h)); 
   }
 
-  vector<TH1D*> hproblems; 
-  for (unsigned int ihist = 0; ihist < fHists.size(); ++ihist) {
-    PixUtil::str2rcr(fHists[ihist].first, lroc, lcol, lrow); 
-    if (roc > -1 && lroc != roc) continue;
-    if (col > -1 && lcol != col) continue;
-    if (row > -1 && lrow != row) continue;
+  vector<pair<int, TH1D*> > selected = select(roc, col, row); 
+  vector<GainPedestalFitter::result> fits; 
+  if (!draw) {
+    vector<TH1D*> hists; 
+    for (unsigned int i = 0; i < selected.size(); ++i) hists.push_back(selected[i].second); 
+    fitAll(GainPedestalFitter::ERR, hists, fits); 
+  }
 
-    h = fHists[ihist].second;
-    if (0 == h) break;
-    f = pif.gpErr(h);
-    if (draw) cout << "fitting " <<  h->GetName() << endl;
-    h->Fit(f, (draw?"":"q"));
-    hsummary[Form("cd_C%d", lroc)]->Fill(f->GetChisquare()/f->GetNDF()); 
-    hsummary[Form("p0_C%d", lroc)]->Fill(f->GetParameter(0)); 
-    hsummary[Form("p1_C%d", lroc)]->Fill(f->GetParameter(1)); 
-    hsummary[Form("p2_C%d", lroc)]->Fill(f->GetParameter(2)); 
-    hsummary[Form("p3_C%d", lroc)]->Fill(f->GetParameter(3)); 
+  vector<TH1D*> hproblems; 
+  double chi2(0.), p[4]; 
+  int ndf(0); 
+  for (unsigned int i = 0; i < selected.size(); ++i) {
+    lroc = selected[i].first; 
+    h = selected[i].second;
+    if (draw) {
+      f = pif.gpErr(h);
+      cout << "fitting " <<  h->GetName() << endl;
+      h->Fit(f, "");
+      chi2 = f->GetChisquare(); 
+      ndf  = f->GetNDF(); 
+      for (int ip = 0; ip < 4; ++ip) p[ip] = f->GetParameter(ip); 
+    } else {
+      chi2 = fits[i].chi2; 
+      ndf  = fits[i].ndf; 
+      for (int ip = 0; ip < 4; ++ip) p[ip] = fits[i].p[ip]; 
+    }
+    hsummary[Form("cd_C%d", lroc)]->Fill(chi2/ndf); 
+    hsummary[Form("p0_C%d", lroc)]->Fill(p[0]); 
+    hsummary[Form("p1_C%d", lroc)]->Fill(p[1]); 
+    hsummary[Form("p2_C%d", lroc)]->Fill(p[2]); 
+    hsummary[Form("p3_C%d", lroc)]->Fill(p[3]); 
     if (draw) {
       c0->Modified();
       c0->Update();
     }
-    if ((f->GetNDF() > 0) && f->GetChisquare()/f->GetNDF() > 3) {
+    if ((ndf > 0) && chi2/ndf > 3) {
       cout << "problem: " << h->GetName() << endl;
+      // -- attach the fit for the plot below
+      if (!draw) h->Fit(pif.gpErr(h), "q"); 
       hproblems.push_back(h); 
     }
   }
@@ -206,6 +244,21 @@ void anaGainPedestal::fitErr(int roc, int col, int row, bool draw) {
   }
 }
 
+// ----------------------------------------------------------------------
+vector<pair<int, TH1D*> > anaGainPedestal::select(int roc, int col, int row) {
+  int lroc, lcol, lrow; 
+  vector<pair<int, TH1D*> > selected; 
+  for (unsigned int ihist = 0; ihist < fHists.size(); ++ihist) {
+    PixUtil::str2rcr(fHists[ihist].first, lroc, lcol, lrow); 
+    if (roc > -1 && lroc != roc) continue;
+    if (col > -1 && lcol != col) continue;
+    if (row > -1 && lrow != row) continue;
+    if (0 == fHists[ihist].second) break;
+    selected.push_back(make_pair(lroc, fHists[ihist].second)); 
+  }
+  return selected; 
+}
+
 // ----------------------------------------------------------------------
 void anaGainPedestal::readAsciiFiles(string directory) {
   vector<string> files = glob(directory); 
@@ -30,6 +30,9 @@ class DLLEXPORT anaGainPedestal {
   std::vector<std::string> glob(std::string directory, std::string basename = "phCalibration_");
   
 private: 
+  /// (roc, histogram) of all pixels matching roc, col, row (-1: all)
+  std::vector<std::pair<int, TH1D*> > select(int roc, int col, int row);
+
   TCanvas                     *c0;
   int                          fNrocs; 
   std::string                  fDirectory;
@@ -16,11 +16,220 @@
 
 using namespace pxar;
 
+namespace {
+
+  // Attaches a consumer for condensed data to the HAL for the lifetime of the object:
+  class consumerGuard {
+    hal * _hal;
+  public:
+    consumerGuard(hal * h, condensedEventConsumer * consumer) : _hal(h) { _hal->setEventConsumer(consumer); }
+    ~consumerGuard() { _hal->setEventConsumer(NULL); }
+  };
+
+  // Holds the testboard lock of the HAL for the lifetime of the object, and
+  // makes the logging context of the pxarCore instance the current one:
+  class testboardGuard {
+    hal * _hal;
+    logContextGuard _log;
+  public:
+    testboardGuard(hal * h, logContext * context) : _hal(h), _log(context) { _hal->lockTestboard(); }
+    ~testboardGuard() { _hal->unlockTestboard(); }
+  };
+
+#ifndef WIN32
+  pthread_mutex_t dictionaryLock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+  // Creates the dictionary singletons. C++98 does not guarantee a thread-safe
+  // construction on first use, so it is serialized here:
+  void initDictionaries() {
+#ifndef WIN32
+    pthread_mutex_lock(&dictionaryLock);
+#endif
+    RegisterDictionary::getInstance();
+    DeviceDictionary::getInstance();
+    ProbeDictionary::getInstance();
+    PatternDictionary::getInstance();
+    TriggerDictionary::getInstance();
+#ifndef WIN32
+    pthread_mutex_unlock(&dictionaryLock);
+#endif
+  }
+
+  // Assigns DAC values to the condensed events of a DAC scan and passes them on,
+  // following the same logic as pxarCore::repackDacScanData:
+  class dacScanStream : public condensedEventConsumer {
+    dacScanConsumer & _consumer;
+    uint8_t _dacStep, _dacMin, _dacMax;
+    uint16_t _flags;
+    size_t _currentDAC;
+    uint8_t _expected_column, _expected_row;
+  public:
+    size_t events;
+    dacScanStream(dacScanConsumer & consumer, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint16_t flags)
+      : _consumer(consumer), _dacStep(dacStep), _dacMin(dacMin), _dacMax(dacMax), _flags(flags),
+	_currentDAC(dacMin), _expected_column(0), _expected_row(0), events(0) {}
+
+    void consume(Event & evt) {
+      if(_currentDAC > _dacMax) { _currentDAC = _dacMin; }
+
+      // Check for pulsed pixels being present:
+      if((_flags&FLAG_CHECK_ORDER) != 0) {
+	for(std::vector<pixel>::iterator pixit = evt.pixels.begin(); pixit != evt.pixels.end(); ++pixit) {
+	  if(pixit->column() != _expected_column || pixit->row() != _expected_row) {
+	    if((_flags&FLAG_FORCE_UNMASKED) != 0) { LOG(logDEBUGPIPES) << "This is a background hit: " << (*pixit); }
+	    else {
+	      LOG(logERROR) << "This pixel doesn't belong here: " << (*pixit) << ". Expected [" << static_cast<int>(_expected_column) << "," << static_cast<int>(_expected_row) << ",x]";
+	    }
+	    // Convention: set a negative pixel value for out-of-order pixel hits:
+	    pixit->setValue(-1*pixit->value());
+	  }
+	}
+      }
+
+      _consumer.consume(static_cast<uint8_t>(_currentDAC), evt.pixels);
+      events++;
+
+      // Advance the expected pixel address if we reached the upper DAC scan boundary:
+      if((_flags&FLAG_CHECK_ORDER) != 0 && _currentDAC == _dacMax) {
+	_expected_row++;
+	if(_expected_row >= ROC_NUMROWS) { _expected_row = 0; _expected_column++; }
+	if(_expected_column >= ROC_NUMCOLS) { _expected_row = 0; _expected_column = 0; }
+      }
+
+      // Move to next DAC setting:
+      _currentDAC += _dacStep;
+    }
+  };
+
+  // Assigns DAC value pairs to the condensed events of a DAC-DAC scan and passes them on,
+  // following the same logic as pxarCore::repackDacDacScanData:
+  class dacDacScanStream : public condensedEventConsumer {
+    dacDacScanConsumer & _consumer;
+    uint8_t _dac1step, _dac1min, _dac1max;
+    uint8_t _dac2step, _dac2min, _dac2max;
+    size_t _current1dac, _current2dac;
+  public:
+    size_t events;
+    dacDacScanStream(dacDacScanConsumer & consumer, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max)
+      : _consumer(consumer), _dac1step(dac1step), _dac1min(dac1min), _dac1max(dac1max),
+	_dac2step(dac2step), _dac2min(dac2min), _dac2max(dac2max),
+	_current1dac(dac1min), _current2dac(dac2min), events(0) {}
+
+    void consume(Event & evt) {
+      if(_current2dac > _dac2max) {
+	_current2dac = _dac2min;
+	_current1dac += _dac1step;
+      }
+      if(_current1dac > _dac1max) { _current1dac = _dac1min; }
+
+      _consumer.consume(static_cast<uint8_t>(_current1dac), static_cast<uint8_t>(_current2dac), evt.pixels);
+      events++;
+      _current2dac += _dac2step;
+    }
+  };
+
+  // Threshold search over the pixels of consecutive DAC settings. Keeps a dense
+  // state per pixel, indexed by (roc, column, row), instead of searching lists:
+  class thresholdFinder {
+    uint16_t _threshold;
+    size_t _rocs, _columns, _rows;
+    // Position of the pixel in the result vector, -1 if not seen yet:
+    std::vector<int32_t> _position;
+    // Efficiency at the previous DAC setting:
+    std::vector<uint8_t> _oldvalue;
+    // Threshold has been crossed:
+    std::vector<bool> _found;
+
+    size_t index(pixel & px) { return (static_cast<size_t>(px.roc())*_columns + px.column())*_rows + px.row(); }
+
+  public:
+    thresholdFinder(uint16_t threshold) : _threshold(threshold), _rocs(0), _columns(0), _rows(0), _position(), _oldvalue(), _found() {}
+
+    // Make sure all given pixels are covered by the state arrays. Must be called
+    // for all data before the first call to add():
+    void extend(std::vector<pixel> & pixels) {
+      size_t rocs = _rocs, columns = _columns, rows = _rows;
+      for(std::vector<pixel>::iterator px = pixels.begin(); px != pixels.end(); ++px) {
+	rocs = std::max(rocs, static_cast<size_t>(px->roc()) + 1);
+	columns = std::max(columns, static_cast<size_t>(px->column()) + 1);
+	rows = std::max(rows, static_cast<size_t>(px->row()) + 1);
+      }
+      if(rocs == _rocs && columns == _columns && rows == _rows) return;
+      _rocs = rocs; _columns = columns; _rows = rows;
+      _position.assign(_rocs*_columns*_rows, -1);
+      _oldvalue.assign(_rocs*_columns*_rows, 0);
+      _found.assign(_rocs*_columns*_rows, false);
+    }
+
+    bool found(pixel & px) { return _found[index(px)]; }
+
+    // Clear the state of all pixels in the given result vector:
+    void reset(std::vector<pixel> & result) {
+      for(std::vector<pixel>::iterator px = result.begin(); px != result.end(); ++px) {
+	size_t i = index(*px);
+	_position[i] = -1;
+	_oldvalue[i] = 0;
+	_found[i] = false;
+      }
+    }
+
+    // Process one pixel at DAC value "dac", adds the pixel to the result vector at its first appearance:
+    void add(uint8_t dac, pixel & px, std::vector<pixel> & result) {
+      size_t i = index(px);
+
+      // Check if for this pixel a threshold has been found already and we can skip the rest:
+      if(_found[i]) return;
+
+      // Pixel is known:
+      if(_position[i] >= 0) {
+	// Calculate efficiency deltas and slope:
+	uint8_t delta_old = abs(_oldvalue[i] - _threshold);
+	uint8_t delta_new = abs(static_cast<uint8_t>(px.value()) - _threshold);
+	bool positive_slope = (static_cast<uint8_t>(px.value()) - _oldvalue[i] > 0 ? true : false);
+
+	// Check which value is closer to the threshold. Only if the slope is positive AND
+	// the new delta between value and threshold is *larger* then the old delta, we 
+	// found the threshold. If slope is negative, we just have a ripple in the DAC's 
+	// distribution:
+	if(positive_slope && !(delta_new < delta_old)) {
+	  _found[i] = true;
+	  return;
+	}
+
+	// No threshold found yet, update the DAC threshold value for the pixel:
+	result[_position[i]].setValue(dac);
+	// Update the old efficiency:
+	_oldvalue[i] = static_cast<uint8_t>(px.value());
+      }
+      // Pixel is new, just adding it:
+      else {
+	// If the pixel is above threshold at first appearance, the respective
+	// DAC value is set as its threshold:
+	if(px.value() >= _threshold) { _found[i] = true; }
+
+	// Store the pixel with original efficiency
+	_oldvalue[i] = static_cast<uint8_t>(px.value());
+
+	// Push pixel to result vector with current DAC as value field:
+	px.setValue(dac);
+	_position[i] = static_cast<int32_t>(result.size());
+	result.push_back(px);
+      }
+    }
+  };
+}
+
 pxarCore::pxarCore(std::string usbId, std::string logLevel) : 
   _daq_running(false), 
   _daq_buffersize(DTB_SOURCE_BUFFER_SIZE),
   _daq_startstop_warning(false)
 {
+  _log = new logContext();
+
+  // Several instances may be created in parallel threads, the dictionaries are
+  // set up once before:
+  initDictionaries();
 
   LOG(logQUIET) << "Instanciating API for " << PACKAGE_STRING;
 
@@ -36,8 +245,12 @@ pxarCore::pxarCore(std::string usbId, std::string logLevel) :
 }
 
 pxarCore::~pxarCore() {
-  delete _dut;
-  delete _hal;
+  {
+    logContextGuard log(_log);
+    delete _dut;
+    delete _hal;
+  }
+  delete _log;
 }
 
 std::string pxarCore::getVersion() { return PACKAGE_STRING; }
@@ -45,6 +258,7 @@ std::string pxarCore::getVersion() { return PACKAGE_STRING; }
 bool pxarCore::initTestboard(std::vector<std::pair<std::string,uint8_t> > sig_delays,
 			std::vector<std::pair<std::string,double> > power_settings,
 			std::vector<std::pair<std::string,uint8_t> > pg_setup) {
+  testboardGuard tblock(_hal, _log);
 
   // Check the HAL status before doing anything else:
   if(!_hal->compatible()) return false;
@@ -66,6 +280,7 @@ bool pxarCore::initTestboard(std::vector<std::pair<std::string,uint8_t> > sig_de
 }
 
 void pxarCore::setTestboardDelays(std::vector<std::pair<std::string,uint8_t> > sig_delays) {
+  testboardGuard tblock(_hal, _log);
   if(!_hal->status()) {
     LOG(logERROR) << "Signal delays not updated!";
     return;
@@ -76,6 +291,7 @@ void pxarCore::setTestboardDelays(std::vector<std::pair<std::string,uint8_t> > s
 }
 
 void pxarCore::setPatternGenerator(std::vector<std::pair<std::string,uint8_t> > pg_setup) {
+  testboardGuard tblock(_hal, _log);
   if(!_hal->status()) {
     LOG(logERROR) << "Pattern generator not updated!";
     return;
@@ -86,6 +302,7 @@ void pxarCore::setPatternGenerator(std::vector<std::pair<std::string,uint8_t> >
 }
 
 void pxarCore::setTestboardPower(std::vector<std::pair<std::string,double> > power_settings) {
+  testboardGuard tblock(_hal, _log);
   if(!_hal->status()) {
     LOG(logERROR) << "Voltages/current limits not upated!";
     return;
@@ -101,6 +318,7 @@ bool pxarCore::initDUT(uint8_t hubid,
 		       std::string roctype,
 		       std::vector<std::vector<std::pair<std::string,uint8_t> > > rocDACs,
 		       std::vector<std::vector<pixelConfig> > rocPixels) {
+  testboardGuard tblock(_hal, _log);
   std::vector<uint8_t> rocI2Cs;
   return initDUT(std::vector<uint8_t>(1,hubid), tbmtype, tbmDACs, roctype, rocDACs, rocPixels, rocI2Cs);
 }
@@ -111,6 +329,7 @@ bool pxarCore::initDUT(std::vector<uint8_t> hubids,
 		       std::string roctype,
 		       std::vector<std::vector<std::pair<std::string,uint8_t> > > rocDACs,
 		       std::vector<std::vector<pixelConfig> > rocPixels) {
+  testboardGuard tblock(_hal, _log);
   std::vector<uint8_t> rocI2Cs;
   return initDUT(hubids, tbmtype, tbmDACs, roctype, rocDACs, rocPixels, rocI2Cs);
 }
@@ -132,6 +351,7 @@ bool pxarCore::initDUT(std::vector<uint8_t> hubids,
 		       std::vector<std::vector<std::pair<std::string,uint8_t> > > rocDACs,
 		       std::vector<std::vector<pixelConfig> > rocPixels,
 		       std::vector<uint8_t> rocI2Cs) {
+  testboardGuard tblock(_hal, _log);
 
   // Check if the HAL is ready:
   if(!_hal->status()) return false;
@@ -357,6 +577,7 @@ bool pxarCore::initDUT(std::vector<uint8_t> hubids,
       // Push the pixelConfigs into the rocConfig:
       newroc.pixels.push_back(*pixIt);
     }
+    newroc.updatePixelIndex();
 
     // Done. Enable bit is already set by rocConfig constructor.
     _dut->roc.push_back(newroc);
@@ -416,6 +637,7 @@ bool pxarCore::initDUT(std::vector<uint8_t> hubids,
 }
 
 bool pxarCore::programDUT() {
+  testboardGuard tblock(_hal, _log);
 
   if(!_dut->_initialized) {
     LOG(logERROR) << "DUT not initialized, unable to program it.";
@@ -511,7 +733,13 @@ uint8_t pxarCore::stringToDeviceCode(std::string name) {
 
 // DTB functions
 
+void pxarCore::setUsbBufferSize(uint32_t writeSize, uint32_t readSize) {
+  testboardGuard tblock(_hal, _log);
+  _hal->setUsbBufferSize(writeSize, readSize);
+}
+
 bool pxarCore::flashTB(std::string filename) {
+  testboardGuard tblock(_hal, _log);
 
   if(_hal->status() || _dut->status()) {
     LOG(logERROR) << "The testboard should only be flashed without initialization"
@@ -539,35 +767,56 @@ bool pxarCore::flashTB(std::string filename) {
 }
 
 double pxarCore::getTBia() {
+  testboardGuard tblock(_hal, _log);
   if(!_hal->status()) {return 0;}
   return _hal->getTBia();
 }
 
 double pxarCore::getTBva() {
+  testboardGuard tblock(_hal, _log);
   if(!_hal->status()) {return 0;}
   return _hal->getTBva();
 }
 
 double pxarCore::getTBid() {
+  testboardGuard tblock(_hal, _log);
   if(!_hal->status()) {return 0;}
   return _hal->getTBid();
 }
 
 double pxarCore::getTBvd() {
+  testboardGuard tblock(_hal, _log);
   if(!_hal->status()) {return 0;}
   return _hal->getTBvd();
 }
 
+std::vector<std::pair<std::string,double> > pxarCore::getTBpower() {
+  testboardGuard tblock(_hal, _log);
+  std::vector<std::pair<std::string,double> > power;
+  if(!_hal->status()) {return power;}
+
+  double va, vd, ia, id;
+  _hal->getTBpower(va, vd, ia, id);
+  power.push_back(std::make_pair("va",va));
+  power.push_back(std::make_pair("vd",vd));
+  power.push_back(std::make_pair("ia",ia));
+  power.push_back(std::make_pair("id",id));
+  return power;
+}
+
 
 void pxarCore::HVoff() {
+  testboardGuard tblock(_hal, _log);
   _hal->HVoff();
 }
 
 void pxarCore::HVon() {
+  testboardGuard tblock(_hal, _log);
   _hal->HVon();
 }
 
 void pxarCore::Poff() {
+  testboardGuard tblock(_hal, _log);
   _hal->Poff();
   // Reset the programmed state of the DUT (lost by turning off power)
   _dut->_programmed = false;
@@ -580,6 +829,7 @@ void pxarCore::Pon() {
 }
 
 bool pxarCore::SignalProbe(std::string probe, std::string name) {
+  testboardGuard tblock(_hal, _log);
 
   if(!_hal->status()) {return false;}
 
@@ -640,6 +890,7 @@ bool pxarCore::SignalProbe(std::string probe, std::string name) {
 
 
 std::vector<uint16_t> pxarCore::daqADC(std::string signalName, uint8_t gain, uint16_t nSample, uint8_t source, uint8_t start){
+  testboardGuard tblock(_hal, _log);
     
   std::vector<uint16_t> data;
   if(!_hal->status()) {return data;}
@@ -653,15 +904,38 @@ std::vector<uint16_t> pxarCore::daqADC(std::string signalName, uint8_t gain, uin
 }
 
 statistics pxarCore::getStatistics() {
+  testboardGuard tblock(_hal, _log);
   LOG(logINFO) << "Fetched DAQ statistics. Counters are being reset now.";
   // Return the accumulated number of decoding errors:
   return _hal->daqStatistics();
 }
 
+statistics pxarCore::peekStatistics() {
+  testboardGuard tblock(_hal, _log);
+  return _hal->daqStatistics(false);
+}
+
+void pxarCore::setLogContext(std::string name, std::string logLevel, FILE * stream) {
+  testboardGuard tblock(_hal, NULL);
+  _log->name = name;
+  _log->ownLevel = !logLevel.empty();
+  if(_log->ownLevel) { _log->level = Log::FromString(logLevel); }
+  _log->stream = stream;
+}
+
+void pxarCore::lockTestboard() {
+  _hal->lockTestboard();
+}
+
+void pxarCore::unlockTestboard() {
+  _hal->unlockTestboard();
+}
+
   
 // TEST functions
 
 bool pxarCore::setDAC(std::string dacName, uint8_t dacValue, uint8_t rocID) {
+  testboardGuard tblock(_hal, _log);
   
   if(!status()) {return false;}
 
@@ -704,6 +978,7 @@ bool pxarCore::setDAC(std::string dacName, uint8_t dacValue, uint8_t rocID) {
 }
 
 bool pxarCore::setDAC(std::string dacName, uint8_t dacValue) {
+  testboardGuard tblock(_hal, _log);
   
   if(!status()) {return false;}
 
@@ -749,6 +1024,7 @@ uint8_t pxarCore::getDACRange(std::string dacName) {
 }
 
 bool pxarCore::setTbmReg(std::string regName, uint8_t regValue, uint8_t tbmid) {
+  testboardGuard tblock(_hal, _log);
 
   if(!status()) {return 0;}
   
@@ -780,6 +1056,7 @@ bool pxarCore::setTbmReg(std::string regName, uint8_t regValue, uint8_t tbmid) {
 }
 
 bool pxarCore::setTbmReg(std::string regName, uint8_t regValue) {
+  testboardGuard tblock(_hal, _log);
 
   for(size_t tbms = 0; tbms < _dut->tbm.size(); ++tbms) {
     if(!setTbmReg(regName, regValue, tbms)) return false;
@@ -787,6 +1064,18 @@ bool pxarCore::setTbmReg(std::string regName, uint8_t regValue) {
   return true;
 }
 
+void pxarCore::startDACTransaction() {
+  testboardGuard tblock(_hal, _log);
+  if(!status()) {return;}
+  _hal->startTransaction();
+}
+
+bool pxarCore::commitDACTransaction() {
+  testboardGuard tblock(_hal, _log);
+  if(!status()) {return false;}
+  return _hal->commitTransaction();
+}
+
 std::vector< std::pair<uint8_t, std::vector<pixel> > > pxarCore::getPulseheightVsDAC(std::string dacName, uint8_t dacMin, uint8_t dacMax, uint16_t flags, uint16_t nTriggers) {
 
   // No step size provided - scanning all DACs with step size 1:
@@ -794,55 +1083,14 @@ std::vector< std::pair<uint8_t, std::vector<pixel> > > pxarCore::getPulseheightV
 }
 
 std::vector< std::pair<uint8_t, std::vector<pixel> > > pxarCore::getPulseheightVsDAC(std::string dacName, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint16_t flags, uint16_t nTriggers) {
+  testboardGuard tblock(_hal, _log);
 
-  if(!status()) {return std::vector< std::pair<uint8_t, std::vector<pixel> > >();}
-
-  // Check DAC range
-  if(dacMin > dacMax) {
-    // Swapping the range:
-    LOG(logWARNING) << "Swapping upper and lower bound.";
-    uint8_t temp = dacMin;
-    dacMin = dacMax;
-    dacMax = temp;
-  }
-
-  // Get the register number and check the range from dictionary:
-  uint8_t dacRegister;
-  if(!verifyRegister(dacName, dacRegister, dacMax, ROC_REG)) {
+  std::vector<Event> data;
+  if(!runDacScan(dacName, dacStep, dacMin, dacMax, flags, nTriggers, false, data)) {
     return std::vector< std::pair<uint8_t, std::vector<pixel> > >();
   }
-
-  // Setup the correct _hal calls for this test
-  HalMemFnPixelSerial   pixelfn      = &hal::SingleRocOnePixelDacScan;
-  HalMemFnPixelParallel multipixelfn = &hal::MultiRocOnePixelDacScan;
-  HalMemFnRocSerial     rocfn        = &hal::SingleRocAllPixelsDacScan;
-  HalMemFnRocParallel   multirocfn   = &hal::MultiRocAllPixelsDacScan;
-
-  // We want the pulse height back from the Map function, no internal flag needed.
-
-  // Load the test parameters into vector
-  std::vector<int32_t> param;
-  param.push_back(static_cast<int32_t>(dacRegister));
-  param.push_back(static_cast<int32_t>(dacMin));
-  param.push_back(static_cast<int32_t>(dacMax));
-  param.push_back(static_cast<int32_t>(flags));
-  param.push_back(static_cast<int32_t>(nTriggers));
-  param.push_back(static_cast<int32_t>(dacStep));
-
-  // check if the flags indicate that the user explicitly asks for serial execution of test:
-  std::vector<Event> data = expandLoop(pixelfn, multipixelfn, rocfn, multirocfn, param, false, flags);
   // repack data into the expected return format
-  std::vector< std::pair<uint8_t, std::vector<pixel> > > result = repackDacScanData(data,dacStep,dacMin,dacMax,flags);
-
-  // Reset the original value for the scanned DAC:
-  std::vector<rocConfig> enabledRocs = _dut->getEnabledRocs();
-  for (std::vector<rocConfig>::iterator rocit = enabledRocs.begin(); rocit != enabledRocs.end(); ++rocit){
-    uint8_t oldDacValue = _dut->getDAC(static_cast<size_t>(rocit - enabledRocs.begin()),dacName);
-    LOG(logDEBUGAPI) << "Reset DAC \"" << dacName << "\" to original value " << static_cast<int>(oldDacValue);
-    _hal->rocSetDAC(static_cast<uint8_t>(rocit - enabledRocs.begin()),dacRegister,oldDacValue);
-  }
-
-  return result;
+  return repackDacScanData(data,dacStep,dacMin,dacMax,flags);
 }
 
 std::vector< std::pair<uint8_t, std::vector<pixel> > > pxarCore::getEfficiencyVsDAC(std::string dacName, uint8_t dacMin, uint8_t dacMax, uint16_t flags, uint16_t nTriggers) {
@@ -852,56 +1100,18 @@ std::vector< std::pair<uint8_t, std::vector<pixel> > > pxarCore::getEfficiencyVs
 }
 
 std::vector< std::pair<uint8_t, std::vector<pixel> > > pxarCore::getEfficiencyVsDAC(std::string dacName, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint16_t flags, uint16_t nTriggers) {
+  testboardGuard tblock(_hal, _log);
 
-  if(!status()) {return std::vector< std::pair<uint8_t, std::vector<pixel> > >();}
-
-  // Check DAC range
-  if(dacMin > dacMax) {
-    // Swapping the range:
-    LOG(logWARNING) << "Swapping upper and lower bound.";
-    uint8_t temp = dacMin;
-    dacMin = dacMax;
-    dacMax = temp;
-  }
-
-  // Get the register number and check the range from dictionary:
-  uint8_t dacRegister;
-  if(!verifyRegister(dacName, dacRegister, dacMax, ROC_REG)) {
+  std::vector<Event> data;
+  if(!runDacScan(dacName, dacStep, dacMin, dacMax, flags, nTriggers, true, data)) {
     return std::vector< std::pair<uint8_t, std::vector<pixel> > >();
   }
-
-  // Setup the correct _hal calls for this test
-  HalMemFnPixelSerial   pixelfn      = &hal::SingleRocOnePixelDacScan;
-  HalMemFnPixelParallel multipixelfn = &hal::MultiRocOnePixelDacScan;
-  HalMemFnRocSerial     rocfn        = &hal::SingleRocAllPixelsDacScan;
-  HalMemFnRocParallel   multirocfn   = &hal::MultiRocAllPixelsDacScan;
-
-  // Load the test parameters into vector
-  std::vector<int32_t> param;
-  param.push_back(static_cast<int32_t>(dacRegister));  
-  param.push_back(static_cast<int32_t>(dacMin));
-  param.push_back(static_cast<int32_t>(dacMax));
-  param.push_back(static_cast<int32_t>(flags));
-  param.push_back(static_cast<int32_t>(nTriggers));
-  param.push_back(static_cast<int32_t>(dacStep));
-
-  // check if the flags indicate that the user explicitly asks for serial execution of test:
-  std::vector<Event> data = expandLoop(pixelfn, multipixelfn, rocfn, multirocfn, param, true, flags);
   // repack data into the expected return format
-  std::vector< std::pair<uint8_t, std::vector<pixel> > > result = repackDacScanData(data,dacStep,dacMin,dacMax,flags);
-
-  // Reset the original value for the scanned DAC:
-  std::vector<rocConfig> enabledRocs = _dut->getEnabledRocs();
-  for (std::vector<rocConfig>::iterator rocit = enabledRocs.begin(); rocit != enabledRocs.end(); ++rocit){
-    uint8_t oldDacValue = _dut->getDAC(static_cast<size_t>(rocit - enabledRocs.begin()),dacName);
-    LOG(logDEBUGAPI) << "Reset DAC \"" << dacName << "\" to original value " << static_cast<int>(oldDacValue);
-    _hal->rocSetDAC(static_cast<uint8_t>(rocit - enabledRocs.begin()),dacRegister,oldDacValue);
-  }
-
-  return result;
+  return repackDacScanData(data,dacStep,dacMin,dacMax,flags);
 }
 
 std::vector< std::pair<uint8_t, std::vector<pixel> > > pxarCore::getThresholdVsDAC(std::string dacName, std::string dac2name, uint8_t dac2min, uint8_t dac2max, uint16_t flags, uint16_t nTriggers) {
+  testboardGuard tblock(_hal, _log);
   // Get the full DAC range for scanning:
   uint8_t dac1min = 0;
   uint8_t dac1max = getDACRange(dacName);
@@ -910,12 +1120,14 @@ std::vector< std::pair<uint8_t, std::vector<pixel> > > pxarCore::getThresholdVsD
 }
 
 std::vector< std::pair<uint8_t, std::vector<pixel> > > pxarCore::getThresholdVsDAC(std::string dac1name, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, std::string dac2name, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint16_t flags, uint16_t nTriggers) {
+  testboardGuard tblock(_hal, _log);
   // No threshold level provided - set threshold to 50%:
   uint8_t threshold = 50;
   return getThresholdVsDAC(dac1name, dac1step, dac1min, dac1max, dac2name, dac2step, dac2min, dac2max, threshold, flags, nTriggers);
 }
 
 std::vector< std::pair<uint8_t, std::vector<pixel> > > pxarCore::getThresholdVsDAC(std::string dac1name, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, std::string dac2name, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint8_t threshold, uint16_t flags, uint16_t nTriggers) {
+  testboardGuard tblock(_hal, _log);
 
   if(!status()) {return std::vector< std::pair<uint8_t, std::vector<pixel> > >();}
 
@@ -997,70 +1209,14 @@ std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > pxar
 }
 
 std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > pxarCore::getPulseheightVsDACDAC(std::string dac1name, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, std::string dac2name, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint16_t flags, uint16_t nTriggers) {
+  testboardGuard tblock(_hal, _log);
 
-  if(!status()) {return std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > >();}
-
-  // Check DAC ranges
-  if(dac1min > dac1max) {
-    // Swapping the range:
-    LOG(logWARNING) << "Swapping upper and lower bound.";
-    uint8_t temp = dac1min;
-    dac1min = dac1max;
-    dac1max = temp;
-  }
-  if(dac2min > dac2max) {
-    // Swapping the range:
-    LOG(logWARNING) << "Swapping upper and lower bound.";
-    uint8_t temp = dac2min;
-    dac2min = dac2max;
-    dac2max = temp;
-  }
-
-  // Get the register number and check the range from dictionary:
-  uint8_t dac1register, dac2register;
-  if(!verifyRegister(dac1name, dac1register, dac1max, ROC_REG)) {
-    return std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > >();
-  }
-  if(!verifyRegister(dac2name, dac2register, dac2max, ROC_REG)) {
+  std::vector<Event> data;
+  if(!runDacDacScan(dac1name, dac1step, dac1min, dac1max, dac2name, dac2step, dac2min, dac2max, flags, nTriggers, false, data)) {
     return std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > >();
   }
-
-  // Setup the correct _hal calls for this test
-  HalMemFnPixelSerial   pixelfn      = &hal::SingleRocOnePixelDacDacScan;
-  HalMemFnPixelParallel multipixelfn = &hal::MultiRocOnePixelDacDacScan;
-  HalMemFnRocSerial     rocfn        = &hal::SingleRocAllPixelsDacDacScan;
-  HalMemFnRocParallel   multirocfn   = &hal::MultiRocAllPixelsDacDacScan;
-
-  // Load the test parameters into vector
-  std::vector<int32_t> param;
-  param.push_back(static_cast<int32_t>(dac1register));  
-  param.push_back(static_cast<int32_t>(dac1min));
-  param.push_back(static_cast<int32_t>(dac1max));
-  param.push_back(static_cast<int32_t>(dac2register));  
-  param.push_back(static_cast<int32_t>(dac2min));
-  param.push_back(static_cast<int32_t>(dac2max));
-  param.push_back(static_cast<int32_t>(flags));
-  param.push_back(static_cast<int32_t>(nTriggers));
-  param.push_back(static_cast<int32_t>(dac1step));
-  param.push_back(static_cast<int32_t>(dac2step));
-
-  // check if the flags indicate that the user explicitly asks for serial execution of test:
-  std::vector<Event> data = expandLoop(pixelfn, multipixelfn, rocfn, multirocfn, param, false, flags);
   // repack data into the expected return format
-  std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > result = repackDacDacScanData(data,dac1step,dac1min,dac1max,dac2step,dac2min,dac2max,flags);
-
-  // Reset the original value for the scanned DAC:
-  std::vector<rocConfig> enabledRocs = _dut->getEnabledRocs();
-  for (std::vector<rocConfig>::iterator rocit = enabledRocs.begin(); rocit != enabledRocs.end(); ++rocit){
-    uint8_t oldDac1Value = _dut->getDAC(static_cast<size_t>(rocit - enabledRocs.begin()),dac1name);
-    uint8_t oldDac2Value = _dut->getDAC(static_cast<size_t>(rocit - enabledRocs.begin()),dac2name);
-    LOG(logDEBUGAPI) << "Reset DAC \"" << dac1name << "\" to original value " << static_cast<int>(oldDac1Value);
-    LOG(logDEBUGAPI) << "Reset DAC \"" << dac2name << "\" to original value " << static_cast<int>(oldDac2Value);
-    _hal->rocSetDAC(static_cast<uint8_t>(rocit - enabledRocs.begin()),dac1register,oldDac1Value);
-    _hal->rocSetDAC(static_cast<uint8_t>(rocit - enabledRocs.begin()),dac2register,oldDac2Value);
-  }
-
-  return result;
+  return repackDacDacScanData(data,dac1step,dac1min,dac1max,dac2step,dac2min,dac2max,flags);
 }
 
 std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > pxarCore::getEfficiencyVsDACDAC(std::string dac1name, uint8_t dac1min, uint8_t dac1max, std::string dac2name, uint8_t dac2min, uint8_t dac2max, uint16_t flags, uint16_t nTriggers) {
@@ -1070,73 +1226,42 @@ std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > pxar
 }
 
 std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > pxarCore::getEfficiencyVsDACDAC(std::string dac1name, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, std::string dac2name, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint16_t flags, uint16_t nTriggers) {
+  testboardGuard tblock(_hal, _log);
 
-  if(!status()) {return std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > >();}
-
-  // Check DAC ranges
-  if(dac1min > dac1max) {
-    // Swapping the range:
-    LOG(logWARNING) << "Swapping upper and lower bound.";
-    uint8_t temp = dac1min;
-    dac1min = dac1max;
-    dac1max = temp;
-  }
-  if(dac2min > dac2max) {
-    // Swapping the range:
-    LOG(logWARNING) << "Swapping upper and lower bound.";
-    uint8_t temp = dac2min;
-    dac2min = dac2max;
-    dac2max = temp;
-  }
-
-  // Get the register number and check the range from dictionary:
-  uint8_t dac1register, dac2register;
-  if(!verifyRegister(dac1name, dac1register, dac1max, ROC_REG)) {
+  std::vector<Event> data;
+  if(!runDacDacScan(dac1name, dac1step, dac1min, dac1max, dac2name, dac2step, dac2min, dac2max, flags, nTriggers, true, data)) {
     return std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > >();
   }
-  if(!verifyRegister(dac2name, dac2register, dac2max, ROC_REG)) {
-    return std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > >();
-  }
-
-  // Setup the correct _hal calls for this test
-  HalMemFnPixelSerial   pixelfn      = &hal::SingleRocOnePixelDacDacScan;
-  HalMemFnPixelParallel multipixelfn = &hal::MultiRocOnePixelDacDacScan;
-  HalMemFnRocSerial     rocfn        = &hal::SingleRocAllPixelsDacDacScan;
-  HalMemFnRocParallel   multirocfn   = &hal::MultiRocAllPixelsDacDacScan;
+  // repack data into the expected return format
+  return repackDacDacScanData(data,dac1step,dac1min,dac1max,dac2step,dac2min,dac2max,flags);
+}
 
-  // Load the test parameters into vector
-  std::vector<int32_t> param;
-  param.push_back(static_cast<int32_t>(dac1register));
-  param.push_back(static_cast<int32_t>(dac1min));
-  param.push_back(static_cast<int32_t>(dac1max));
-  param.push_back(static_cast<int32_t>(dac2register));  
-  param.push_back(static_cast<int32_t>(dac2min));
-  param.push_back(static_cast<int32_t>(dac2max));
-  param.push_back(static_cast<int32_t>(flags));
-  param.push_back(static_cast<int32_t>(nTriggers));
-  param.push_back(static_cast<int32_t>(dac1step));
-  param.push_back(static_cast<int32_t>(dac2step));
+bool pxarCore::getPulseheightVsDAC(std::string dacName, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint16_t flags, uint16_t nTriggers, dacScanConsumer & consumer) {
+  testboardGuard tblock(_hal, _log);
+  std::vector<Event> data;
+  return runDacScan(dacName, dacStep, dacMin, dacMax, flags, nTriggers, false, data, &consumer);
+}
 
-  // check if the flags indicate that the user explicitly asks for serial execution of test:
-  std::vector<Event> data = expandLoop(pixelfn, multipixelfn, rocfn, multirocfn, param, true, flags);
-  // repack data into the expected return format
-  std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > result = repackDacDacScanData(data,dac1step,dac1min,dac1max,dac2step,dac2min,dac2max,flags);
+bool pxarCore::getEfficiencyVsDAC(std::string dacName, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint16_t flags, uint16_t nTriggers, dacScanConsumer & consumer) {
+  testboardGuard tblock(_hal, _log);
+  std::vector<Event> data;
+  return runDacScan(dacName, dacStep, dacMin, dacMax, flags, nTriggers, true, data, &consumer);
+}
 
-  // Reset the original value for the scanned DAC:
-  std::vector<rocConfig> enabledRocs = _dut->getEnabledRocs();
-  for (std::vector<rocConfig>::iterator rocit = enabledRocs.begin(); rocit != enabledRocs.end(); ++rocit){
-    uint8_t oldDac1Value = _dut->getDAC(static_cast<size_t>(rocit - enabledRocs.begin()),dac1name);
-    uint8_t oldDac2Value = _dut->getDAC(static_cast<size_t>(rocit - enabledRocs.begin()),dac2name);
-    LOG(logDEBUGAPI) << "Reset DAC \"" << dac1name << "\" to original value " << static_cast<int>(oldDac1Value);
-    LOG(logDEBUGAPI) << "Reset DAC \"" << dac2name << "\" to original value " << static_cast<int>(oldDac2Value);
-    _hal->rocSetDAC(static_cast<uint8_t>(rocit - enabledRocs.begin()),dac1register,oldDac1Value);
-    _hal->rocSetDAC(static_cast<uint8_t>(rocit - enabledRocs.begin()),dac2register,oldDac2Value);
-  }
+bool pxarCore::getPulseheightVsDACDAC(std::string dac1name, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, std::string dac2name, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint16_t flags, uint16_t nTriggers, dacDacScanConsumer & consumer) {
+  testboardGuard tblock(_hal, _log);
+  std::vector<Event> data;
+  return runDacDacScan(dac1name, dac1step, dac1min, dac1max, dac2name, dac2step, dac2min, dac2max, flags, nTriggers, false, data, &consumer);
+}
 
-  return result;
+bool pxarCore::getEfficiencyVsDACDAC(std::string dac1name, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, std::string dac2name, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint16_t flags, uint16_t nTriggers, dacDacScanConsumer & consumer) {
+  testboardGuard tblock(_hal, _log);
+  std::vector<Event> data;
+  return runDacDacScan(dac1name, dac1step, dac1min, dac1max, dac2name, dac2step, dac2min, dac2max, flags, nTriggers, true, data, &consumer);
 }
 
 std::vector<pixel> pxarCore::getPulseheightMap(uint16_t flags, uint16_t nTriggers) {
+  testboardGuard tblock(_hal, _log);
 
   if(!status()) {return std::vector<pixel>();}
 
@@ -1161,6 +1286,7 @@ std::vector<pixel> pxarCore::getPulseheightMap(uint16_t flags, uint16_t nTrigger
 }
 
 std::vector<pixel> pxarCore::getEfficiencyMap(uint16_t flags, uint16_t nTriggers) {
+  testboardGuard tblock(_hal, _log);
 
   if(!status()) {return std::vector<pixel>();}
 
@@ -1185,6 +1311,7 @@ std::vector<pixel> pxarCore::getEfficiencyMap(uint16_t flags, uint16_t nTriggers
 }
 
 std::vector<pixel> pxarCore::getThresholdMap(std::string dacName, uint16_t flags, uint16_t nTriggers) {
+  testboardGuard tblock(_hal, _log);
   // Get the full DAC range for scanning:
   uint8_t dacMin = 0;
   uint8_t dacMax = getDACRange(dacName);
@@ -1193,12 +1320,14 @@ std::vector<pixel> pxarCore::getThresholdMap(std::string dacName, uint16_t flags
 }
 
 std::vector<pixel> pxarCore::getThresholdMap(std::string dacName, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint16_t flags, uint16_t nTriggers) {
+  testboardGuard tblock(_hal, _log);
   // No threshold level provided - set threshold to 50%:
   uint8_t threshold = 50;
   return getThresholdMap(dacName, dacStep, dacMin, dacMax, threshold, flags, nTriggers);
 }
 
 std::vector<pixel> pxarCore::getThresholdMap(std::string dacName, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint8_t threshold, uint16_t flags, uint16_t nTriggers) {
+  testboardGuard tblock(_hal, _log);
 
   if(!status()) {return std::vector<pixel>();}
 
@@ -1239,6 +1368,7 @@ std::vector<pixel> pxarCore::getThresholdMap(std::string dacName, uint8_t dacSte
 }
 
 std::vector<std::vector<uint16_t> > pxarCore::daqGetReadback() {
+  testboardGuard tblock(_hal, _log);
 
   std::vector<std::vector<uint16_t> > values;
   if(!status()) { return values; }
@@ -1248,6 +1378,83 @@ std::vector<std::vector<uint16_t> > pxarCore::daqGetReadback() {
   return values;
 }
 
+std::vector<std::vector<uint16_t> > pxarCore::daqReadbackScan(std::string dacName, std::vector<std::pair<uint8_t, uint8_t> > settings, uint32_t nTriggers, uint16_t period) {
+  return readbackScan(dacName, -1, settings, nTriggers, period);
+}
+
+std::vector<std::vector<uint16_t> > pxarCore::daqReadbackScan(std::string dacName, uint8_t rocID, std::vector<std::pair<uint8_t, uint8_t> > settings, uint32_t nTriggers, uint16_t period) {
+  return readbackScan(dacName, static_cast<int>(rocID), settings, nTriggers, period);
+}
+
+std::vector<std::vector<uint16_t> > pxarCore::readbackScan(std::string dacName, int rocID, std::vector<std::pair<uint8_t, uint8_t> > settings, uint32_t nTriggers, uint16_t period) {
+  testboardGuard tblock(_hal, _log);
+
+  std::vector<std::vector<uint16_t> > values;
+  if(!status()) { return values; }
+  if(daqStatus()) {
+    LOG(logERROR) << "DAQ is already running! Stop DAQ to run a readback scan.";
+    return values;
+  }
+
+  // Check the DAC name once, not for every setting:
+  if(!dacName.empty()) {
+    uint8_t dacRegister, dacValue = 0;
+    if(!verifyRegister(dacName, dacRegister, dacValue, ROC_REG)) return values;
+  }
+
+  // Use the shortest period possible without the warning of daqTrigger():
+  if(period < _dut->pg_sum) { period = _dut->pg_sum; }
+
+  LOG(logDEBUGAPI) << "Readback scan of " << settings.size() << " settings"
+		   << (dacName.empty() ? "" : " of DAC " + dacName) << ", "
+		   << nTriggers << " triggers each.";
+
+  if(!daqStart()) { return values; }
+
+  for(std::vector<std::pair<uint8_t, uint8_t> >::iterator it = settings.begin(); it != settings.end(); ++it) {
+
+    if(!dacName.empty()) {
+      if(rocID < 0) { setDAC(dacName, it->first); }
+      else { setDAC(dacName, it->first, static_cast<uint8_t>(rocID)); }
+    }
+    setDAC("readback", it->second);
+
+    // Words decoded before the new settings were programmed are not wanted:
+    _hal->daqReadback();
+
+    _hal->daqTrigger(nTriggers, period);
+    try { _hal->daqAllEvents(); }
+    catch(DataNoEvent &) {}
+
+    std::vector<std::vector<uint16_t> > rb = _hal->daqReadback();
+    std::vector<uint16_t> last(rb.size(), 0);
+    size_t nmissing = 0;
+    for(size_t roc = 0; roc < rb.size(); roc++) {
+      // The latest word of the selected register, only that one is sure to be started after the DACs were set:
+      bool found = false;
+      for(std::vector<uint16_t>::reverse_iterator w = rb.at(roc).rbegin(); w != rb.at(roc).rend(); ++w) {
+	if(((*w >> 8) & 0x0f) == (it->second & 0x0f)) {
+	  last.at(roc) = *w;
+	  found = true;
+	  break;
+	}
+      }
+      if(!found) { nmissing++; }
+    }
+    if(rb.empty()) {
+      LOG(logWARNING) << "Readback scan: no readback data received for setting " << static_cast<int>(it - settings.begin());
+    }
+    else if(nmissing > 0) {
+      LOG(logWARNING) << "Readback scan: " << nmissing << " ROCs without readback word for register "
+		      << static_cast<int>(it->second) << " at setting " << static_cast<int>(it - settings.begin());
+    }
+    values.push_back(last);
+  }
+
+  daqStop();
+  return values;
+}
+
 
 // DAQ functions
 
@@ -1264,6 +1471,7 @@ bool pxarCore::daqStart(const int buffersize, const bool init) {
 }
 
 bool pxarCore::daqStart(const uint16_t flags, const int buffersize, const bool init) {
+  testboardGuard tblock(_hal, _log);
 
   if(!status()) {return false;}
   if(daqStatus()) {return false;}
@@ -1311,6 +1519,7 @@ bool pxarCore::daqStart(const uint16_t flags, const int buffersize, const bool i
 }
 
 bool pxarCore::daqSingleSignal(std::string triggerSignal) {
+  testboardGuard tblock(_hal, _log);
   
   // We do NOT require a running DAQ session here!
 
@@ -1333,6 +1542,7 @@ bool pxarCore::daqSingleSignal(std::string triggerSignal) {
 }
 
 bool pxarCore::daqTriggerSource(std::string triggerSource) {
+  testboardGuard tblock(_hal, _log);
 
   if(daqStatus()) {
     LOG(logERROR) << "DAQ is already running! Stop DAQ to change the trigger source.";
@@ -1390,6 +1600,7 @@ bool pxarCore::daqTriggerSource(std::string triggerSource) {
 
 bool pxarCore::daqStatus()
 {
+  testboardGuard tblock(_hal, _log);
 
   uint8_t perFull;
 
@@ -1398,6 +1609,7 @@ bool pxarCore::daqStatus()
 }
 
 bool pxarCore::daqStatus(uint8_t & perFull) {
+  testboardGuard tblock(_hal, _log);
 
   // Check if a DAQ session is running:
   if(!_daq_running) {
@@ -1421,6 +1633,7 @@ bool pxarCore::daqStatus(uint8_t & perFull) {
 }
 
 uint16_t pxarCore::daqTrigger(uint32_t nTrig, uint16_t period) {
+  testboardGuard tblock(_hal, _log);
 
   if(!daqStatus()) { return 0; }
   // Pattern Generator loop doesn't work for delay periods smaller than
@@ -1438,6 +1651,7 @@ uint16_t pxarCore::daqTrigger(uint32_t nTrig, uint16_t period) {
 }
 
 uint16_t pxarCore::daqTriggerLoop(uint16_t period) {
+  testboardGuard tblock(_hal, _log);
 
   if(!daqStatus()) { return 0; }
 
@@ -1456,12 +1670,14 @@ uint16_t pxarCore::daqTriggerLoop(uint16_t period) {
 }
 
 void pxarCore::daqTriggerLoopHalt() {
+  testboardGuard tblock(_hal, _log);
 
   // Just halt the pattern generator loop:
   _hal->daqTriggerLoopHalt();
 }
 
 std::vector<uint16_t> pxarCore::daqGetBuffer() {
+  testboardGuard tblock(_hal, _log);
 
   // Reading out all data from the DTB and returning the raw blob.
   // The HAL function throws pxar::DataNoEvent if nothing to be 
@@ -1471,6 +1687,7 @@ std::vector<uint16_t> pxarCore::daqGetBuffer() {
 }
 
 std::vector<rawEvent> pxarCore::daqGetRawEventBuffer() {
+  testboardGuard tblock(_hal, _log);
 
   // Reading out all data from the DTB and returning the raw blob.
   // Select the right readout channels depending on the number of TBMs
@@ -1480,6 +1697,7 @@ std::vector<rawEvent> pxarCore::daqGetRawEventBuffer() {
 }
 
 std::vector<Event> pxarCore::daqGetEventBuffer() {
+  testboardGuard tblock(_hal, _log);
 
   // Reading out all data from the DTB and returning the decoded Event buffer.
   // Select the right readout channels depending on the number of TBMs
@@ -1488,7 +1706,17 @@ std::vector<Event> pxarCore::daqGetEventBuffer() {
   return _hal->daqAllEvents();
 }
 
+std::vector<Event> pxarCore::daqGetEventBuffer(std::vector<rawEvent> & rawbuffer) {
+  testboardGuard tblock(_hal, _log);
+
+  // Reading out and decoding all data from the DTB, keeping the raw data records.
+  // The HAL function throws pxar::DataNoEvent if nothing to be returned
+  rawbuffer.clear();
+  return _hal->daqAllEvents(&rawbuffer);
+}
+
 Event pxarCore::daqGetEvent() {
+  testboardGuard tblock(_hal, _log);
 
   // Return the next decoded Event from the FIFO buffer.
   // The HAL function throws pxar::DataNoEvent if no event is available
@@ -1496,6 +1724,7 @@ Event pxarCore::daqGetEvent() {
 }
 
 rawEvent pxarCore::daqGetRawEvent() {
+  testboardGuard tblock(_hal, _log);
 
   // Return the next raw data record from the FIFO buffer:
   // The HAL function throws pxar::DataNoEvent if no event is available
@@ -1507,6 +1736,7 @@ bool pxarCore::daqStop() {
 }
 
 bool pxarCore::daqStop(const bool init) {
+  testboardGuard tblock(_hal, _log);
 
   if(!status()) {return false;}
   if(!_daq_running) {
@@ -1541,11 +1771,15 @@ bool pxarCore::daqStop(const bool init) {
 }
 
 
-std::vector<Event> pxarCore::expandLoop(HalMemFnPixelSerial pixelfn, HalMemFnPixelParallel multipixelfn, HalMemFnRocSerial rocfn, HalMemFnRocParallel multirocfn, std::vector<int32_t> param, bool efficiency, uint16_t flags) {
+std::vector<Event> pxarCore::expandLoop(HalMemFnPixelSerial pixelfn, HalMemFnPixelParallel multipixelfn, HalMemFnRocSerial rocfn, HalMemFnRocParallel multirocfn, std::vector<int32_t> param, bool efficiency, uint16_t flags, condensedEventConsumer * consumer) {
+  testboardGuard tblock(_hal, _log);
   
   // pointer to vector to hold our data
   std::vector<Event> data = std::vector<Event>();
 
+  // Hand the data to the consumer directly if requested:
+  consumerGuard guard(_hal, consumer);
+
   // Start test timer:
   timer t;
 
@@ -1553,7 +1787,7 @@ std::vector<Event> pxarCore::expandLoop(HalMemFnPixelSerial pixelfn, HalMemFnPix
   std::vector<uint8_t> enabledRocs = _dut->getEnabledRocIDs();
   for(std::vector<uint8_t>::iterator rc = enabledRocs.begin(); rc != enabledRocs.end(); ++rc) {
     // Compare the configuration of the first ROC with all others:
-    if(!comparePixelConfiguration(_dut->getEnabledPixels(enabledRocs.at(0)),_dut->getEnabledPixels(*rc))) {
+    if(!comparePixelConfiguration(_dut->roc.at(enabledRocs.at(0)),_dut->roc.at(*rc))) {
       flags |= FLAG_FORCE_SERIAL;
       LOG(logINFO) << "Not all ROCs have their pixels configured the same way. "
 		   << "Running in FLAG_FORCE_SERIAL mode.";
@@ -1592,12 +1826,12 @@ std::vector<Event> pxarCore::expandLoop(HalMemFnPixelSerial pixelfn, HalMemFnPix
       // Get one of the enabled ROCs:
       std::vector<uint8_t> enabledRocs = _dut->getEnabledRocIDs();
       std::vector<Event> rocdata = std::vector<Event>();
-      std::vector<pixelConfig> enabledPixels = _dut->getEnabledPixels(enabledRocs.front());
+      const std::vector<pixelConfig> & enabledPixels = _dut->getEnabledPixelsView(enabledRocs.front());
 
       LOG(logDEBUGAPI) << "\"The Loop\" contains "
 		       << enabledPixels.size() << " calls to \'multipixelfn\'";
 
-      for (std::vector<pixelConfig>::iterator px = enabledPixels.begin(); px != enabledPixels.end(); ++px) {
+      for (std::vector<pixelConfig>::const_iterator px = enabledPixels.begin(); px != enabledPixels.end(); ++px) {
 	// execute call to HAL layer routine and store data in buffer
 	std::vector<Event> buffer = CALL_MEMBER_FN(*_hal,multipixelfn)(rocs_i2c, px->column(), px->row(), efficiency, param);
 
@@ -1696,7 +1930,7 @@ std::vector<Event> pxarCore::expandLoop(HalMemFnPixelSerial pixelfn, HalMemFnPix
   } // single roc fnc
 
   // check that we ended up with data, otherwise print an error:
-  if (data.empty()){ LOG(logCRITICAL) << "NO DATA FROM TEST FUNCTION -- are any TBMs/ROCs/PIXs enabled?!"; }
+  if (data.empty() && consumer == NULL){ LOG(logCRITICAL) << "NO DATA FROM TEST FUNCTION -- are any TBMs/ROCs/PIXs enabled?!"; }
   
   // Test is over, mask the whole device again and clear leftover calibrate signals:
   MaskAndTrim(false);
@@ -1832,8 +2066,6 @@ std::vector< std::pair<uint8_t, std::vector<pixel> > > pxarCore::repackDacScanDa
 std::vector<pixel> pxarCore::repackThresholdMapData (std::vector<Event> &data, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint8_t thresholdlevel, uint16_t nTriggers, uint16_t flags) {
 
   std::vector<pixel> result;
-  // Vector of pixels for which a threshold has already been found
-  std::vector<pixel> found;
 
   // Threshold is the the given efficiency level "thresholdlevel"
   // Using ceiling function to take higher threshold when in doubt.
@@ -1847,8 +2079,11 @@ std::vector<pixel> pxarCore::repackThresholdMapData (std::vector<Event> &data, u
   // First, pack the data as it would be a regular Dac Scan:
   std::vector<std::pair<uint8_t,std::vector<pixel> > > packed_dac = repackDacScanData(data, dacStep, dacMin, dacMax, flags);
 
-  // Efficiency map:
-  std::map<pixel,uint8_t> oldvalue;
+  // Per-pixel threshold search state for all pixels found in the data:
+  thresholdFinder finder(threshold);
+  for(std::vector<std::pair<uint8_t,std::vector<pixel> > >::iterator it = packed_dac.begin(); it != packed_dac.end(); ++it) {
+    finder.extend(it->second);
+  }
 
   // Then loop over all pixels and DAC settings, start from the back if we are looking for falling edge.
   // This ensures that we end up having the correct edge, even if the efficiency suddenly changes from 0 to max.
@@ -1861,63 +2096,16 @@ std::vector<pixel> pxarCore::repackThresholdMapData (std::vector<Event> &data, u
   for(std::vector<std::pair<uint8_t,std::vector<pixel> > >::iterator it = it_start; it != it_end; it += increase_op) {
     // For every DAC value, loop over all pixels:
     for(std::vector<pixel>::iterator pixit = it->second.begin(); pixit != it->second.end(); ++pixit) {
-      // Check if for this pixel a threshold has been found already and we can skip the rest:
-      std::vector<pixel>::iterator px_found = std::find_if(found.begin(),
-							   found.end(),
-							   findPixelXY(pixit->column(), pixit->row(), pixit->roc()));
-      if(px_found != found.end()) continue;
-
-      // Check if we have that particular pixel already in the result vector:
-      std::vector<pixel>::iterator px = std::find_if(result.begin(),
-						     result.end(),
-						     findPixelXY(pixit->column(), pixit->row(), pixit->roc()));
-  
-      // Pixel is known:
-      if(px != result.end()) {
-	// Calculate efficiency deltas and slope:
-	uint8_t delta_old = abs(oldvalue[*px] - threshold);
-	uint8_t delta_new = abs(static_cast<uint8_t>(pixit->value()) - threshold);
-	bool positive_slope = (static_cast<uint8_t>(pixit->value()) - oldvalue[*px] > 0 ? true : false);
-
-	// Check which value is closer to the threshold. Only if the slope is positive AND
-	// the new delta between value and threshold is *larger* then the old delta, we 
-	// found the threshold. If slope is negative, we just have a ripple in the DAC's 
-	// distribution:
-	if(positive_slope && !(delta_new < delta_old)) {        
-	  found.push_back(*pixit);    
-	  continue; 
-	}
-
-	// No threshold found yet, update the DAC threshold value for the pixel:
-	px->setValue(it->first);
-	// Update the oldvalue map:
-	oldvalue[*px] = static_cast<uint8_t>(pixit->value());
-      }
-      // Pixel is new, just adding it:
-      else {
-        // If the pixel is above threshold at first appearance, the respective
-	// DAC value is set as its threshold:
-	if(pixit->value() >= threshold) { found.push_back(*pixit); }
-
-	// Store the pixel with original efficiency
-	oldvalue.insert(std::make_pair(*pixit,pixit->value()));
-
-	// Push pixel to result vector with current DAC as value field:
-	pixit->setValue(it->first);
-	result.push_back(*pixit);
-      }
+      finder.add(it->first, *pixit, result);
     }
   }
 
   // Check for pixels that have not reached the threshold at all:
   for(std::vector<pixel>::iterator px = result.begin(); px != result.end(); ++px) {
-    std::vector<pixel>::iterator px_found = std::find_if(found.begin(),
-							 found.end(),
-							 findPixelXY(px->column(), px->row(), px->roc()));
-    // The pixel is in the "found" vector, which means it crossed threshold at some point:
-    if(px_found != found.end()) continue;
+    // The pixel crossed threshold at some point:
+    if(finder.found(*px)) continue;
 
-    // The pixel is not in and never reached the threshold. We set the return value to
+    // The pixel never reached the threshold. We set the return value to
     // "dacMax" (rising edge) or "dacMin" (falling edge):
     if((flags&FLAG_RISING_EDGE) != 0) { px->setValue(dacMax); }
     else { px->setValue(dacMin); }
@@ -1935,8 +2123,6 @@ std::vector<pixel> pxarCore::repackThresholdMapData (std::vector<Event> &data, u
 std::vector<std::pair<uint8_t,std::vector<pixel> > > pxarCore::repackThresholdDacScanData (std::vector<Event> &data, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint8_t thresholdlevel, uint16_t nTriggers, uint16_t flags) {
 
   std::vector<std::pair<uint8_t,std::vector<pixel> > > result;
-  // Map of pixels with already assigned threshold (key is the dac2 value):
-  std::map<uint8_t,std::vector<pixel> > found;
 
   // Threshold is the the given efficiency level "thresholdlevel":
   // Using ceiling function to take higher threshold when in doubt.
@@ -1950,8 +2136,11 @@ std::vector<std::pair<uint8_t,std::vector<pixel> > > pxarCore::repackThresholdDa
   // First, pack the data as it would be a regular DacDac Scan:
   std::vector<std::pair<uint8_t,std::pair<uint8_t,std::vector<pixel> > > > packed_dacdac = repackDacDacScanData(data,dac1step,dac1min,dac1max,dac2step,dac2min,dac2max,flags);
 
-  // Efficiency map:
-  std::map<uint8_t,std::map<pixel,uint8_t> > oldvalue;  
+  // Per-pixel threshold search state for all pixels found in the data:
+  thresholdFinder finder(threshold);
+  for(std::vector<std::pair<uint8_t,std::pair<uint8_t,std::vector<pixel> > > >::iterator it = packed_dacdac.begin(); it != packed_dacdac.end(); ++it) {
+    finder.extend(it->second.second);
+  }
 
   // Then loop over all pixels and DAC settings, start from the back if we are looking for falling edge.
   // This ensures that we end up having the correct edge, even if the efficiency suddenly changes from 0 to max.
@@ -1961,87 +2150,42 @@ std::vector<std::pair<uint8_t,std::vector<pixel> > > pxarCore::repackThresholdDa
   if((flags&FLAG_RISING_EDGE) != 0) { it_start = packed_dacdac.begin(); it_end = packed_dacdac.end(); increase_op = 1; }
   else { it_start = packed_dacdac.end()-1; it_end = packed_dacdac.begin()-1; increase_op = -1;  }
 
+  // The thresholds for different DAC2 values are independent. Collect the DAC/DAC entries
+  // for every DAC2 value in scan order, the DAC2 values are ordered by their first appearance:
+  std::vector<std::vector<std::vector<std::pair<uint8_t,std::pair<uint8_t,std::vector<pixel> > > >::iterator> > dac2entries(256);
+  std::vector<uint8_t> dac2order;
   for(std::vector<std::pair<uint8_t,std::pair<uint8_t,std::vector<pixel> > > >::iterator it = it_start; it != it_end; it += increase_op) {
+    if(it->second.second.empty()) continue;
+    if(dac2entries.at(it->second.first).empty()) { dac2order.push_back(it->second.first); }
+    dac2entries.at(it->second.first).push_back(it);
+  }
 
-    // For every DAC/DAC entry, loop over all pixels:
-    for(std::vector<pixel>::iterator pixit = it->second.second.begin(); pixit != it->second.second.end(); ++pixit) {
-      
-      // Find the current DAC2 value in the result vector (simple replace for find_if):
-      std::vector<std::pair<uint8_t, std::vector<pixel> > >::iterator dac;
-      for(dac = result.begin(); dac != result.end(); ++dac) { if(it->second.first == dac->first) break; }
-
-      // Didn't find the DAC2 value:
-      if(dac == result.end()) {
-	result.push_back(std::make_pair(it->second.first,std::vector<pixel>()));
-	dac = result.end() - 1;
-	// Also add an entry for bookkeeping:
-	found.insert(std::make_pair(it->second.first,std::vector<pixel>()));
-	oldvalue.insert(std::make_pair(it->second.first,std::map<pixel,uint8_t>()));
-      }
-      
-      // Check if for this pixel a threshold has been found already and we can skip the rest:
-      std::vector<pixel>::iterator px_found = std::find_if(found[dac->first].begin(),
-							   found[dac->first].end(),
-							   findPixelXY(pixit->column(), pixit->row(), pixit->roc()));
-      if(px_found != found[dac->first].end()) continue;
-
-      // Check if we have that particular pixel already in:
-      std::vector<pixel>::iterator px = std::find_if(dac->second.begin(),
-						     dac->second.end(),
-						     findPixelXY(pixit->column(), pixit->row(), pixit->roc()));
-
-      // Pixel is known:
-      if(px != dac->second.end()) {
-	// Calculate efficiency deltas and slope:
-	uint8_t delta_old = abs(oldvalue[dac->first][*px] - threshold);
-	uint8_t delta_new = abs(static_cast<uint8_t>(pixit->value()) - threshold);
-	bool positive_slope = (static_cast<uint8_t>(pixit->value()) - oldvalue[dac->first][*px] > 0 ? true : false);
-
-        // Check which value is closer to the threshold. Only if the slope is positive AND
-	// the new delta between value and threshold is *larger* then the old delta, we 
-	// found the threshold. If slope is negative, we just have a ripple in the DAC's 
-	// distribution:
-	if(positive_slope && !(delta_new < delta_old)) {
-	  found[dac->first].push_back(*pixit);
-	  continue;
-	}
-
-        // No threshold found yet, update the DAC threshold value for the pixel:
-	px->setValue(it->first);
-	// Update the oldvalue map:
-	oldvalue[dac->first][*px] = static_cast<uint8_t>(pixit->value());
-      }
-      // Pixel is new, just adding it:
-      else {
-        // If the pixel is above threshold at first appearance, the respective
-	// DAC value is set as its threshold:
-	if(pixit->value() >= threshold) { found[dac->first].push_back(*pixit); }
+  for(std::vector<uint8_t>::iterator dac2 = dac2order.begin(); dac2 != dac2order.end(); ++dac2) {
+    result.push_back(std::make_pair(*dac2,std::vector<pixel>()));
+    std::vector<pixel> & dacresult = result.back().second;
 
-	// Store the pixel with original efficiency
-	oldvalue[dac->first].insert(std::make_pair(*pixit,pixit->value()));
-	// Push pixel to result vector with current DAC as value field:
-	pixit->setValue(it->first);
-	dac->second.push_back(*pixit);
+    // For every DAC/DAC entry, loop over all pixels:
+    std::vector<std::vector<std::pair<uint8_t,std::pair<uint8_t,std::vector<pixel> > > >::iterator> & entries = dac2entries.at(*dac2);
+    for(size_t entry = 0; entry < entries.size(); entry++) {
+      for(std::vector<pixel>::iterator pixit = entries.at(entry)->second.second.begin(); pixit != entries.at(entry)->second.second.end(); ++pixit) {
+	finder.add(entries.at(entry)->first, *pixit, dacresult);
       }
     }
-  }
 
-  // Check for pixels that have not reached the threshold at all:
-  for(std::vector<std::pair<uint8_t,std::vector<pixel> > >::iterator dac = result.begin(); dac != result.end(); ++dac) {
-    
-    for(std::vector<pixel>::iterator px = dac->second.begin(); px != dac->second.end(); px++) {
-      std::vector<pixel>::iterator px_found = std::find_if(found[dac->first].begin(),
-							   found[dac->first].end(),
-							   findPixelXY(px->column(), px->row(), px->roc()));
-      // The pixel is in the "found" vector, which means it crossed threshold at some point:
-      if(px_found != found[dac->first].end()) continue;
-
-      // The pixel is not in and never reached the threshold. We set the return value to
+    // Check for pixels that have not reached the threshold at all:
+    for(std::vector<pixel>::iterator px = dacresult.begin(); px != dacresult.end(); px++) {
+      // The pixel crossed threshold at some point:
+      if(finder.found(*px)) continue;
+
+      // The pixel never reached the threshold. We set the return value to
       // "dacMax" (rising edge) or "dacMin" (falling edge):
       if((flags&FLAG_RISING_EDGE) != 0) { px->setValue(dac2max); }
       else { px->setValue(dac2min); }
-      LOG(logWARNING) << "No threshold found for " << (*px) << " at DAC value " << static_cast<int>(dac->first);
+      LOG(logWARNING) << "No threshold found for " << (*px) << " at DAC value " << static_cast<int>(*dac2);
     }
+
+    // Clear the search state before moving to the next DAC2 value:
+    finder.reset(dacresult);
   }
 
   // Sort the output map by DAC values and ROC->col->row - just because we are so nice:
@@ -2052,6 +2196,136 @@ std::vector<std::pair<uint8_t,std::vector<pixel> > > pxarCore::repackThresholdDa
   return result;
 }
 
+bool pxarCore::runDacScan(std::string dacName, uint8_t dacStep, uint8_t & dacMin, uint8_t & dacMax, uint16_t flags, uint16_t nTriggers, bool efficiency, std::vector<Event> & data, dacScanConsumer * consumer) {
+
+  if(!status()) {return false;}
+
+  // Check DAC range
+  if(dacMin > dacMax) {
+    // Swapping the range:
+    LOG(logWARNING) << "Swapping upper and lower bound.";
+    uint8_t temp = dacMin;
+    dacMin = dacMax;
+    dacMax = temp;
+  }
+
+  // Get the register number and check the range from dictionary:
+  uint8_t dacRegister;
+  if(!verifyRegister(dacName, dacRegister, dacMax, ROC_REG)) { return false; }
+
+  // Setup the correct _hal calls for this test
+  HalMemFnPixelSerial   pixelfn      = &hal::SingleRocOnePixelDacScan;
+  HalMemFnPixelParallel multipixelfn = &hal::MultiRocOnePixelDacScan;
+  HalMemFnRocSerial     rocfn        = &hal::SingleRocAllPixelsDacScan;
+  HalMemFnRocParallel   multirocfn   = &hal::MultiRocAllPixelsDacScan;
+
+  // Load the test parameters into vector
+  std::vector<int32_t> param;
+  param.push_back(static_cast<int32_t>(dacRegister));
+  param.push_back(static_cast<int32_t>(dacMin));
+  param.push_back(static_cast<int32_t>(dacMax));
+  param.push_back(static_cast<int32_t>(flags));
+  param.push_back(static_cast<int32_t>(nTriggers));
+  param.push_back(static_cast<int32_t>(dacStep));
+
+  if(consumer) {
+    LOG(logDEBUGAPI) << "Streaming DAC range " << static_cast<int>(dacMin) << " - " << static_cast<int>(dacMax) << " (step size " << static_cast<int>(dacStep) << ")";
+
+    // Run the test, the data is passed on to the consumer on the fly:
+    dacScanStream stream(*consumer, dacStep, dacMin, dacMax, flags);
+    expandLoop(pixelfn, multipixelfn, rocfn, multirocfn, param, efficiency, flags, &stream);
+    LOG(logDEBUGAPI) << "Streamed " << stream.events << " DacScan data blocks.";
+  }
+  else {
+    // check if the flags indicate that the user explicitly asks for serial execution of test:
+    data = expandLoop(pixelfn, multipixelfn, rocfn, multirocfn, param, efficiency, flags);
+  }
+
+  // Reset the original value for the scanned DAC:
+  std::vector<rocConfig> enabledRocs = _dut->getEnabledRocs();
+  for (std::vector<rocConfig>::iterator rocit = enabledRocs.begin(); rocit != enabledRocs.end(); ++rocit){
+    uint8_t oldDacValue = _dut->getDAC(static_cast<size_t>(rocit - enabledRocs.begin()),dacName);
+    LOG(logDEBUGAPI) << "Reset DAC \"" << dacName << "\" to original value " << static_cast<int>(oldDacValue);
+    _hal->rocSetDAC(static_cast<uint8_t>(rocit - enabledRocs.begin()),dacRegister,oldDacValue);
+  }
+
+  return true;
+}
+
+bool pxarCore::runDacDacScan(std::string dac1name, uint8_t dac1step, uint8_t & dac1min, uint8_t & dac1max, std::string dac2name, uint8_t dac2step, uint8_t & dac2min, uint8_t & dac2max, uint16_t flags, uint16_t nTriggers, bool efficiency, std::vector<Event> & data, dacDacScanConsumer * consumer) {
+
+  if(!status()) {return false;}
+
+  // Check DAC ranges
+  if(dac1min > dac1max) {
+    // Swapping the range:
+    LOG(logWARNING) << "Swapping upper and lower bound.";
+    uint8_t temp = dac1min;
+    dac1min = dac1max;
+    dac1max = temp;
+  }
+  if(dac2min > dac2max) {
+    // Swapping the range:
+    LOG(logWARNING) << "Swapping upper and lower bound.";
+    uint8_t temp = dac2min;
+    dac2min = dac2max;
+    dac2max = temp;
+  }
+
+  // Get the register number and check the range from dictionary:
+  uint8_t dac1register, dac2register;
+  if(!verifyRegister(dac1name, dac1register, dac1max, ROC_REG)) { return false; }
+  if(!verifyRegister(dac2name, dac2register, dac2max, ROC_REG)) { return false; }
+
+  // Setup the correct _hal calls for this test
+  HalMemFnPixelSerial   pixelfn      = &hal::SingleRocOnePixelDacDacScan;
+  HalMemFnPixelParallel multipixelfn = &hal::MultiRocOnePixelDacDacScan;
+  HalMemFnRocSerial     rocfn        = &hal::SingleRocAllPixelsDacDacScan;
+  HalMemFnRocParallel   multirocfn   = &hal::MultiRocAllPixelsDacDacScan;
+
+  // Load the test parameters into vector
+  std::vector<int32_t> param;
+  param.push_back(static_cast<int32_t>(dac1register));
+  param.push_back(static_cast<int32_t>(dac1min));
+  param.push_back(static_cast<int32_t>(dac1max));
+  param.push_back(static_cast<int32_t>(dac2register));
+  param.push_back(static_cast<int32_t>(dac2min));
+  param.push_back(static_cast<int32_t>(dac2max));
+  param.push_back(static_cast<int32_t>(flags));
+  param.push_back(static_cast<int32_t>(nTriggers));
+  param.push_back(static_cast<int32_t>(dac1step));
+  param.push_back(static_cast<int32_t>(dac2step));
+
+  if(consumer) {
+    LOG(logDEBUGAPI) << "Streaming DAC range [" << static_cast<int>(dac1min) << " - " << static_cast<int>(dac1max)
+		     << ", step size " << static_cast<int>(dac1step) << "]x["
+		     << static_cast<int>(dac2min) << " - " << static_cast<int>(dac2max)
+		     << ", step size " << static_cast<int>(dac2step) << "]";
+
+    // Run the test, the data is passed on to the consumer on the fly:
+    dacDacScanStream stream(*consumer, dac1step, dac1min, dac1max, dac2step, dac2min, dac2max);
+    expandLoop(pixelfn, multipixelfn, rocfn, multirocfn, param, efficiency, flags, &stream);
+    LOG(logDEBUGAPI) << "Streamed " << stream.events << " DacDacScan data blocks.";
+  }
+  else {
+    // check if the flags indicate that the user explicitly asks for serial execution of test:
+    data = expandLoop(pixelfn, multipixelfn, rocfn, multirocfn, param, efficiency, flags);
+  }
+
+  // Reset the original value for the scanned DAC:
+  std::vector<rocConfig> enabledRocs = _dut->getEnabledRocs();
+  for (std::vector<rocConfig>::iterator rocit = enabledRocs.begin(); rocit != enabledRocs.end(); ++rocit){
+    uint8_t oldDac1Value = _dut->getDAC(static_cast<size_t>(rocit - enabledRocs.begin()),dac1name);
+    uint8_t oldDac2Value = _dut->getDAC(static_cast<size_t>(rocit - enabledRocs.begin()),dac2name);
+    LOG(logDEBUGAPI) << "Reset DAC \"" << dac1name << "\" to original value " << static_cast<int>(oldDac1Value);
+    LOG(logDEBUGAPI) << "Reset DAC \"" << dac2name << "\" to original value " << static_cast<int>(oldDac2Value);
+    _hal->rocSetDAC(static_cast<uint8_t>(rocit - enabledRocs.begin()),dac1register,oldDac1Value);
+    _hal->rocSetDAC(static_cast<uint8_t>(rocit - enabledRocs.begin()),dac2register,oldDac2Value);
+  }
+
+  return true;
+}
+
 std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > pxarCore::repackDacDacScanData (std::vector<Event> &data, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint16_t /*flags*/) {
   std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > result;
 
@@ -2134,7 +2408,7 @@ void pxarCore::MaskAndTrim(bool trim, std::vector<rocConfig>::iterator rocit) {
   // This ROC is supposed to be trimmed as configured, so let's trim it:
   if(trim) {
     LOG(logDEBUGAPI) << "ROC@I2C " << static_cast<int>(rocit->i2c_address) << " features "
-		     << static_cast<int>(std::count_if(rocit->pixels.begin(),rocit->pixels.end(),configMaskSet(true)))
+		     << static_cast<int>(rocit->nMaskedPixels())
 		     << " masked pixels.";
     LOG(logDEBUGAPI) << "Unmasking and trimming ROC@I2C " << static_cast<int>(rocit->i2c_address) << " in one go.";
     _hal->RocSetMask(rocit->i2c_address,false,rocit->pixels);
@@ -2155,7 +2429,7 @@ void pxarCore::SetCalibrateBits(bool enable) {
 
     // Check if the signal has to be turned on or off:
     if(enable) {
-      std::vector<pixelConfig> cal_pixels = _dut->getEnabledPixels(rocit - _dut->roc.begin());
+      const std::vector<pixelConfig> & cal_pixels = _dut->getEnabledPixelsView(rocit - _dut->roc.begin());
       LOG(logDEBUGAPI) << "Configuring calibrate bits in " << cal_pixels.size() << " enabled PUCs of ROC@I2C " 
 		       << static_cast<int>(rocit->i2c_address);
       _hal->RocSetCalibrate(rocit->i2c_address,cal_pixels,0); 
@@ -2323,6 +2597,7 @@ uint32_t pxarCore::getPatternGeneratorDelaySum(std::vector<std::pair<uint16_t,ui
 }
 
 bool pxarCore::setExternalClock(bool enable) {
+  testboardGuard tblock(_hal, _log);
 
   LOG(logDEBUGAPI) << "Setting clock to " << (enable ? "external" : "internal") << " source.";
   if(enable) {
@@ -2339,6 +2614,7 @@ bool pxarCore::setExternalClock(bool enable) {
 }
 
 void pxarCore::setSignalMode(std::string signal, uint8_t mode, uint8_t speed) {
+  testboardGuard tblock(_hal, _log);
 
   uint8_t sigRegister, value = 0;
   if(!verifyRegister(signal, sigRegister, value, DTB_REG)) return;
@@ -2352,6 +2628,7 @@ void pxarCore::setSignalMode(std::string signal, uint8_t mode, uint8_t speed) {
 }
 
 void pxarCore::setSignalMode(std::string signal, std::string mode, uint8_t speed) {
+  testboardGuard tblock(_hal, _log);
  
   uint8_t modeValue = 0xff;
 
@@ -2373,12 +2650,14 @@ void pxarCore::setSignalMode(std::string signal, std::string mode, uint8_t speed
 
 void pxarCore::setClockStretch(uint8_t src, uint16_t delay, uint16_t width)
 {
+  testboardGuard tblock(_hal, _log);
   LOG(logDEBUGAPI) << "Set Clock Stretch " << static_cast<int>(src) << " " << static_cast<int>(delay) << " " << static_cast<int>(width); 
   _hal->SetClockStretch(src,width,delay);
   
 }
 
 uint16_t pxarCore::GetADC( uint8_t rpc_par1 ){
+  testboardGuard tblock(_hal, _log);
   
   if( ! status() ) { return 0; } 
 
@@ -26,6 +26,7 @@ typedef unsigned char uint8_t;
 #include <string>
 #include <vector>
 #include <map>
+#include <cstdio>
 #include "datatypes.h"
 #include "exceptions.h"
 
@@ -103,6 +104,8 @@ namespace pxar {
   /** Forward declaration, not including the header file!
    */
   class hal;
+  class condensedEventConsumer;
+  struct logContext;
 
 
   /** Define typedefs to allow easy passing of member function
@@ -114,6 +117,31 @@ namespace pxar {
   typedef  std::vector<Event> (hal::*HalMemFnRocSerial)(uint8_t rocid, bool efficiency, std::vector<int32_t> parameter);
   typedef  std::vector<Event> (hal::*HalMemFnPixelSerial)(uint8_t rocid, uint8_t column, uint8_t row, bool efficiency, std::vector<int32_t> parameter);
 
+  /** Consumer interface for streamed DAC scan results
+   *
+   *  Implementations receive the pixel data of one DAC setting at a time
+   *  while the scan is still running, e.g. to fill histograms directly
+   *  instead of keeping the full scan in memory. The consumer is called once
+   *  per DAC setting and pulsed pixel (or group of pixels pulsed together),
+   *  so every DAC value is delivered several times during a scan.
+   */
+  class DLLEXPORT dacScanConsumer {
+  public:
+    virtual ~dacScanConsumer() {}
+    virtual void consume(uint8_t dac, std::vector<pixel> & pixels) = 0;
+  };
+
+  /** Consumer interface for streamed 2D DAC-DAC scan results
+   *
+   *  Like pxar::dacScanConsumer, called once per pair of DAC settings and
+   *  pulsed pixel with the data read for that setting.
+   */
+  class DLLEXPORT dacDacScanConsumer {
+  public:
+    virtual ~dacDacScanConsumer() {}
+    virtual void consume(uint8_t dac1, uint8_t dac2, std::vector<pixel> & pixels) = 0;
+  };
+
 
 
   /** pxar API class definition
@@ -318,6 +346,13 @@ namespace pxar {
      */
     bool flashTB(std::string filename);
 
+    /** Function to change the sizes of the host-side USB write and read
+     *  buffers of the DTB connection (in bytes, default 64kB each).
+     *  Large DAQ readouts bypass the read buffer, larger buffers reduce the
+     *  number of USB transfers.
+     */
+    void setUsbBufferSize(uint32_t writeSize, uint32_t readSize);
+
     /** Function to read out analog DUT supply current on the testboard
      *  The current will be returned in SI units of Ampere
      */
@@ -338,6 +373,12 @@ namespace pxar {
      */
     double getTBvd();
 
+    /** Function to read out all DUT supply voltages and currents on the testboard
+     *  at once, costing a single USB round trip. Returns name/value pairs
+     *  ("va", "vd", "ia", "id") in SI units of Volts and Ampere.
+     */
+    std::vector<std::pair<std::string,double> > getTBpower();
+
     /** turn off HV
      */
     void HVoff();
@@ -411,6 +452,23 @@ namespace pxar {
      */
     bool setTbmReg(std::string regName, uint8_t regValue);
 
+    /** Start a register transaction
+     *
+     *  All following setDAC and setTbmReg calls update the pxar::dut bookkeeping
+     *  immediately, but the devices are only programmed when the transaction is
+     *  committed. Repeated changes of the same register are combined, values
+     *  already programmed on the device are not written again.
+     */
+    void startDACTransaction();
+
+    /** Commit a register transaction
+     *
+     *  Programs all DACs and TBM registers changed since startDACTransaction()
+     *  in one go and sends them to the testboard with a single USB transfer.
+     *  Test functions and DAQ sessions commit open transactions automatically.
+     */
+    bool commitDACTransaction();
+
     /** Method to scan a DAC range and measure the pulse height
      *
      *  Returns a vector of pairs containing set dac value and a pxar::pixel vector,
@@ -456,6 +514,28 @@ namespace pxar {
      */
     std::vector< std::pair<uint8_t, std::vector<pixel> > > getEfficiencyVsDAC(std::string dacName, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint16_t flags, uint16_t nTriggers);
 
+    /** Method to scan a DAC range and measure the pulse height, streaming version
+     *
+     *  Instead of returning the full scan, the pixel data is handed to the
+     *  "consumer" per DAC setting while the scan is running. The memory
+     *  footprint is thus limited to one DTB readout block.
+     *  Returns false if the scan could not be started.
+     *
+     *  If the readout of the DTB is corrupt, a pxar::DataMissingEvent is thrown.
+     */
+    bool getPulseheightVsDAC(std::string dacName, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint16_t flags, uint16_t nTriggers, dacScanConsumer & consumer);
+
+    /** Method to scan a DAC range and measure the efficiency, streaming version
+     *
+     *  Instead of returning the full scan, the pixel data is handed to the
+     *  "consumer" per DAC setting while the scan is running. The memory
+     *  footprint is thus limited to one DTB readout block.
+     *  Returns false if the scan could not be started.
+     *
+     *  If the readout of the DTB is corrupt, a pxar::DataMissingEvent is thrown.
+     */
+    bool getEfficiencyVsDAC(std::string dacName, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint16_t flags, uint16_t nTriggers, dacScanConsumer & consumer);
+
     /** Method to scan a DAC range and measure the pixel threshold
      *
      *  Returns a vector of pairs containing set dac value and pixels,
@@ -562,6 +642,28 @@ namespace pxar {
      */
     std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > getEfficiencyVsDACDAC(std::string dac1name, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, std::string dac2name, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint16_t flags, uint16_t nTriggers);
 
+    /** Method to scan a 2D DAC-Range (DAC1 vs. DAC2) and measure the pulse
+     *  height, streaming version
+     *
+     *  The pixel data is handed to the "consumer" per pair of DAC settings
+     *  while the scan is running instead of being returned at the end.
+     *  Returns false if the scan could not be started.
+     *
+     *  If the readout of the DTB is corrupt, a pxar::DataMissingEvent is thrown.
+     */
+    bool getPulseheightVsDACDAC(std::string dac1name, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, std::string dac2name, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint16_t flags, uint16_t nTriggers, dacDacScanConsumer & consumer);
+
+    /** Method to scan a 2D DAC-Range (DAC1 vs. DAC2) and measure the
+     *  efficiency, streaming version
+     *
+     *  The pixel data is handed to the "consumer" per pair of DAC settings
+     *  while the scan is running instead of being returned at the end.
+     *  Returns false if the scan could not be started.
+     *
+     *  If the readout of the DTB is corrupt, a pxar::DataMissingEvent is thrown.
+     */
+    bool getEfficiencyVsDACDAC(std::string dac1name, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, std::string dac2name, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint16_t flags, uint16_t nTriggers, dacDacScanConsumer & consumer);
+
     /** Method to get a map of the pulse height
      *
      *  Returns a vector of pixels, with the value of the pxar::pixel struct being
@@ -782,6 +884,13 @@ namespace pxar {
      */
     std::vector<Event> daqGetEventBuffer();
 
+    /** Same as pxarCore::daqGetEventBuffer(), additionally the raw data records
+     *  the Events were decoded from are returned in rawbuffer, one pxar::rawEvent
+     *  per pxar::Event. This allows keeping the raw data for later re-decoding
+     *  without reading the testboard RAM twice.
+     */
+    std::vector<Event> daqGetEventBuffer(std::vector<rawEvent> & rawbuffer);
+
     /** Function to return the full currently available ROC slow readback value
      *  buffer. The data is stored until a new DAQ session or test is called and
      *  can be fetched once (deleted at read time). The return vector contains
@@ -789,6 +898,29 @@ namespace pxar {
      */
     std::vector<std::vector<uint16_t> > daqGetReadback();
 
+    /** Function to acquire ROC slow readback values for a list of settings
+     *  within one DAQ session. Every setting is a pair of the value for the
+     *  DAC "dacName" and the readback register to select via the "readback"
+     *  DAC. For every setting both DACs are programmed, nTriggers triggers are
+     *  sent (one complete readback word needs 16, plus up to 16 to reach the
+     *  next start marker) and the data are decoded. An empty "dacName" only
+     *  cycles the readback register. A period of 0 selects the shortest period
+     *  the configured pattern generator allows.
+     *
+     *  The return vector holds for every setting one entry per ROC found in the
+     *  readout chain (as pxarCore::daqGetReadback()): the last readback word of
+     *  this ROC whose register (bits 8-11) matches the selected one, or 0 if
+     *  no such word was received.
+     *
+     *  The DAQ must not be running, it is started and stopped by this function.
+     */
+    std::vector<std::vector<uint16_t> > daqReadbackScan(std::string dacName, std::vector<std::pair<uint8_t, uint8_t> > settings, uint32_t nTriggers = 32, uint16_t period = 0);
+
+    /** Same as above, the DAC "dacName" is only programmed on the ROC with
+     *  the given ID (counting all ROCs up from 0, as pxarCore::setDAC()).
+     */
+    std::vector<std::vector<uint16_t> > daqReadbackScan(std::string dacName, uint8_t rocID, std::vector<std::pair<uint8_t, uint8_t> > settings, uint32_t nTriggers = 32, uint16_t period = 0);
+
     /** Function that returns a class object of the type pxar::statistics
      *  containing all collected error statistics from the last (non-raw)
      *  DAQ readout or API test call. Statistics can be fetched once and
@@ -816,6 +948,32 @@ namespace pxar {
      */
     statistics getStatistics();
 
+    /** Function that returns the current DAQ statistics as getStatistics(),
+     *  but without resetting the counters. Meant for monitoring from another
+     *  thread, which must not take the counters away from the running test.
+     */
+    statistics peekStatistics();
+
+    /** Functions to lock the testboard for the calling thread. Every pxarCore
+     *  function talking to the testboard holds this (recursive) lock for its
+     *  duration, so calls from different threads are never interleaved. A
+     *  test can hold it across several calls which must not be interrupted
+     *  by testboard access from other threads (e.g. the PixMonitor thread).
+     *  Every lockTestboard() has to be matched by an unlockTestboard().
+     */
+    void lockTestboard();
+    void unlockTestboard();
+
+    /** Function to set up the logging context of this pxarCore instance, for
+     *  running several instances (one per testboard) in parallel threads.
+     *  While a thread executes a call of this instance, its log messages are
+     *  prefixed with "name" and, if given, go to "stream" instead of the
+     *  process-wide log output and are filtered with "logLevel" instead of
+     *  the process-wide reporting level. Messages of the DAQ threads of this
+     *  instance follow the same context.
+     */
+    void setLogContext(std::string name, std::string logLevel = "", FILE * stream = NULL);
+
     /** DUT object for book keeping of settings
      */
     dut * _dut;
@@ -830,12 +988,27 @@ namespace pxar {
      */
     uint16_t GetADC( uint8_t rpc_par1 ) ;
 
+    /** Repacks map data from (possibly) several ROCs into one long vector
+     *  of pixels and returns the threshold value. Only works on the data
+     *  given and is checked against the former implementation in tools/decoder.cc.
+     */
+    static std::vector<pixel> repackThresholdMapData (std::vector<Event> &data, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint8_t thresholdlevel, uint16_t nTriggers, uint16_t flags);
+
+    /** Repacks DAC scan data into pairs of DAC values with fired pxar::pixel vectors and return the threshold value.
+     *  Only works on the data given, as repackThresholdMapData().
+     */
+    static std::vector<std::pair<uint8_t,std::vector<pixel> > > repackThresholdDacScanData (std::vector<Event> &data, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint8_t thresholdlevel, uint16_t nTriggers, uint16_t flags);
+
   private:
 
     /** Private HAL object for the API to access hardware routines
      */
     hal * _hal;
 
+    /** Logging context of this instance, see setLogContext()
+     */
+    logContext * _log;
+
     /** Routine to loop over all active ROCs/pixels and call the
      *  appropriate pixel, ROC or module HAL methods for execution.
      *
@@ -843,31 +1016,37 @@ namespace pxar {
      *  will check for the most efficient way to carry out a test requested by
      *  the user, i.e. select the full-ROC test instead of the pixel-by-pixel
      *  function, all depending on the configuration of the DUT.
+     *
+     *  If a consumer is given, the condensed data is handed to it during the
+     *  test and the returned vector stays empty.
+     */
+    std::vector<Event> expandLoop(HalMemFnPixelSerial pixelfn, HalMemFnPixelParallel multipixelfn, HalMemFnRocSerial rocfn, HalMemFnRocParallel multirocfn, std::vector<int32_t> param, bool efficiency, uint16_t flags = 0, condensedEventConsumer * consumer = NULL);
+
+    /** Runs a DAC scan for getPulseheightVsDAC and getEfficiencyVsDAC: orders
+     *  the DAC range, runs the test and resets the scanned DAC to its configured
+     *  value. The data is returned in "data", or streamed to the consumer if one
+     *  is given. Returns false if the DUT is not ready or the DAC is invalid.
      */
-    std::vector<Event> expandLoop(HalMemFnPixelSerial pixelfn, HalMemFnPixelParallel multipixelfn, HalMemFnRocSerial rocfn, HalMemFnRocParallel multirocfn, std::vector<int32_t> param, bool efficiency, uint16_t flags = 0);
+    bool runDacScan(std::string dacName, uint8_t dacStep, uint8_t & dacMin, uint8_t & dacMax, uint16_t flags, uint16_t nTriggers, bool efficiency, std::vector<Event> & data, dacScanConsumer * consumer = NULL);
+
+    /** Runs a DAC-DAC scan for getPulseheightVsDACDAC and getEfficiencyVsDACDAC,
+     *  as runDacScan().
+     */
+    bool runDacDacScan(std::string dac1name, uint8_t dac1step, uint8_t & dac1min, uint8_t & dac1max, std::string dac2name, uint8_t dac2step, uint8_t & dac2min, uint8_t & dac2max, uint16_t flags, uint16_t nTriggers, bool efficiency, std::vector<Event> & data, dacDacScanConsumer * consumer = NULL);
     
     /** Repacks map data from (possibly) several ROCs into one long vector
      *  of pixels.
      */
     std::vector<pixel> repackMapData (std::vector<Event> &data, uint16_t flags);
 
-    /** Repacks map data from (possibly) several ROCs into one long vector
-     *  of pixels and returns the threshold value.
-     */
-    std::vector<pixel> repackThresholdMapData (std::vector<Event> &data, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint8_t thresholdlevel, uint16_t nTriggers, uint16_t flags);
-
     /** Repacks DAC scan data into pairs of DAC values with fired pxar::pixel vectors.
      */
-    std::vector< std::pair<uint8_t, std::vector<pixel> > > repackDacScanData (std::vector<Event> &data, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint16_t flags);
-
-    /** Repacks DAC scan data into pairs of DAC values with fired pxar::pixel vectors and return the threshold value.
-     */
-    std::vector<std::pair<uint8_t,std::vector<pixel> > > repackThresholdDacScanData (std::vector<Event> &data, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint8_t thresholdlevel, uint16_t nTriggers, uint16_t flags);
+    static std::vector< std::pair<uint8_t, std::vector<pixel> > > repackDacScanData (std::vector<Event> &data, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint16_t flags);
 
     /** repacks (2D) DAC-DAC scan data into pairs of DAC values with
      *  vectors of the fired pixels.
      */
-    std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > repackDacDacScanData (std::vector<Event> &data, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint16_t flags);
+    static std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > repackDacDacScanData (std::vector<Event> &data, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint16_t flags);
 
     /** Helper function for conversion from string to register value
      *
@@ -882,6 +1061,11 @@ namespace pxar {
      */
     uint8_t stringToDeviceCode(std::string name);
 
+    /** Implementation of pxarCore::daqReadbackScan(), rocID < 0 programs the
+     *  scanned DAC on all enabled ROCs.
+     */
+    std::vector<std::vector<uint16_t> > readbackScan(std::string dacName, int rocID, std::vector<std::pair<uint8_t, uint8_t> > settings, uint32_t nTriggers, uint16_t period);
+
     /** Routine to loop over all ROCs/pixels and update the NIOS cache of trim
      *  and mask bits with the current test configuration. This cache is used
      *  for the trimming done on the test trigger loops unless FLAG_FORCE_UNMASKED
@@ -1028,6 +1212,12 @@ namespace pxar {
      */
     std::vector< pixelConfig > getEnabledPixels(size_t rocid);
 
+    /** Function returning a reference to the enabled pixels configs for a specific
+     *  ROC ID without copying them. The reference is valid until the pixel
+     *  configuration of the DUT is changed.
+     */
+    const std::vector< pixelConfig > & getEnabledPixelsView(size_t rocid);
+
     /** Function returning the enabled pixels configs for a ROC with given I2C address:
      */
     std::vector< pixelConfig > getEnabledPixelsI2C(size_t roci2c);
@@ -1127,6 +1317,11 @@ namespace pxar {
      */
     void maskPixel(uint8_t column, uint8_t row, bool mask, uint8_t rocid);
 
+    /** Function to mask all pixels set in the bitmap (indexed by column*ROC_NUMROWS + row)
+     *  on a specific ROC, the mask of the other pixels is not changed:
+     */
+    void maskPixels(const std::bitset< ROC_NUMCOLS*ROC_NUMROWS > & mask, uint8_t rocid);
+
     /** Function to enable all pixels on all ROCs:
      */
     void testAllPixels(bool enable);
@@ -177,6 +177,101 @@ namespace pxar {
     m_errors_pixel_buffer_corrupt = 0;
   }
 
+  void rocConfig::updatePixelIndex() {
+    _index.assign(ROC_NUMCOLS*ROC_NUMROWS, -1);
+    _nindexed = 0;
+    _enabled.reset();
+    _masked.reset();
+    _enabledPixelsValid = false;
+
+    for(size_t i = 0; i < pixels.size(); i++) {
+      uint8_t column = pixels[i].column(), row = pixels[i].row();
+      if(column >= ROC_NUMCOLS || row >= ROC_NUMROWS) {
+	LOG(logWARNING) << "Pixel " << static_cast<int>(column) << ", " << static_cast<int>(row)
+			<< " is outside of the ROC and will be ignored.";
+	continue;
+      }
+      size_t idx = column*ROC_NUMROWS + row;
+      // The first configuration of a pixel wins, duplicates are ignored:
+      if(_index[idx] >= 0) continue;
+      _index[idx] = static_cast<int16_t>(i);
+      _nindexed++;
+      _enabled[idx] = pixels[i].enable();
+      _masked[idx] = pixels[i].mask();
+    }
+  }
+
+  pixelConfig * rocConfig::findPixel(uint8_t column, uint8_t row) {
+    if(column >= ROC_NUMCOLS || row >= ROC_NUMROWS || _index.empty()) return NULL;
+    int16_t pos = _index[column*ROC_NUMROWS + row];
+    return (pos < 0 ? NULL : &pixels[pos]);
+  }
+
+  bool rocConfig::setPixelEnable(uint8_t column, uint8_t row, bool enable) {
+    pixelConfig * px = findPixel(column, row);
+    if(!px) return false;
+    px->setEnable(enable);
+    _enabled[column*ROC_NUMROWS + row] = enable;
+    _enabledPixelsValid = false;
+    return true;
+  }
+
+  bool rocConfig::setPixelMask(uint8_t column, uint8_t row, bool mask) {
+    pixelConfig * px = findPixel(column, row);
+    if(!px) return false;
+    px->setMask(mask);
+    _masked[column*ROC_NUMROWS + row] = mask;
+    _enabledPixelsValid = false;
+    return true;
+  }
+
+  bool rocConfig::setPixelTrim(uint8_t column, uint8_t row, uint8_t trim) {
+    pixelConfig * px = findPixel(column, row);
+    if(!px) return false;
+    px->setTrim(trim);
+    _enabledPixelsValid = false;
+    return true;
+  }
+
+  void rocConfig::setAllPixelsEnable(bool enable) {
+    for(std::vector<pixelConfig>::iterator px = pixels.begin(); px != pixels.end(); ++px) { px->setEnable(enable); }
+    updatePixelIndex();
+  }
+
+  void rocConfig::setAllPixelsMask(bool mask) {
+    for(std::vector<pixelConfig>::iterator px = pixels.begin(); px != pixels.end(); ++px) { px->setMask(mask); }
+    updatePixelIndex();
+  }
+
+  size_t rocConfig::maskPixels(const std::bitset< ROC_NUMCOLS*ROC_NUMROWS > & mask) {
+    if(mask.none()) return 0;
+    if(_index.empty()) return mask.count();
+    size_t nmissing = 0;
+    for(size_t idx = 0; idx < mask.size(); idx++) {
+      if(!mask.test(idx)) continue;
+      if(_index[idx] < 0) {
+	nmissing++;
+	continue;
+      }
+      pixels[_index[idx]].setMask(true);
+      _masked.set(idx);
+    }
+    _enabledPixelsValid = false;
+    return nmissing;
+  }
+
+  const std::vector<pixelConfig> & rocConfig::enabledPixels() {
+    if(!_enabledPixelsValid) {
+      _enabledPixels.clear();
+      _enabledPixels.reserve(_enabled.count());
+      for(std::vector<pixelConfig>::const_iterator px = pixels.begin(); px != pixels.end(); ++px) {
+	if(px->enable()) { _enabledPixels.push_back(*px); }
+      }
+      _enabledPixelsValid = true;
+    }
+    return _enabledPixels;
+  }
+
   tbmConfig::tbmConfig(uint8_t tbmtype) : dacs(), type(tbmtype), hubid(31), core(0xE0), tokenchains(), enable(true) {
 
     if(tbmtype == 0x0) {
@@ -20,6 +20,7 @@ typedef unsigned char uint8_t;
 #include <iostream>
 #include <vector>
 #include <map>
+#include <bitset>
 #include <limits>
 #include <cmath>
 
@@ -82,7 +83,7 @@ namespace pxar {
 
     /** Member function to get the value stored for this pixel hit
      */
-    double value() { 
+    double value() const { 
       return static_cast<double>(_mean);
     };
 
@@ -287,7 +288,11 @@ namespace pxar {
     /** Overloaded sum operator for adding up data from different events
      */
     friend Event& operator+=(Event &lhs, const Event &rhs) {
-      // FIXME this currently only transports pixels, no header information:
+      // The TBM header and trailer of the first event added are kept:
+      if(lhs.header == 0 && lhs.trailer == 0) {
+	lhs.header = rhs.header;
+	lhs.trailer = rhs.trailer;
+      }
       lhs.pixels.insert(lhs.pixels.end(), rhs.pixels.begin(), rhs.pixels.end());
       return lhs;
     };
@@ -396,18 +401,77 @@ namespace pxar {
    *
    *  Contains a DAC map for the ROC programming settings, a type flag, enable switch
    *  and a vector of pixelConfigs.
+   *
+   *  The pixelConfigs are indexed by column*ROC_NUMROWS + row, and their enable and
+   *  mask bits are mirrored in bitsets. This allows O(1) access to single pixels and
+   *  fast counting and comparison of pixel configurations. The pixel setters below keep
+   *  the vector and the bitsets in sync. If the pixels vector is modified directly,
+   *  updatePixelIndex() has to be called afterwards.
    */
   class DLLEXPORT rocConfig {
   public:
-  rocConfig() : pixels(), dacs(), type(0), _enable(true) {}
+  rocConfig() : pixels(), dacs(), type(0), _enable(true),
+      _index(), _nindexed(0), _enabled(), _masked(), _enabledPixels(), _enabledPixelsValid(false) {}
     std::vector< pixelConfig > pixels;
     std::map< uint8_t,uint8_t > dacs;
     uint8_t type;
     uint8_t i2c_address;
     bool enable() const { return _enable; }
     void setEnable(bool enable) { _enable = enable; }
+
+    /** Rebuild the pixel index and the enable/mask bitsets from the pixels vector
+     */
+    void updatePixelIndex();
+
+    /** Pointer to the configuration of the given pixel, NULL if not configured
+     */
+    pixelConfig * findPixel(uint8_t column, uint8_t row);
+
+    bool pixelEnabled(uint8_t column, uint8_t row) const {
+      return (column < ROC_NUMCOLS && row < ROC_NUMROWS && _enabled.test(column*ROC_NUMROWS + row));
+    }
+    bool pixelMasked(uint8_t column, uint8_t row) const {
+      return (column < ROC_NUMCOLS && row < ROC_NUMROWS && _masked.test(column*ROC_NUMROWS + row));
+    }
+
+    /** Pixel setters, return false if the pixel is not configured
+     */
+    bool setPixelEnable(uint8_t column, uint8_t row, bool enable);
+    bool setPixelMask(uint8_t column, uint8_t row, bool mask);
+    bool setPixelTrim(uint8_t column, uint8_t row, uint8_t trim);
+    void setAllPixelsEnable(bool enable);
+    void setAllPixelsMask(bool mask);
+
+    /** Set the mask bit of all pixels marked in the bitmap (indexed by column*ROC_NUMROWS + row),
+     *  the other pixels are not changed. Returns the number of marked pixels which are not configured.
+     */
+    size_t maskPixels(const std::bitset< ROC_NUMCOLS*ROC_NUMROWS > & mask);
+
+    size_t nEnabledPixels() const { return _enabled.count(); }
+    size_t nMaskedPixels() const { return _masked.count(); }
+    bool allPixelsEnabled() const { return _enabled.count() == _nindexed; }
+
+    /** Enabled pixels in the order of the pixels vector. The list is cached
+     *  and only rebuilt after the pixel configuration has changed.
+     */
+    const std::vector< pixelConfig > & enabledPixels();
+
+    /** Bitmap of enabled pixels, indexed by column*ROC_NUMROWS + row
+     */
+    const std::bitset< ROC_NUMCOLS*ROC_NUMROWS > & enabledPixelMap() const { return _enabled; }
+
+    /** Bitmap of masked pixels, indexed by column*ROC_NUMROWS + row
+     */
+    const std::bitset< ROC_NUMCOLS*ROC_NUMROWS > & maskedPixelMap() const { return _masked; }
+
   private:
     bool _enable;
+    std::vector< int16_t > _index; // position in pixels, -1 if not configured
+    size_t _nindexed;
+    std::bitset< ROC_NUMCOLS*ROC_NUMROWS > _enabled;
+    std::bitset< ROC_NUMCOLS*ROC_NUMROWS > _masked;
+    std::vector< pixelConfig > _enabledPixels;
+    bool _enabledPixelsValid;
   };
 
   /** Class for TBM states
@@ -441,6 +505,11 @@ namespace pxar {
      */
     friend class dtbEventDecoder;
 
+    /** Allow the event file writer and reader to store and restore the counters
+     */
+    friend class eventFileWriter;
+    friend class eventFileReader;
+
   public:
   statistics() :
     m_info_words_read(0),
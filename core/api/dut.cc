@@ -43,7 +43,7 @@ void dut::info() {
 
 size_t dut::getNEnabledPixels(uint8_t rocid) {
   if (!_initialized || rocid >= roc.size()) return 0;
-  return std::count_if(roc.at(rocid).pixels.begin(),roc.at(rocid).pixels.end(),configEnableSet(true));
+  return roc.at(rocid).nEnabledPixels();
 }
 
 size_t dut::getNEnabledPixels() {
@@ -51,14 +51,14 @@ size_t dut::getNEnabledPixels() {
   size_t nenabled = 0;
   // Loop over all ROCs
   for (std::vector<rocConfig>::iterator rocit = roc.begin() ; rocit != roc.end(); ++rocit){
-    nenabled += std::count_if(rocit->pixels.begin(),rocit->pixels.end(),configEnableSet(true));
+    nenabled += rocit->nEnabledPixels();
   }
   return nenabled;
 }
 
 size_t dut::getNMaskedPixels(uint8_t rocid) {
   if (!_initialized || rocid >= roc.size()) return 0;
-  return std::count_if(roc.at(rocid).pixels.begin(),roc.at(rocid).pixels.end(),configMaskSet(true));
+  return roc.at(rocid).nMaskedPixels();
 }
 
 size_t dut::getNMaskedPixels() {
@@ -66,7 +66,7 @@ size_t dut::getNMaskedPixels() {
   size_t nmasked = 0;
   // Loop over all ROCs
   for (std::vector<rocConfig>::iterator rocit = roc.begin() ; rocit != roc.end(); ++rocit){
-    nmasked += std::count_if(rocit->pixels.begin(),rocit->pixels.end(),configMaskSet(true));
+    nmasked += rocit->nMaskedPixels();
   }
   return nmasked;
 }
@@ -122,17 +122,18 @@ size_t dut::getNTbms() {
 
 
 std::vector< pixelConfig > dut::getEnabledPixels(size_t rocid) {
+  return getEnabledPixelsView(rocid);
+}
 
-  std::vector< pixelConfig > result;
+const std::vector< pixelConfig > & dut::getEnabledPixelsView(size_t rocid) {
+
+  static const std::vector< pixelConfig > empty;
 
   // Check if DUT is allright and the roc we are looking at exists:
-  if (!status() || !(rocid < roc.size())) return result;
+  if (!status() || !(rocid < roc.size())) return empty;
 
-  // Search for pixels that have enable set
-  for (std::vector<pixelConfig>::iterator it = roc.at(rocid).pixels.begin(); it != roc.at(rocid).pixels.end(); ++it){
-    if (it->enable()) result.push_back(*it);
-  }
-  return result;
+  // The list of enabled pixels is cached by the ROC configuration:
+  return roc.at(rocid).enabledPixels();
 }
 
 std::vector< pixelConfig > dut::getEnabledPixelsI2C(size_t roci2c) {
@@ -145,10 +146,8 @@ std::vector< pixelConfig > dut::getEnabledPixelsI2C(size_t roci2c) {
   // Loop over all ROCs
   for (std::vector<rocConfig>::iterator rocit = roc.begin() ; rocit != roc.end(); ++rocit){
     if(rocit->i2c_address == roci2c) {
-      // Search for pixels that have enable set
-      for (std::vector<pixelConfig>::iterator it = rocit->pixels.begin(); it != rocit->pixels.end(); ++it){
-	if (it->enable()) result.push_back(*it);
-      }
+      const std::vector<pixelConfig> & enabled = rocit->enabledPixels();
+      result.insert(result.end(), enabled.begin(), enabled.end());
     }
   }
 
@@ -162,12 +161,11 @@ std::vector< pixelConfig > dut::getEnabledPixels() {
   // Check if DUT is allright and the roc we are looking at exists:
   if (!status()) return result;
 
+  result.reserve(getNEnabledPixels());
   // Loop over all ROCs
   for (std::vector<rocConfig>::iterator rocit = roc.begin() ; rocit != roc.end(); ++rocit){
-    // Search for pixels that have enable set
-    for (std::vector<pixelConfig>::iterator it = rocit->pixels.begin(); it != rocit->pixels.end(); ++it){
-      if (it->enable()) result.push_back(*it);
-    }
+    const std::vector<pixelConfig> & enabled = rocit->enabledPixels();
+    result.insert(result.end(), enabled.begin(), enabled.end());
   }
   return result;
 }
@@ -179,7 +177,8 @@ std::vector< pixelConfig > dut::getMaskedPixels(size_t rocid) {
   // Check if DUT is allright and the roc we are looking at exists:
   if (!status() || !(rocid < roc.size())) return result;
 
-  // Search for pixels that have enable set
+  // Search for pixels that have mask set
+  result.reserve(roc.at(rocid).nMaskedPixels());
   for (std::vector<pixelConfig>::iterator it = roc.at(rocid).pixels.begin(); it != roc.at(rocid).pixels.end(); ++it){
     if (it->mask()) result.push_back(*it);
   }
@@ -193,9 +192,10 @@ std::vector< pixelConfig > dut::getMaskedPixels() {
   // Check if DUT is allright and the roc we are looking at exists:
   if (!status()) return result;
 
+  result.reserve(getNMaskedPixels());
   // Loop over all ROCs
   for (std::vector<rocConfig>::iterator rocit = roc.begin() ; rocit != roc.end(); ++rocit){
-    // Search for pixels that have enable set
+    // Search for pixels that have mask set
     for (std::vector<pixelConfig>::iterator it = rocit->pixels.begin(); it != rocit->pixels.end(); ++it){
       if (it->mask()) result.push_back(*it);
     }
@@ -213,8 +213,9 @@ std::vector< bool > dut::getEnabledColumns(size_t roci2c) {
   for(std::vector<rocConfig>::iterator rocit = roc.begin(); rocit != roc.end(); ++rocit){
     if(rocit->i2c_address == roci2c) {
       // Search for pixels that have enable set
-      for(std::vector<pixelConfig>::iterator it = rocit->pixels.begin(); it != rocit->pixels.end(); ++it){
-	if (it->enable()) result.at((*it).column()) = true;
+      const std::vector<pixelConfig> & enabled = rocit->enabledPixels();
+      for(std::vector<pixelConfig>::const_iterator it = enabled.begin(); it != enabled.end(); ++it){
+	result.at((*it).column()) = true;
       }
     }
   }
@@ -281,23 +282,13 @@ std::vector< tbmConfig > dut::getEnabledTbms() {
 }
 
 bool dut::getPixelEnabled(uint8_t column, uint8_t row) {
-  std::vector<pixelConfig>::iterator it = std::find_if(roc.at(0).pixels.begin(),
-						       roc.at(0).pixels.end(),
-						       findPixelXY(column,row));
-  if(it != roc.at(0).pixels.end()) { return it->enable(); }
-  return false;
+  return roc.at(0).pixelEnabled(column,row);
 }
 
 bool dut::getAllPixelEnable(){
  if (!status()) return false;
- // search for pixels that DO NOT have enable set
- std::vector<pixelConfig>::iterator it = std::find_if(roc.at(0).pixels.begin(),
-						      roc.at(0).pixels.end(),
-						      configEnableSet(false));
- if(it != roc.at(0).pixels.end())
-   return false; // found a disabled pixel
- else
-   return true; // all pixels are enabled
+ // check that no configured pixel has enable unset
+ return roc.at(0).allPixelsEnabled();
 }
 
 
@@ -320,13 +311,9 @@ pixelConfig dut::getPixelConfig(size_t rocid, uint8_t column, uint8_t row) {
   pixelConfig result; // initialized with 0 by constructor
   if (!status()) return result;
   // find pixel with specified column and row
-  std::vector<pixelConfig>::iterator it = std::find_if(roc.at(rocid).pixels.begin(),
-						       roc.at(rocid).pixels.end(),
-						       findPixelXY(column,row));
+  pixelConfig * px = roc.at(rocid).findPixel(column,row);
   // if pixel found, set result accordingly
-  if(it != roc.at(rocid).pixels.end()){
-    result = *it;
-  }
+  if(px) result = *px;
   return result;
 }
 
@@ -423,14 +410,8 @@ void dut:: maskPixel(uint8_t column, uint8_t row, bool mask) {
   if(status()) {
     // Loop over all ROCs
     for (std::vector<rocConfig>::iterator rocit = roc.begin() ; rocit != roc.end(); ++rocit){
-      // Find pixel with specified column and row
-      std::vector<pixelConfig>::iterator it = std::find_if(rocit->pixels.begin(),
-							   rocit->pixels.end(),
-							   findPixelXY(column,row));
-      // Set enable bit
-      if(it != rocit->pixels.end()) {
-	it->setMask(mask);
-      } else {
+      // Set mask bit of the pixel with specified column and row
+      if(!rocit->setPixelMask(column,row,mask)) {
 	LOG(logWARNING) << "Pixel at column " << static_cast<int>(column) << " and row " << static_cast<int>(row) << " not found for ROC " << static_cast<int>(rocit - roc.begin()) << "!" ;
       }
     }
@@ -440,32 +421,31 @@ void dut:: maskPixel(uint8_t column, uint8_t row, bool mask) {
 void dut:: maskPixel(uint8_t column, uint8_t row, bool mask, uint8_t rocid) {
 
   if(status() && rocid < roc.size()) {
-    // Find pixel with specified column and row
-    std::vector<pixelConfig>::iterator it = std::find_if(roc.at(rocid).pixels.begin(),
-							 roc.at(rocid).pixels.end(),
-							 findPixelXY(column,row));
-    // Set mask:
-    if(it != roc.at(rocid).pixels.end()){
-      it->setMask(mask);
-    } else {
+    // Set mask bit of the pixel with specified column and row
+    if(!roc.at(rocid).setPixelMask(column,row,mask)) {
       LOG(logWARNING) << "Pixel at column " << static_cast<int>(column) << " and row " << static_cast<int>(row) << " not found for ROC " << static_cast<int>(rocid)<< "!" ;
     }
   }
 }
 
+void dut::maskPixels(const std::bitset< ROC_NUMCOLS*ROC_NUMROWS > & mask, uint8_t rocid) {
+
+  if(status() && rocid < roc.size()) {
+    // Set mask bits of all pixels in the bitmap
+    size_t nmissing = roc.at(rocid).maskPixels(mask);
+    if(nmissing > 0) {
+      LOG(logWARNING) << nmissing << " pixels to be masked not found for ROC " << static_cast<int>(rocid) << "!" ;
+    }
+  }
+}
+
 void dut::testPixel(uint8_t column, uint8_t row, bool enable) {
 
   if(status()) {
     // Loop over all ROCs
     for (std::vector<rocConfig>::iterator rocit = roc.begin() ; rocit != roc.end(); ++rocit){
-      // Find pixel with specified column and row
-      std::vector<pixelConfig>::iterator it = std::find_if(rocit->pixels.begin(),
-							   rocit->pixels.end(),
-							   findPixelXY(column,row));
-      // Set enable bit
-      if(it != rocit->pixels.end()) {
-	it->setEnable(enable);
-      } else {
+      // Set enable bit of the pixel with specified column and row
+      if(!rocit->setPixelEnable(column,row,enable)) {
 	LOG(logWARNING) << "Pixel at column " << static_cast<int>(column) << " and row " << static_cast<int>(row) << " not found for ROC " << static_cast<int>(rocit - roc.begin())<< "!" ;
       }
     }
@@ -475,14 +455,8 @@ void dut::testPixel(uint8_t column, uint8_t row, bool enable) {
 void dut::testPixel(uint8_t column, uint8_t row, bool enable, uint8_t rocid) {
 
   if(status() && rocid < roc.size()) {
-    // Find pixel with specified column and row
-    std::vector<pixelConfig>::iterator it = std::find_if(roc.at(rocid).pixels.begin(),
-							 roc.at(rocid).pixels.end(),
-							 findPixelXY(column,row));
-    // Set mask:
-    if(it != roc.at(rocid).pixels.end()){
-      it->setEnable(enable);
-    } else {
+    // Set enable bit of the pixel with specified column and row
+    if(!roc.at(rocid).setPixelEnable(column,row,enable)) {
       LOG(logWARNING) << "Pixel at column " << static_cast<int>(column) << " and row " << static_cast<int>(row) << " not found for ROC " << static_cast<int>(rocid)<< "!" ;
     }
   }
@@ -494,10 +468,8 @@ void dut::maskAllPixels(bool mask) {
     LOG(logDEBUGAPI) << "Set mask bit to " << static_cast<int>(mask) << " for all pixels on all ROCs.";
     // Loop over all ROCs
     for (std::vector<rocConfig>::iterator rocit = roc.begin() ; rocit != roc.end(); ++rocit){
-      // loop over all pixel, set enable according to parameter
-      for (std::vector<pixelConfig>::iterator pixelit = rocit->pixels.begin() ; pixelit != rocit->pixels.end(); ++pixelit){
-	pixelit->setMask(mask);
-      }
+      // set mask for all pixels according to parameter
+      rocit->setAllPixelsMask(mask);
     }
   }
 }
@@ -506,10 +478,8 @@ void dut::maskAllPixels(bool mask, uint8_t rocid) {
 
   if(status() && rocid < roc.size()) {
     LOG(logDEBUGAPI) << "Set mask bit to " << static_cast<int>(mask) << " for all pixels on ROC " << static_cast<int>(rocid);
-    // loop over all pixel, set enable according to parameter
-    for (std::vector<pixelConfig>::iterator pixelit = roc.at(rocid).pixels.begin() ; pixelit != roc.at(rocid).pixels.end(); ++pixelit){
-      pixelit->setMask(mask);
-    }
+    // set mask for all pixels according to parameter
+    roc.at(rocid).setAllPixelsMask(mask);
   }
 }
 
@@ -517,10 +487,8 @@ void dut::testAllPixels(bool enable, uint8_t rocid) {
 
   if(status() && rocid < roc.size()) {
     LOG(logDEBUGAPI) << "Set enable bit to " << static_cast<int>(enable) << " for all pixels on ROC " << static_cast<int>(rocid);
-    // loop over all pixel, set enable according to parameter
-    for (std::vector<pixelConfig>::iterator pixelit = roc.at(rocid).pixels.begin() ; pixelit != roc.at(rocid).pixels.end(); ++pixelit){
-      pixelit->setEnable(enable);
-    }
+    // set enable for all pixels according to parameter
+    roc.at(rocid).setAllPixelsEnable(enable);
   }
 }
 
@@ -530,10 +498,8 @@ void dut::testAllPixels(bool enable) {
     LOG(logDEBUGAPI) << "Set enable bit to " << static_cast<int>(enable) << " for all pixels on all ROCs";
     // Loop over all ROCs
     for (std::vector<rocConfig>::iterator rocit = roc.begin() ; rocit != roc.end(); ++rocit){
-      // loop over all pixel, set enable according to parameter
-      for (std::vector<pixelConfig>::iterator pixelit = rocit->pixels.begin() ; pixelit != rocit->pixels.end(); ++pixelit){
-	pixelit->setEnable(enable);
-      }
+      // set enable for all pixels according to parameter
+      rocit->setAllPixelsEnable(enable);
     }
   }
 }
@@ -541,16 +507,8 @@ void dut::testAllPixels(bool enable) {
 bool dut::updateTrimBits(pixelConfig trimming, uint8_t rocid) {
 
   if(status() && rocid < roc.size()) {
-
-    // Find the pixel in the given ROC pixels vector:
-    std::vector<pixelConfig>::iterator px = std::find_if(roc.at(rocid).pixels.begin(),
-							 roc.at(rocid).pixels.end(),
-							 findPixelXY(trimming.column(),trimming.row()));
-    // Pixel was not found:
-    if(px == roc.at(0).pixels.end()) return false;
-    // Pixel was found, set the new trimming values:
-    px->setTrim(trimming.trim());
-    return true;
+    // Set the new trimming values, fails if the pixel was not found:
+    return roc.at(rocid).setPixelTrim(trimming.column(),trimming.row(),trimming.trim());
   }
   else { return false; }
 }
@@ -558,16 +516,8 @@ bool dut::updateTrimBits(pixelConfig trimming, uint8_t rocid) {
 bool dut::updateTrimBits(uint8_t column, uint8_t row, uint8_t trim, uint8_t rocid) {
 
   if(status() && rocid < roc.size()) {
-
-    // Find the pixel in the given ROC pixels vector:
-    std::vector<pixelConfig>::iterator px = std::find_if(roc.at(rocid).pixels.begin(),
-							 roc.at(rocid).pixels.end(),
-							 findPixelXY(column,row));
-    // Pixel was not found:
-    if(px == roc.at(0).pixels.end()) return false;
-    // Pixel was found, set the new trimming values:
-    px->setTrim(trim);
-    return true;
+    // Set the new trimming values, fails if the pixel was not found:
+    return roc.at(rocid).setPixelTrim(column,row,trim);
   }
   else { return false; }
 }
@@ -577,15 +527,8 @@ bool dut::updateTrimBits(std::vector<pixelConfig> trimming, uint8_t rocid) {
   if(status() && rocid < roc.size()) {
     // Loop over all trimbit pixelConfigs we got as parameter:
     for (std::vector<pixelConfig>::iterator it = trimming.begin(); it != trimming.end(); ++it){
-
-      // Find the pixel in the given ROC pixels vector:
-      std::vector<pixelConfig>::iterator px = std::find_if(roc.at(rocid).pixels.begin(),
-							   roc.at(rocid).pixels.end(),
-							   findPixelXY(it->column(),it->row()));
-      // Pixel was not found:
-      if(px == roc.at(0).pixels.end()) return false;
-      // Pixel was found, set the new trimming values:
-      px->setTrim(it->trim());
+      // Set the new trimming values, stop if the pixel was not found:
+      if(!roc.at(rocid).setPixelTrim(it->column(),it->row(),it->trim())) return false;
     }
     return true;
   }
@@ -0,0 +1,452 @@
+/**
+ * pxar event file writer and reader implementation
+ */
+
+#include "eventfile.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+using namespace pxar;
+
+namespace {
+  // All columns are padded to multiples of eight bytes:
+  uint64_t padded(uint64_t bytes) { return (bytes + 7) & ~static_cast<uint64_t>(7); }
+
+  // Size of a block with the given content, header included:
+  uint64_t blockSize(uint64_t nevents, uint64_t nhits, uint64_t nrawwords, bool raw) {
+    uint64_t size = sizeof(eventFileBlockHeader)
+      + padded(4*(nevents+1))           // hitoffset
+      + 2*padded(2*nevents)             // header, trailer
+      + padded(4*nhits)                 // event
+      + 3*padded(nhits)                 // roc, column, row
+      + padded(2*nhits);                // value
+    if(raw) {
+      size += padded(4*(nevents+1))     // rawoffset
+	+ padded(nevents)               // rawflags
+	+ padded(2*nrawwords);          // raw
+    }
+    return size;
+  }
+
+  template <typename T>
+    const T * column(const char * &pos, uint64_t n) {
+    const T * col = reinterpret_cast<const T*>(pos);
+    pos += padded(sizeof(T)*n);
+    return col;
+  }
+}
+
+eventFileWriter::eventFileWriter(const std::string & filename) :
+  m_filename(filename), m_file(NULL), m_offset(0), m_events(0), m_index() {
+
+  m_file = fopen(filename.c_str(), "wb");
+  if(!m_file) { throw EventFileError("Could not open event file " + filename + " for writing"); }
+
+  eventFileHeader header;
+  header.magic = EVENTFILE_MAGIC;
+  header.version = EVENTFILE_VERSION;
+  header.byteorder = EVENTFILE_BYTEORDER;
+  header.indexoffset = 0;
+  write(&header, sizeof(header));
+  LOG(logDEBUGAPI) << "Opened event file " << m_filename << " for writing.";
+}
+
+eventFileWriter::~eventFileWriter() {
+  try { close(); }
+  catch(EventFileError &e) { LOG(logERROR) << e.what(); }
+}
+
+void eventFileWriter::write(const void * data, size_t size) {
+  if(size > 0 && fwrite(data, 1, size, m_file) != size) {
+    throw EventFileError("Error writing to event file " + m_filename);
+  }
+  m_offset += size;
+}
+
+void eventFileWriter::pad() {
+  static const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  write(zeros, padded(m_offset) - m_offset);
+}
+
+void eventFileWriter::writeBlock(std::vector<Event> & events, statistics stats, std::vector<rawEvent> * raw) {
+
+  if(!m_file) { throw EventFileError("Event file " + m_filename + " has already been closed"); }
+  if(raw && raw->size() != events.size()) {
+    throw EventFileError("Number of raw events does not match the number of decoded events");
+  }
+
+  // Assemble the columns:
+  size_t nevents = events.size();
+  std::vector<uint32_t> hitoffset(1, 0), event;
+  std::vector<uint16_t> header(nevents), trailer(nevents);
+  std::vector<uint8_t> roc, col, row;
+  std::vector<int16_t> value;
+
+  for(size_t i = 0; i < nevents; i++) {
+    header[i] = events[i].header;
+    trailer[i] = events[i].trailer;
+    for(std::vector<pixel>::iterator px = events[i].pixels.begin(); px != events[i].pixels.end(); ++px) {
+      event.push_back(i);
+      roc.push_back(px->roc());
+      col.push_back(px->column());
+      row.push_back(px->row());
+      value.push_back(static_cast<int16_t>(px->value()));
+    }
+    hitoffset.push_back(event.size());
+  }
+
+  std::vector<uint32_t> rawoffset(1, 0);
+  std::vector<uint8_t> rawflags;
+  std::vector<uint16_t> rawdata;
+  if(raw) {
+    for(std::vector<rawEvent>::iterator it = raw->begin(); it != raw->end(); ++it) {
+      rawdata.insert(rawdata.end(), it->data.begin(), it->data.end());
+      rawoffset.push_back(rawdata.size());
+      rawflags.push_back((it->IsStartError() ? 1 : 0) | (it->IsEndError() ? 2 : 0) | (it->IsOverflow() ? 4 : 0));
+    }
+  }
+
+  // Block header with the statistics counters:
+  eventFileBlockHeader block;
+  memset(&block, 0, sizeof(block));
+  block.magic = EVENTFILE_BLOCK_MAGIC;
+  block.nevents = nevents;
+  block.firstevent = m_events;
+  block.nhits = event.size();
+  block.flags = (raw ? EVENTFILE_BLOCK_RAW : 0);
+  block.nrawwords = rawdata.size();
+  block.size = blockSize(block.nevents, block.nhits, block.nrawwords, raw != NULL);
+
+  uint32_t counters[EVENTFILE_STATISTICS] = {
+    stats.m_info_words_read, stats.m_info_events_empty, stats.m_info_events_valid, stats.m_info_pixels_valid,
+    stats.m_errors_event_start, stats.m_errors_event_stop, stats.m_errors_event_overflow,
+    stats.m_errors_event_invalid_words, stats.m_errors_event_invalid_xor,
+    stats.m_errors_tbm_header, stats.m_errors_tbm_trailer, stats.m_errors_tbm_eventid_mismatch,
+    stats.m_errors_roc_missing, stats.m_errors_roc_readback,
+    stats.m_errors_pixel_incomplete, stats.m_errors_pixel_address,
+    stats.m_errors_pixel_pulseheight, stats.m_errors_pixel_buffer_corrupt };
+  memcpy(block.stats, counters, sizeof(counters));
+
+  eventFileIndexEntry entry;
+  entry.offset = m_offset;
+  entry.firstevent = m_events;
+  entry.nevents = block.nevents;
+  entry.reserved = 0;
+
+  // Write the block:
+  write(&block, sizeof(block));
+  write(&hitoffset[0], 4*hitoffset.size()); pad();
+  if(nevents > 0) {
+    write(&header[0], 2*nevents); pad();
+    write(&trailer[0], 2*nevents); pad();
+  }
+  if(!event.empty()) {
+    write(&event[0], 4*event.size()); pad();
+    write(&roc[0], roc.size()); pad();
+    write(&col[0], col.size()); pad();
+    write(&row[0], row.size()); pad();
+    write(&value[0], 2*value.size()); pad();
+  }
+  if(raw) {
+    write(&rawoffset[0], 4*rawoffset.size()); pad();
+    if(nevents > 0) { write(&rawflags[0], nevents); pad(); }
+    if(!rawdata.empty()) { write(&rawdata[0], 2*rawdata.size()); pad(); }
+  }
+
+  // Make the block available to readers right away:
+  if(fflush(m_file) != 0) { throw EventFileError("Error writing to event file " + m_filename); }
+
+  m_index.push_back(entry);
+  m_events += nevents;
+  LOG(logDEBUGAPI) << "Wrote block " << m_index.size() << " with " << nevents << " events, "
+		   << block.nhits << " hits and " << block.nrawwords << " raw words to " << m_filename;
+}
+
+void eventFileWriter::close() {
+  if(!m_file) return;
+
+  // Append the block index:
+  uint64_t indexoffset = m_offset;
+  uint32_t index[2] = { EVENTFILE_INDEX_MAGIC, static_cast<uint32_t>(m_index.size()) };
+  write(index, sizeof(index));
+  if(!m_index.empty()) { write(&m_index[0], m_index.size()*sizeof(eventFileIndexEntry)); }
+
+  // Store its position in the file header:
+  if(fseek(m_file, offsetof(eventFileHeader, indexoffset), SEEK_SET) != 0
+     || fwrite(&indexoffset, sizeof(indexoffset), 1, m_file) != 1) {
+    fclose(m_file);
+    m_file = NULL;
+    throw EventFileError("Error writing the index of event file " + m_filename);
+  }
+
+  bool closed = (fclose(m_file) == 0);
+  m_file = NULL;
+  if(!closed) { throw EventFileError("Error closing event file " + m_filename); }
+  LOG(logDEBUGAPI) << "Closed event file " << m_filename << " with " << m_events << " events in "
+		   << m_index.size() << " blocks.";
+}
+
+
+eventFileReader::eventFileReader(const std::string & filename) :
+  m_data(NULL), m_size(0), m_events(0), m_blocks(), m_offsets() {
+
+  map(filename);
+
+  // Check the file header:
+  if(m_size < sizeof(eventFileHeader)) {
+    unmap();
+    throw EventFileError("File " + filename + " is not a pxar event file");
+  }
+  const eventFileHeader * header = reinterpret_cast<const eventFileHeader*>(m_data);
+  if(header->magic != EVENTFILE_MAGIC || header->byteorder != EVENTFILE_BYTEORDER || header->version != EVENTFILE_VERSION) {
+    unmap();
+    throw EventFileError("File " + filename + " is not a pxar event file of this version and byte order");
+  }
+
+  // Use the block index if the file has been closed properly, otherwise scan for the blocks:
+  if(header->indexoffset != 0) { readIndex(header->indexoffset); }
+  else {
+    LOG(logWARNING) << "Event file " << filename << " has no block index, scanning for blocks.";
+    scanBlocks();
+  }
+  LOG(logDEBUGAPI) << "Opened event file " << filename << " with " << m_events << " events in "
+		   << m_blocks.size() << " blocks.";
+}
+
+eventFileReader::~eventFileReader() {
+  unmap();
+}
+
+void eventFileReader::map(const std::string & filename) {
+#ifndef WIN32
+  int fd = open(filename.c_str(), O_RDONLY);
+  if(fd < 0) { throw EventFileError("Could not open event file " + filename); }
+  struct stat st;
+  if(fstat(fd, &st) != 0) {
+    ::close(fd);
+    throw EventFileError("Could not open event file " + filename);
+  }
+  m_size = st.st_size;
+  if(m_size > 0) {
+    void * data = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data == MAP_FAILED) {
+      ::close(fd);
+      throw EventFileError("Could not map event file " + filename);
+    }
+    m_data = static_cast<const char*>(data);
+  }
+  // The mapping stays valid after closing the file descriptor:
+  ::close(fd);
+#else
+  std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+  if(!file) { throw EventFileError("Could not open event file " + filename); }
+  file.seekg(0, std::ios::end);
+  m_buffer.resize(static_cast<size_t>(file.tellg()));
+  file.seekg(0, std::ios::beg);
+  if(!m_buffer.empty()) { file.read(&m_buffer[0], m_buffer.size()); }
+  m_size = m_buffer.size();
+  m_data = (m_size > 0 ? &m_buffer[0] : NULL);
+#endif
+}
+
+void eventFileReader::unmap() {
+#ifndef WIN32
+  if(m_data) { munmap(const_cast<char*>(m_data), m_size); }
+#else
+  m_buffer.clear();
+#endif
+  m_data = NULL;
+  m_size = 0;
+}
+
+void eventFileReader::readIndex(uint64_t offset) {
+  const uint32_t * index = (offset + 2*sizeof(uint32_t) <= m_size ? reinterpret_cast<const uint32_t*>(m_data + offset) : NULL);
+  if(!index || index[0] != EVENTFILE_INDEX_MAGIC
+     || offset + 2*sizeof(uint32_t) + index[1]*sizeof(eventFileIndexEntry) > m_size) {
+    LOG(logWARNING) << "Corrupt block index in event file, scanning for blocks.";
+    scanBlocks();
+    return;
+  }
+
+  const eventFileIndexEntry * entry = reinterpret_cast<const eventFileIndexEntry*>(index + 2);
+  for(uint32_t i = 0; i < index[1]; i++) {
+    addBlock(entry[i].offset);
+    if(m_blocks.size() != i+1 || m_blocks.back().firstevent != entry[i].firstevent) {
+      LOG(logWARNING) << "Block index does not match the event file content, scanning for blocks.";
+      m_blocks.clear();
+      m_offsets.clear();
+      m_events = 0;
+      scanBlocks();
+      return;
+    }
+  }
+}
+
+void eventFileReader::scanBlocks() {
+  // Blocks follow each other directly after the file header:
+  uint64_t offset = sizeof(eventFileHeader);
+  while(offset + sizeof(eventFileBlockHeader) <= m_size) {
+    const eventFileBlockHeader * block = reinterpret_cast<const eventFileBlockHeader*>(m_data + offset);
+    if(block->magic != EVENTFILE_BLOCK_MAGIC) break;
+    size_t nblocks = m_blocks.size();
+    addBlock(offset);
+    if(m_blocks.size() == nblocks) {
+      LOG(logWARNING) << "Event file ends with incomplete block, ignoring it.";
+      break;
+    }
+    offset += block->size;
+  }
+}
+
+void eventFileReader::addBlock(uint64_t offset) {
+  // Check that the block is complete and consistent:
+  if(offset + sizeof(eventFileBlockHeader) > m_size) return;
+  const eventFileBlockHeader * header = reinterpret_cast<const eventFileBlockHeader*>(m_data + offset);
+  bool raw = ((header->flags & EVENTFILE_BLOCK_RAW) != 0);
+  if(header->magic != EVENTFILE_BLOCK_MAGIC || header->firstevent != m_events
+     || header->size != blockSize(header->nevents, header->nhits, header->nrawwords, raw)
+     || offset + header->size > m_size) return;
+
+  eventFileBlock block;
+  block.firstevent = header->firstevent;
+  block.nevents = header->nevents;
+  block.nhits = header->nhits;
+  block.nrawwords = header->nrawwords;
+
+  const char * pos = m_data + offset + sizeof(eventFileBlockHeader);
+  block.hitoffset = column<uint32_t>(pos, block.nevents+1);
+  block.header = column<uint16_t>(pos, block.nevents);
+  block.trailer = column<uint16_t>(pos, block.nevents);
+  block.event = column<uint32_t>(pos, block.nhits);
+  block.roc = column<uint8_t>(pos, block.nhits);
+  block.column = column<uint8_t>(pos, block.nhits);
+  block.row = column<uint8_t>(pos, block.nhits);
+  block.value = column<int16_t>(pos, block.nhits);
+  block.rawoffset = NULL;
+  block.rawflags = NULL;
+  block.raw = NULL;
+  if(raw) {
+    block.rawoffset = column<uint32_t>(pos, block.nevents+1);
+    block.rawflags = column<uint8_t>(pos, block.nevents);
+    block.raw = column<uint16_t>(pos, block.nrawwords);
+  }
+
+  // The offset columns have to be ascending and end with the column lengths:
+  for(uint32_t i = 0; i < block.nevents; i++) {
+    if(block.hitoffset[i] > block.hitoffset[i+1]) return;
+    if(raw && block.rawoffset[i] > block.rawoffset[i+1]) return;
+  }
+  if(block.hitoffset[0] != 0 || block.hitoffset[block.nevents] != block.nhits
+     || (raw && (block.rawoffset[0] != 0 || block.rawoffset[block.nevents] != block.nrawwords))) return;
+
+  m_blocks.push_back(block);
+  m_offsets.push_back(offset);
+  m_events += block.nevents;
+}
+
+const eventFileBlockHeader * eventFileReader::blockHeader(size_t block) {
+  if(block >= m_blocks.size()) { throw EventFileError("Event file block out of range"); }
+  return reinterpret_cast<const eventFileBlockHeader*>(m_data + m_offsets[block]);
+}
+
+size_t eventFileReader::findBlock(uint64_t event) {
+  if(event >= m_events) { throw EventFileError("Event index out of range"); }
+
+  // Binary search for the last block starting at or before the event:
+  size_t low = 0, high = m_blocks.size();
+  while(high - low > 1) {
+    size_t mid = (low + high)/2;
+    if(m_blocks[mid].firstevent <= event) low = mid;
+    else high = mid;
+  }
+  // Skip empty blocks sharing the same first event:
+  while(event >= m_blocks[low].firstevent + m_blocks[low].nevents) low++;
+  return low;
+}
+
+eventFileBlock eventFileReader::getBlock(size_t block) {
+  if(block >= m_blocks.size()) { throw EventFileError("Event file block out of range"); }
+  return m_blocks[block];
+}
+
+statistics eventFileReader::getStatistics(size_t block) {
+  const uint32_t * counters = blockHeader(block)->stats;
+  statistics stats;
+  stats.m_info_words_read = counters[0];
+  stats.m_info_events_empty = counters[1];
+  stats.m_info_events_valid = counters[2];
+  stats.m_info_pixels_valid = counters[3];
+  stats.m_errors_event_start = counters[4];
+  stats.m_errors_event_stop = counters[5];
+  stats.m_errors_event_overflow = counters[6];
+  stats.m_errors_event_invalid_words = counters[7];
+  stats.m_errors_event_invalid_xor = counters[8];
+  stats.m_errors_tbm_header = counters[9];
+  stats.m_errors_tbm_trailer = counters[10];
+  stats.m_errors_tbm_eventid_mismatch = counters[11];
+  stats.m_errors_roc_missing = counters[12];
+  stats.m_errors_roc_readback = counters[13];
+  stats.m_errors_pixel_incomplete = counters[14];
+  stats.m_errors_pixel_address = counters[15];
+  stats.m_errors_pixel_pulseheight = counters[16];
+  stats.m_errors_pixel_buffer_corrupt = counters[17];
+  return stats;
+}
+
+statistics eventFileReader::getStatistics() {
+  statistics stats;
+  for(size_t block = 0; block < m_blocks.size(); block++) { stats += getStatistics(block); }
+  return stats;
+}
+
+Event eventFileReader::getEvent(uint64_t event) {
+  const eventFileBlock & block = m_blocks[findBlock(event)];
+  size_t i = event - block.firstevent;
+
+  Event evt;
+  evt.header = block.header[i];
+  evt.trailer = block.trailer[i];
+  evt.pixels.reserve(block.hitoffset[i+1] - block.hitoffset[i]);
+  for(uint32_t hit = block.hitoffset[i]; hit < block.hitoffset[i+1]; hit++) {
+    evt.pixels.push_back(pixel(block.roc[hit], block.column[hit], block.row[hit], block.value[hit]));
+  }
+  return evt;
+}
+
+std::vector<Event> eventFileReader::getEvents(uint64_t first, uint64_t count) {
+  std::vector<Event> events;
+  if(first >= m_events) return events;
+  uint64_t last = std::min(first + count, m_events);
+  events.reserve(last - first);
+  for(uint64_t event = first; event < last; event++) { events.push_back(getEvent(event)); }
+  return events;
+}
+
+bool eventFileReader::hasRawEvent(uint64_t event) {
+  return (m_blocks[findBlock(event)].raw != NULL);
+}
+
+rawEvent eventFileReader::getRawEvent(uint64_t event) {
+  const eventFileBlock & block = m_blocks[findBlock(event)];
+  if(!block.raw) { throw EventFileError("No raw data stored for this event"); }
+  size_t i = event - block.firstevent;
+
+  rawEvent evt;
+  evt.data.assign(block.raw + block.rawoffset[i], block.raw + block.rawoffset[i+1]);
+  if(block.rawflags[i] & 1) { evt.SetStartError(); }
+  if(block.rawflags[i] & 2) { evt.SetEndError(); }
+  if(block.rawflags[i] & 4) { evt.SetOverflow(); }
+  return evt;
+}
@@ -0,0 +1,221 @@
+/**
+ * pxar event file format
+ * binary, column-oriented storage of decoded events with optional raw data
+ */
+
+#ifndef PXAR_EVENTFILE_H
+#define PXAR_EVENTFILE_H
+
+#include "datatypes.h"
+#include "exceptions.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace pxar {
+
+  /** The pxar event file stores decoded events in blocks, typically one block per
+   *  DAQ readout. Each block holds its events as column arrays and the decoding
+   *  statistics of the readout; an index of all blocks is appended when the file
+   *  is closed. All values are stored in the byte order of the machine writing the
+   *  file, the byte order mark in the file header allows to detect a mismatch.
+   *
+   *  File layout:
+   *    file header
+   *    block 0, block 1, ...
+   *    block index (only present if the writer was closed properly)
+   *
+   *  Block layout, every column padded to a multiple of eight bytes:
+   *    block header (including the statistics counters)
+   *    uint32 hitoffset[nevents+1]  hits of event i: [hitoffset[i], hitoffset[i+1])
+   *    uint16 header[nevents]       TBM header
+   *    uint16 trailer[nevents]      TBM trailer
+   *    uint32 event[nhits]          event index (within the block) of each hit
+   *    uint8  roc[nhits]
+   *    uint8  column[nhits]
+   *    uint8  row[nhits]
+   *    int16  value[nhits]          pulse height
+   *  Raw data side channel, only if EVENTFILE_BLOCK_RAW is set:
+   *    uint32 rawoffset[nevents+1]  raw words of event i: [rawoffset[i], rawoffset[i+1])
+   *    uint8  rawflags[nevents]     rawEvent error flags (1 start, 2 end, 4 overflow)
+   *    uint16 raw[nrawwords]
+   */
+
+#define EVENTFILE_MAGIC        0x56455850 // "PXEV"
+#define EVENTFILE_BLOCK_MAGIC  0x4b425850 // "PXBK"
+#define EVENTFILE_INDEX_MAGIC  0x58495850 // "PXIX"
+#define EVENTFILE_VERSION      1
+#define EVENTFILE_BYTEORDER    0x0102
+#define EVENTFILE_BLOCK_RAW    0x1 // Block carries the raw data side channel
+#define EVENTFILE_STATISTICS   18  // Number of statistics counters stored per block
+
+  struct eventFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t byteorder;
+    // Offset of the block index, zero if the file has not been closed:
+    uint64_t indexoffset;
+  };
+
+  struct eventFileBlockHeader {
+    uint32_t magic;
+    uint32_t nevents;
+    // Index of the first event of this block within the file:
+    uint64_t firstevent;
+    // Total size of the block in bytes, this header included:
+    uint64_t size;
+    uint32_t nhits;
+    uint32_t flags;
+    uint32_t nrawwords;
+    uint32_t reserved;
+    uint32_t stats[EVENTFILE_STATISTICS];
+  };
+
+  struct eventFileIndexEntry {
+    uint64_t offset;
+    uint64_t firstevent;
+    uint32_t nevents;
+    uint32_t reserved;
+  };
+
+  /** Read-only view of the columns of one event file block. The pointers refer
+   *  directly to the (memory-mapped) file and stay valid as long as the
+   *  eventFileReader they were obtained from exists.
+   */
+  struct DLLEXPORT eventFileBlock {
+    uint64_t firstevent;
+    uint32_t nevents;
+    uint32_t nhits;
+    uint32_t nrawwords;
+    const uint32_t * hitoffset;
+    const uint16_t * header;
+    const uint16_t * trailer;
+    const uint32_t * event;
+    const uint8_t * roc;
+    const uint8_t * column;
+    const uint8_t * row;
+    const int16_t * value;
+    // Raw data side channel, NULL if not present:
+    const uint32_t * rawoffset;
+    const uint8_t * rawflags;
+    const uint16_t * raw;
+  };
+
+  /** Class to write pxar event files. Blocks are appended and flushed to disk one
+   *  by one, so the file can be written as the data comes in. The block index is
+   *  written when the file is closed, files without index can still be read.
+   *
+   *  All functions throw a pxar::EventFileError in case of I/O errors.
+   */
+  class DLLEXPORT eventFileWriter {
+  public:
+    /** Create a new event file, an existing file is overwritten.
+     */
+    eventFileWriter(const std::string & filename);
+
+    /** Closes the file if this has not been done yet.
+     */
+    ~eventFileWriter();
+
+    /** Append a block of decoded events together with the decoding statistics
+     *  of their readout. If raw is given it has to contain the raw data records
+     *  the events were decoded from, one per event, which are stored as raw
+     *  data side channel (see pxarCore::daqGetEventBuffer(std::vector<rawEvent>&)).
+     */
+    void writeBlock(std::vector<Event> & events, statistics stats, std::vector<rawEvent> * raw = NULL);
+
+    /** Write the block index and close the file.
+     */
+    void close();
+
+    /** Number of events written so far.
+     */
+    uint64_t events() { return m_events; }
+
+  private:
+    // Not copyable:
+    eventFileWriter(const eventFileWriter &);
+    eventFileWriter & operator=(const eventFileWriter &);
+
+    void write(const void * data, size_t size);
+    void pad();
+
+    std::string m_filename;
+    FILE * m_file;
+    uint64_t m_offset;
+    uint64_t m_events;
+    std::vector<eventFileIndexEntry> m_index;
+  };
+
+  /** Class to read pxar event files. The file is memory-mapped (read into memory
+   *  on Windows) and only the requested events are decoded from their columns,
+   *  so arbitrary event ranges can be accessed without reading the full file.
+   *
+   *  The constructor throws a pxar::EventFileError if the file cannot be opened
+   *  or is not a valid event file, all accessors throw it for out-of-range
+   *  requests.
+   */
+  class DLLEXPORT eventFileReader {
+  public:
+    eventFileReader(const std::string & filename);
+    ~eventFileReader();
+
+    /** Total number of events and blocks stored in the file
+     */
+    uint64_t events() { return m_events; }
+    size_t blocks() { return m_blocks.size(); }
+
+    /** Column view of the given block
+     */
+    eventFileBlock getBlock(size_t block);
+
+    /** Decoding statistics of the given block, or summed up over all blocks
+     */
+    statistics getStatistics(size_t block);
+    statistics getStatistics();
+
+    /** Returns the event with the given index, counted from the beginning of the file
+     */
+    Event getEvent(uint64_t event);
+
+    /** Returns count events starting from event index first. The range is
+     *  truncated at the end of the file.
+     */
+    std::vector<Event> getEvents(uint64_t first, uint64_t count);
+
+    /** Returns true if the block containing the given event stores raw data
+     */
+    bool hasRawEvent(uint64_t event);
+
+    /** Returns the raw data record of the given event, if stored
+     */
+    rawEvent getRawEvent(uint64_t event);
+
+  private:
+    // Not copyable:
+    eventFileReader(const eventFileReader &);
+    eventFileReader & operator=(const eventFileReader &);
+
+    void map(const std::string & filename);
+    void unmap();
+    void readIndex(uint64_t offset);
+    void scanBlocks();
+    void addBlock(uint64_t offset);
+    // Find the block containing the given event:
+    size_t findBlock(uint64_t event);
+    const eventFileBlockHeader * blockHeader(size_t block);
+
+    const char * m_data;
+    size_t m_size;
+#ifdef WIN32
+    std::vector<char> m_buffer;
+#endif
+    uint64_t m_events;
+    std::vector<eventFileBlock> m_blocks;
+    std::vector<uint64_t> m_offsets;
+  };
+
+} //namespace pxar
+
+#endif /* PXAR_EVENTFILE_H */
@@ -56,6 +56,14 @@ namespace pxar {
     UsbConnectionTimeout(const std::string& what_arg) : pxarException(what_arg) {}
   };
 
+  /**  This exception class covers problems reading or writing pxar event files,
+   *   such as missing files, I/O errors or corrupt file contents.
+   */
+  class EventFileError : public pxarException {
+  public:
+    EventFileError(const std::string& what_arg) : pxarException(what_arg) {}
+  };
+
   /** This exception class is the base class for all pxar data exceptions
    */
   class DataException : public pxarException {
@@ -189,6 +189,8 @@ cdef extern from "api.h" namespace "pxar":
         double getTBva()
         double getTBid()
         double getTBvd()
+        vector[pair[string, double]] getTBpower()
+        void setUsbBufferSize(uint32_t writeSize, uint32_t readSize) except +
         void HVoff()
         void HVon()
         void Poff()
@@ -199,6 +201,8 @@ cdef extern from "api.h" namespace "pxar":
         uint8_t getDACRange(string dacName) except +
         bool setTbmReg(string regName, uint8_t regValue, uint8_t tbmid) except +
         bool setTbmReg(string regName, uint8_t regValue) except +
+        void startDACTransaction() except +
+        bool commitDACTransaction() except +
         vector[pair[uint8_t, vector[pixel]]] getPulseheightVsDAC(string dacName, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint16_t flags, uint16_t nTriggers)  except +
         vector[pair[uint8_t, vector[pixel]]] getEfficiencyVsDAC(string dacName, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint16_t flags, uint16_t nTriggers) except +
         vector[pair[uint8_t, vector[pixel]]] getThresholdVsDAC(string dac1Name, uint8_t dac1Step, uint8_t dac1Min, uint8_t dac1Max, string dac2Name, uint8_t dac2Step, uint8_t dac2Min, uint8_t dac2Max, uint8_t threshold, uint16_t flags, uint16_t nTriggers) except +
@@ -415,6 +415,10 @@ cdef class PyPxarCore:
         return float(self.thisptr.getTBid())
     def getTBvd(self):
         return float(self.thisptr.getTBvd())
+    def getTBpower(self):
+        return self.thisptr.getTBpower()
+    def setUsbBufferSize(self, int writeSize, int readSize):
+        self.thisptr.setUsbBufferSize(writeSize, readSize)
     def HVoff(self):
         self.thisptr.HVoff()
     def HVon(self):
@@ -437,6 +441,10 @@ cdef class PyPxarCore:
             return self.thisptr.setTbmReg(regName, regValue)
         else:
             return self.thisptr.setTbmReg(regName, regValue, tbmid)
+    def startDACTransaction(self):
+        self.thisptr.startDACTransaction()
+    def commitDACTransaction(self):
+        return self.thisptr.commitDACTransaction()
     def getPulseheightVsDAC(self, string dacName, int dacStep, int dacMin, int dacMax, int flags = 0, int nTriggers = 16):
         cdef vector[pair[uint8_t, vector[pixel]]] r
         r = self.thisptr.getPulseheightVsDAC(dacName, dacStep, dacMin, dacMax, flags, nTriggers)
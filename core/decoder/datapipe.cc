@@ -4,8 +4,59 @@
 #include "constants.h"
 #include "exceptions.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace pxar {
 
+  // Lookup tables for the PSI46dig pixel address decoding. The row tables are indexed
+  // with the nine row address bits (raw bits 9-17) and store the decoded row as well as
+  // the column LSB, separately for regular and inverted addresses. The double column
+  // table is indexed with the six double column address bits (raw bits 18-23).
+  class pixelAddressTable {
+  public:
+    uint8_t row[2][512];
+    uint8_t columnLSB[2][512];
+    uint8_t dcol[64];
+
+    pixelAddressTable() {
+      for(int invert = 0; invert < 2; invert++) {
+	for(int bits = 0; bits < 512; bits++) {
+	  int r2 = (bits >> 6) & 7;
+	  int r1 = (bits >> 3) & 7;
+	  int r0 = bits & 7;
+	  if(invert) { r2 ^= 0x7; r1 ^= 0x7; r0 ^= 0x7; }
+	  int r = r2*36 + r1*6 + r0;
+	  // Same (wrapping) arithmetic as pixel::decodeRaw:
+	  row[invert][bits] = static_cast<uint8_t>(80 - r/2);
+	  columnLSB[invert][bits] = static_cast<uint8_t>(r&1);
+	}
+      }
+      for(int bits = 0; bits < 64; bits++) { dcol[bits] = static_cast<uint8_t>(((bits >> 3) & 7)*6 + (bits & 7)); }
+    }
+  };
+
+  static const pixelAddressTable addressTable;
+
+  pixelDecodingStatus dtbEventDecoder::decodePixel(uint32_t raw, uint8_t roc, bool invertAddress, pixel &pix) {
+    // Check the pulse height fill bit:
+    if((raw & 0x10) != 0) { return PIXEL_INVALID_PULSEHEIGHT; }
+
+    // Look up the pixel address:
+    uint32_t rowbits = (raw >> 9) & 0x1ff;
+    uint8_t row = addressTable.row[invertAddress][rowbits];
+    uint8_t column = 2*addressTable.dcol[(raw >> 18) & 0x3f] + addressTable.columnLSB[invertAddress][rowbits];
+
+    // Perform range checks:
+    if(row >= ROC_NUMROWS || column >= ROC_NUMCOLS) {
+      return (row == ROC_NUMROWS ? PIXEL_BUFFER_CORRUPT : PIXEL_INVALID_ADDRESS);
+    }
+
+    pix = pixel(roc, column, row, (raw & 0x0f) + ((raw >> 1) & 0xf0));
+    return PIXEL_VALID;
+  }
+
   rawEvent* dtbEventSplitter::Read() {
     record.Clear();
 
@@ -24,6 +75,54 @@ namespace pxar {
     return &record;
   }
 
+  // Maximum number of samples stored per raw event:
+  static const size_t maxEventSize = 40000;
+
+  // Returns the index of the first sample matching either of the two markers, i.e.
+  // (sample & mask) == marker, or count if there is none:
+  static inline size_t findMarker(const uint16_t * data, size_t count, uint16_t mask0, uint16_t marker0, uint16_t mask1, uint16_t marker1) {
+    size_t i = 0;
+#ifdef __SSE2__
+    // Skip blocks of eight samples without any marker:
+    const __m128i m0 = _mm_set1_epi16(static_cast<short>(mask0));
+    const __m128i v0 = _mm_set1_epi16(static_cast<short>(marker0));
+    const __m128i m1 = _mm_set1_epi16(static_cast<short>(mask1));
+    const __m128i v1 = _mm_set1_epi16(static_cast<short>(marker1));
+    for(; i + 8 <= count; i += 8) {
+      __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+      __m128i hit = _mm_or_si128(_mm_cmpeq_epi16(_mm_and_si128(w, m0), v0),
+				 _mm_cmpeq_epi16(_mm_and_si128(w, m1), v1));
+      if(_mm_movemask_epi8(hit) != 0) { break; }
+    }
+#endif
+    for(; i < count; i++) {
+      if((data[i] & mask0) == marker0 || (data[i] & mask1) == marker1) { return i; }
+    }
+    return count;
+  }
+
+  void dtbEventSplitter::AddUntilMarker(uint16_t mask0, uint16_t marker0, uint16_t mask1, uint16_t marker1, bool stopAtOverflow) {
+    // Copy the samples up to the next marker block-wise from the source, the marker
+    // itself is consumed and available via GetLast():
+    while(true) {
+      size_t count;
+      const uint16_t * block = GetBlock(count);
+      size_t n = findMarker(block, count, mask0, marker0, mask1, marker1);
+
+      // If total Event size is too big, only store what fits:
+      size_t room = (record.GetSize() < maxEventSize) ? maxEventSize - record.GetSize() : 0;
+      if(n > room) {
+	record.data.insert(record.data.end(), block, block + room);
+	record.SetOverflow();
+	if(stopAtOverflow) { Advance(room + 1); return; }
+      }
+      else { record.data.insert(record.data.end(), block, block + n); }
+
+      if(n < count) { Advance(n + 1); return; }
+      Advance(count);
+    }
+  }
+
   void dtbEventSplitter::SplitDeser400() {
     // If last one had Event end marker, get a new sample:
     if (!nextStartDetected) { Get(); }
@@ -37,16 +136,13 @@ namespace pxar {
     record.Add(GetLast() | ((GetChannel() & 0x7) << 8));
 
     // Else keep reading and adding samples until we find any marker.
-    while ((Get() & 0xe000) != 0xc000) {
-      // Check if the last read sample has Event end marker:
-      if ((GetLast() & 0xe000) == 0xa000) {
-	record.SetEndError();
-	nextStartDetected = true;
-	return;
-      }
-      // If total Event size is too big, break:
-      if (record.GetSize() < 40000) record.Add(GetLast());
-      else record.SetOverflow();
+    AddUntilMarker(0xe000, 0xc000, 0xe000, 0xa000, false);
+
+    // Check if the last read sample has Event end marker:
+    if ((GetLast() & 0xe000) == 0xa000) {
+      record.SetEndError();
+      nextStartDetected = true;
+      return;
     }
     record.Add(GetLast());
     nextStartDetected = false;
@@ -65,16 +161,13 @@ namespace pxar {
 
     // Else keep reading and adding samples until we find the last trailer marker.
     // Make sure to look for "c0" and not "c" - the latter one is also the DESER160 end marker!
-    while ((Get() & 0xef00) != 0xc000) {
-      // Check if the last read sample has Event end marker:
-      if ((GetLast() & 0xe000) == 0xa000) {
-	record.SetEndError();
-	nextStartDetected = true;
-	return;
-      }
-      // If total Event size is too big, break:
-      if (record.GetSize() < 40000) record.Add(GetLast());
-      else record.SetOverflow();
+    AddUntilMarker(0xef00, 0xc000, 0xe000, 0xa000, false);
+
+    // Check if the last read sample has Event end marker:
+    if ((GetLast() & 0xe000) == 0xa000) {
+      record.SetEndError();
+      nextStartDetected = true;
+      return;
     }
     record.Add(GetLast());
     nextStartDetected = false;
@@ -90,20 +183,14 @@ namespace pxar {
       while (!(GetLast() & 0x8000)) Get();
     }
 
-    // Else keep reading and adding samples until we find any marker.
-    do {
-      // If total Event size is too big, break:
-      if (record.GetSize() >= 40000) {
-	record.SetOverflow();
-	break;
-      }
-
-      // FIXME Very first Event starts with 0xC - which srews up empty Event detection here!
-      // If the Event start sample is also Event end sample, write and quit:
-      if((GetLast() & 0xc000) == 0xc000) { break; }
-
+    // FIXME Very first Event starts with 0xC - which srews up empty Event detection here!
+    // If the Event start sample is also Event end sample, write and quit.
+    // Else keep reading and adding samples until we find any marker, stop if total
+    // Event size is too big:
+    if((GetLast() & 0xc000) != 0xc000) {
       record.Add(GetLast());
-    } while ((Get() & 0xc000) == 0);
+      AddUntilMarker(0x8000, 0x8000, 0x4000, 0x4000, true);
+    }
 
     // Check if the last read sample has Event end marker:
     if (GetLast() & 0x4000) record.Add(GetLast());
@@ -115,7 +202,10 @@ namespace pxar {
     record.Clear();
     try {
       do {
-	record.Add(Get());
+	size_t count;
+	const uint16_t * block = GetBlock(count);
+	record.data.insert(record.data.end(), block, block + count);
+	Advance(count);
       } while(1);
     }
     catch(dsBufferEmpty) {}
@@ -144,15 +234,17 @@ namespace pxar {
     if(sample->IsOverflow()) { decodingStats.m_errors_event_overflow++; }
     decodingStats.m_info_words_read += sample->GetSize();
 
-    // If a TBM header and trailer should be available, process them first:
-    if(GetEnvelopeType() != TBM_NONE) { ProcessTBM(sample); }
+    // If a TBM header and trailer should be available, process them first and
+    // skip them for the ROC data decoding:
+    std::vector<uint16_t>::iterator begin = sample->data.begin(), end = sample->data.end();
+    if(GetEnvelopeType() != TBM_NONE && ProcessTBM(sample)) { begin += 2; end -= 2; }
 
     // Decode ADC Data for analog devices:
-    if(GetDeviceType() < ROC_PSI46DIG) { DecodeADC(sample); }
+    if(GetDeviceType() < ROC_PSI46DIG) { DecodeADC(begin, end); }
     // Decode DESER400 Data for digital devices and TBMs:
-    else if(GetEnvelopeType() > TBM_EMU) { DecodeDeser400(sample); }
+    else if(GetEnvelopeType() > TBM_EMU) { DecodeDeser400(begin, end); }
     // Decode DESER160 Data for digital devices without real TBM
-    else { DecodeDeser160(sample); }
+    else { DecodeDeser160(begin, end); }
 
     if((GetFlags() & FLAG_DUMP_FLAWED_EVENTS) != 0) {
       if(error_count != (decodingStats.errors_event()
@@ -173,14 +265,14 @@ namespace pxar {
     return &roc_Event;
   }
 
-  void dtbEventDecoder::ProcessTBM(rawEvent * sample) {
+  bool dtbEventDecoder::ProcessTBM(rawEvent * sample) {
     LOG(logDEBUGPIPES) << "Processing TBM header and trailer...";
 
     // Check if the data is long enough to hold header and trailer:
     if(sample->GetSize() < 4) {
       decodingStats.m_errors_tbm_header++;
       decodingStats.m_errors_tbm_trailer++;
-      return;
+      return false;
     }
     unsigned int size = sample->GetSize();
 
@@ -216,14 +308,12 @@ namespace pxar {
 
     // Check for correct TBM event ID:
     CheckEventID();
-
-    // Remove header and trailer:
-    sample->data.erase(sample->data.begin(), sample->data.begin() + 2);
-    sample->data.erase(sample->data.end() - 2, sample->data.end());
+    return true;
   }
 
-  void dtbEventDecoder::DecodeDeser400(rawEvent * sample) {
+  void dtbEventDecoder::DecodeDeser400(std::vector<uint16_t>::iterator begin, std::vector<uint16_t>::iterator end) {
     LOG(logDEBUGPIPES) << "Decoding ROC data from DESER400...";
+    size_t size = end - begin;
 
     // Count the ROC headers:
     int16_t roc_n = -1;
@@ -231,9 +321,21 @@ namespace pxar {
     // Check if ROC has inverted pixel address (ROC_PSI46DIG):
     bool invertedAddress = ( GetDeviceType() == ROC_PSI46DIG ? true : false );
 
+    // Check if we have to look for fill bits of the TBM09 data stream:
+    bool fillBits = (GetEnvelopeType() >= TBM_09);
+    uint8_t rocOffset = GetTokenChainOffset();
+
+    // Reserve expected number of pixels from data length:
+    roc_Event.pixels.reserve(size/2);
+
+    // Local counters, added to the decoding statistics once per event:
+    uint32_t invalid_words = 0, pixels_valid = 0, pixels_incomplete = 0;
+    uint32_t pixels_address = 0, pixels_pulseheight = 0, pixels_corrupt = 0;
+    pixel pix;
+
     // Loop over the full data:
-    for(std::vector<uint16_t>::iterator word = sample->data.begin(); word != sample->data.end(); word++) {
-      CheckInvalidWord(*word);
+    for(std::vector<uint16_t>::iterator word = begin; word != end; word++) {
+      if(((*word) & 0x1000) != 0) { invalid_words++; }
 
       // Check if we have a ROC header:
       if(((*word) & 0xe000) == 0x4000) {
@@ -246,6 +348,11 @@ namespace pxar {
 	  LOG(logCRITICAL) << "Channel " << static_cast<int>(GetChannel())
 			   << " ROC " << static_cast<int>(roc_n)
 			   << " header reports DESER400 failure!";
+	  decodingStats.m_errors_event_invalid_words += invalid_words;
+	  decodingStats.m_info_pixels_valid += pixels_valid;
+	  decodingStats.m_errors_pixel_address += pixels_address;
+	  decodingStats.m_errors_pixel_pulseheight += pixels_pulseheight;
+	  decodingStats.m_errors_pixel_buffer_corrupt += pixels_corrupt;
 	  decodingStats.m_errors_event_invalid_xor++;
 	  throw DataDecodingError("Invalid XOR eye diagram encountered.");
 	}
@@ -257,8 +364,8 @@ namespace pxar {
       else if(((*word) & 0xe000) <= 0x2000) {
 
 	// Only one word left or unexpected alignment marker:
-	if(sample->data.end() - word < 2 || ((*word) & 0x8000)) {
-	  decodingStats.m_errors_pixel_incomplete++;
+	if(end - word < 2 || ((*word) & 0x8000)) {
+	  pixels_incomplete++;
 	  break;
 	}
 	
@@ -267,55 +374,69 @@ namespace pxar {
 	// (*(word+1) >> 13 == 1
 
 	uint32_t raw = (((*word) & 0x0fff) << 12) + ((*(++word)) & 0x0fff);
-	try {
-	  // Check if this is just fill bits of the TBM09 data stream 
-	  // accounting for the other channel:
-	  if(GetEnvelopeType() >= TBM_09 && (raw&0xffffff) == 0xffffff) {
-	    LOG(logDEBUGPIPES) << "Empty hit detected (TBM09 data streams). Skipping.";
-	    continue;
-	  }
-
-	  // Get the correct ROC id: Channel number x ROC offset (= token chain length)
-	  // TBM08x: channel 0: 0-7, channel 1: 8-15
-	  // TBM09x: channel 0: 0-3, channel 1: 4-7, channel 2: 8-11, channel 3: 12-15
-	  pixel pix(raw,static_cast<uint8_t>(roc_n + GetTokenChainOffset()),invertedAddress);
-	  roc_Event.pixels.push_back(pix);
-	  decodingStats.m_info_pixels_valid++;
+
+	// Check if this is just fill bits of the TBM09 data stream 
+	// accounting for the other channel:
+	if(fillBits && (raw&0xffffff) == 0xffffff) {
+	  LOG(logDEBUGPIPES) << "Empty hit detected (TBM09 data streams). Skipping.";
+	  continue;
 	}
-	catch(DataInvalidAddressError /*&e*/){
+
+	// Get the correct ROC id: Channel number x ROC offset (= token chain length)
+	// TBM08x: channel 0: 0-7, channel 1: 8-15
+	// TBM09x: channel 0: 0-3, channel 1: 4-7, channel 2: 8-11, channel 3: 12-15
+	switch(decodePixel(raw, static_cast<uint8_t>(roc_n + rocOffset), invertedAddress, pix)) {
+	case PIXEL_VALID:
+	  roc_Event.pixels.push_back(pix);
+	  pixels_valid++;
+	  break;
+	case PIXEL_INVALID_ADDRESS:
 	  // decoding of raw address lead to invalid address
-	  decodingStats.m_errors_pixel_address++;
-	}
-	catch(DataInvalidPulseheightError /*&e*/){
+	  LOG(logDEBUGPIPES) << "Invalid pixel from raw value of " << std::hex << raw << std::dec;
+	  pixels_address++;
+	  break;
+	case PIXEL_INVALID_PULSEHEIGHT:
 	  // decoding of pulse height featured non-zero fill bit
-	  decodingStats.m_errors_pixel_pulseheight++;
-	}
-	catch(DataCorruptBufferError /*&e*/){
+	  LOG(logDEBUGPIPES) << "Invalid pulse-height fill bit from raw value of " << std::hex << raw << std::dec;
+	  pixels_pulseheight++;
+	  break;
+	case PIXEL_BUFFER_CORRUPT:
 	  // decoding returned row 80 - corrupt data buffer
-	  decodingStats.m_errors_pixel_buffer_corrupt++;
+	  LOG(logDEBUGPIPES) << "Corrupt data buffer (row 80) from raw value of " << std::hex << raw << std::dec;
+	  pixels_corrupt++;
+	  break;
 	}
       }
     }
 
+    // Update the decoding statistics:
+    decodingStats.m_errors_event_invalid_words += invalid_words;
+    decodingStats.m_info_pixels_valid += pixels_valid;
+    decodingStats.m_errors_pixel_incomplete += pixels_incomplete;
+    decodingStats.m_errors_pixel_address += pixels_address;
+    decodingStats.m_errors_pixel_pulseheight += pixels_pulseheight;
+    decodingStats.m_errors_pixel_buffer_corrupt += pixels_corrupt;
+
     // Check event validity (empty, missing ROCs...):
     CheckEventValidity(roc_n);
   }
 
-  void dtbEventDecoder::DecodeADC(rawEvent * sample) {
+  void dtbEventDecoder::DecodeADC(std::vector<uint16_t>::iterator begin, std::vector<uint16_t>::iterator end) {
     LOG(logDEBUGPIPES) << "Decoding ROC data from ADC...";
+    size_t size = end - begin;
 
     int16_t roc_n = -1;
 
     // Reserve expected number of pixels from data length (subtract ROC headers):
-    if (sample->GetSize() - 3*GetTokenChainLength() > 0) {
-      roc_Event.pixels.reserve((sample->GetSize() - 3*GetTokenChainLength())/6);
+    if (size - 3*GetTokenChainLength() > 0) {
+      roc_Event.pixels.reserve((size - 3*GetTokenChainLength())/6);
     }
 
     // Loop over the full data:
-    for(std::vector<uint16_t>::iterator word = sample->data.begin(); word != sample->data.end(); word++) {
+    for(std::vector<uint16_t>::iterator word = begin; word != end; word++) {
 
       // Not enough data for anything, stop here - and assume it was half a pixel hit:
-      if((sample->data.end() - word < 2)) { 
+      if((end - word < 2)) { 
 	decodingStats.m_errors_pixel_incomplete++;
 	break;
       }
@@ -347,7 +468,7 @@ namespace pxar {
       // We have a pixel hit:
       else {
 	// Not enough data for a new pixel hit (six words):
-	if(sample->data.end() - word < 6) {
+	if(end - word < 6) {
 	  decodingStats.m_errors_pixel_incomplete++;
 	  break;
 	}
@@ -373,8 +494,9 @@ namespace pxar {
     CheckEventValidity(roc_n);
   }
 
-  void dtbEventDecoder::DecodeDeser160(rawEvent * sample) {
+  void dtbEventDecoder::DecodeDeser160(std::vector<uint16_t>::iterator begin, std::vector<uint16_t>::iterator end) {
     LOG(logDEBUGPIPES) << "Decoding ROC data from DESER160...";
+    size_t size = end - begin;
 
     // Count the ROC headers:
     int16_t roc_n = -1;
@@ -383,12 +505,12 @@ namespace pxar {
     bool invertedAddress = ( GetDeviceType() == ROC_PSI46DIG ? true : false );
 
     // Reserve expected number of pixels from data length (subtract ROC headers):
-    if(sample->GetSize()-GetTokenChainLength() > 0) {
-      roc_Event.pixels.reserve((sample->GetSize()-GetTokenChainLength())/2);
+    if(size-GetTokenChainLength() > 0) {
+      roc_Event.pixels.reserve((size-GetTokenChainLength())/2);
     }
 
     // Loop over the full data:
-    for(std::vector<uint16_t>::iterator word = sample->data.begin(); word != sample->data.end(); word++) {
+    for(std::vector<uint16_t>::iterator word = begin; word != end; word++) {
 
       // Check if we have a ROC header:
       if(((*word) & 0x0ffc) == 0x07f8) {
@@ -401,7 +523,7 @@ namespace pxar {
       // Require that we found at least one ROC header and have two or more words left:
       else if(roc_n >= 0) {
 	// It's not a ROC header but the last word:
-	if(sample->data.end() - word < 2) {
+	if(end - word < 2) {
 	  decodingStats.m_errors_pixel_incomplete++;
 	  continue;
 	}
@@ -30,7 +30,17 @@ namespace pxar {
     virtual uint8_t ReadTokenChainOffset() = 0;
     virtual uint8_t ReadEnvelopeType() = 0;
     virtual uint8_t ReadDeviceType() = 0;
+
+    // Block access: returns the samples available as contiguous block without consuming
+    // them, count is set to their number (at least one). The block stays valid until the
+    // next Read or ReadBlock call. Every ReadBlock has to be followed by ReadAdvance
+    // consuming between one and count samples, the last one becomes ReadLast().
+    // Sources without contiguous storage hand out one sample at a time:
+    virtual const T* ReadBlock(size_t &count) { blockSample = Read(); count = 1; return &blockSample; }
+    virtual void ReadAdvance(size_t) {}
+    T blockSample;
   public:
+    dataSource() : blockSample() {}
     virtual ~dataSource() {}
     template <class S> friend class dataSink;
   };
@@ -71,6 +81,8 @@ namespace pxar {
     uint8_t GetTokenChainOffset() { return src->ReadTokenChainOffset(); }
     uint8_t GetEnvelopeType() { return src->ReadEnvelopeType(); }
     uint8_t GetDeviceType() { return src->ReadDeviceType(); }
+    const T* GetBlock(size_t &count) { return src->ReadBlock(count); }
+    void Advance(size_t count) { src->ReadAdvance(count); }
     void GetAll() { while (true) Get(); }
     template <class TI, class TO> friend void operator >> (dataSource<TI> &, dataSink<TO> &); 
     template  <class TI, class TO> friend dataSource<TO>& operator >> (dataSource<TI> &in, dataPipe<TI,TO> &out);
@@ -108,6 +120,14 @@ namespace pxar {
   dsBufferEmpty() : dataPipeException("Buffer empty") {}
   };
 
+  // Return codes of the exception-free raw pixel decoding:
+  enum pixelDecodingStatus {
+    PIXEL_VALID = 0,
+    PIXEL_INVALID_ADDRESS,
+    PIXEL_INVALID_PULSEHEIGHT,
+    PIXEL_BUFFER_CORRUPT
+  };
+
   // DTB data Event splitter
   class dtbEventSplitter : public dataPipe<uint16_t, rawEvent*> {
     rawEvent record;
@@ -124,6 +144,7 @@ namespace pxar {
     void SplitDeser160();
     void SplitDeser400();
     void SplitSoftTBM();
+    void AddUntilMarker(uint16_t mask0, uint16_t marker0, uint16_t mask1, uint16_t marker1, bool stopAtOverflow);
 
     bool nextStartDetected;
   public:
@@ -159,10 +180,11 @@ namespace pxar {
     uint8_t ReadEnvelopeType() { return GetEnvelopeType(); }
     uint8_t ReadDeviceType() { return GetDeviceType(); }
 
-    void DecodeADC(rawEvent * sample);
-    void DecodeDeser160(rawEvent * sample);
-    void DecodeDeser400(rawEvent * sample);
-    void ProcessTBM(rawEvent * sample);
+    void DecodeADC(std::vector<uint16_t>::iterator begin, std::vector<uint16_t>::iterator end);
+    void DecodeDeser160(std::vector<uint16_t>::iterator begin, std::vector<uint16_t>::iterator end);
+    void DecodeDeser400(std::vector<uint16_t>::iterator begin, std::vector<uint16_t>::iterator end);
+    // Checks TBM header and trailer, returns false if the event is too short to hold them:
+    bool ProcessTBM(rawEvent * sample);
     statistics decodingStats;
 
     // Readback decoding:
@@ -197,7 +219,13 @@ namespace pxar {
   dtbEventDecoder() : decodingStats(), readback_dirty(false), count(), shiftReg(), readback(), eventID(-1), ultrablack(0xfff), black(0xfff), levelS(0), sumUB(0), sumB(0), slidingWindow(0), total_event(5), flawed_event(0), error_count(0), event_ringbuffer(7) {};
     void Clear() { decodingStats.clear(); readback.clear(); count.clear(); shiftReg.clear(); eventID = -1; };
     statistics getStatistics();
+    // Current statistics, without clearing them:
+    const statistics & peekStatistics() const { return decodingStats; }
     std::vector<std::vector<uint16_t> > getReadback();
+
+    // Exception-free decoding of PSI46dig raw pixel data using lookup tables for the
+    // (inverted) pixel address. Returns a pixelDecodingStatus, pix is only filled for PIXEL_VALID:
+    static pixelDecodingStatus decodePixel(uint32_t raw, uint8_t roc, bool invertAddress, pixel &pix);
   };
 }
 #endif
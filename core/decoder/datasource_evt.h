@@ -30,6 +30,16 @@ namespace pxar {
       // LOG(logDEBUGPIPES) << "pos " << pos;
       return (pos < buffer.size()) ? lastSample = buffer[pos++] : throw dsBufferEmpty();
     }
+    const uint16_t* ReadBlock(size_t &count) {
+      if(!connected) throw dpNotConnected();
+      if(pos >= buffer.size()) throw dsBufferEmpty();
+      count = buffer.size() - pos;
+      return &buffer[pos];
+    }
+    void ReadAdvance(size_t count) {
+      pos += count;
+      lastSample = buffer[pos-1];
+    }
     uint16_t ReadLast() {
       if(!connected) throw dpNotConnected();
       return lastSample;
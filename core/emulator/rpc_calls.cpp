@@ -283,7 +283,9 @@ void CTestboard::Pg_Triggers(uint32_t nTriggers, uint16_t) {
   for(size_t i = 0; i < nTriggers; i++) {
     for(size_t ch = 0; ch < channels; ch++) {
       size_t rocs = notokenpass(tbmtype,ch) ? 0 : roc_per_ch;
-      fillRawData(i,daq_buffer.at(ch),tbmtype,rocs,false,true,0,0);
+      // Bad timings lose a ROC header:
+      if(rocs > 0 && badtiming(tbmtype,ch)) rocs--;
+      fillRawData(daq_event.at(ch)++,daq_buffer.at(ch),tbmtype,rocs,false,true,0,0);
     }
   }
 }
@@ -587,6 +589,37 @@ bool CTestboard::notokenpass(uint8_t tbmtype, uint8_t channel) {
   return (tbm_registers.at(hubid).at(core)[0x0]&0x40);
 }
 
+bool CTestboard::badtiming(uint8_t tbmtype, uint8_t channel) {
+
+  // No or emulated TBM - no phases to adjust:
+  if(tbmtype <= TBM_EMU) return false;
+
+  // Synthetic window of working timings, settings never programmed are fine:
+  uint8_t channels_per_tbm = (tbmtype >= TBM_09 ? 4 : 2);
+  uint8_t hubid = (channel/channels_per_tbm ? tbm_registers.rbegin()->first : tbm_registers.begin()->first);
+  uint8_t core = ((channel%channels_per_tbm)/(channels_per_tbm/2) > 0 ? 0xF0 : 0xE0);
+
+  // TBM 160/400 MHz phases, stored on the first core. Only one phase difference is bad,
+  // the default settings 0x84, 0x34, 0x20 and 0x00 as well as 0x2c all are outside:
+  std::map<uint8_t, uint8_t> & phases = tbm_registers.at(hubid).at(0xE0);
+  if(phases.find(TBM_REG_CORES_A_B) != phases.end()) {
+    uint8_t value = phases[TBM_REG_CORES_A_B];
+    int clk160 = (value >> 5) & 0x7, clk400 = (value >> 2) & 0x7;
+    if(((clk400 - clk160) & 0x7) == 6) return true;
+  }
+
+  // ROC port phases and token header/trailer delay of this core, defaults 0x49, 0x64 and 0x00 are fine:
+  std::map<uint8_t, uint8_t> & delays = tbm_registers.at(hubid).at(core);
+  if(delays.find(TBM_REG_SET_DELAYS) != delays.end()) {
+    uint8_t value = delays[TBM_REG_SET_DELAYS];
+    int port0 = value & 0x7, port1 = (value >> 3) & 0x7;
+    if((value >> 6) == 3 || port0 > 5) return true;
+    int distance = (port0 - port1) & 0x7;
+    if(distance > 2 && distance < 6) return true;
+  }
+  return false;
+}
+
 bool CTestboard::LoopMultiRocAllPixelsCalibrate(std::vector<uint8_t> &roci2cs, uint16_t nTriggers, uint16_t flags) {
   LOG(pxar::logDEBUGRPC) << "called.";
 
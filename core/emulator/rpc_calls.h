@@ -18,6 +18,19 @@ class CRpcError {
   void What() {};
 };
 
+// Pipelined calls are answered right away by the emulator:
+template <class T>
+class rpcFuture {
+  T m_value;
+  bool m_ready;
+ public:
+ rpcFuture() : m_value(T()), m_ready(false) {}
+  void Set(T value) { m_value = value; m_ready = true; }
+  bool Pending() { return false; }
+  bool Ready() { return m_ready; }
+  T Get() { return m_value; }
+};
+
 class CTestboard {
 
   uint16_t vd, va, id, ia;
@@ -88,10 +101,11 @@ class CTestboard {
   }
 
   void SetTimeout(unsigned int) {}
+  void SetUsbBufferSize(uint32_t, uint32_t) {}
   bool IsConnected() { return true; }
   const char * ConnectionError() { return "none."; }
 
-  void Flush() { }
+  void Flush() { LOG(pxar::logDEBUGRPC) << "called."; }
   void Clear() { }
 
 
@@ -171,6 +185,11 @@ class CTestboard {
   uint16_t _GetID();
   uint16_t _GetIA();
 
+  void _GetVD(rpcFuture<uint16_t> &mV) { mV.Set(_GetVD()); }
+  void _GetVA(rpcFuture<uint16_t> &mV) { mV.Set(_GetVA()); }
+  void _GetID(rpcFuture<uint16_t> &uA100) { uA100.Set(_GetID()); }
+  void _GetIA(rpcFuture<uint16_t> &uA100) { uA100.Set(_GetIA()); }
+
   uint16_t _GetVD_Reg();
   uint16_t _GetVDAC_Reg();
   uint16_t _GetVD_Cap();
@@ -211,6 +230,7 @@ class CTestboard {
   void Daq_Stop(uint8_t channel);
   void Daq_MemReset(uint8_t channel);
   uint32_t Daq_GetSize(uint8_t channel);
+  void Daq_GetSize(rpcFuture<uint32_t> &size, uint8_t channel) { size.Set(Daq_GetSize(channel)); }
   uint8_t Daq_FillLevel(uint8_t channel);
   uint8_t Daq_FillLevel();
   uint8_t Daq_Read(std::vector<uint16_t> &data, uint32_t blocksize = 65536, uint8_t channel = 0);
@@ -273,6 +293,7 @@ class CTestboard {
   int16_t TrimChip(std::vector<int16_t> &trim);
 
   bool notokenpass(uint8_t tbmtype, uint8_t channel);
+  bool badtiming(uint8_t tbmtype, uint8_t channel);
   
   // == Trigger Loop functions for Host-side DAQ ROC/Module testing ==============
   // Exported RPC-Calls for the Trimbit storage setup:
@@ -7,10 +7,163 @@
 
 namespace pxar {
 
-  uint16_t dtbSource::FillBuffer() {
+#ifndef WIN32
+  dtbPrefetcher::dtbPrefetcher(CTestboard * src, uint8_t daqchannel)
+    : tb(src), channel(daqchannel), rpcLock(NULL), logctx(NULL), running(false), stopping(false),
+      ring(DTB_SOURCE_RING_SIZE), head(0), filled(0),
+      endOfStream(false), paused(false), eosState(0), eosRemaining(0), rpcFailed(false), rpcError() {
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&cond, NULL);
+    for(size_t i = 0; i < ring.size(); i++) { ring.at(i).data.reserve(DTB_SOURCE_BLOCK_SIZE/2); }
+  }
+
+  dtbPrefetcher::~dtbPrefetcher() {
+    Stop();
+    pthread_cond_destroy(&cond);
+    pthread_mutex_destroy(&mutex);
+  }
+
+  bool dtbPrefetcher::Start(pthread_mutex_t * lock) {
+    if(running) return true;
+    rpcLock = lock;
+    logctx = SetLogOutput::Context();
+    stopping = false;
+    paused = false;
+    running = (pthread_create(&thread, NULL, dtbPrefetcher::Run, this) == 0);
+    if(running) { LOG(logDEBUGPIPES) << "Started prefetching channel " << static_cast<int>(channel) << "."; }
+    return running;
+  }
+
+  void dtbPrefetcher::Stop() {
+    if(!running) return;
+    pthread_mutex_lock(&mutex);
+    stopping = true;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+    pthread_join(thread, NULL);
+    running = false;
+    LOG(logDEBUGPIPES) << "Stopped prefetching channel " << static_cast<int>(channel) << ", "
+		       << filled << " blocks buffered.";
+  }
+
+  void * dtbPrefetcher::Run(void * arg) {
+    static_cast<dtbPrefetcher*>(arg)->Loop();
+    return NULL;
+  }
+
+  void dtbPrefetcher::Loop() {
+    SetLogOutput::Context() = logctx;
+    pthread_mutex_lock(&mutex);
+    while(!stopping) {
+      // Wait for a free buffer, or for the consumer after the DTB was found empty:
+      if(paused || endOfStream || rpcFailed || filled == ring.size()) {
+	pthread_cond_wait(&cond, &mutex);
+	continue;
+      }
+
+      // The next free buffer is not touched by the consumer, read without holding the mutex:
+      block & next = ring.at((head + filled)%ring.size());
+      pthread_mutex_unlock(&mutex);
+
+      uint8_t state = 0;
+      bool failed = false;
+      CRpcError error;
+      if(rpcLock) pthread_mutex_lock(rpcLock);
+      try { state = tb->Daq_Read(next.data, DTB_SOURCE_BLOCK_SIZE, next.remaining, channel); }
+      catch(CRpcError &e) { failed = true; error = e; }
+      if(rpcLock) pthread_mutex_unlock(rpcLock);
+
+      pthread_mutex_lock(&mutex);
+      if(failed) {
+	rpcFailed = true;
+	rpcError = error;
+      }
+      else if(next.data.empty()) {
+	endOfStream = true;
+	paused = true;
+	eosState = state;
+	eosRemaining = next.remaining;
+      }
+      else {
+	next.state = state;
+	filled++;
+      }
+      pthread_cond_broadcast(&cond);
+    }
+    pthread_mutex_unlock(&mutex);
+  }
+
+  bool dtbPrefetcher::Next(std::vector<uint16_t> & buffer, uint8_t & state, uint32_t & remaining, bool & eos) {
+    eos = false;
+    pthread_mutex_lock(&mutex);
+    while(1) {
+      // Hand out the oldest block, the consumer's buffer is recycled:
+      if(filled > 0) {
+	buffer.swap(ring.at(head).data);
+	state = ring.at(head).state;
+	remaining = ring.at(head).remaining;
+	head = (head + 1)%ring.size();
+	filled--;
+	pthread_cond_broadcast(&cond);
+	pthread_mutex_unlock(&mutex);
+	return true;
+      }
+      if(rpcFailed) {
+	rpcFailed = false;
+	CRpcError error = rpcError;
+	pthread_mutex_unlock(&mutex);
+	throw error;
+      }
+      if(endOfStream) {
+	endOfStream = false;
+	eos = true;
+	state = eosState;
+	remaining = eosRemaining;
+	pthread_mutex_unlock(&mutex);
+	return false;
+      }
+      if(!running) {
+	pthread_mutex_unlock(&mutex);
+	return false;
+      }
+      // Request more data after the end of stream has been consumed:
+      if(paused) {
+	paused = false;
+	pthread_cond_broadcast(&cond);
+      }
+      pthread_cond_wait(&cond, &mutex);
+    }
+  }
+
+  bool dtbSource::StartPrefetch(pthread_mutex_t * lock) {
+    if(!connected) return false;
+    if(!prefetch.get()) { prefetch.reset(new dtbPrefetcher(tb, channel)); }
+    return prefetch.get()->Start(lock);
+  }
+
+  void dtbSource::StopPrefetch() {
+    if(prefetch.get()) { prefetch.get()->Stop(); }
+  }
+#endif
+
+  void dtbSource::FillBuffer() {
     pos = 0;
     do {
-      dtbState = tb->Daq_Read(buffer, DTB_SOURCE_BLOCK_SIZE, dtbRemainingSize, channel);
+#ifndef WIN32
+      bool endOfStream = false;
+      if(prefetch.get() && (prefetch.get()->Next(buffer, dtbState, dtbRemainingSize, endOfStream) || endOfStream)) {
+	// Block or end of stream delivered by the background reader:
+	if(endOfStream) { buffer.clear(); }
+      }
+      else if(rpcLock) {
+	pthread_mutex_lock(rpcLock);
+	try { dtbState = tb->Daq_Read(buffer, DTB_SOURCE_BLOCK_SIZE, dtbRemainingSize, channel); }
+	catch(...) { pthread_mutex_unlock(rpcLock); throw; }
+	pthread_mutex_unlock(rpcLock);
+      }
+      else
+#endif
+	dtbState = tb->Daq_Read(buffer, DTB_SOURCE_BLOCK_SIZE, dtbRemainingSize, channel);
     
       if (buffer.size() == 0) {
 	if (stopAtEmptyData) throw dsBufferEmpty();
@@ -28,8 +181,6 @@ namespace pxar {
     LOG(logDEBUGPIPES) << "FULL RAW DATA BLOB:";
     LOG(logDEBUGPIPES) << listVector(buffer,true);
     LOG(logDEBUGPIPES) << "-------------------------";
-
-    return lastSample = buffer[pos++];
   }
 
 }
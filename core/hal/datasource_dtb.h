@@ -5,8 +5,93 @@
 #include "datapipe.h"
 #include "rpc_calls.h"
 
+#ifndef WIN32
+#include <pthread.h>
+#endif
+
 namespace pxar {
 
+#ifndef WIN32
+  /** Background reader for the DTB data source: keeps reading blocks of
+   *  DTB_SOURCE_BLOCK_SIZE from one DAQ channel into a ring of preallocated
+   *  buffers while the consumer is still busy with the previous ones. Blocks
+   *  are handed out by swapping buffers, no data is copied.
+   *  After the DTB has been found empty once, the reader pauses until the next
+   *  block is requested, so it never reads further ahead than the consumer.
+   */
+  class dtbPrefetcher {
+  public:
+    dtbPrefetcher(CTestboard * src, uint8_t daqchannel);
+    ~dtbPrefetcher();
+
+    /** Start the reader thread, "lock" serializes the access to the DTB.
+     *  Returns false if the thread could not be started.
+     */
+    bool Start(pthread_mutex_t * lock);
+
+    /** Stop the reader thread, blocks already read are kept.
+     */
+    void Stop();
+
+    /** Swap the next block read into "buffer" and return true. Returns false
+     *  if no block is available, either because the DTB was found empty (end
+     *  of stream, "state" holds the DAQ state of that read) or because the
+     *  reader is not running. Errors of the reader are re-thrown here.
+     */
+    bool Next(std::vector<uint16_t> & buffer, uint8_t & state, uint32_t & remaining, bool & endOfStream);
+
+  private:
+    static void * Run(void * arg);
+    void Loop();
+
+    CTestboard * tb;
+    uint8_t channel;
+    pthread_mutex_t * rpcLock;
+    // Logging context of the thread which started the reader:
+    logContext * logctx;
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool running;
+    bool stopping;
+
+    // --- ring of block buffers
+    struct block {
+      std::vector<uint16_t> data;
+      uint8_t state;
+      uint32_t remaining;
+    };
+    std::vector<block> ring;
+    size_t head;
+    size_t filled;
+
+    // --- stream state
+    bool endOfStream;
+    bool paused;
+    uint8_t eosState;
+    uint32_t eosRemaining;
+    bool rpcFailed;
+    CRpcError rpcError;
+
+    // Not copyable:
+    dtbPrefetcher(const dtbPrefetcher &);
+    dtbPrefetcher & operator=(const dtbPrefetcher &);
+  };
+
+  // Owning handle for the prefetcher of a dtbSource, copies of a source start without one:
+  class dtbPrefetchHandle {
+    dtbPrefetcher * prefetcher;
+  public:
+    dtbPrefetchHandle() : prefetcher(NULL) {}
+    dtbPrefetchHandle(const dtbPrefetchHandle &) : prefetcher(NULL) {}
+    dtbPrefetchHandle & operator=(const dtbPrefetchHandle &) { reset(NULL); return *this; }
+    ~dtbPrefetchHandle() { reset(NULL); }
+    void reset(dtbPrefetcher * p) { delete prefetcher; prefetcher = p; }
+    dtbPrefetcher * get() { return prefetcher; }
+  };
+#endif
+
   // DTB data source class
   class dtbSource : public dataSource<uint16_t> {
     volatile bool stopAtEmptyData;
@@ -22,17 +107,34 @@ namespace pxar {
     bool connected;
     uint8_t envelopetype;
     uint8_t devicetype;
+#ifndef WIN32
+    // Lock serializing the DTB access when reading several sources in parallel:
+    pthread_mutex_t * rpcLock;
+    // Background reader, only present once prefetching has been started:
+    dtbPrefetchHandle prefetch;
+#endif
 
     // --- data buffer
     uint16_t lastSample;
     unsigned int pos;
     std::vector<uint16_t> buffer;
-    uint16_t FillBuffer();
+    void FillBuffer();
 
     // --- virtual data access methods
     uint16_t Read() { 
       if(!connected) throw dpNotConnected();
-      return (pos < buffer.size()) ? lastSample = buffer[pos++] : FillBuffer();
+      if(pos >= buffer.size()) FillBuffer();
+      return lastSample = buffer[pos++];
+    }
+    const uint16_t* ReadBlock(size_t &count) {
+      if(!connected) throw dpNotConnected();
+      if(pos >= buffer.size()) FillBuffer();
+      count = buffer.size() - pos;
+      return &buffer[pos];
+    }
+    void ReadAdvance(size_t count) {
+      pos += count;
+      lastSample = buffer[pos-1];
     }
     uint16_t ReadLast() {
       if(!connected) throw dpNotConnected();
@@ -64,10 +166,29 @@ namespace pxar {
     }
   public:
   dtbSource(CTestboard * src, uint8_t daqchannel, uint8_t tokenChainLength, uint8_t offset, uint8_t tbmtype, uint8_t roctype, bool endlessStream, uint16_t daqflags = 0)
-    : stopAtEmptyData(endlessStream), tb(src), channel(daqchannel), flags(daqflags), chainlength(tokenChainLength), chainlengthOffset(offset), connected(true), envelopetype(tbmtype), devicetype(roctype), lastSample(0x4000), pos(0) {}
-  dtbSource() : connected(false) {}
+    : stopAtEmptyData(endlessStream), tb(src), channel(daqchannel), flags(daqflags), chainlength(tokenChainLength), chainlengthOffset(offset), dtbRemainingSize(0), dtbState(0), connected(true), envelopetype(tbmtype), devicetype(roctype),
+#ifndef WIN32
+      rpcLock(NULL),
+#endif
+      lastSample(0x4000), pos(0) {}
+  dtbSource()
+    : stopAtEmptyData(false), tb(NULL), channel(0), flags(0), chainlength(0), chainlengthOffset(0), dtbRemainingSize(0), dtbState(0), connected(false), envelopetype(0), devicetype(0),
+#ifndef WIN32
+      rpcLock(NULL),
+#endif
+      lastSample(0x4000), pos(0) {}
     bool isConnected() { return connected; }
 
+#ifndef WIN32
+    // Set a lock to be held while reading from the DTB, NULL disables locking:
+    void SetLock(pthread_mutex_t * lock) { rpcLock = lock; }
+
+    // Start/stop reading ahead from the DTB in a background thread. While prefetching,
+    // all other DTB access has to hold "lock":
+    bool StartPrefetch(pthread_mutex_t * lock);
+    void StopPrefetch();
+#endif
+
     // --- control and status
     uint8_t  GetState() { return dtbState; }
     uint32_t GetRemainingSize() { return dtbRemainingSize; }
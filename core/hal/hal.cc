@@ -24,9 +24,17 @@ hal::hal(std::string name) :
   m_tokenchains(),
   m_daqstatus(),
   _currentTrgSrc(TRG_SEL_PG_DIR),
+  m_rocdacs(),
+  m_tbmregs(),
+  m_transaction(false),
+  m_stageddacs(),
+  m_stagedregs(),
   m_src(),
   m_splitter(),
-  m_decoder()
+  m_decoder(),
+  m_condenseSlab(),
+  m_consumer(NULL),
+  m_consumed(0)
 {
 
   // Get a new CTestboard class instance:
@@ -80,7 +88,15 @@ hal::hal(std::string name) :
     m_splitter.push_back(dtbEventSplitter());
     m_decoder.push_back(dtbEventDecoder());
   }
-  
+
+#ifndef WIN32
+  pthread_mutex_init(&m_rpclock, NULL);
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&m_tblock, &attr);
+  pthread_mutexattr_destroy(&attr);
+#endif
 }
 
 hal::~hal() {
@@ -96,6 +112,11 @@ hal::~hal() {
   LOG(logQUIET) << "Connection to board " << _testboard->GetBoardId() << " closed.";
   _testboard->Close();
   delete _testboard;
+
+#ifndef WIN32
+  pthread_mutex_destroy(&m_rpclock);
+  pthread_mutex_destroy(&m_tblock);
+#endif
 }
 
 bool hal::status() {
@@ -106,6 +127,11 @@ bool hal::status() {
   return _initialized;
 }
 
+void hal::setUsbBufferSize(uint32_t writeSize, uint32_t readSize) {
+  LOG(logDEBUGHAL) << "Setting USB buffer sizes to " << writeSize << "b (write), " << readSize << "b (read).";
+  _testboard->SetUsbBufferSize(writeSize, readSize);
+}
+
 uint32_t hal::GetHashForString(const char * s)
 {
   // Using some primes
@@ -313,6 +339,12 @@ void hal::initTBMCore(tbmConfig tbm) {
   // Program all registers according to the configuration data:
   LOG(logDEBUGHAL) << "Setting register vector for TBM Core " << tbm.corename() << ".";
   if(tbm.NoTokenPass()) { LOG(logDEBUGHAL) << "This TBM has the NoTokenPass register set!"; }
+  // Always write the full register set, drop what we know about this core:
+  std::map<uint8_t,uint8_t> & shadow = m_tbmregs[tbm.hubid];
+  for(std::map<uint8_t,uint8_t>::iterator it = shadow.begin(); it != shadow.end();) {
+    if((it->first & 0xF0) == tbm.core) { shadow.erase(it++); }
+    else { ++it; }
+  }
   tbmSetRegs(tbm.hubid,tbm.core,tbm.dacs);
 }
 
@@ -334,6 +366,8 @@ void hal::initROC(uint8_t roci2c, uint8_t type, std::map< uint8_t,uint8_t > dacV
 
   // Programm all DAC registers according to the configuration data:
   LOG(logDEBUGHAL) << "Setting DAC vector for ROC@I2C " << static_cast<int>(roci2c) << ".";
+  // Always write the full DAC set, drop what we know about this ROC:
+  m_rocdacs.erase(roci2c);
   rocSetDACs(roci2c,dacVector);
 }
 
@@ -492,6 +526,20 @@ double hal::getTBvd() {
   return (_testboard->_GetVD()/1000.0);
 }
 
+void hal::getTBpower(double & va, double & vd, double & ia, double & id) {
+  // Queue all four requests, they are sent together when the first value is read:
+  rpcFuture<uint16_t> mva, mvd, mia, mid;
+  _testboard->_GetVA(mva);
+  _testboard->_GetVD(mvd);
+  _testboard->_GetIA(mia);
+  _testboard->_GetID(mid);
+
+  va = mva.Get()/1000.0;
+  vd = mvd.Get()/1000.0;
+  ia = mia.Get()/10000.0;
+  id = mid.Get()/10000.0;
+}
+
 
 void hal::setTBia(double IA) {
   // Set the VA analog current limit in A:
@@ -529,29 +577,16 @@ void hal::setHubId(uint8_t hub0, uint8_t hub1) {
 
 bool hal::rocSetDACs(uint8_t roci2c, std::map< uint8_t, uint8_t > dacPairs) {
 
-  // Make sure we are writing to the correct ROC by setting the I2C address:
-  _testboard->roc_I2cAddr(roci2c);
-
-  // Check if WBC has been updated:
-  bool is_wbc = false;
-
-  // Check if one of the DACs to be set is RangeTemp and shift it to the end:
-  std::map<uint8_t,uint8_t>::iterator rangetemp = dacPairs.end();
-
-  // Iterate over all DAC id/value pairs and set the DAC
-  for(std::map< uint8_t,uint8_t >::iterator it = dacPairs.begin(); it != dacPairs.end(); ++it) {
-    if(it->first == ROC_DAC_RangeTemp) { rangetemp = it; continue; }
-
-    LOG(logDEBUGHAL) << "Set DAC" << static_cast<int>(it->first) << " to " << static_cast<int>(it->second);
-    _testboard->roc_SetDAC(it->first,it->second);
-    if(it->first == ROC_DAC_WBC) { is_wbc = true; }
+  // Within a transaction only stage the new values, later writes win:
+  if(m_transaction) {
+    for(std::map< uint8_t,uint8_t >::iterator it = dacPairs.begin(); it != dacPairs.end(); ++it) {
+      m_stageddacs[roci2c][it->first] = it->second;
+    }
+    return true;
   }
 
-  // Check if RangeTemp has been omitted and set it now - this allows to read its value via lastDAC:
-  if(rangetemp != dacPairs.end()) {
-    LOG(logDEBUGHAL) << "Set DAC" << static_cast<int>(rangetemp->first) << " to " << static_cast<int>(rangetemp->second);
-    _testboard->roc_SetDAC(rangetemp->first,rangetemp->second);
-  }
+  bool is_wbc = false;
+  size_t written = rocWriteDACs(roci2c, dacPairs, is_wbc);
 
   // Make sure to issue a ROC Reset after WBC has been programmed:
   if(is_wbc) {
@@ -560,57 +595,178 @@ bool hal::rocSetDACs(uint8_t roci2c, std::map< uint8_t, uint8_t > dacPairs) {
   }
 
   // Send all queued commands to the testboard:
-  _testboard->Flush();
+  if(written > 0) { _testboard->Flush(); }
   // Everything went all right:
   return true;
 }
 
 bool hal::rocSetDAC(uint8_t roci2c, uint8_t dacId, uint8_t dacValue) {
 
-  // Make sure we are writing to the correct ROC by setting the I2C address:
-  _testboard->roc_I2cAddr(roci2c);
+  std::map< uint8_t,uint8_t > dacPairs;
+  dacPairs.insert(std::make_pair(dacId,dacValue));
+  return rocSetDACs(roci2c, dacPairs);
+}
 
-  LOG(logDEBUGHAL) << "ROC@I2C " << static_cast<size_t>(roci2c) 
-		   << ": Set DAC" << static_cast<int>(dacId) << " to " << static_cast<int>(dacValue);
-  _testboard->roc_SetDAC(dacId,dacValue);
-  _testboard->Flush();
+size_t hal::rocWriteDACs(uint8_t roci2c, const std::map<uint8_t,uint8_t> & dacPairs, bool & is_wbc) {
 
-  // Make sure to issue a ROC Reset after the DAc WBC has been programmed:
-  if(dacId == ROC_DAC_WBC) {
-    LOG(logDEBUGHAL) << "WBC has been programmed - sending a ROC Reset command.";
-    daqTriggerSingleSignal(TRG_SEND_RSR);
+  std::map<uint8_t,uint8_t> & shadow = m_rocdacs[roci2c];
+  size_t written = 0;
+
+  // RangeTemp is set last in a second pass - this allows to read its value via lastDAC:
+  for(size_t pass = 0; pass < 2; pass++) {
+    for(std::map< uint8_t,uint8_t >::const_iterator it = dacPairs.begin(); it != dacPairs.end(); ++it) {
+      if((it->first == ROC_DAC_RangeTemp) != (pass == 1)) continue;
+
+      // Skip unchanged values, except for the registers steering the readback:
+      std::map<uint8_t,uint8_t>::iterator known = shadow.find(it->first);
+      if(known != shadow.end() && known->second == it->second
+	 && it->first != ROC_DAC_Readback && it->first != ROC_DAC_RangeTemp) {
+	LOG(logDEBUGHAL) << "ROC@I2C " << static_cast<int>(roci2c)
+			 << ": DAC" << static_cast<int>(it->first) << " already at " << static_cast<int>(it->second);
+	continue;
+      }
+
+      // Make sure we are writing to the correct ROC by setting the I2C address once:
+      if(written == 0) { _testboard->roc_I2cAddr(roci2c); }
+
+      LOG(logDEBUGHAL) << "ROC@I2C " << static_cast<int>(roci2c)
+		       << ": Set DAC" << static_cast<int>(it->first) << " to " << static_cast<int>(it->second);
+      _testboard->roc_SetDAC(it->first,it->second);
+      shadow[it->first] = it->second;
+      if(it->first == ROC_DAC_WBC) { is_wbc = true; }
+      written++;
+    }
+  }
+  return written;
+}
+
+void hal::rocInvalidateDAC(uint8_t dacId) {
+  for(std::map<uint8_t, std::map<uint8_t,uint8_t> >::iterator roc = m_rocdacs.begin(); roc != m_rocdacs.end(); ++roc) {
+    roc->second.erase(dacId);
   }
-  return true;
 }
 
 bool hal::tbmSetRegs(uint8_t hubid, uint8_t core, std::map< uint8_t, uint8_t > regPairs) {
 
-  // Iterate over all register id/value pairs and set them
+  // Add the core address to all register ids:
+  std::map< uint8_t,uint8_t > regs;
   for(std::map< uint8_t,uint8_t >::iterator it = regPairs.begin(); it != regPairs.end(); ++it) {
-    // One of the register settings had an issue, abort:
-    if(!tbmSetReg(hubid, core | it->first, it->second)) return false;
+    regs[core | it->first] = it->second;
+  }
+
+  // Within a transaction only stage the new values, later writes win:
+  if(m_transaction) {
+    for(std::map< uint8_t,uint8_t >::iterator it = regs.begin(); it != regs.end(); ++it) {
+      m_stagedregs[hubid][it->first] = it->second;
+    }
+    return true;
   }
 
   // Send all queued commands to the testboard:
-  _testboard->Flush();
+  if(tbmWriteRegs(hubid, regs) > 0) { _testboard->Flush(); }
   // Everything went all right:
   return true;
 }
 
 bool hal::tbmSetReg(uint8_t hubid, uint8_t regId, uint8_t regValue) {
 
-  LOG(logDEBUGHAL) << "TBM@HUB " << static_cast<int>(hubid)
-		   << ": set register \"0x" << std::hex << static_cast<int>(regId) 
-		   << "\" to 0x" << static_cast<int>(regValue) << std::dec;
+  if(m_transaction) {
+    m_stagedregs[hubid][regId] = regValue;
+    return true;
+  }
 
-  // Make sure we are writing to the correct TBM by setting the module's hub id:
-  _testboard->mod_Addr(hubid);
+  std::map< uint8_t,uint8_t > regs;
+  regs.insert(std::make_pair(regId,regValue));
+  tbmWriteRegs(hubid, regs);
+  return true;
+}
+
+size_t hal::tbmWriteRegs(uint8_t hubid, const std::map<uint8_t,uint8_t> & regPairs) {
+
+  std::map<uint8_t,uint8_t> & shadow = m_tbmregs[hubid];
+  size_t written = 0;
+
+  for(std::map< uint8_t,uint8_t >::const_iterator it = regPairs.begin(); it != regPairs.end(); ++it) {
+    // Skip unchanged values, except for the command register injecting triggers and resets:
+    bool command = ((it->first & 0x0F) == TBM_REG_CLEAR_INJECT);
+    std::map<uint8_t,uint8_t>::iterator known = shadow.find(it->first);
+    if(known != shadow.end() && known->second == it->second && !command) {
+      LOG(logDEBUGHAL) << "TBM@HUB " << static_cast<int>(hubid)
+		       << ": register \"0x" << std::hex << static_cast<int>(it->first)
+		       << "\" already at 0x" << static_cast<int>(it->second) << std::dec;
+      continue;
+    }
+
+    // Make sure we are writing to the correct TBM by setting the module's hub id once:
+    if(written == 0) { _testboard->mod_Addr(hubid); }
+
+    LOG(logDEBUGHAL) << "TBM@HUB " << static_cast<int>(hubid)
+		     << ": set register \"0x" << std::hex << static_cast<int>(it->first)
+		     << "\" to 0x" << static_cast<int>(it->second) << std::dec;
+    _testboard->tbm_Set(it->first,it->second);
+    if(!command) { shadow[it->first] = it->second; }
+    written++;
+  }
+  return written;
+}
+
+void hal::startTransaction() {
+  if(m_transaction) {
+    LOG(logDEBUGHAL) << "Register transaction already open, "
+		     << m_stageddacs.size() << " ROCs and " << m_stagedregs.size() << " TBMs staged.";
+    return;
+  }
+  LOG(logDEBUGHAL) << "Starting register transaction.";
+  m_transaction = true;
+}
+
+bool hal::commitTransaction() {
 
-  // Set this register:
-  _testboard->tbm_Set(regId,regValue);
+  if(!m_transaction) {
+    LOG(logDEBUGHAL) << "No register transaction open, nothing to commit.";
+    return true;
+  }
+  m_transaction = false;
+
+  size_t staged = 0, written = 0;
+  bool is_wbc = false;
+
+  // TBM registers first, one hub id selection per TBM:
+  for(std::map<uint8_t, std::map<uint8_t,uint8_t> >::iterator tbm = m_stagedregs.begin(); tbm != m_stagedregs.end(); ++tbm) {
+    staged += tbm->second.size();
+    written += tbmWriteRegs(tbm->first, tbm->second);
+  }
+
+  // ROC DACs, one I2C address selection per ROC:
+  for(std::map<uint8_t, std::map<uint8_t,uint8_t> >::iterator roc = m_stageddacs.begin(); roc != m_stageddacs.end(); ++roc) {
+    staged += roc->second.size();
+    written += rocWriteDACs(roc->first, roc->second, is_wbc);
+  }
+
+  m_stagedregs.clear();
+  m_stageddacs.clear();
+
+  LOG(logDEBUGHAL) << "Committing register transaction: " << written << " of "
+		   << staged << " staged registers changed.";
+
+  // One ROC Reset for all ROCs after WBC has been programmed:
+  if(is_wbc) {
+    LOG(logDEBUGHAL) << "WBC has been programmed - sending a ROC Reset command.";
+    daqTriggerSingleSignal(TRG_SEND_RSR);
+  }
+
+  // Send all queued commands to the testboard:
+  if(written > 0) { _testboard->Flush(); }
   return true;
 }
 
+void hal::clearShadowRegisters() {
+  LOG(logDEBUGHAL) << "Clearing shadow registers of " << m_rocdacs.size() << " ROCs and "
+		   << m_tbmregs.size() << " TBMs.";
+  m_rocdacs.clear();
+  m_tbmregs.clear();
+}
+
 void hal::SetupI2CValues(std::vector<uint8_t> roci2cs) {
 
   LOG(logDEBUGHAL) << "Writing the following available I2C devices into NIOS storage:";
@@ -774,7 +930,7 @@ std::vector<Event> hal::MultiRocAllPixelsCalibrate(std::vector<uint8_t> roci2cs,
   daqClear();
 
   // check for missing events
-  int missing = expected/nTriggers - data.size();
+  int missing = expected/nTriggers - (data.size() + m_consumed);
   if(missing != 0) {
     LOG(logCRITICAL) << "Incomplete DAQ data readout! Missing " << missing << " Events.";
     // serious runtime issue as data is invalid and cannot be recovered at this point:
@@ -816,7 +972,7 @@ std::vector<Event> hal::MultiRocOnePixelCalibrate(std::vector<uint8_t> roci2cs,
   daqClear();
 
   // We expect one Event per trigger, all ROCs are triggered in parallel:
-  int missing = 1 - data.size();
+  int missing = 1 - (data.size() + m_consumed);
   if(missing != 0) { 
     LOG(logCRITICAL) << "Incomplete DAQ data readout! Missing " << missing << " Events."; 
     // serious runtime issue as data is invalid and cannot be recovered at this point:
@@ -857,7 +1013,7 @@ std::vector<Event> hal::SingleRocAllPixelsCalibrate(uint8_t roci2c, bool efficie
   daqClear();
 
   // check for missing events
-  int missing = expected/nTriggers - data.size();
+  int missing = expected/nTriggers - (data.size() + m_consumed);
   if(missing != 0) { 
     LOG(logCRITICAL) << "Incomplete DAQ data readout! Missing " << missing << " Events.";
     // serious runtime issue as data is invalid and cannot be recovered at this point:
@@ -897,7 +1053,7 @@ std::vector<Event> hal::SingleRocOnePixelCalibrate(uint8_t roci2c, uint8_t colum
   daqClear();
 
   // We are expecting one Event per trigger:
-  int missing = 1 - data.size();
+  int missing = 1 - (data.size() + m_consumed);
   if(missing != 0) { 
     LOG(logCRITICAL) << "Incomplete DAQ data readout! Missing " << missing << " Events.";
     // serious runtime issue as data is invalid and cannot be recovered at this point:
@@ -934,6 +1090,9 @@ std::vector<Event> hal::MultiRocAllPixelsDacScan(std::vector<uint8_t> roci2cs, b
   daqStart(flags,deser160phase);
   timer t;
 
+  // The testboard leaves the scanned DACs at their last value:
+  rocInvalidateDAC(dacreg);
+
   // Call the RPC command containing the trigger loop:
   bool done = false;
   std::vector<Event> data = std::vector<Event>();
@@ -949,7 +1108,7 @@ std::vector<Event> hal::MultiRocAllPixelsDacScan(std::vector<uint8_t> roci2cs, b
   daqClear();
 
   // check for errors in readout (i.e. missing events)
-  int missing = expected/nTriggers - data.size();
+  int missing = expected/nTriggers - (data.size() + m_consumed);
   if(missing != 0) {
     LOG(logCRITICAL) << "Incomplete DAQ data readout! Missing " << missing << " Events.";
     // serious runtime issue as data is invalid and cannot be recovered at this point:
@@ -987,6 +1146,9 @@ std::vector<Event> hal::MultiRocOnePixelDacScan(std::vector<uint8_t> roci2cs, ui
   daqStart(flags,deser160phase);
   timer t;
 
+  // The testboard leaves the scanned DACs at their last value:
+  rocInvalidateDAC(dacreg);
+
   // Call the RPC command containing the trigger loop:
   bool done = false;
   std::vector<Event> data = std::vector<Event>();
@@ -1002,7 +1164,7 @@ std::vector<Event> hal::MultiRocOnePixelDacScan(std::vector<uint8_t> roci2cs, ui
   daqClear();
 
   // check for errors in readout (i.e. missing events)
-  int missing = expected/nTriggers - data.size();
+  int missing = expected/nTriggers - (data.size() + m_consumed);
   if(missing != 0) { 
     LOG(logCRITICAL) << "Incomplete DAQ data readout! Missing " << missing << " Events.";
     // serious runtime issue as data is invalid and cannot be recovered at this point:
@@ -1036,6 +1198,9 @@ std::vector<Event> hal::SingleRocAllPixelsDacScan(uint8_t roci2c, bool efficienc
   daqStart(flags,deser160phase);
   timer t;
 
+  // The testboard leaves the scanned DACs at their last value:
+  rocInvalidateDAC(dacreg);
+
   // Call the RPC command containing the trigger loop:
   bool done = false;
   std::vector<Event> data = std::vector<Event>();
@@ -1051,7 +1216,7 @@ std::vector<Event> hal::SingleRocAllPixelsDacScan(uint8_t roci2c, bool efficienc
   daqClear();
 
   // check for errors in readout (i.e. missing events)
-  int missing = expected/nTriggers - data.size();
+  int missing = expected/nTriggers - (data.size() + m_consumed);
   if(missing != 0) { 
     LOG(logCRITICAL) << "Incomplete DAQ data readout! Missing " << missing << " Events.";
     // serious runtime issue as data is invalid and cannot be recovered at this point:
@@ -1085,6 +1250,9 @@ std::vector<Event> hal::SingleRocOnePixelDacScan(uint8_t roci2c, uint8_t column,
   daqStart(flags,deser160phase);
   timer t;
 
+  // The testboard leaves the scanned DACs at their last value:
+  rocInvalidateDAC(dacreg);
+
   // Call the RPC command containing the trigger loop:
   bool done = false;
   std::vector<Event> data = std::vector<Event>();
@@ -1100,7 +1268,7 @@ std::vector<Event> hal::SingleRocOnePixelDacScan(uint8_t roci2c, uint8_t column,
   daqClear();
 
   // check for errors in readout (i.e. missing events)
-  int missing = expected/nTriggers - data.size();
+  int missing = expected/nTriggers - (data.size() + m_consumed);
   if(missing != 0) { 
     LOG(logCRITICAL) << "Incomplete DAQ data readout! Missing " << missing << " Events.";
     // serious runtime issue as data is invalid and cannot be recovered at this point:
@@ -1144,6 +1312,10 @@ std::vector<Event> hal::MultiRocAllPixelsDacDacScan(std::vector<uint8_t> roci2cs
   daqStart(flags,deser160phase);
   timer t;
 
+  // The testboard leaves the scanned DACs at their last value:
+  rocInvalidateDAC(dac1reg);
+  rocInvalidateDAC(dac2reg);
+
   // Call the RPC command containing the trigger loop:
   bool done = false;
   std::vector<Event> data = std::vector<Event>();
@@ -1159,7 +1331,7 @@ std::vector<Event> hal::MultiRocAllPixelsDacDacScan(std::vector<uint8_t> roci2cs
   daqClear();
 
   // check for errors in readout (i.e. missing events)
-  int missing = expected/nTriggers - data.size();
+  int missing = expected/nTriggers - (data.size() + m_consumed);
   if(missing != 0) { 
     LOG(logCRITICAL) << "Incomplete DAQ data readout! Missing " << missing << " Events.";
     // serious runtime issue as data is invalid and cannot be recovered at this point:
@@ -1206,6 +1378,10 @@ std::vector<Event> hal::MultiRocOnePixelDacDacScan(std::vector<uint8_t> roci2cs,
   daqStart(flags,deser160phase);
   timer t;
 
+  // The testboard leaves the scanned DACs at their last value:
+  rocInvalidateDAC(dac1reg);
+  rocInvalidateDAC(dac2reg);
+
   // Call the RPC command containing the trigger loop:
   bool done = false;
   std::vector<Event> data = std::vector<Event>();
@@ -1221,7 +1397,7 @@ std::vector<Event> hal::MultiRocOnePixelDacDacScan(std::vector<uint8_t> roci2cs,
   daqClear();
 
   // check for errors in readout (i.e. missing events)
-  int missing = expected/nTriggers - data.size();
+  int missing = expected/nTriggers - (data.size() + m_consumed);
   if(missing != 0) { 
     LOG(logCRITICAL) << "Incomplete DAQ data readout! Missing " << missing << " Events.";
     // serious runtime issue as data is invalid and cannot be recovered at this point:
@@ -1264,6 +1440,10 @@ std::vector<Event> hal::SingleRocAllPixelsDacDacScan(uint8_t roci2c, bool effici
   daqStart(flags,deser160phase);
   timer t;
 
+  // The testboard leaves the scanned DACs at their last value:
+  rocInvalidateDAC(dac1reg);
+  rocInvalidateDAC(dac2reg);
+
   // Call the RPC command containing the trigger loop:
   bool done = false;
   std::vector<Event> data = std::vector<Event>();
@@ -1279,7 +1459,7 @@ std::vector<Event> hal::SingleRocAllPixelsDacDacScan(uint8_t roci2c, bool effici
   daqClear();
 
   // check for errors in readout (i.e. missing events)
-  int missing = expected/nTriggers - data.size();
+  int missing = expected/nTriggers - (data.size() + m_consumed);
   if(missing != 0) { 
     LOG(logCRITICAL) << "Incomplete DAQ data readout! Missing " << missing << " Events.";
     // serious runtime issue as data is invalid and cannot be recovered at this point:
@@ -1322,6 +1502,10 @@ std::vector<Event> hal::SingleRocOnePixelDacDacScan(uint8_t roci2c, uint8_t colu
   daqStart(flags,deser160phase);
   timer t;
 
+  // The testboard leaves the scanned DACs at their last value:
+  rocInvalidateDAC(dac1reg);
+  rocInvalidateDAC(dac2reg);
+
   // Call the RPC command containing the trigger loop:
   bool done = false;
   std::vector<Event> data = std::vector<Event>();
@@ -1337,7 +1521,7 @@ std::vector<Event> hal::SingleRocOnePixelDacDacScan(uint8_t roci2c, uint8_t colu
   daqClear();
 
   // check for errors in readout (i.e. missing events)
-  int missing = expected/nTriggers - data.size();
+  int missing = expected/nTriggers - (data.size() + m_consumed);
   if(missing != 0) { 
     LOG(logCRITICAL) << "Incomplete DAQ data readout! Missing " << missing << " Events.";
     // serious runtime issue as data is invalid and cannot be recovered at this point:
@@ -1373,6 +1557,7 @@ void hal::Pon() {
   _testboard->Flush();
 
   // Clear HAL internal counters:
+  clearShadowRegisters();
   m_tbmtype = TBM_NONE;
   m_roctype = ROC_NONE;
   m_roccount = 0;
@@ -1386,6 +1571,9 @@ void hal::Poff() {
   // Turn off DUT power and execute (flush):
   _testboard->Poff();
   _testboard->Flush();
+
+  // All registers are lost:
+  clearShadowRegisters();
 }
 
 
@@ -1467,6 +1655,13 @@ void hal::SigSetLVDS(){
 void hal::daqStart(uint16_t flags, uint8_t deser160phase, uint32_t buffersize) {
 
   LOG(logDEBUGHAL) << "Starting new DAQ session.";
+
+  // Staged registers have to be programmed before taking data:
+  if(m_transaction) {
+    LOG(logWARNING) << "Register transaction still open when starting DAQ, committing now.";
+    commitTransaction();
+  }
+  m_consumed = 0;
   for(uint8_t channel = 0; channel < DTB_DAQ_CHANNELS; channel++) { m_daqstatus.push_back(false); }
 
   // Clear all decoder instances:
@@ -1589,44 +1784,287 @@ Event hal::daqEvent() {
   return current_Event;
 }
 
-std::vector<Event> hal::daqAllEvents() {
+size_t hal::daqChannelsConnected() {
+  size_t channels = 0;
+  for(size_t ch = 0; ch < m_src.size(); ch++) {
+    if(m_src.at(ch).isConnected()) { channels++; }
+  }
+  return channels;
+}
+
+#ifndef WIN32
+namespace {
+  // State of one DAQ channel drained in its own thread. The events of the channel are
+  // stored back to back in one pixel and one raw word arena, event i spans the ranges
+  // [pixoffset[i], pixoffset[i+1]) and [wordoffset[i], wordoffset[i+1]) respectively:
+  struct daqChannelWorker {
+    daqChannelWorker() : channel(0), splitter(NULL), decoder(NULL), keepRaw(false), pixels(), words(), pixoffset(1, 0), wordoffset(1, 0),
+			 headers(), trailers(), flags(), pipeError(false), dataError(false), decodingError(false), rpcError(false), message(), rpcerror(), logctx(NULL) {}
+    size_t size() const { return (decoder ? pixoffset.size() : wordoffset.size()) - 1; }
+    size_t npixels(size_t evt) const { return (evt + 1 < pixoffset.size() ? pixoffset[evt+1] - pixoffset[evt] : 0); }
+    size_t nwords(size_t evt) const { return (evt + 1 < wordoffset.size() ? wordoffset[evt+1] - wordoffset[evt] : 0); }
+    uint8_t channel;
+    dtbEventSplitter * splitter;
+    // Decoder to be attached, NULL if only raw events are requested:
+    dtbEventDecoder * decoder;
+    // Store the raw events next to the decoded ones:
+    bool keepRaw;
+    std::vector<pixel> pixels;
+    std::vector<uint16_t> words;
+    std::vector<size_t> pixoffset;
+    std::vector<size_t> wordoffset;
+    // TBM header and trailer of decoded events, error flags of raw events:
+    std::vector<uint16_t> headers;
+    std::vector<uint16_t> trailers;
+    std::vector<uint8_t> flags;
+    // Errors are stored and handed back to the calling thread:
+    bool pipeError;
+    bool dataError;
+    bool decodingError;
+    bool rpcError;
+    std::string message;
+    CRpcError rpcerror;
+    // Log context of the calling thread, messages of the worker carry the same one:
+    logContext * logctx;
+  };
+
+  void * daqDrainChannel(void * arg) {
+    daqChannelWorker * worker = static_cast<daqChannelWorker*>(arg);
+    logContextGuard log(worker->logctx);
+
+    try {
+      dataSink<rawEvent*> rawpump;
+      dataSink<Event*> Eventpump;
+      if(worker->decoder) { *(worker->splitter) >> *(worker->decoder) >> Eventpump; }
+      else { *(worker->splitter) >> rawpump; }
+
+      while(1) {
+	// The raw event the decoder has been working on stays available via GetLast():
+	rawEvent * raw = NULL;
+	if(worker->decoder) {
+	  Event * evt = Eventpump.Get();
+	  worker->pixels.insert(worker->pixels.end(), evt->pixels.begin(), evt->pixels.end());
+	  worker->headers.push_back(evt->header);
+	  worker->trailers.push_back(evt->trailer);
+	  worker->pixoffset.push_back(worker->pixels.size());
+	  if(worker->keepRaw) { raw = worker->decoder->GetLast(); }
+	}
+	else { raw = rawpump.Get(); }
+
+	if(raw) {
+	  worker->words.insert(worker->words.end(), raw->data.begin(), raw->data.end());
+	  worker->flags.push_back((raw->IsStartError() ? 1 : 0) | (raw->IsEndError() ? 2 : 0) | (raw->IsOverflow() ? 4 : 0));
+	  worker->wordoffset.push_back(worker->words.size());
+	}
+      }
+    }
+    catch(dsBufferEmpty &) {
+      LOG(logDEBUGHAL) << "Finished readout Channel " << static_cast<int>(worker->channel) << ".";
+    }
+    catch(dataPipeException &e) { worker->pipeError = true; worker->message = e.what(); }
+    catch(DataDecodingError &e) { worker->decodingError = true; worker->message = e.what(); }
+    catch(pxarException &e) { worker->dataError = true; worker->message = e.what(); }
+    catch(CRpcError &e) { worker->rpcError = true; worker->rpcerror = e; }
+    return NULL;
+  }
+}
+
+namespace {
+  // Runs the background readers of all connected data sources while in scope:
+  class prefetchGuard {
+    std::vector<dtbSource> & sources;
+  public:
+    prefetchGuard(std::vector<dtbSource> & src, pthread_mutex_t * lock) : sources(src) {
+      for(size_t ch = 0; ch < sources.size(); ch++) {
+	if(sources.at(ch).isConnected()) { sources.at(ch).StartPrefetch(lock); }
+      }
+    }
+    ~prefetchGuard() {
+      for(size_t ch = 0; ch < sources.size(); ch++) { sources.at(ch).StopPrefetch(); }
+    }
+  };
+}
+
+bool hal::daqDrainParallel(std::vector<Event> * events, std::vector<rawEvent> * rawevents) {
+
+  std::vector<daqChannelWorker> workers;
+  for(size_t ch = 0; ch < m_src.size(); ch++) {
+    if(!m_src.at(ch).isConnected()) continue;
+    daqChannelWorker worker;
+    worker.channel = static_cast<uint8_t>(ch);
+    worker.splitter = &m_splitter.at(ch);
+    if(events) { worker.decoder = &m_decoder.at(ch); }
+    worker.keepRaw = (rawevents != NULL);
+    worker.logctx = SetLogOutput::Context();
+    workers.push_back(worker);
+  }
+
+  // Start one thread per channel, all DTB reads are serialized by the lock:
+  LOG(logDEBUGHAL) << "Draining " << workers.size() << " DAQ channels in parallel.";
+  std::vector<pthread_t> threads(workers.size());
+  std::vector<bool> running(workers.size(), false);
+  for(size_t i = 0; i < workers.size(); i++) {
+    m_src.at(workers.at(i).channel).SetLock(&m_rpclock);
+    running.at(i) = (pthread_create(&threads.at(i), NULL, daqDrainChannel, &workers.at(i)) == 0);
+    // Fall back to reading the channel from this thread:
+    if(!running.at(i)) {
+      LOG(logDEBUGHAL) << "Could not start thread for channel " << static_cast<int>(workers.at(i).channel) << ", reading serially.";
+      daqDrainChannel(&workers.at(i));
+    }
+  }
+  for(size_t i = 0; i < workers.size(); i++) {
+    if(running.at(i)) { pthread_join(threads.at(i), NULL); }
+    m_src.at(workers.at(i).channel).SetLock(NULL);
+    m_src.at(workers.at(i).channel).StopPrefetch();
+  }
+
+  // Reset the DTB memory of all drained channels to work around buffer issue:
+  bool pipeok = true;
+  for(size_t i = 0; i < workers.size(); i++) {
+    if(workers.at(i).pipeError) {
+      LOG(logERROR) << workers.at(i).message;
+      pipeok = false;
+    }
+    else { _testboard->Daq_MemReset(workers.at(i).channel); }
+  }
+  _testboard->Flush();
+
+  // Hand errors of the reader threads on to the caller:
+  for(size_t i = 0; i < workers.size(); i++) {
+    if(workers.at(i).rpcError) throw workers.at(i).rpcerror;
+    if(workers.at(i).decodingError) throw DataDecodingError(workers.at(i).message);
+    if(workers.at(i).dataError) throw DataException(workers.at(i).message);
+  }
+
+  // Merge the channels event by event, the longest channel defines the event count:
+  size_t nevents = 0;
+  for(size_t i = 0; i < workers.size(); i++) { nevents = std::max(nevents, workers.at(i).size()); }
+
+  if(events) {
+    events->reserve(events->size() + nevents);
+    size_t mismatch = 0;
+    for(size_t evt = 0; evt < nevents; evt++) {
+      // Merge directly into the output buffer, allocating the pixels only once:
+      events->push_back(Event());
+      Event & current_Event = events->back();
+      size_t npixels = 0;
+      for(size_t i = 0; i < workers.size(); i++) { npixels += workers.at(i).npixels(evt); }
+      current_Event.pixels.reserve(npixels);
+
+      bool first = true;
+      for(size_t i = 0; i < workers.size(); i++) {
+	daqChannelWorker & worker = workers.at(i);
+	if(evt >= worker.size()) continue;
+	// Keep the TBM header and trailer of the first channel:
+	if(first) {
+	  current_Event.header = worker.headers.at(evt);
+	  current_Event.trailer = worker.trailers.at(evt);
+	}
+	// Compare the trigger count of the channels if we have TBM headers:
+	else if(m_tbmtype != TBM_NONE && m_tbmtype != TBM_EMU
+		&& ((worker.headers.at(evt) >> 8) & 0xff) != current_Event.triggerCount()) { mismatch++; }
+	first = false;
+	current_Event.pixels.insert(current_Event.pixels.end(),
+				    worker.pixels.begin() + worker.pixoffset.at(evt),
+				    worker.pixels.begin() + worker.pixoffset.at(evt+1));
+      }
+    }
+    if(mismatch > 0) { LOG(logWARNING) << "Found " << mismatch << " events with trigger count mismatch between DAQ channels."; }
+  }
+
+  if(rawevents) {
+    rawevents->reserve(rawevents->size() + nevents);
+    for(size_t evt = 0; evt < nevents; evt++) {
+      rawevents->push_back(rawEvent());
+      rawEvent & current_Event = rawevents->back();
+      size_t nwords = 0;
+      for(size_t i = 0; i < workers.size(); i++) { nwords += workers.at(i).nwords(evt); }
+      current_Event.data.reserve(nwords);
+
+      for(size_t i = 0; i < workers.size(); i++) {
+	daqChannelWorker & worker = workers.at(i);
+	if(evt >= worker.size()) continue;
+	current_Event.data.insert(current_Event.data.end(),
+				  worker.words.begin() + worker.wordoffset.at(evt),
+				  worker.words.begin() + worker.wordoffset.at(evt+1));
+	// Carry over the event flags:
+	if(worker.flags.at(evt) & 1) { current_Event.SetStartError(); }
+	if(worker.flags.at(evt) & 2) { current_Event.SetEndError(); }
+	if(worker.flags.at(evt) & 4) { current_Event.SetOverflow(); }
+      }
+    }
+  }
+
+  LOG(logDEBUGHAL) << "Drained all DAQ channels.";
+  return pipeok;
+}
+#endif
+
+std::vector<Event> hal::daqAllEvents(std::vector<rawEvent> * raw) {
 
   std::vector<Event> evt;
+
+#ifndef WIN32
+  // Read ahead from the DTB in the background while decoding:
+  prefetchGuard prefetch(m_src, &m_rpclock);
+
+  // Read multiple DAQ channels in parallel, one thread each:
+  if(daqChannelsConnected() > 1) {
+    if(!daqDrainParallel(&evt, raw)) return evt;
+    if(evt.empty()) throw DataNoEvent("No event available");
+    return evt;
+  }
+#endif
   
   // Prepare channel flags:
   std::vector<bool> done_ch;
   for(size_t i = 0; i < m_src.size(); i++) { done_ch.push_back(false); }
 
   while(1) {
-    // Read the next Event from each of the pipes:
-    Event current_Event;
+    // Read the next Event from each of the pipes, directly into the output buffer:
+    evt.push_back(Event());
+    Event & current_Event = evt.back();
+    if(raw) { raw->push_back(rawEvent()); }
     for(size_t ch = 0; ch < m_src.size(); ch++) {
       if(m_src.at(ch).isConnected()) {
 	dataSink<Event*> Eventpump;
 	m_splitter.at(ch) >> m_decoder.at(ch) >> Eventpump;
 
-	// Add all event data from this channel:
-	try { current_Event += *Eventpump.Get(); }
+	// Add all event data from this channel, the raw event stays available from the decoder:
+	try {
+	  current_Event += *Eventpump.Get();
+	  if(raw) { raw->back() += *m_decoder.at(ch).GetLast(); }
+	}
 	catch (dsBufferEmpty &) {
 	  LOG(logDEBUGHAL) << "Finished readout Channel " << ch << ".";
 	  // Reset the DTB memory to work around buffer issue:
+	  lockDTB();
 	  _testboard->Daq_MemReset(ch);
+	  unlockDTB();
 	  done_ch.at(ch) = true;
 	}
-	catch (dataPipeException &e) { LOG(logERROR) << e.what(); return evt; }
+	catch (dataPipeException &e) {
+	  LOG(logERROR) << e.what();
+	  evt.pop_back();
+	  if(raw) { raw->pop_back(); }
+	  return evt;
+	}
       }
       else { done_ch.at(ch) = true; }
     }
 
+    lockDTB();
     _testboard->Flush();
+    unlockDTB();
 
     // If all readout is finished, return:
     std::vector<bool>::iterator fin = std::find(done_ch.begin(), done_ch.end(), false);
     if(fin == done_ch.end()) {
       LOG(logDEBUGHAL) << "Drained all DAQ channels.";
+      evt.pop_back();
+      if(raw) { raw->pop_back(); }
       break;
     }
-    else { evt.push_back(current_Event); }
   }
   
   if(evt.empty()) throw DataNoEvent("No event available");
@@ -1667,13 +2105,26 @@ std::vector<rawEvent> hal::daqAllRawEvents() {
 
   std::vector<rawEvent> raw;
 
+#ifndef WIN32
+  // Read ahead from the DTB in the background while decoding:
+  prefetchGuard prefetch(m_src, &m_rpclock);
+
+  // Read multiple DAQ channels in parallel, one thread each:
+  if(daqChannelsConnected() > 1) {
+    if(!daqDrainParallel(NULL, &raw)) return raw;
+    if(raw.empty()) throw DataNoEvent("No event available");
+    return raw;
+  }
+#endif
+
   // Prepare channel flags:
   std::vector<bool> done_ch;
   for(size_t i = 0; i < m_src.size(); i++) { done_ch.push_back(false); }
 
   while(1) {
-    // Read the next Event from each of the pipes:
-    rawEvent current_Event;
+    // Read the next Event from each of the pipes, directly into the output buffer:
+    raw.push_back(rawEvent());
+    rawEvent & current_Event = raw.back();
     
     for(size_t ch = 0; ch < m_src.size(); ch++) {
       if(m_src.at(ch).isConnected()) {
@@ -1684,23 +2135,27 @@ std::vector<rawEvent> hal::daqAllRawEvents() {
 	catch (dsBufferEmpty &) {
 	  LOG(logDEBUGHAL) << "Finished readout Channel " << ch << ".";
 	  // Reset the DTB memory to work around buffer issue:
+	  lockDTB();
 	  _testboard->Daq_MemReset(ch);
+	  unlockDTB();
 	  done_ch.at(ch) = true;
 	}
-	catch (dataPipeException &e) { LOG(logERROR) << e.what(); return raw; }
+	catch (dataPipeException &e) { LOG(logERROR) << e.what(); raw.pop_back(); return raw; }
       }
       else { done_ch.at(ch) = true; }
     }
 
+    lockDTB();
     _testboard->Flush();
+    unlockDTB();
 
     // If all readout is finished, return:
     std::vector<bool>::iterator fin = std::find(done_ch.begin(), done_ch.end(), false);
     if(fin == done_ch.end()) {
       LOG(logDEBUGHAL) << "Drained all DAQ channels.";
+      raw.pop_back();
       break;
     }
-    else { raw.push_back(current_Event); }
   }
 
   if(raw.empty()) throw DataNoEvent("No event available");
@@ -1716,7 +2171,14 @@ std::vector<uint16_t> hal::daqBuffer() {
     if(m_src.at(ch).isConnected()) {
       dataSink<uint16_t> rawpump;
       m_src.at(ch) >> rawpump;
-      try { while(1) { raw.push_back(rawpump.Get()); } }
+      try {
+	while(1) {
+	  size_t count;
+	  const uint16_t * block = rawpump.GetBlock(count);
+	  raw.insert(raw.end(), block, block + count);
+	  rawpump.Advance(count);
+	}
+      }
       catch (dsBufferEmpty &) {
 	LOG(logDEBUGHAL) << "Finished readout Channel " << ch << ".";
 	// Reset the DTB memory to work around buffer issue:
@@ -1785,21 +2247,30 @@ void hal::daqTriggerLoopHalt() {
 
 uint32_t hal::daqBufferStatus() {
 
+  // Query all active DAQ channels at once, the replies arrive together:
+  rpcFuture<uint32_t> sizes[DTB_DAQ_CHANNELS];
+  for(uint8_t channel = 0; channel < DTB_DAQ_CHANNELS; channel++) {
+    if(m_daqstatus.size() > channel && m_daqstatus.at(channel)) {
+      _testboard->Daq_GetSize(sizes[channel], channel);
+    }
+  }
+
   uint32_t buffered_data = 0;
   // Summing up data words in all active DAQ channels:
   for(uint8_t channel = 0; channel < DTB_DAQ_CHANNELS; channel++) {
     if(m_daqstatus.size() > channel && m_daqstatus.at(channel)) {
-      buffered_data += _testboard->Daq_GetSize(channel);
+      buffered_data += sizes[channel].Get();
     }
   }
   return buffered_data;
 }
 
-statistics hal::daqStatistics() {
+statistics hal::daqStatistics(bool reset) {
   // Read statistics from the active channels:
   statistics errors;
   for(size_t ch = 0; ch < m_decoder.size(); ch++) {
-    errors += m_decoder.at(ch).getStatistics();
+    if(reset) { errors += m_decoder.at(ch).getStatistics(); }
+    else { errors += m_decoder.at(ch).peekStatistics(); }
   }
   return errors;
 }
@@ -1895,13 +2366,27 @@ std::vector<Event> hal::condenseTriggers(std::vector<Event> &data, uint16_t nTri
     LOG(logCRITICAL) << "Data size does not correspond to " << nTriggers << " triggers! Aborting data processing!";
     return packed;
   }
+  packed.reserve(data.size()/nTriggers);
+
+  // Dense lookup table covering all pixels of a full module, reused between calls:
+  if(m_condenseSlab.size() != MOD_NUMROCS*ROC_NUMCOLS*ROC_NUMROWS) {
+    m_condenseSlab.assign(MOD_NUMROCS*ROC_NUMCOLS*ROC_NUMROWS, 0);
+  }
+
+  // Hit counters and running mean/M2 for the pulse height, indexed like the condensed pixels:
+  std::vector<uint16_t> pxcount;
+  std::vector<double> pxmean;
+  std::vector<double> pxm2;
+
+  // Scratch event keeping its capacity between the condensed events:
+  Event evt;
 
   for(std::vector<Event>::iterator Eventit = data.begin(); Eventit!= data.end(); Eventit += nTriggers) {
 
-    Event evt;
-    std::map<pixel,uint16_t> pxcount = std::map<pixel,uint16_t>();
-    std::map<pixel,double> pxmean = std::map<pixel,double>();
-    std::map<pixel,double> pxm2 = std::map<pixel,double>();
+    evt.Clear();
+    pxcount.clear();
+    pxmean.clear();
+    pxm2.clear();
 
     for(std::vector<Event>::iterator it = Eventit; it != Eventit+nTriggers; ++it) {
 
@@ -1909,18 +2394,27 @@ std::vector<Event> hal::condenseTriggers(std::vector<Event> &data, uint16_t nTri
       for(std::vector<pixel>::iterator pixit = (it)->pixels.begin(); pixit != (it)->pixels.end(); ++pixit) {
 
 	// Check if we have that particular pixel already in:
-	std::vector<pixel>::iterator px = std::find_if(evt.pixels.begin(),
-						       evt.pixels.end(),
-						       findPixelXY(pixit->column(), pixit->row(), pixit->roc()));
+	uint32_t * slot = NULL;
+	size_t pos;
+	if(pixit->roc() < MOD_NUMROCS && pixit->column() < ROC_NUMCOLS && pixit->row() < ROC_NUMROWS) {
+	  slot = &m_condenseSlab[(pixit->roc()*ROC_NUMCOLS + pixit->column())*ROC_NUMROWS + pixit->row()];
+	  pos = (*slot != 0 ? *slot - 1 : evt.pixels.size());
+	}
+	else {
+	  // Addresses outside the module range are not in the table, search for them:
+	  pos = std::find_if(evt.pixels.begin(), evt.pixels.end(),
+			     findPixelXY(pixit->column(), pixit->row(), pixit->roc())) - evt.pixels.begin();
+	}
+
 	// Pixel is known:
-	if(px != evt.pixels.end()) {
-	  if(efficiency) { px->setValue(px->value()+1); }
+	if(pos < evt.pixels.size()) {
+	  if(efficiency) { evt.pixels[pos].setValue(evt.pixels[pos].value()+1); }
 	  else {
 	    // Calculate the variance incrementally:
-	    double delta = pixit->value() - pxmean[*px];
-	    pxmean[*px] += delta/pxcount[*px];
-	    pxm2[*px] += delta*(pixit->value() - pxmean[*px]);
-	    pxcount[*px]++;
+	    double delta = pixit->value() - pxmean[pos];
+	    pxmean[pos] += delta/pxcount[pos];
+	    pxm2[pos] += delta*(pixit->value() - pxmean[pos]);
+	    pxcount[pos]++;
 	  }
 	}
 	// Pixel is new:
@@ -1928,11 +2422,12 @@ std::vector<Event> hal::condenseTriggers(std::vector<Event> &data, uint16_t nTri
 	  if(efficiency) { pixit->setValue(1); }
 	  else {
 	    // Initialize counters and temporary variables:
-	    pxcount.insert(std::make_pair(*pixit,1));
-	    pxmean.insert(std::make_pair(*pixit,pixit->value()));
-	    pxm2.insert(std::make_pair(*pixit,0));
+	    pxcount.push_back(1);
+	    pxmean.push_back(pixit->value());
+	    pxm2.push_back(0);
 	  }
 	  evt.pixels.push_back(*pixit);
+	  if(slot) { *slot = evt.pixels.size(); }
 	}
       }
     }
@@ -1940,11 +2435,19 @@ std::vector<Event> hal::condenseTriggers(std::vector<Event> &data, uint16_t nTri
     // Calculate mean and variance for the pulse height depending on the
     // number of triggers received:
     if(!efficiency) {
-      for(std::vector<pixel>::iterator px = evt.pixels.begin(); px != evt.pixels.end(); ++px) {
-	px->setValue(pxmean[*px]); // The mean
-	px->setVariance(pxm2[*px]/(pxcount[*px] - 1)); // The variance
+      for(size_t pos = 0; pos < evt.pixels.size(); pos++) {
+	evt.pixels[pos].setValue(pxmean[pos]); // The mean
+	evt.pixels[pos].setVariance(pxm2[pos]/(pxcount[pos] - 1)); // The variance
       }
     }
+
+    // Reset the table entries of all pixels we have touched:
+    for(std::vector<pixel>::iterator px = evt.pixels.begin(); px != evt.pixels.end(); ++px) {
+      if(px->roc() < MOD_NUMROCS && px->column() < ROC_NUMCOLS && px->row() < ROC_NUMROWS) {
+	m_condenseSlab[(px->roc()*ROC_NUMCOLS + px->column())*ROC_NUMROWS + px->row()] = 0;
+      }
+    }
+    // Store the event, allocating its pixels only once:
     packed.push_back(evt);
   }
 
@@ -1957,12 +2460,20 @@ void hal::addCondensedData(std::vector<Event> &data, uint16_t nTriggers, bool ef
 
   std::vector<Event> tmpdata = std::vector<Event>();
   try {
-    tmpdata = daqAllEvents();
-    tmpdata = condenseTriggers(tmpdata, nTriggers, efficiency);
-    data.insert(data.end(),tmpdata.begin(),tmpdata.end());
-    LOG(logDEBUGHAL) << (tmpdata.size()*nTriggers) << " events read and condensed (" << t << "ms), "
+    // Swap the event buffers around instead of copying them:
+    daqAllEvents().swap(tmpdata);
+    condenseTriggers(tmpdata, nTriggers, efficiency).swap(tmpdata);
+    size_t ncondensed = tmpdata.size();
+    // Hand the data to the consumer directly if we have one:
+    if(m_consumer) {
+      for(std::vector<Event>::iterator it = tmpdata.begin(); it != tmpdata.end(); ++it) { m_consumer->consume(*it); }
+      m_consumed += tmpdata.size();
+    }
+    else if(data.empty()) { data.swap(tmpdata); }
+    else { data.insert(data.end(),tmpdata.begin(),tmpdata.end()); }
+    LOG(logDEBUGHAL) << (ncondensed*nTriggers) << " events read and condensed (" << t << "ms), "
 		     << data.size() << " events buffered.";
-    LOG(logINFO) << (data.size()*nTriggers) << " events read in total (" << t << "ms).";
+    LOG(logINFO) << ((data.size() + m_consumed)*nTriggers) << " events read in total (" << t << "ms).";
   }
   catch(DataNoEvent) {}
   catch(DataException &e) {
@@ -10,6 +10,15 @@
 
 namespace pxar {
 
+  /** Interface for receiving condensed test data from the HAL while a test
+   *  loop is still running, instead of collecting it in the returned vector.
+   */
+  class condensedEventConsumer {
+  public:
+    virtual ~condensedEventConsumer() {}
+    virtual void consume(Event & evt) = 0;
+  };
+
   class hal
   {
 
@@ -34,6 +43,11 @@ namespace pxar {
      */
     bool compatible() { return _compatible; }
 
+    /** Change the sizes of the host-side USB write and read buffers (in bytes).
+     *  Reads of at least the read buffer size go directly to their destination.
+     */
+    void setUsbBufferSize(uint32_t writeSize, uint32_t readSize);
+
 
     // DEVICE INITIALIZATION
 
@@ -127,6 +141,22 @@ namespace pxar {
      */
     bool tbmSetRegs(uint8_t hubid, uint8_t core, std::map< uint8_t, uint8_t > regPairs);
 
+    /** Start a register transaction. Until commitTransaction() is called, all DAC
+     *  and TBM register writes are only staged in the HAL, repeated writes to the
+     *  same register are combined.
+     */
+    void startTransaction();
+
+    /** Write all registers staged since startTransaction() to the DUT with a single
+     *  I2C address selection per ROC and a single flush of the RPC buffer.
+     */
+    bool commitTransaction();
+
+    /** Forget the register values known to be programmed on the DUT. The next write
+     *  to every register is sent to the device, even if the value is unchanged.
+     */
+    void clearShadowRegisters();
+
     /** Function to set and update the pattern generator command list on the DTB
      */
     void SetupPatternGenerator(std::vector<std::pair<uint16_t,uint8_t> > pg_setup, uint16_t delaysum);
@@ -161,6 +191,10 @@ namespace pxar {
      */
     double getTBvd();
 
+    /** Read all testboard voltages and currents with a single USB round trip
+     */
+    void getTBpower(double & va, double & vd, double & ia, double & id);
+
 
     // Testboard probe channel commands:
     /** Selects "signal" as output for the DTB probe channel D1 (digital) 
@@ -289,6 +323,13 @@ namespace pxar {
      */
     std::vector<Event> SingleRocOnePixelDacDacScan(uint8_t roci2c, uint8_t column, uint8_t row, bool efficiency, std::vector<int32_t> parameter);
 
+    /** Set a consumer for the condensed data of the test functions above. While
+     *  set, all condensed events are handed to the consumer as soon as they are
+     *  read from the DTB and the test functions return empty vectors.
+     *  NULL restores the default behavior.
+     */
+    void setEventConsumer(condensedEventConsumer * consumer) { m_consumer = consumer; }
+
 
     // DAQ functions:
     /** Starting a new data acquisition session
@@ -344,13 +385,31 @@ namespace pxar {
      */
     rawEvent daqRawEvent();
 
-    /** Read all remaining decoded Events from the FIFO buffer
+    /** Read all remaining decoded Events from the FIFO buffer. If raw is
+     *  given, the raw data records the Events were decoded from are stored
+     *  there, one per Event.
      */
-    std::vector<Event> daqAllEvents();
+    std::vector<Event> daqAllEvents(std::vector<rawEvent> * raw = NULL);
 
-    /** Return the current decoding statistics for all channels:
+    /** Return the current decoding statistics for all channels, the counters are
+     *  reset unless reset is false:
      */
-    statistics daqStatistics();
+    statistics daqStatistics(bool reset = true);
+
+    /** Recursive lock taken by pxarCore for every call which talks to the testboard.
+     *  Other threads (e.g. the PixMonitor polling thread) thereby only access the
+     *  testboard between two complete call sequences of the test. No-op on WIN32.
+     */
+    void lockTestboard() {
+#ifndef WIN32
+      pthread_mutex_lock(&m_tblock);
+#endif
+    }
+    void unlockTestboard() {
+#ifndef WIN32
+      pthread_mutex_unlock(&m_tblock);
+#endif
+    }
 
     /** Return all readback values for the last readout. Return format is a vector containing
      *  one vector of uint16_t radback values for every ROC in the readout chain.
@@ -401,6 +460,10 @@ namespace pxar {
 
   private:
 
+    /** The benchmark of condenseTriggers on generated data, see tools/condensebench.cc
+     */
+    friend class condenseBench;
+
     /** Private instance of the testboard RPC interface, routes all
      *  hardware access:
      */
@@ -430,6 +493,37 @@ namespace pxar {
 
     uint16_t _currentTrgSrc;
 
+    /** Shadow copies of the DAC values programmed on each ROC (by I2C address) and
+     *  of the register values programmed on each TBM (by hub id), writes of
+     *  unchanged values are skipped.
+     */
+    std::map<uint8_t, std::map<uint8_t,uint8_t> > m_rocdacs;
+    std::map<uint8_t, std::map<uint8_t,uint8_t> > m_tbmregs;
+
+    /** Register writes staged in an open transaction
+     */
+    bool m_transaction;
+    std::map<uint8_t, std::map<uint8_t,uint8_t> > m_stageddacs;
+    std::map<uint8_t, std::map<uint8_t,uint8_t> > m_stagedregs;
+
+    /** Write DACs to one ROC, skipping the values already programmed. Selects the
+     *  I2C address only if anything is written and does not flush. Returns the
+     *  number of DACs written, is_wbc is set if WBC was among them.
+     */
+    size_t rocWriteDACs(uint8_t roci2c, const std::map<uint8_t,uint8_t> & dacPairs, bool & is_wbc);
+
+    /** Write registers to one TBM, skipping the values already programmed. The
+     *  clear/inject register (base4) holds commands and is always written. Selects
+     *  the hub id only if anything is written and does not flush. Returns the
+     *  number of registers written.
+     */
+    size_t tbmWriteRegs(uint8_t hubid, const std::map<uint8_t,uint8_t> & regPairs);
+
+    /** Forget the shadow value of one DAC on all ROCs, e.g. after it has been
+     *  scanned by the testboard
+     */
+    void rocInvalidateDAC(uint8_t dacId);
+
     /** Print the info block with software and firmware versions,
      *  MAC and USB ids etc. read from the connected testboard
      */
@@ -491,10 +585,56 @@ namespace pxar {
      */
     std::vector<uint16_t> * daqReadChannel(uint8_t channel);
 
+    /** Return the number of DAQ channels with a connected data source
+     */
+    size_t daqChannelsConnected();
+
+#ifndef WIN32
+    /** Drain all connected DAQ channels in parallel, one thread per channel.
+     *  Each thread runs the splitter (and the decoder if events are requested)
+     *  of its channel, the results are merged in channel order afterwards.
+     *  At least one of the two output vectors has to be given, events are
+     *  decoded if the events vector is present.
+     *  Returns false if the data pipe of any channel reported an error, the
+     *  output then contains all events read before.
+     */
+    bool daqDrainParallel(std::vector<Event> * events, std::vector<rawEvent> * rawevents);
+
+    // Lock serializing the DTB access of the parallel channel readout and prefetching:
+    pthread_mutex_t m_rpclock;
+
+    // Lock serializing complete pxarCore call sequences between threads, recursive:
+    pthread_mutex_t m_tblock;
+#endif
+
+    /** Serialize DTB access with the readout threads of the data sources,
+     *  required while prefetching is active. No-op on WIN32.
+     */
+    void lockDTB() {
+#ifndef WIN32
+      pthread_mutex_lock(&m_rpclock);
+#endif
+    }
+    void unlockDTB() {
+#ifndef WIN32
+      pthread_mutex_unlock(&m_rpclock);
+#endif
+    }
+
     // Our default pipe work buffers:
     std::vector<dtbSource> m_src;
     std::vector<dtbEventSplitter> m_splitter;
     std::vector<dtbEventDecoder> m_decoder;
+
+    /** Dense (roc, column, row) lookup table used by condenseTriggers, holding
+     *  the position of each pixel in the condensed event plus one, zero if the
+     *  pixel has not been seen yet. Only touched entries are reset after use.
+     */
+    std::vector<uint32_t> m_condenseSlab;
+
+    // Consumer for condensed test data and number of events handed to it in this DAQ session:
+    condensedEventConsumer * m_consumer;
+    size_t m_consumed;
   };
 }
 #endif
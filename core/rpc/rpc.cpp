@@ -51,6 +51,78 @@ void rpcMessage::Receive(CRpcIo &rpc_io)
 }
 
 
+// === pipelined calls ======================================================
+
+void rpcReply::Discard()
+{
+	// Keep the reply stream in order, errors are reported by the other replies:
+	if (m_pipe) try { m_pipe->Sync(); } catch (...) {}
+}
+
+
+void rpcReply::Wait()
+{
+	if (m_pipe) m_pipe->Sync();
+	if (m_error != CRpcError::OK) throw CRpcError(m_error);
+	if (!m_ready) throw CRpcError(CRpcError::NO_CMD_MSG);
+}
+
+
+void rpcPipeline::Queue(rpcReply &reply, uint16_t cmd, uint8_t size)
+{
+	// A reply object can only wait for one call at a time:
+	if (reply.m_pipe) Sync();
+	reply.m_pipe  = this;
+	reply.m_cmd   = cmd;
+	reply.m_size  = size;
+	reply.m_ready = false;
+	reply.m_error = CRpcError::OK;
+	m_pending.push_back(&reply);
+}
+
+
+void rpcPipeline::Sync()
+{
+	if (m_pending.empty()) return;
+
+	// Take over the queue first, receiving must not recurse into it:
+	vector<rpcReply*> pending;
+	pending.swap(m_pending);
+	for (size_t i=0; i<pending.size(); i++) pending[i]->m_pipe = 0;
+
+	size_t i = 0;
+	try
+	{
+		(*m_io)->Flush();
+		rpcMessage msg;
+		for (; i<pending.size(); i++)
+		{
+			msg.Receive(**m_io);
+			msg.Check(pending[i]->m_cmd, pending[i]->m_size);
+			pending[i]->Decode(msg);
+			pending[i]->m_ready = true;
+		}
+	}
+	catch (CRpcError &e)
+	{
+		// The reply stream is out of order, all remaining replies are lost:
+		for (; i<pending.size(); i++) pending[i]->m_error = e.error;
+		throw;
+	}
+}
+
+
+void rpcPipeline::Cancel()
+{
+	for (size_t i=0; i<m_pending.size(); i++)
+	{
+		m_pending[i]->m_pipe = 0;
+		m_pending[i]->m_error = CRpcError::UNDEF;
+	}
+	m_pending.clear();
+}
+
+
 // === data =================================================================
 
 void CDataHeader::RecvHeader(CRpcIo &rpc_io)
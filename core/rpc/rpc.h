@@ -47,13 +47,19 @@ extern const char rpc_timestamp[];
 
 #define RPC_DEFS \
 	CRpcIo *rpc_io; \
+	rpcPipeline rpc_pipe; \
 	static const char rpc_timestamp[]; \
 	static const unsigned int rpc_cmdListSize; \
 	static const char *rpc_cmdName[]; \
 	int *rpc_cmdId; \
-	void rpc_Clear() { for ( unsigned int i=2; i<rpc_cmdListSize; i++) rpc_cmdId[i] = -1; rpc_cmdId[0] = 0; rpc_cmdId[1] = 1; } \
+	void rpc_Clear() { rpc_pipe.Cancel(); for ( unsigned int i=2; i<rpc_cmdListSize; i++) rpc_cmdId[i] = -1; rpc_cmdId[0] = 0; rpc_cmdId[1] = 1; } \
 	void rpc_Connect(CRpcIo &port) { rpc_io = &port; rpc_Clear(); } \
 	uint16_t rpc_GetCallId(uint16_t x) \
+	{ \
+		rpc_pipe.Sync(); \
+		return rpc_LookupCallId(x); \
+	} \
+	uint16_t rpc_LookupCallId(uint16_t x) \
 	{ \
 		int id = rpc_cmdId[x]; \
 		if (id >= 0) return id; \
@@ -64,7 +70,7 @@ extern const char rpc_timestamp[];
 	} \
 	friend class CRpcError;
 
-#define RPC_INIT rpc_io = &RpcIoNull; rpc_cmdId = new int[rpc_cmdListSize]; rpc_Clear();
+#define RPC_INIT rpc_io = &RpcIoNull; rpc_pipe.Connect(&rpc_io); rpc_cmdId = new int[rpc_cmdListSize]; rpc_Clear();
 
 #define RPC_EXIT delete[] rpc_cmdId;
 
@@ -133,6 +139,78 @@ public:
 };
 
 
+// === pipelined calls ======================================================
+
+// Calls returning a value normally flush the output buffer and wait for their
+// reply, costing one USB round trip each. Pipelined calls only queue their
+// request. All queued requests are sent with a single flush when the first
+// reply is needed, the replies are then received in the order of the calls.
+
+class rpcPipeline;
+
+class rpcReply
+{
+	friend class rpcPipeline;
+	// Not copyable, the pipeline refers to the reply while it is pending:
+	rpcReply(const rpcReply &);
+	rpcReply& operator=(const rpcReply &);
+protected:
+	rpcPipeline *m_pipe;
+	uint16_t m_cmd;
+	uint8_t  m_size;
+	bool m_ready;
+	CRpcError::errorId m_error;
+	virtual void Decode(rpcMessage &msg) = 0;
+	void Wait();
+	void Discard();
+public:
+	rpcReply() : m_pipe(0), m_cmd(0), m_size(0), m_ready(false), m_error(CRpcError::OK) {}
+	virtual ~rpcReply() {}
+	bool Pending() { return m_pipe != 0; }
+	bool Ready() { return m_ready; }
+};
+
+
+inline void rpc_Get(rpcMessage &msg, bool &x)     { x = msg.Get_BOOL(); }
+inline void rpc_Get(rpcMessage &msg, int8_t &x)   { x = msg.Get_INT8(); }
+inline void rpc_Get(rpcMessage &msg, uint8_t &x)  { x = msg.Get_UINT8(); }
+inline void rpc_Get(rpcMessage &msg, int16_t &x)  { x = msg.Get_INT16(); }
+inline void rpc_Get(rpcMessage &msg, uint16_t &x) { x = msg.Get_UINT16(); }
+inline void rpc_Get(rpcMessage &msg, int32_t &x)  { x = msg.Get_INT32(); }
+inline void rpc_Get(rpcMessage &msg, uint32_t &x) { x = msg.Get_UINT32(); }
+
+
+// Future for the return value of a pipelined call. Get() waits for the reply,
+// a reply still pending on destruction is received and discarded.
+template <class T>
+class rpcFuture : public rpcReply
+{
+	T m_value;
+	void Decode(rpcMessage &msg) { rpc_Get(msg, m_value); }
+public:
+	rpcFuture() : m_value(T()) {}
+	~rpcFuture() { Discard(); }
+	T Get() { Wait(); return m_value; }
+};
+
+
+class rpcPipeline
+{
+	CRpcIo **m_io;
+	vector<rpcReply*> m_pending;
+public:
+	rpcPipeline() : m_io(0) {}
+	~rpcPipeline() { Cancel(); }
+	void Connect(CRpcIo **rpc_io) { m_io = rpc_io; }
+	// Register the reply for a request already written to the output buffer:
+	void Queue(rpcReply &reply, uint16_t cmd, uint8_t size);
+	// Flush all queued requests and receive their replies:
+	void Sync();
+	// Drop all queued requests, their replies become invalid:
+	void Cancel();
+};
+
+
 // === data =================================================================
 
 #define vectorR vector
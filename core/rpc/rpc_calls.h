@@ -209,6 +209,14 @@ public:
 
 	void SetTimeout(unsigned int timeout) { rpc_io->SetTimeout(timeout); }
 
+#ifdef INTERFACE_USB
+	void SetUsbBufferSize(uint32_t writeSize, uint32_t readSize) {
+	  if(usb != NULL) usb->SetBufferSize(writeSize, readSize);
+	}
+#else
+	void SetUsbBufferSize(uint32_t /*writeSize*/, uint32_t /*readSize*/) {}
+#endif /* INTERFACE_USB */
+
 	bool IsConnected() { return rpc_io->Connected(); }
 	const char * ConnectionError()
 	{ return rpc_io->GetErrorMsg(rpc_io->GetLastError()); }
@@ -293,6 +301,12 @@ public:
 	RPC_EXPORT uint16_t _GetID();
 	RPC_EXPORT uint16_t _GetIA();
 
+	// Pipelined versions, answered with the next synchronisation:
+	void _GetVD(rpcFuture<uint16_t> &mV);
+	void _GetVA(rpcFuture<uint16_t> &mV);
+	void _GetID(rpcFuture<uint16_t> &uA100);
+	void _GetIA(rpcFuture<uint16_t> &uA100);
+
 	RPC_EXPORT uint16_t _GetVD_Reg();
 	RPC_EXPORT uint16_t _GetVDAC_Reg();
 	RPC_EXPORT uint16_t _GetVD_Cap();
@@ -333,6 +347,7 @@ public:
 	RPC_EXPORT void Daq_Stop(uint8_t channel);
 	RPC_EXPORT void Daq_MemReset(uint8_t channel);
 	RPC_EXPORT uint32_t Daq_GetSize(uint8_t channel);
+	void Daq_GetSize(rpcFuture<uint32_t> &size, uint8_t channel);
 	RPC_EXPORT uint8_t Daq_FillLevel(uint8_t channel);
 	RPC_EXPORT uint8_t Daq_FillLevel();
 	RPC_EXPORT uint8_t Daq_Read(HWvectorR<uint16_t> &data, uint32_t blocksize = 65536, uint8_t channel = 0);
@@ -7,6 +7,8 @@
 #endif
 
 #include <stdint.h>
+#include <string.h>
+#include <vector>
 
 #include "rpc_error.h"
 
@@ -55,3 +57,46 @@ public:
 	void SetTimeout(unsigned int /*timeout*/) {};
 };
 
+
+// In-process loopback: everything written and flushed is read back again.
+// Allows to measure the host-side transfer path without a testboard attached.
+class CRpcIoLoopback : public CRpcIo
+{
+	std::vector<unsigned char> m_out, m_in;
+	uint32_t m_posIn;
+	bool m_open;
+public:
+	CRpcIoLoopback() : m_posIn(0), m_open(false) {}
+	void Write(const void *buffer, uint32_t size)
+	{
+		const unsigned char *data = static_cast<const unsigned char *>(buffer);
+		m_out.insert(m_out.end(), data, data + size);
+	}
+	void Flush()
+	{
+		// drop the data already read before appending the new block:
+		m_in.erase(m_in.begin(), m_in.begin() + m_posIn);
+		m_posIn = 0;
+		m_in.insert(m_in.end(), m_out.begin(), m_out.end());
+		m_out.clear();
+	}
+	void Clear() { m_out.clear(); m_in.clear(); m_posIn = 0; }
+	void Read(void *buffer, uint32_t size)
+	{
+		if (m_in.size() - m_posIn < size) throw CRpcError(CRpcError::READ_TIMEOUT);
+		if (size) memcpy(buffer, &m_in[m_posIn], size);
+		m_posIn += size;
+	}
+	const char* Name() { return "CRpcIoLoopback"; }
+	// Error processing
+	int32_t GetLastError() { return 0; }
+	const char* GetErrorMsg(int /*error*/) { return "ok"; }
+	// Connection
+	bool Open(char /*name*/[]) { Clear(); m_open = true; return true; }
+	void Close() { Clear(); m_open = false; }
+	bool EnumFirst(uint32_t &nDevices) { nDevices = 1; return true; }
+	bool EnumNext(char name[]) { strcpy(name, "loopback"); return true; }
+	bool Enum(char name[], uint32_t pos) { if (pos > 0) return false; strcpy(name, "loopback"); return true; }
+	bool Connected() { return m_open; }
+	void SetTimeout(unsigned int /*timeout*/) {}
+};
@@ -0,0 +1,74 @@
+// rpc_pipelined.cpp
+//
+// Pipelined versions of RPC calls returning a value. The request is only
+// written to the output buffer, the reply is received into an rpcFuture
+// when it is needed (see rpcPipeline).
+// The command ids are the ones of the synchronous calls in rpc_calls.cpp.
+
+#include "rpc_calls.h"
+
+void CTestboard::_GetVD(rpcFuture<uint16_t> &rpc_par0)
+{ RPC_PROFILING
+	try {
+	uint16_t rpc_clientCallId = rpc_LookupCallId(45);
+	RPC_THREAD_LOCK
+	rpcMessage msg;
+	msg.Create(rpc_clientCallId);
+	msg.Send(*rpc_io);
+	rpc_pipe.Queue(rpc_par0, rpc_clientCallId, 2);
+	RPC_THREAD_UNLOCK
+	} catch (CRpcError &e) { e.SetFunction(45); throw; };
+}
+
+void CTestboard::_GetVA(rpcFuture<uint16_t> &rpc_par0)
+{ RPC_PROFILING
+	try {
+	uint16_t rpc_clientCallId = rpc_LookupCallId(46);
+	RPC_THREAD_LOCK
+	rpcMessage msg;
+	msg.Create(rpc_clientCallId);
+	msg.Send(*rpc_io);
+	rpc_pipe.Queue(rpc_par0, rpc_clientCallId, 2);
+	RPC_THREAD_UNLOCK
+	} catch (CRpcError &e) { e.SetFunction(46); throw; };
+}
+
+void CTestboard::_GetID(rpcFuture<uint16_t> &rpc_par0)
+{ RPC_PROFILING
+	try {
+	uint16_t rpc_clientCallId = rpc_LookupCallId(47);
+	RPC_THREAD_LOCK
+	rpcMessage msg;
+	msg.Create(rpc_clientCallId);
+	msg.Send(*rpc_io);
+	rpc_pipe.Queue(rpc_par0, rpc_clientCallId, 2);
+	RPC_THREAD_UNLOCK
+	} catch (CRpcError &e) { e.SetFunction(47); throw; };
+}
+
+void CTestboard::_GetIA(rpcFuture<uint16_t> &rpc_par0)
+{ RPC_PROFILING
+	try {
+	uint16_t rpc_clientCallId = rpc_LookupCallId(48);
+	RPC_THREAD_LOCK
+	rpcMessage msg;
+	msg.Create(rpc_clientCallId);
+	msg.Send(*rpc_io);
+	rpc_pipe.Queue(rpc_par0, rpc_clientCallId, 2);
+	RPC_THREAD_UNLOCK
+	} catch (CRpcError &e) { e.SetFunction(48); throw; };
+}
+
+void CTestboard::Daq_GetSize(rpcFuture<uint32_t> &rpc_par0, uint8_t rpc_par1)
+{ RPC_PROFILING
+	try {
+	uint16_t rpc_clientCallId = rpc_LookupCallId(77);
+	RPC_THREAD_LOCK
+	rpcMessage msg;
+	msg.Create(rpc_clientCallId);
+	msg.Put_UINT8(rpc_par1);
+	msg.Send(*rpc_io);
+	rpc_pipe.Queue(rpc_par0, rpc_clientCallId, 4);
+	RPC_THREAD_UNLOCK
+	} catch (CRpcError &e) { e.SetFunction(77); throw; };
+}
@@ -29,32 +29,53 @@ typedef uint32_t DWORD;
 
 #include <stdint.h>
 
-#define USBWRITEBUFFERSIZE  4096
-#define USBREADBUFFERSIZE   4096
+// Default sizes of the host-side transfer buffers, can be changed at runtime
+// with CUSB::SetBufferSize():
+#define USBWRITEBUFFERSIZE  65536
+#define USBREADBUFFERSIZE   65536
+
+// Limits of the FTDI USB transfer size, which follows the read buffer size:
+#define USBMINTRANSFERSIZE  4096
+#define USBMAXTRANSFERSIZE  65536
 
 
 #define ESC_EXTENDED 0x8f
 
+#ifdef HAVE_LIBFTDI
+struct ftdiState;
+#endif
+
 class CUSB : public CRpcIo
 {
   bool isUSB_open;
 
   int ftdiStatus;
 
-#ifndef HAVE_LIBFTDI
+#ifdef HAVE_LIBFTDI
+  // Device context, read buffer and reader thread, one set per object so that
+  // several testboards can be used in one process:
+  ftdiState *m_ftdi;
+#else
   FT_HANDLE ftHandle;
 #endif
 
   uint32_t enumPos, enumCount;
   uint32_t m_timeout; // maximum time to awit for read/write call in ms
 
-  uint32_t m_posW;
-  unsigned char m_bufferW[USBWRITEBUFFERSIZE];
+  uint32_t m_posW, m_bufferSizeW;
+  unsigned char *m_bufferW;
 
+  // Reads of at least m_bufferSizeR bytes bypass the staging buffer:
   DWORD m_posR, m_sizeR;
-  unsigned char m_bufferR[USBREADBUFFERSIZE];
+  uint32_t m_bufferSizeR;
+  unsigned char *m_bufferR;
 
   bool FillBuffer(uint32_t minBytesToRead);
+  uint32_t TransferSize();
+
+  // The buffers are owned by the object, copying it is not supported:
+  CUSB(const CUSB &);
+  CUSB & operator=(const CUSB &);
 
 public:
   CUSB();
@@ -92,6 +113,13 @@ public:
   bool Show();
   void SetTimeout(unsigned int timeout);
 
+  /** Change the sizes of the write and read buffers. Pending output is
+   *  flushed, data already buffered for reading is kept.
+   */
+  void SetBufferSize(uint32_t writeSize, uint32_t readSize);
+  uint32_t GetWriteBufferSize() { return m_bufferSizeW; }
+  uint32_t GetReadBufferSize() { return m_bufferSizeR; }
+
 
   // read methods
 
@@ -1,14 +1,15 @@
 #ifndef WIN32
 #include <libusb.h>
-#include <cstring>
 #include <unistd.h>
 #include <time.h> // needed for usleep function
 #endif
 
 #include <cstdio>
+#include <cstring>
 #include <stdlib.h>
 #include <stdio.h>
 #include <iostream>
+#include <algorithm>
 
 #include "log.h"
 #include "exceptions.h"
@@ -21,6 +22,10 @@ using namespace pxar;
 
 CUSB::CUSB(){
   m_posR = m_sizeR = m_posW = 0;
+  m_bufferSizeW = USBWRITEBUFFERSIZE;
+  m_bufferSizeR = USBREADBUFFERSIZE;
+  m_bufferW = new unsigned char[m_bufferSizeW];
+  m_bufferR = new unsigned char[m_bufferSizeR];
   isUSB_open = false;
   ftHandle = 0;
   ftdiStatus = 0;
@@ -30,6 +35,8 @@ CUSB::CUSB(){
 
  CUSB::~CUSB(){
    Close();
+   delete[] m_bufferW;
+   delete[] m_bufferR;
  }
 
 const char* CUSB::GetErrorMsg(int error)
@@ -194,7 +201,7 @@ bool CUSB::Open(char serialNumber[])
   ftdiStatus = FT_SetBaudRate(ftHandle, 9600);
   if (ftdiStatus != FT_OK) UsbConnectionError("Error setting FTDI baud rate.");
   // set usb transfer size parameters (see: http://www.ftdichip.com/Support/Knowledgebase/ft_setusbparameters.htm)
-  ftdiStatus = FT_SetUSBParameters(ftHandle, 8192, 8192); // default: 4096, must be multiple of 64
+  ftdiStatus = FT_SetUSBParameters(ftHandle, TransferSize(), TransferSize()); // default: 4096, must be multiple of 64
   if (ftdiStatus != FT_OK) UsbConnectionError("Error setting USB transfer size parameters.");
 
 
@@ -215,11 +222,15 @@ void CUSB::Close()
 void CUSB::Write(uint32_t bytesToWrite, const void *buffer)
 {
   if (!isUSB_open) throw UsbConnectionError("Attempt to write to USB without open connection.");
-	uint32_t k=0;
-	for (k=0; k < bytesToWrite; k++)
+	const unsigned char *src = reinterpret_cast<const unsigned char*>(buffer);
+	while (bytesToWrite)
 	{
-		if (m_posW >= USBWRITEBUFFERSIZE) { Flush(); }
-		m_bufferW[m_posW++] = (reinterpret_cast<unsigned char*>(const_cast<void*>(buffer)))[k];
+		if (m_posW >= m_bufferSizeW) { Flush(); }
+		uint32_t n = std::min(bytesToWrite, m_bufferSizeW - m_posW);
+		memcpy(m_bufferW + m_posW, src, n);
+		m_posW += n;
+		src += n;
+		bytesToWrite -= n;
 	}
 }
 
@@ -259,7 +270,7 @@ bool CUSB::FillBuffer(uint32_t minBytesToRead)
 	if (m_posR<m_sizeR) return false;
 
 	bytesToRead = (bytesAvailable>minBytesToRead)? bytesAvailable : minBytesToRead;
-	if (bytesToRead>USBREADBUFFERSIZE) bytesToRead = USBREADBUFFERSIZE;
+	if (bytesToRead>m_bufferSizeR) bytesToRead = m_bufferSizeR;
 
 	ftdiStatus = FT_Read(ftHandle, m_bufferR, bytesToRead, &m_sizeR);
         if (m_sizeR < bytesToRead) {
@@ -283,41 +294,50 @@ void CUSB::Read(uint32_t bytesToRead, void *buffer, uint32_t &bytesRead)
 
 	if (!isUSB_open) throw UsbConnectionError("Attempt to read from USB without open connection.");
 
-	bool timeout = false;
+	unsigned char *dest = reinterpret_cast<unsigned char*>(buffer);
 	bytesRead = 0;
 
-	uint32_t i;
+	// Data left over from the last read:
+	uint32_t n = std::min(static_cast<uint32_t>(m_sizeR - m_posR), bytesToRead);
+	memcpy(dest, m_bufferR + m_posR, n);
+	m_posR += n;
+	bytesRead = n;
 
-	for (i=0; i<bytesToRead; i++)
+	while (bytesRead < bytesToRead)
 	{
-		if (m_posR<m_sizeR)
-		  (reinterpret_cast<unsigned char*>(const_cast<void*>(buffer)))[i] = m_bufferR[m_posR++];
-
-		else if (!timeout)
-		{
-			uint32_t n = bytesToRead-i;
-			if (n>USBREADBUFFERSIZE) n = USBREADBUFFERSIZE;
-
-			if (!FillBuffer(n)) throw UsbConnectionError("Error writing to USB");
-			if (m_sizeR < n) timeout = true;
-
-			if (m_posR<m_sizeR)
-			  (reinterpret_cast<unsigned char*>(const_cast<void*>(buffer)))[i] = m_bufferR[m_posR++];
-			else
-			{   // timeout (bytesRead < bytesToRead)
-				bytesRead = i;
+		uint32_t remaining = bytesToRead - bytesRead;
+
+		if (remaining >= m_bufferSizeR)
+		{   // large block, read directly into the destination
+			DWORD received = 0;
+			ftdiStatus = FT_Read(ftHandle, dest + bytesRead, remaining, &received);
+			if (ftdiStatus != FT_OK)
+			{
+				LOG(logCRITICAL) << "FTD2XX error occured: " << GetErrorMsg(ftdiStatus);
+				throw UsbConnectionError("Error reading from USB");
+			}
+			bytesRead += received;
+			if (received < remaining)
+			{
+				LOG(logCRITICAL) << "Requested to read " << remaining
+						 << "b, but read " << received
+						 << "b - " << (remaining-received) << "b missing!";
 				throw UsbConnectionTimeout("Read from USB timed out.");
 			}
 		}
 
 		else
 		{
-			bytesRead = i;
-			throw UsbConnectionTimeout("Read from USB timed out.");
+			if (!FillBuffer(remaining)) throw UsbConnectionError("Error reading from USB");
+
+			n = std::min(static_cast<uint32_t>(m_sizeR), remaining);
+			memcpy(dest + bytesRead, m_bufferR, n);
+			m_posR = n;
+			bytesRead += n;
+			// timeout (bytesRead < bytesToRead)
+			if (n < remaining) throw UsbConnectionTimeout("Read from USB timed out.");
 		}
 	}
-
-	bytesRead = bytesToRead;
 }
 
 
@@ -357,6 +377,47 @@ void CUSB::SetTimeout(unsigned int timeout)
   FT_SetTimeouts(ftHandle,m_timeout,m_timeout);
 }
 
+uint32_t CUSB::TransferSize()
+{
+  // FTDI transfer sizes must be a multiple of 64 bytes:
+  uint32_t size = std::max(static_cast<uint32_t>(USBMINTRANSFERSIZE), std::min(m_bufferSizeR, static_cast<uint32_t>(USBMAXTRANSFERSIZE)));
+  return size - size%64;
+}
+
+void CUSB::SetBufferSize(uint32_t writeSize, uint32_t readSize)
+{
+  if (writeSize == 0 || readSize == 0) throw UsbConnectionError("USB buffer size must not be zero.");
+
+  // send whatever is still waiting in the write buffer:
+  if (m_posW > 0 && isUSB_open) Flush();
+  m_posW = 0;
+  if (writeSize != m_bufferSizeW) {
+    delete[] m_bufferW;
+    m_bufferSizeW = writeSize;
+    m_bufferW = new unsigned char[m_bufferSizeW];
+  }
+
+  // keep data which has been received but not read yet:
+  uint32_t unread = m_sizeR - m_posR;
+  if (readSize < unread) readSize = unread;
+  if (readSize != m_bufferSizeR) {
+    unsigned char *buffer = new unsigned char[readSize];
+    memcpy(buffer, m_bufferR + m_posR, unread);
+    delete[] m_bufferR;
+    m_bufferR = buffer;
+    m_bufferSizeR = readSize;
+    m_posR = 0;
+    m_sizeR = unread;
+  }
+
+  LOG(logDEBUGRPC) << "USB buffer sizes set to " << m_bufferSizeW << "b (write), "
+		   << m_bufferSizeR << "b (read), transfer size " << TransferSize() << "b";
+
+  if (!isUSB_open) return;
+  ftdiStatus = FT_SetUSBParameters(ftHandle, TransferSize(), TransferSize());
+  if (ftdiStatus != FT_OK) throw UsbConnectionError("Error setting USB transfer size parameters.");
+}
+
 void CUSB::Read_String(char *s, uint16_t maxlength)
 {
 	char ch = 0;
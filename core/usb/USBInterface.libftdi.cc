@@ -6,6 +6,9 @@
 #include <iostream>
 #include <unistd.h>
 #include <time.h> // needed for usleep function
+#include <sys/time.h>
+#include <errno.h>
+#include <algorithm>
 
 #include "log.h"
 #include "exceptions.h"
@@ -14,21 +17,36 @@
 
 // needed for threaded readout of FTDI
 #include <pthread.h> 
-#include <semaphore.h>
 
-static struct ftdi_context ftdic;
-
-// the read buffer needs to be accessable outside of our USB class
+// the read buffer is filled by a reader thread per device
 #define BUFSIZE 0x200000
-static pthread_t readerthread;
-static sem_t buf_data, buf_space;
-static unsigned char read_buffer[BUFSIZE];
-static int32_t head, tail; // read buffer is used as ring buffer
 
-// cleanup is threaded to include a timeout on the calls to the device that sometimes hang
-pthread_mutex_t cleanup_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_t usbclose_thread, usbdeinit_thread;
-volatile bool usbclose_done, usbdeinit_done;
+struct ftdiState {
+  struct ftdi_context ftdic;
+  pthread_t readerthread;
+  pthread_mutex_t buf_mutex;
+  pthread_cond_t buf_data;
+  unsigned char read_buffer[BUFSIZE];
+  int32_t head, tail; // read buffer is used as ring buffer, protected by buf_mutex
+  int32_t read_chunksize; // bytes requested per ftdi_read_data() call, protected by buf_mutex
+  pxar::logContext *logctx; // log context of the thread which opened the device, used by the reader
+
+  // cleanup is threaded to include a timeout on the calls to the device that sometimes hang
+  pthread_mutex_t cleanup_mutex;
+  pthread_t usbclose_thread, usbdeinit_thread;
+  volatile bool usbclose_done, usbdeinit_done;
+
+  ftdiState() : head(0), tail(0), read_chunksize(USBMINTRANSFERSIZE), logctx(NULL), usbclose_done(false), usbdeinit_done(false) {
+    pthread_mutex_init(&buf_mutex, NULL);
+    pthread_cond_init(&buf_data, NULL);
+    pthread_mutex_init(&cleanup_mutex, NULL);
+  }
+  ~ftdiState() {
+    pthread_mutex_destroy(&cleanup_mutex);
+    pthread_cond_destroy(&buf_data);
+    pthread_mutex_destroy(&buf_mutex);
+  }
+};
 
 const int32_t productID_FT232H = 0x6014; // new testboard FTDI chip product id (FT232H)
 const int32_t productID_OLD = 0x6001; //  single channel devices (R Chips) used in older test boards
@@ -37,44 +55,57 @@ const int32_t vendorID = 0x0403; // Future Technology Devices International, Ltd
 using namespace std;
 using namespace pxar;
 
-static void add_to_buf (unsigned char c) {
-    int32_t nh;
-
-    sem_wait (&buf_space);
-    if (head == (BUFSIZE -1)) nh = 0;
-    else                      nh = head + 1;
+static int32_t buf_used (ftdiState *state) {
+    return (state->head >= state->tail) ? (state->head - state->tail) : (state->head + BUFSIZE - state->tail);
+}
 
-    if (nh == tail) {
-        fprintf (stderr, "USBInterface (libftdi) FATAL: overflow of circular buffer in threaded read routine. Sorry -- will exit now.\n");
-        exit (1);
+static void add_to_buf (ftdiState *state, const unsigned char *data, int32_t n) {
+    while (n > 0) {
+        pthread_mutex_lock (&state->buf_mutex);
+        // one byte is kept free to tell a full buffer from an empty one:
+        int32_t count = std::min(n, BUFSIZE - 1 - buf_used(state));
+        int32_t added = 0;
+        while (added < count) {
+            int32_t segment = std::min(count - added, BUFSIZE - state->head);
+            memcpy (state->read_buffer + state->head, data + added, segment);
+            state->head = (state->head + segment) % BUFSIZE;
+            added += segment;
+        }
+        if (added > 0) pthread_cond_broadcast (&state->buf_data);
+        pthread_mutex_unlock (&state->buf_mutex);
+
+        data += added;
+        n -= added;
+        // buffer full: wait for the reading side without holding the lock
+        if (n > 0) {
+            usleep(100);
+            pthread_testcancel();
+        }
     }
-    read_buffer[head] = c;
-    head = nh;
-    sem_post (&buf_data);
 }
 
 static void *reader (void *arg) {
   // there is no non-blocking read command implemented in libftdi ->
   // therefore we use multithreading and a static buffer to emulate
   // non-blocking calls
-    struct ftdi_context *handle = reinterpret_cast<struct ftdi_context *>(arg);
-    unsigned char buf[0x1000];
-    int32_t br, i;
+    ftdiState *state = reinterpret_cast<ftdiState *>(arg);
+    logContextGuard log(state->logctx);
+    unsigned char buf[USBMAXTRANSFERSIZE];
+    int32_t br, chunksize;
 
     while (1) {
       usleep(100); // wait 0.1 ms
       pthread_testcancel();
-      br = ftdi_read_data (handle, buf, sizeof(buf));
+      pthread_mutex_lock (&state->buf_mutex);
+      chunksize = state->read_chunksize;
+      pthread_mutex_unlock (&state->buf_mutex);
+      br = ftdi_read_data (&state->ftdic, buf, chunksize);
       pthread_testcancel();
       if (br< 0){
 	LOG(logCRITICAL)<< "ERROR during USB read polling: error code from libusb_bulk_transfer(): " << br;
 	throw UsbConnectionError("ERROR during USB read polling");
       }
-      if (br > 0){
-	for (i=0; i<br; i++){
-	  add_to_buf (buf[i]);
-	}
-      }
+      if (br > 0) add_to_buf (state, buf, br);
     }
     return NULL;
 }
@@ -82,22 +113,22 @@ static void *reader (void *arg) {
 static void *usbclose (void *arg) {
   // on some circumstances, the ftdi_usb_close() call hangs;
   // this is a workaround to implement a timeout
-    struct ftdi_context *handle = reinterpret_cast<struct ftdi_context *>(arg);
-    ftdi_usb_close(handle);
-    pthread_mutex_lock(&cleanup_mutex); usbclose_done = true; pthread_mutex_unlock(&cleanup_mutex);
+    ftdiState *state = reinterpret_cast<ftdiState *>(arg);
+    ftdi_usb_close(&state->ftdic);
+    pthread_mutex_lock(&state->cleanup_mutex); state->usbclose_done = true; pthread_mutex_unlock(&state->cleanup_mutex);
     return NULL;
 }
 
 static void *usbdeinit (void *arg) {
   // on some circumstances, the ftdi_deinit() call hangs;
   // this is a workaround to implement a timeout
-    struct ftdi_context *handle = reinterpret_cast<struct ftdi_context *>(arg);
-    ftdi_deinit(handle);
-    pthread_mutex_lock(&cleanup_mutex); usbdeinit_done = true; pthread_mutex_unlock(&cleanup_mutex);
+    ftdiState *state = reinterpret_cast<ftdiState *>(arg);
+    ftdi_deinit(&state->ftdic);
+    pthread_mutex_lock(&state->cleanup_mutex); state->usbdeinit_done = true; pthread_mutex_unlock(&state->cleanup_mutex);
     return NULL;
 }
 
-uint32_t FindAllUSB(struct ftdi_device_list ** devlist){
+static uint32_t FindAllUSB(struct ftdi_context *ftdic, struct ftdi_device_list ** devlist){
   int status;
   uint32_t nDevices = 0;
   struct ftdi_device_list *  	devlist_atb;
@@ -107,7 +138,7 @@ uint32_t FindAllUSB(struct ftdi_device_list ** devlist){
   // This first checks explicitly for DTB boards, then for ATB ones and merges the device lists
 
   // DTB
-  status =  ftdi_usb_find_all(&ftdic, devlist,vendorID,productID_FT232H);
+  status =  ftdi_usb_find_all(ftdic, devlist,vendorID,productID_FT232H);
   if( status < 0) {
     return status;
   }
@@ -116,7 +147,7 @@ uint32_t FindAllUSB(struct ftdi_device_list ** devlist){
   }
 
   // ATB
-  status =  ftdi_usb_find_all(&ftdic, &devlist_atb,vendorID,productID_OLD);
+  status =  ftdi_usb_find_all(ftdic, &devlist_atb,vendorID,productID_OLD);
   if( status < 0) {
     return status;
   }
@@ -135,37 +166,51 @@ uint32_t FindAllUSB(struct ftdi_device_list ** devlist){
 
 CUSB::CUSB(){
       m_posR = m_sizeR = m_posW = 0;
+      // reads are buffered by the reader thread, m_bufferSizeR only sets the USB transfer size
+      m_bufferSizeW = USBWRITEBUFFERSIZE;
+      m_bufferSizeR = USBREADBUFFERSIZE;
+      m_bufferW = new unsigned char[m_bufferSizeW];
+      m_bufferR = NULL;
       m_timeout = 150000; // maximum time to wait for read call in ms
       isUSB_open = false;
       ftdiStatus = 0;
       enumPos = enumCount = 0;
-      ftdiStatus = ftdi_init(&ftdic);
+      m_ftdi = new ftdiState();
+      ftdiStatus = ftdi_init(&m_ftdi->ftdic);
       if ( ftdiStatus < 0)
 	{
 	  LOG(logCRITICAL) <<  "USBInterface constructor: ftdi_init failed";
+	  delete m_ftdi;
+	  delete[] m_bufferW;
 	  throw UsbConnectionError("USBInterface constructor: ftdi_init failed");
 	}
 }
 
 CUSB::~CUSB(){ 
   if (isUSB_open) Close(); 
-  pthread_mutex_lock(&cleanup_mutex); usbdeinit_done = false; pthread_mutex_unlock(&cleanup_mutex);
+  pthread_mutex_lock(&m_ftdi->cleanup_mutex); m_ftdi->usbdeinit_done = false; pthread_mutex_unlock(&m_ftdi->cleanup_mutex);
   // create cleanup thread to allow timeout freeing the USB handle (might hang sometimes)
-  pthread_create (&usbdeinit_thread, NULL, usbdeinit, &ftdic);
+  pthread_create (&m_ftdi->usbdeinit_thread, NULL, usbdeinit, m_ftdi);
   bool done = false;
   for (int time = 0; time<1000;time++){
     usleep(1000); // wait 1ms
     // check status and break if usbdevice is closed
-    pthread_mutex_lock(&cleanup_mutex); 
-    if (usbdeinit_done) {
+    pthread_mutex_lock(&m_ftdi->cleanup_mutex); 
+    if (m_ftdi->usbdeinit_done) {
       done = true;    }
-    pthread_mutex_unlock(&cleanup_mutex);
+    pthread_mutex_unlock(&m_ftdi->cleanup_mutex);
     if (done) break;  }
+  // a hanging cleanup thread still uses the state, it is not freed then
+  if (done) {
+    pthread_join(m_ftdi->usbdeinit_thread, NULL);
+    delete m_ftdi;
+  }
+  delete[] m_bufferW;
 }
 
 const char* CUSB::GetErrorMsg()
 {
-  return ftdi_get_error_string(&ftdic);
+  return ftdi_get_error_string(&m_ftdi->ftdic);
 }
 
 
@@ -173,7 +218,7 @@ bool CUSB::EnumFirst(uint32_t &nDevices)
 {
   struct ftdi_device_list *  	devlist;
 
-  ftdiStatus = FindAllUSB(&devlist);
+  ftdiStatus = FindAllUSB(&m_ftdi->ftdic, &devlist);
   if( ftdiStatus <= 0) {
     nDevices = enumCount = enumPos = 0;
     return false;
@@ -193,7 +238,7 @@ bool CUSB::EnumNext(char name[])
     return false;
   }
   struct ftdi_device_list *  	devlist;
-  ftdiStatus =  FindAllUSB(&devlist);
+  ftdiStatus =  FindAllUSB(&m_ftdi->ftdic, &devlist);
   if( ftdiStatus <= 0) {
     enumCount = enumPos = 0;
     return false;
@@ -206,7 +251,7 @@ bool CUSB::EnumNext(char name[])
   
   char manufacturer[128], description[128], serial[128];
 
-  if ((ftdiStatus = ftdi_usb_get_strings(&ftdic,devlist->dev, manufacturer, 128, description, 128, serial, 128)) < 0)
+  if ((ftdiStatus = ftdi_usb_get_strings(&m_ftdi->ftdic,devlist->dev, manufacturer, 128, description, 128, serial, 128)) < 0)
     {
       LOG(logCRITICAL) << " USBInterface::EnumNext(): Error polling USB device number " << enumPos;
       throw UsbConnectionError(" USBInterface::EnumNext(): Error polling USB device");
@@ -227,7 +272,7 @@ bool CUSB::Enum(char name[], uint32_t pos)
   }
 
   struct ftdi_device_list *  	devlist;
-  ftdiStatus =  FindAllUSB(&devlist);
+  ftdiStatus =  FindAllUSB(&m_ftdi->ftdic, &devlist);
   if( ftdiStatus <= 0) {
     enumCount = enumPos = 0;
     return false;
@@ -239,7 +284,7 @@ bool CUSB::Enum(char name[], uint32_t pos)
   for (uint32_t i=0; i<pos; i++) devlist = devlist->next;
   
   char manufacturer[128], description[128], serial[128];
-  if ((ftdiStatus = ftdi_usb_get_strings(&ftdic,devlist->dev, manufacturer, 128, description, 128, serial, 128)) < 0)
+  if ((ftdiStatus = ftdi_usb_get_strings(&m_ftdi->ftdic,devlist->dev, manufacturer, 128, description, 128, serial, 128)) < 0)
     {
       LOG(logCRITICAL) << " USBInterface::EnumNext(): Error polling USB device number " << pos;
       throw UsbConnectionError(" USBInterface::EnumNext(): Error polling USB device");
@@ -267,7 +312,7 @@ bool CUSB::Open(char serialNumber[])
 
   // open list of usb devices with the expected vendor and product ids
   struct ftdi_device_list *  	devlist;
-  ftdiStatus =  FindAllUSB(&devlist);
+  ftdiStatus =  FindAllUSB(&m_ftdi->ftdic, &devlist);
   
   if( ftdiStatus <= 0) {
     LOG(logCRITICAL) << " USBInterface::Open(): Error searching attached USB devices! ftdiStatus: " << ftdiStatus;
@@ -280,7 +325,7 @@ bool CUSB::Open(char serialNumber[])
   for (int32_t i=0; i<ndevices; i++) {
     char manufacturer[128], description[128], serial[128];
     if ((ftdiStatus = 
-	 ftdi_usb_get_strings(&ftdic,devlist->dev, manufacturer, 
+	 ftdi_usb_get_strings(&m_ftdi->ftdic,devlist->dev, manufacturer, 
 			      128, description, 128, serial, 128)) < 0){
       LOG(logINTERFACE) << " USBInterface::Open(): Error polling USB device number " << i;
       devlist = devlist->next;
@@ -295,7 +340,7 @@ bool CUSB::Open(char serialNumber[])
       // found the device
       LOG(logINTERFACE) << " USBInterface::Open(): found device with serial " << serial;
       // now open it
-      ftdiStatus = ftdi_usb_open_dev(&ftdic, devlist->dev);
+      ftdiStatus = ftdi_usb_open_dev(&m_ftdi->ftdic, devlist->dev);
       if( ftdiStatus < 0) {
 	/* maybe the ftdi_sio and usbserial kernel modules are attached to the device */
 	/* try to detach them using the libusb library directly */
@@ -320,7 +365,7 @@ bool CUSB::Open(char serialNumber[])
 	libusb_close(handle);
 
 	// now open it again
-	ftdiStatus = ftdi_usb_open_dev(&ftdic, devlist->dev);
+	ftdiStatus = ftdi_usb_open_dev(&m_ftdi->ftdic, devlist->dev);
 	if( ftdiStatus < 0) {
 	  LOG(logCRITICAL) << "FTDI returned status code " << ftdiStatus << " after attempt to detach kernel drivers ";
 	  ftdi_list_free(&devlist);
@@ -354,22 +399,25 @@ bool CUSB::Open(char serialNumber[])
 //     ftdi	pointer to ftdi_context
 //     bitmask	Bitmask to configure lines. HIGH/ON value configures a line as output.
 //     mode	Bitbang mode: use the values defined in ftdi_mpsse_mode
-  ftdiStatus = ftdi_set_bitmode(&ftdic, 0xFF, BITMODE_SYNCFF); //BITMODE_SYNCFF = 0x40, BITMODE_SYNCBB = 0x04
+  ftdiStatus = ftdi_set_bitmode(&m_ftdi->ftdic, 0xFF, BITMODE_SYNCFF); //BITMODE_SYNCFF = 0x40, BITMODE_SYNCBB = 0x04
   if (ftdiStatus < 0) UsbConnectionError("Error setting FTDI synchronous bit-bang mode.");
   // set the baud rate
-  ftdiStatus = ftdi_set_baudrate(&ftdic, 9600);
+  ftdiStatus = ftdi_set_baudrate(&m_ftdi->ftdic, 9600);
   if (ftdiStatus < 0) UsbConnectionError("Error setting FTDI baud rate.");
   // set usb transfer size parameters (see: http://www.ftdichip.com/Support/Knowledgebase/ft_setusbparameters.htm)
-  ftdiStatus = ftdi_read_data_set_chunksize(&ftdic, 4096); // default: 4096, must be multiple of 64
+  ftdiStatus = ftdi_read_data_set_chunksize(&m_ftdi->ftdic, TransferSize()); // default: 4096, must be multiple of 64
   if (ftdiStatus < 0) UsbConnectionError("Error setting USB read size parameters.");
-  ftdiStatus = ftdi_write_data_set_chunksize(&ftdic, 4096); // default: 4096, must be multiple of 64
+  ftdiStatus = ftdi_write_data_set_chunksize(&m_ftdi->ftdic, TransferSize()); // default: 4096, must be multiple of 64
   if (ftdiStatus < 0) UsbConnectionError("Error setting USB write size parameters.");
 
 
   // init threads for client-side data buffering
-  sem_init (&buf_data, 0, 0);
-  sem_init (&buf_space, 0, BUFSIZE);
-  pthread_create (&readerthread, NULL, reader, &ftdic);
+  pthread_mutex_lock(&m_ftdi->buf_mutex);
+  m_ftdi->head = m_ftdi->tail = 0;
+  m_ftdi->read_chunksize = TransferSize();
+  pthread_mutex_unlock(&m_ftdi->buf_mutex);
+  m_ftdi->logctx = SetLogOutput::Context();
+  pthread_create (&m_ftdi->readerthread, NULL, reader, m_ftdi);
 
   return true;
 }
@@ -377,28 +425,28 @@ bool CUSB::Open(char serialNumber[])
 
 void CUSB::Close(){
   if( !isUSB_open) return;
-  pthread_cancel(readerthread);
+  pthread_cancel(m_ftdi->readerthread);
   usleep(10000);
-  // join reader thread and clean up semaphores
-  pthread_join(readerthread, NULL);
-  sem_destroy (&buf_data);
-  sem_destroy (&buf_space);
+  // join reader thread
+  pthread_join(m_ftdi->readerthread, NULL);
   usleep(10000);
   // set the flag (lock mutex first)
-  pthread_mutex_lock(&cleanup_mutex); usbclose_done = false; pthread_mutex_unlock(&cleanup_mutex);
+  pthread_mutex_lock(&m_ftdi->cleanup_mutex); m_ftdi->usbclose_done = false; pthread_mutex_unlock(&m_ftdi->cleanup_mutex);
   // create cleanup thread to allow timeout on call to device (might hang)
-  pthread_create (&usbclose_thread, NULL, usbclose, &ftdic);
+  pthread_create (&m_ftdi->usbclose_thread, NULL, usbclose, m_ftdi);
   bool done = false;
   for (int time = 0; time<1000;time++){
     usleep(1000); // wait 1ms
     // check status and break if usbdevice is closed
-    pthread_mutex_lock(&cleanup_mutex);  // lock mutex
-    if (usbclose_done) {
+    pthread_mutex_lock(&m_ftdi->cleanup_mutex);  // lock mutex
+    if (m_ftdi->usbclose_done) {
       //successfully closed usb connection
       done = true; }
-    pthread_mutex_unlock(&cleanup_mutex); // unlock mutex
+    pthread_mutex_unlock(&m_ftdi->cleanup_mutex); // unlock mutex
     if (done) break;}
   //WARNING: closing the USB connection timed out!
+  if (done) pthread_join(m_ftdi->usbclose_thread, NULL);
+  else pthread_detach(m_ftdi->usbclose_thread);
   isUSB_open = 0;
 }
 
@@ -411,10 +459,14 @@ void CUSB::WriteCommand(unsigned char x){
 void CUSB::Write(uint32_t bytesToWrite, const void *buffer)
 { 
   if (!isUSB_open) throw UsbConnectionError("Attempt to write to USB without open connection.");
-  uint32_t k=0;
-  for( k=0; k < bytesToWrite; k++ ) {
-    if( m_posW >= USBWRITEBUFFERSIZE) {Flush();}
-    m_bufferW[m_posW++] = (reinterpret_cast<unsigned char*>(const_cast<void*>(buffer)))[k];
+  const unsigned char *src = reinterpret_cast<const unsigned char*>(buffer);
+  while( bytesToWrite ) {
+    if( m_posW >= m_bufferSizeW) {Flush();}
+    uint32_t n = std::min(bytesToWrite, m_bufferSizeW - m_posW);
+    memcpy(m_bufferW + m_posW, src, n);
+    m_posW += n;
+    src += n;
+    bytesToWrite -= n;
   }
   return;
 }
@@ -429,7 +481,7 @@ void CUSB::Flush()
 
   if( !bytesToWrite) return;
 
-  ftdiStatus = ftdi_write_data(&ftdic, m_bufferW, bytesToWrite);
+  ftdiStatus = ftdi_write_data(&m_ftdi->ftdic, m_bufferW, bytesToWrite);
 
   if( ftdiStatus < 0)  throw UsbConnectionError("USB write failed");
   if( ftdiStatus != bytesToWrite) { 
@@ -449,45 +501,44 @@ void CUSB::Read(uint32_t bytesToRead, void *buffer, uint32_t &bytesRead)
 {
   if (!isUSB_open) throw UsbConnectionError("Attempt to read from USB without open connection.");
  
-   // Copy over data from the circular buffer
-    uint32_t timewasted = 0; // time in ms wasted in this routine
-
-    uint32_t bytesReadSoFar = 0;
-      for (uint32_t i=0; i<bytesToRead; i++) {
-	bool bufferready = true;
-	if (tail == head) bufferready = false;
-	if (!bufferready){
-	  while (!bufferready && timewasted<m_timeout){
-	    if (timewasted==(m_timeout/10)) {
-	      LOG(logWARNING) << "USBInterface: Read(): data not ready (got " << bytesReadSoFar << "b of "<< bytesToRead <<"b) after " << timewasted << "ms yet! Will wait for up to " << m_timeout << "ms";
-	    }
-	    usleep(1000); //wait 1 ms
-	    timewasted++;
-	    if (tail != head) bufferready = true;	    
-	  }
-	}
-	if (bufferready){
-	  sem_wait (&buf_data);	
-	  (reinterpret_cast<unsigned char*>(const_cast<void*>(buffer)))[i] = read_buffer[tail];
-	  if (tail == (BUFSIZE -1)) tail = 0;
-	  else                      tail++;
-	  sem_post (&buf_space);
-	  bytesReadSoFar++;
-	} 
-	else // buffer was not ready and reading it timed out so we stop attempting it now
-	  {
-	    bytesRead = i;
-	    LOG(logCRITICAL) << " Timeout reading from USB buffer after " << m_timeout << " ms ";
-	    if (bytesRead < bytesToRead) {
-	      LOG(logCRITICAL) << "Requested to read " << bytesToRead 
-			       << "b, actually read  " << bytesRead 
-			       << "b - " << (bytesToRead-bytesRead) << "b missing!";
-	    }
-	    throw UsbConnectionTimeout("Timeout reading from USB");
-	    break;
-	  }
+  // Copy over data from the circular buffer in as few blocks as possible
+  unsigned char *dest = reinterpret_cast<unsigned char*>(buffer);
+  uint32_t timewasted = 0; // time in ms wasted in this routine
+  uint32_t bytesReadSoFar = 0;
+
+  ftdiState *state = m_ftdi;
+  pthread_mutex_lock(&state->buf_mutex);
+  while (bytesReadSoFar < bytesToRead) {
+    if (state->tail == state->head) {
+      if (timewasted >= m_timeout) break;
+      if (timewasted == (m_timeout/10)) {
+	LOG(logWARNING) << "USBInterface: Read(): data not ready (got " << bytesReadSoFar << "b of "<< bytesToRead <<"b) after " << timewasted << "ms yet! Will wait for up to " << m_timeout << "ms";
       }
-      bytesRead = bytesReadSoFar;
+      // wait up to 1 ms for the reader thread to deliver more data
+      struct timeval now;
+      gettimeofday(&now, NULL);
+      struct timespec until;
+      until.tv_sec = now.tv_sec + (now.tv_usec + 1000)/1000000;
+      until.tv_nsec = ((now.tv_usec + 1000)%1000000)*1000;
+      if (pthread_cond_timedwait(&state->buf_data, &state->buf_mutex, &until) == ETIMEDOUT) timewasted++;
+      continue;
+    }
+    uint32_t segment = std::min(static_cast<uint32_t>(state->head > state->tail ? state->head - state->tail : BUFSIZE - state->tail), bytesToRead - bytesReadSoFar);
+    memcpy(dest + bytesReadSoFar, state->read_buffer + state->tail, segment);
+    state->tail = (state->tail + segment) % BUFSIZE;
+    bytesReadSoFar += segment;
+  }
+  pthread_mutex_unlock(&state->buf_mutex);
+
+  bytesRead = bytesReadSoFar;
+  if (bytesRead < bytesToRead) {
+    // buffer was not ready and reading it timed out so we stop attempting it now
+    LOG(logCRITICAL) << " Timeout reading from USB buffer after " << m_timeout << " ms ";
+    LOG(logCRITICAL) << "Requested to read " << bytesToRead 
+		     << "b, actually read  " << bytesRead 
+		     << "b - " << (bytesToRead-bytesRead) << "b missing!";
+    throw UsbConnectionTimeout("Timeout reading from USB");
+  }
 }
 
 //----------------------------------------------------------------------
@@ -495,14 +546,12 @@ void CUSB::Clear()
 {
   if( !isUSB_open) return;
 
-  ftdiStatus = ftdi_usb_purge_buffers(&ftdic);
+  ftdiStatus = ftdi_usb_purge_buffers(&m_ftdi->ftdic);
 
   // drain our buffer.
-  while (head != tail) {
-    unsigned char t;
-    uint32_t n;
-    Read(1, &t, n);
-  }
+  pthread_mutex_lock(&m_ftdi->buf_mutex);
+  m_ftdi->tail = m_ftdi->head;
+  pthread_mutex_unlock(&m_ftdi->buf_mutex);
 
   m_posR = m_sizeR = 0;
   m_posW = 0;
@@ -519,8 +568,12 @@ bool CUSB::Show()
   LOG(logINFO) << "  - max timeout for read calls set to " << m_timeout << "ms";
 
   unsigned char latency;
-  if (ftdi_get_latency_timer(&ftdic,&latency)==0){ LOG(logINFO) << "  - FTDI latency timer set to " << static_cast<int>(latency); }
-  LOG(logINFO) << "  - data waiting in local read buffer: " << !(tail == head);
+  if (ftdi_get_latency_timer(&m_ftdi->ftdic,&latency)==0){ LOG(logINFO) << "  - FTDI latency timer set to " << static_cast<int>(latency); }
+  pthread_mutex_lock(&m_ftdi->buf_mutex);
+  int32_t used = buf_used(m_ftdi);
+  pthread_mutex_unlock(&m_ftdi->buf_mutex);
+  LOG(logINFO) << "  - data waiting in local read buffer: " << used << "b";
+  LOG(logINFO) << "  - buffer sizes: " << m_bufferSizeW << "b (write), USB transfer size " << TransferSize() << "b";
  
   return true;
 }
@@ -530,6 +583,43 @@ void CUSB::SetTimeout(unsigned int timeout)
   m_timeout = timeout;
 }
 
+//----------------------------------------------------------------------
+uint32_t CUSB::TransferSize()
+{
+  // FTDI transfer sizes must be a multiple of 64 bytes:
+  uint32_t size = std::max(static_cast<uint32_t>(USBMINTRANSFERSIZE), std::min(m_bufferSizeR, static_cast<uint32_t>(USBMAXTRANSFERSIZE)));
+  return size - size%64;
+}
+
+void CUSB::SetBufferSize(uint32_t writeSize, uint32_t readSize)
+{
+  if (writeSize == 0 || readSize == 0) throw UsbConnectionError("USB buffer size must not be zero.");
+
+  // send whatever is still waiting in the write buffer:
+  if (m_posW > 0 && isUSB_open) Flush();
+  m_posW = 0;
+  if (writeSize != m_bufferSizeW) {
+    delete[] m_bufferW;
+    m_bufferSizeW = writeSize;
+    m_bufferW = new unsigned char[m_bufferSizeW];
+  }
+
+  // unread data stays in the ring buffer of the reader thread
+  m_bufferSizeR = readSize;
+  pthread_mutex_lock(&m_ftdi->buf_mutex);
+  m_ftdi->read_chunksize = TransferSize();
+  pthread_mutex_unlock(&m_ftdi->buf_mutex);
+
+  LOG(logDEBUGRPC) << "USB buffer sizes set to " << m_bufferSizeW << "b (write), "
+		   << m_bufferSizeR << "b (read), transfer size " << TransferSize() << "b";
+
+  // the libftdi read chunk is reallocated by ftdi_read_data_set_chunksize() and is
+  // in use by the reader thread, it is only changed when the device is opened
+  if (!isUSB_open) return;
+  ftdiStatus = ftdi_write_data_set_chunksize(&m_ftdi->ftdic, TransferSize());
+  if (ftdiStatus < 0) throw UsbConnectionError("Error setting USB write size parameters.");
+}
+
 //----------------------------------------------------------------------
 void CUSB::Read_String(char *s, uint16_t maxlength)
 {
@@ -150,6 +150,13 @@ namespace pxar {
     return true;
   }
 
+  /** Helper function to compare the enabled pixels of two ROC configurations,
+   *  compares the enable bitmaps of both ROCs in one go
+   */
+  bool inline comparePixelConfiguration(const rocConfig & rocA, const rocConfig & rocB) {
+    return (rocA.enabledPixelMap() == rocB.enabledPixelMap());
+  }
+
   /** Helper function to recover the ADC sign of analog data words
    */
   inline int16_t expandSign(uint16_t x) { return (x & 0x0800) ? static_cast<int16_t>(x) - 4096 : static_cast<int16_t>(x); }
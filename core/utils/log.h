@@ -29,6 +29,15 @@ typedef unsigned int uint32_t;
 #include <cstdio>
 #include <string.h>
 
+// Storage of the per-thread logging context:
+#if (defined __CINT__)
+#define PXAR_THREAD_LOCAL
+#elif (defined WIN32)
+#define PXAR_THREAD_LOCAL __declspec(thread)
+#else
+#define PXAR_THREAD_LOCAL __thread
+#endif
+
 
 namespace pxar {
 
@@ -46,6 +55,22 @@ namespace pxar {
     logINTERFACE
   };
 
+  /** Logging context of one pxarCore instance, for running several testboards
+   *  in one process. While a thread works for the instance it is the current
+   *  context of that thread: messages are prefixed with the name, go to the
+   *  stream (if set) instead of the process-wide SetLogOutput::Stream(), and
+   *  are filtered with the level (if set) instead of the process-wide
+   *  reporting level. An empty context changes nothing.
+   */
+  struct logContext {
+    logContext() : name(), ownLevel(false), level(logINFO), stream(NULL) {}
+    bool empty() const { return name.empty() && !ownLevel && !stream; }
+    std::string name;
+    bool ownLevel;
+    TLogLevel level;
+    FILE* stream;
+  };
+
   template <typename T>
     class pxarLog {
   public:
@@ -100,7 +125,7 @@ namespace pxar {
     char buffer[11];
     time_t t;
     time(&t);
-    tm r = * localtime(&t);
+    tm r;
     strftime(buffer, sizeof(buffer), "%X", localtime_r(&t, &r));
     struct timeval tv;
     gettimeofday(&tv, 0);
@@ -117,6 +142,10 @@ namespace pxar {
     if (logName().size() > 0) {
       os << "<" << logName() << "> ";
     }
+    logContext * context = T::Context();
+    if (context && !context->name.empty()) {
+      os << "<" << context->name << "> ";
+    }
     os << std::setw(8) << ToString(level) << ": ";
     
     // For debug levels we want also function name and line number printed:
@@ -137,6 +166,8 @@ namespace pxar {
   template <typename T>
     TLogLevel& pxarLog<T>::ReportingLevel() {
     static TLogLevel reportingLevel = logINFO;
+    logContext * context = T::Context();
+    if (context && context->ownLevel) return context->level;
     return reportingLevel;
   }
 
@@ -181,6 +212,28 @@ namespace pxar {
     static FILE*& Stream();
     static bool& Duplicate();
     static void Output(const std::string& msg);
+    /** Logging context of the calling thread, NULL if none */
+    static logContext*& Context();
+  };
+
+  inline logContext*& SetLogOutput::Context()
+  {
+    static PXAR_THREAD_LOCAL logContext* context = NULL;
+    return context;
+  }
+
+  /** Makes a logging context the current one of the calling thread for the
+   *  lifetime of the object. Empty contexts and NULL are ignored, so the
+   *  context set up by the caller stays in effect.
+   */
+  class logContextGuard {
+    logContext * previous;
+    bool active;
+  public:
+    logContextGuard(logContext * context) : previous(SetLogOutput::Context()), active(context && !context->empty()) {
+      if (active) SetLogOutput::Context() = context;
+    }
+    ~logContextGuard() { if (active) SetLogOutput::Context() = previous; }
   };
 
   inline bool& SetLogOutput::Duplicate()
@@ -192,6 +245,8 @@ namespace pxar {
   inline FILE*& SetLogOutput::Stream()
   {
     static FILE* pStream = stderr;
+    logContext * context = Context();
+    if (context && context->stream) return context->stream;
     return pStream;
   }
 
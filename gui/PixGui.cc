@@ -134,6 +134,8 @@ TGMainFrame(p, 1, 1, kVerticalFrame), fWidth(w), fHeight(h) {
 
   // Left: h/w monitoring 
   fMonitor = new PixMonitorFrame(h1v2l, this);
+  // the monitoring thread samples the testboard, the timer only displays its latest sample
+  fPixSetup->getPixMonitor()->startService(fConfigParameters->getMonitorInterval());
   fTimer = new TTimer(1000);
   fTimer->Connect("Timeout()", "PixMonitorFrame", fMonitor, "Update()");
   fTimer->TurnOn();
@@ -325,6 +327,7 @@ PixGui::~PixGui() {
 
 // ----------------------------------------------------------------------
 void PixGui::Cleanup() {
+  fPixSetup->getPixMonitor()->stopService();
   fPixSetup->getPixMonitor()->dumpSummaries();
   gApplication->Terminate(0);
 }
@@ -338,6 +341,7 @@ void PixGui::CloseWindow() {
   } 
   
   if (fTimer) fTimer->TurnOff();
+  fPixSetup->getPixMonitor()->stopService();
   if (fApi) delete fApi; 
   fPixSetup->getPixMonitor()->dumpSummaries();
 
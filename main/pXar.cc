@@ -25,6 +25,7 @@
 #include "PixUserTestFactory.hh"
 #include "PixGui.hh"
 #include "PixSetup.hh"
+#include "PixResultCache.hh"
 #include "PixUtil.hh"
 
 #include "api.h"
@@ -51,7 +52,9 @@ int main(int argc, char *argv[]){
     doRunSingleTest(false), 
     doUpdateFlash(false),
     doUpdateRootFile(false),
-    doUseRootLogon(false)
+    doUseRootLogon(false),
+    doForce(false),
+    doInvalidate(false)
     ;
   for (int i = 0; i < argc; i++){
     if (!strcmp(argv[i],"-h")) {
@@ -59,7 +62,9 @@ int main(int argc, char *argv[]){
       cout << "-a                    do not do tests, do not recreate rootfile, but read in existing rootfile" << endl;
       cout << "-c filename           read in commands from filename" << endl;
       cout << "-d [--dir] path       directory with config files" << endl;
+      cout << "-F [--force]          ignore cached test results (results are still recorded)" << endl;
       cout << "-g                    start with GUI" << endl;
+      cout << "-I [--invalidate]     clear all cached test results" << endl;
       cout << "-p \"p1=v1[;p2=v2]\"  set parameters for test" << endl;
       cout << "-r rootfilename       set rootfile (and logfile) name" << endl;
       cout << "-t test               run test" << endl;
@@ -71,7 +76,9 @@ int main(int argc, char *argv[]){
     if (!strcmp(argv[i],"-c"))                                {cmdFile    = string(argv[++i]); doRunScript = true;} 
     if (!strcmp(argv[i],"-d") || !strcmp(argv[i], "--dir"))   {dir  = string(argv[++i]); }               
     if (!strcmp(argv[i],"-f"))                                {doUpdateFlash = true; flashFile = string(argv[++i]);} 
+    if (!strcmp(argv[i],"-F") || !strcmp(argv[i], "--force")) {doForce = true; } 
     if (!strcmp(argv[i],"-g"))                                {doRunGui   = true; } 
+    if (!strcmp(argv[i],"-I") || !strcmp(argv[i], "--invalidate")) {doInvalidate = true; } 
     if (!strcmp(argv[i],"-p"))                                {testParameters  = string(argv[++i]); }               
     if (!strcmp(argv[i],"-r"))                                {rootfile  = string(argv[++i]); }               
     if (!strcmp(argv[i],"-t"))                                {doRunSingleTest = true; runtest  = string(argv[++i]); }
@@ -217,6 +224,8 @@ int main(int argc, char *argv[]){
   PixSetup a(api, ptp, configParameters);  
   a.setUseRootLogon(doUseRootLogon); 
   a.setRootFileUpdate(doUpdateRootFile);
+  a.getResultCache()->setForce(doForce);
+  if (doInvalidate) a.getResultCache()->invalidate();
 
   if (doRunGui) {
     runGui(a, argc, argv); 
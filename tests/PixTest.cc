@@ -14,6 +14,9 @@
 
 #include "PixTest.hh"
 #include "PixUtil.hh"
+#include "PixResultCache.hh"
+#include "ScurveFitter.hh"
+#include "HitAccumulator.hh"
 #include "timer.h"
 #include "log.h"
 #include "helper.h"
@@ -1619,6 +1622,11 @@ void PixTest::scurveAna(string dac, string name, vector<shist256*> maps, vector<
   int roc(0), ic(0), ir(0); 
   TH1D *h1 = new TH1D("h1", "h1", 256, 0., 256.); h1->Sumw2(); 
 
+  // -- fit all s-curves at once, in parallel
+  ScurveFitter fitter(fNtrig);
+  vector<ScurveFitter::result> fits; 
+  fitter.fit(maps, fits); 
+
   for (unsigned int iroc = 0; iroc < rocIds.size(); ++iroc) {
     LOG(logDEBUG) << "analyzing ROC " << static_cast<int>(rocIds[iroc]);
     h2 = bookTH2D(Form("thr_%s_%s_C%d", name.c_str(), dac.c_str(), rocIds[iroc]), 
@@ -1648,20 +1656,40 @@ void PixTest::scurveAna(string dac, string name, vector<shist256*> maps, vector<
 
     for (unsigned int i = iroc*4160; i < (iroc+1)*4160; ++i) {
       PixUtil::idx2rcr(i, roc, ic, ir);
-      if (maps[i]->getSumOfWeights() < 1) {
+      if (fits[i].empty) {
 	if (dumpFile) OutputFile << empty << endl;
 	continue;
       }
+      fThreshold  = fits[i].threshold; 
+      fThresholdE = fits[i].thresholdE; 
+      fSigma      = fits[i].sigma; 
+      fSigmaE     = fits[i].sigmaE; 
+      fThresholdN = fits[i].thresholdN; 
+      bool ok = fits[i].ok; 
+
       // -- calculated "proper" errors
-      h1->Reset();
-      for (int ib = 1; ib <= 256; ++ib) {
-	h1->SetBinContent(ib, maps[i]->get(ib));
-	h1->SetBinError(ib, fNtrig*PixUtil::dBinomial(static_cast<int>(maps[i]->get(ib)), fNtrig)); 
+      if (dumpFile || (result & 0x30)) {
+	h1->Reset();
+	for (int ib = 1; ib <= 256; ++ib) {
+	  h1->SetBinContent(ib, maps[i]->get(ib));
+	  h1->SetBinError(ib, fNtrig*PixUtil::dBinomial(static_cast<int>(maps[i]->get(ib)), fNtrig)); 
+	}
       }
 
-      bool ok = threshold(h1); 
       if (((result & 0x10) && !ok) || (result & 0x20)) {
 	TH1D *h1c = (TH1D*)h1->Clone(Form("scurve_%s_c%d_r%d_C%d", dac.c_str(), ic, ir, rocIds[iroc])); 
+	// -- attach the ROOT fit for display and cross-check it against the native fit
+	threshold(h1c); 
+	if (TMath::Abs(fThreshold - fits[i].threshold) > 0.05 || TMath::Abs(fSigma - fits[i].sigma) > 0.05) {
+	  LOG(logDEBUG) << "scurve fit c" << ic << " r" << ir << " C" << static_cast<int>(rocIds[iroc]) 
+			<< ": ROOT thr = " << fThreshold << " sig = " << fSigma 
+			<< ", native thr = " << fits[i].threshold << " sig = " << fits[i].sigma;
+	}
+	fThreshold  = fits[i].threshold; 
+	fThresholdE = fits[i].thresholdE; 
+	fSigma      = fits[i].sigma; 
+	fSigmaE     = fits[i].sigmaE; 
+	fThresholdN = fits[i].thresholdN; 
 	if (!ok) {
 	  h1c->SetTitle(Form("problematic %s scurve (c%d_r%d_C%d), thr = %4.3f", dac.c_str(), ic, ir, rocIds[iroc], fThreshold));
 	} else {
@@ -1753,6 +1781,42 @@ void PixTest::saveDacs() {
   fPixSetup->writeDacParameterFiles();
 }
 
+// ----------------------------------------------------------------------
+bool PixTest::cachedResult() {
+  PixResultCache *rc = fPixSetup->getResultCache();
+  if (0 == rc) return false;
+  return rc->lookup(fName, PixResultCache::hashParameters(fParameters), fPixSetup->getConfigurationHash());
+}
+
+// ----------------------------------------------------------------------
+void PixTest::cacheResult(uint64_t stateBefore, vector<string> outputs) {
+  PixResultCache *rc = fPixSetup->getResultCache();
+  if (0 == rc) return;
+  rc->record(fName, PixResultCache::hashParameters(fParameters), stateBefore, fPixSetup->getConfigurationHash(), outputs);
+}
+
+// ----------------------------------------------------------------------
+vector<string> PixTest::rocFileNames(string basename) {
+  vector<string> names;
+  string suffix = fPixSetup->getConfigParameters()->getTrimVcalSufix();
+  vector<uint8_t> rocs = fApi->_dut->getEnabledRocIDs(); 
+  for (unsigned int iroc = 0; iroc < rocs.size(); ++iroc) {
+    names.push_back(Form("%s%s_C%d.dat", basename.c_str(), suffix.c_str(), static_cast<int>(rocs[iroc])));
+  }
+  return names;
+}
+
+// ----------------------------------------------------------------------
+vector<string> PixTest::tbmFileNames() {
+  vector<string> names;
+  string basename = fPixSetup->getConfigParameters()->getTbmParameterFileName();
+  for (unsigned int itbm = 0; itbm < fApi->_dut->getNTbms(); itbm += 2) {
+    names.push_back(Form("%s_C%da.dat", basename.c_str(), itbm));
+    names.push_back(Form("%s_C%db.dat", basename.c_str(), itbm));
+  }
+  return names;
+}
+
 // ----------------------------------------------------------------------
 void PixTest::saveTrimBits() {
   fPixSetup->writeTrimFiles();
@@ -1928,13 +1992,15 @@ void PixTest::dutCalibrateOff() {
 // ----------------------------------------------------------------------
 void PixTest::maskPixels() {
   if (0 == fPixSetup->getConfigParameters()->nMaskedPixels()) return;
-  vector<vector<pair<int, int> > > vmask =  fPixSetup->getConfigParameters()->getMaskedPixels();
+  ConfigParameters *cp = fPixSetup->getConfigParameters();
+  vector<vector<pair<int, int> > > vmask = cp->getMaskedPixels();
   for (unsigned int i = 0; i < vmask.size(); ++i) {
-    vector<pair<int, int> > mask = vmask[i]; 
+    const vector<pair<int, int> > &mask = vmask[i]; 
+    if (0 == mask.size()) continue;
     for (unsigned int ipix = 0; ipix < mask.size(); ++ipix) {
       LOG(logINFO) << "ROC " << getIdFromIdx(i) << " masking pixel " << mask[ipix].first << "/" << mask[ipix].second; 
-      fApi->_dut->maskPixel(mask[ipix].first, mask[ipix].second, true, getIdFromIdx(i)); 
     }
+    fApi->_dut->maskPixels(cp->getMaskedPixelMap(i), getIdFromIdx(i)); 
   }
 }
 
@@ -2274,6 +2340,7 @@ void PixTest::maskHotPixels(std::vector<TH2D*> v) {
   timer t;
   uint8_t perFull;
   bool daq_loop = true;
+  HitAccumulator acc(v.size()); 
     
   fApi->daqStart();
 
@@ -2292,7 +2359,7 @@ void PixTest::maskHotPixels(std::vector<TH2D*> v) {
       catch(pxar::DataNoEvent &) {}
       for(std::vector<pxar::Event>::iterator it = daqdat.begin(); it != daqdat.end(); ++it) {
 	for (unsigned int ipix = 0; ipix < it->pixels.size(); ++ipix) {
-	  v[getIdxFromId(it->pixels[ipix].roc())]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row());
+	  acc.fill(getIdxFromId(it->pixels[ipix].roc()), it->pixels[ipix].column(), it->pixels[ipix].row());
 	}
       }
 
@@ -2316,9 +2383,10 @@ void PixTest::maskHotPixels(std::vector<TH2D*> v) {
   catch(pxar::DataNoEvent &) {}
   for(std::vector<pxar::Event>::iterator it = daqdat.begin(); it != daqdat.end(); ++it) {
     for (unsigned int ipix = 0; ipix < it->pixels.size(); ++ipix) {
-      v[getIdxFromId(it->pixels[ipix].roc())]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row());
+      acc.fill(getIdxFromId(it->pixels[ipix].roc()), it->pixels[ipix].column(), it->pixels[ipix].row());
     }
   }
+  for (unsigned int i = 0; i < v.size(); ++i) acc.flush(i, v[i]); 
 
   finalCleanup();
 
@@ -94,6 +94,14 @@ public:
   void saveTbmParameters(); 
   /// save TB parameters to file
   void saveTbParameters(); 
+  /// true if the result cache has a valid result of this test for the current configuration and parameters
+  bool cachedResult();
+  /// record a completed run of this test in the result cache (stateBefore from PixSetup::getConfigurationHash())
+  void cacheResult(uint64_t stateBefore, std::vector<std::string> outputs);
+  /// names (relative to the config directory) of the per-ROC files basename<trimVcalSuffix>_C<iroc>.dat
+  std::vector<std::string> rocFileNames(std::string basename);
+  /// names (relative to the config directory) of the TBM parameter files
+  std::vector<std::string> tbmFileNames();
   /// create vector (per ROC) of vector of dead pixels
   std::vector<std::vector<std::pair<int, int> > > deadPixels(int ntrig, bool scanCalDel = false);
   /// mask all pixels mentioned in the mask file
@@ -22,6 +22,7 @@ PixTestDaq::PixTestDaq(PixSetup *a, std::string name) : PixTest(a, name), fParDe
   LOG(logDEBUG) << "PixTestDaq ctor(PixSetup &a, string, TGTab *)";
   
   fTree = 0; 
+  fPhCal.setLookupTable(true);
   fPhCal.setPHParameters(fPixSetup->getConfigParameters()->getGainPedestalParameters());
   fPhCalOK = fPhCal.initialized();
 }
@@ -231,6 +232,8 @@ void PixTestDaq::ProcessData(uint16_t numevents){
 			fTreeEvent.trailer = it->trailer;
 		}
 
+		vector<double> vq(it->pixels.size(), 0.);
+		if (fPhCalOK && vq.size() > 0) fPhCal.vcal(&it->pixels[0], vq.size(), &vq[0]);
 		for (unsigned int ipix = 0; ipix < it->pixels.size(); ++ipix) {
 			idx = getIdxFromId(it->pixels[ipix].roc());
 			if(idx == -1) {
@@ -241,13 +244,7 @@ void PixTestDaq::ProcessData(uint16_t numevents){
 			fPhmap[idx]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row(), it->pixels[ipix].value());
 			fPh[idx]->Fill(it->pixels[ipix].value());
 
-			if (fPhCalOK) {
-				q = static_cast<uint16_t>(fPhCal.vcal(it->pixels[ipix].roc(), it->pixels[ipix].column(),	
-								      it->pixels[ipix].row(), it->pixels[ipix].value()));
-			}
-			else {
-				q = 0;
-			}
+			q = static_cast<uint16_t>(vq[ipix]);
 			fQ[idx]->Fill(q);
 			fQmap[idx]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row(), q);
 				if (fParFillTree && ipix < 20000) {
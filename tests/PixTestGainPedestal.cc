@@ -12,6 +12,7 @@
 
 #include "PixTestGainPedestal.hh"
 #include "PHCalibration.hh"
+#include "GainPedestalFitter.hh"
 #include "PixUtil.hh"
 #include "log.h"
 
@@ -136,9 +137,16 @@ void PixTestGainPedestal::doTest() {
   PixTest::update(); 
   bigBanner(Form("PixTestGainPedestal::doTest() ntrig = %d", fParNtrig));
 
+  if (cachedResult()) {
+    LOG(logINFO) << "PixTestGainPedestal::doTest() skipped, gain/pedestal parameters unchanged since the last run";
+    return;
+  }
+  uint64_t stateBefore = fPixSetup->getConfigurationHash();
+
   measure();
   fit();
   saveGainPedestalParameters();
+  cacheResult(stateBefore, rocFileNames(fPixSetup->getConfigParameters()->getGainPedestalParameterFileName()));
 
   int seconds = t.RealTime(); 
   LOG(logINFO) << "PixTestGainPedestal::doTest() done, duration: " << seconds << " seconds";
@@ -156,9 +164,16 @@ void PixTestGainPedestal::fullTest() {
 
   //  fParDumpHists = 1; 
 
+  if (cachedResult()) {
+    LOG(logINFO) << "PixTestGainPedestal::fullTest() skipped, gain/pedestal parameters unchanged since the last run";
+    return;
+  }
+  uint64_t stateBefore = fPixSetup->getConfigurationHash();
+
   measure();
   fit();
   saveGainPedestalParameters();
+  cacheResult(stateBefore, rocFileNames(fPixSetup->getConfigParameters()->getGainPedestalParameterFileName()));
 
   int seconds = t.RealTime(); 
   LOG(logINFO) << "PixTestGainPedestal::doTest() done, duration: " << seconds << " seconds";
@@ -414,6 +429,29 @@ void PixTestGainPedestal::fit() {
   double nl(0.), ifunction(0.), ipol1(0.), x0(0.), y0(0.), x1(200.), y1(0.); 
   int iroc(0), ic(0), ir(0); 
 
+  // -- fit all pixels in parallel (one ROC at a time), unless the ROOT fits are shown or dumped
+  vector<GainPedestalFitter::result> fits; 
+  if (0 == fParShowFits && 0 == fParDumpHists) {
+    GainPedestalFitter fitter(mode); 
+    for (unsigned int i0 = 0; i0 < fHists.size(); i0 += 4160) {
+      vector<GainPedestalFitter::curve> curves; 
+      for (unsigned int i = i0; i < fHists.size() && i < i0 + 4160; ++i) {
+	// -- the points of h1 below: a high range point replaces a low range point in the same bin
+	map<int, double> bins; 
+	for (int ib = 0; ib < static_cast<int>(fLpoints.size()); ++ib) bins[fLpoints[ib]] = fHists[i]->get(ib+1);
+	for (int ib = 0; ib < static_cast<int>(fHpoints.size()); ++ib) bins[7*fHpoints[ib]] = fHists[i]->get(100+ib+1);
+	GainPedestalFitter::curve c; 
+	for (map<int, double>::iterator it = bins.begin(); it != bins.end(); ++it) {
+	  c.add(it->first + 0.5, it->second, fracErr*it->second); 
+	}
+	curves.push_back(c); 
+      }
+      vector<GainPedestalFitter::result> r; 
+      fitter.fit(curves, r); 
+      copy(r.begin(), r.end(), back_inserter(fits));
+    }
+  }
+
   for (unsigned int i = 0; i < fHists.size(); ++i) {
     h1->Reset();
     for (int ib = 0; ib < static_cast<int>(fLpoints.size()); ++ib) {
@@ -444,7 +482,12 @@ void PixTestGainPedestal::fit() {
 	h1->SetTitle(Form("gainPedestal_c%d_r%d_C%d", ic, ir, iroc)); 
 	h1->SetName(Form("gainPedestal_c%d_r%d_C%d", ic, ir, iroc)); 
       }
-      h1->Fit(f, "rq");
+      if (fits.size() > 0) {
+	f->SetParameters(fits[i].p); 
+	f->SetParErrors(fits[i].e); 
+      } else {
+	h1->Fit(f, "rq");
+      }
       if (fParDumpHists) {
 	ifunction = f->Integral(0., 200.);
 	y0 = f->Eval(x0);
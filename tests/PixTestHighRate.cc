@@ -10,6 +10,7 @@
 #include <TStyle.h>
 
 #include "PixUtil.hh"
+#include "HitAccumulator.hh"
 
 
 #include <TH2.h>
@@ -878,13 +879,15 @@ void PixTestHighRate::fillMap(vector<TH2D*> hist) {
   try { daqdat = fApi->daqGetEventBuffer(); }
   catch(pxar::DataNoEvent &) {}
 
+  HitAccumulator acc(hist.size());
   for(std::vector<pxar::Event>::iterator it = daqdat.begin(); it != daqdat.end(); ++it) {
     pixCnt += it->pixels.size();
 
     for (unsigned int ipix = 0; ipix < it->pixels.size(); ++ipix) {
-      hist[getIdxFromId(it->pixels[ipix].roc())]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row());
+      acc.fill(getIdxFromId(it->pixels[ipix].roc()), it->pixels[ipix].column(), it->pixels[ipix].row());
     }
   }
+  for (unsigned int i = 0; i < hist.size(); ++i) acc.flush(i, hist[i]);
   LOG(logDEBUG) << "Processing Data: " << daqdat.size() << " events with " << pixCnt << " pixels";
 }
 
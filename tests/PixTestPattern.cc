@@ -579,7 +579,7 @@ void PixTestPattern::doTest()
 
 	//set the input filename (for Pattern and Pixels)
 	string fname;
-	ConfigParameters* config = ConfigParameters::Singleton();
+	ConfigParameters* config = fPixSetup->getConfigParameters();
 	f_Directory = config->getDirectory();
 	fname = f_Directory + "/" + fInputFile + ".dat";
 
@@ -145,16 +145,26 @@ void PixTestPretest::doTest() {
   PixTest::update(); 
   bigBanner(Form("PixTestPretest::doTest()"));
 
+  uint64_t stateBefore = fPixSetup->getConfigurationHash();
+  bool cached = cachedResult();
+
   programROC();
   TH1 *h1 = (*fDisplayedHist); 
   h1->Draw(getHistOption(h1).c_str());
   PixTest::update(); 
 
   if (fProblem) {
+    if (cached) fPixSetup->getResultCache()->invalidate(fName);
     bigBanner("ERROR: some ROCs are not programmable; stop"); 
     return;
   }
 
+  // -- the configuration is the one a previous pretest left behind: programROC() is the verification
+  if (cached) {
+    LOG(logINFO) << "PixTestPretest::doTest() skipped, configuration verified against cached result";
+    return;
+  }
+
   setVana();
   h1 = (*fDisplayedHist); 
   h1->Draw(getHistOption(h1).c_str());
@@ -186,6 +196,13 @@ void PixTestPretest::doTest() {
     saveTbmParameters();
   }
 
+  vector<string> outputs = rocFileNames(fPixSetup->getConfigParameters()->getDACParameterFileName());
+  if ((tbmtype == "tbm09c") || (tbmtype == "tbm08c")) {
+    vector<string> tbmFiles = tbmFileNames();
+    outputs.insert(outputs.end(), tbmFiles.begin(), tbmFiles.end());
+  }
+  cacheResult(stateBefore, outputs);
+
   int seconds = t.RealTime(); 
   LOG(logINFO) << "PixTestPretest::doTest() done, duration: " << seconds << " seconds";
 }
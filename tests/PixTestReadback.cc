@@ -373,21 +373,34 @@ void PixTestReadback::CalibrateIa(){
 
 
 
+  vector<uint8_t> vanas;
   for(int ivana=0; ivana<npoints; ivana++){
-    vana = (uint8_t)ivana*pace;
-    for(unsigned int iroc = 0; iroc < rocIds.size(); iroc++){
-      LOG(logDEBUG)<<"Vana scan for ROC "<<getIdFromIdx(iroc);
-      fApi->setDAC("vana", 0);
-      tbIa = fApi->getTBia()*1E3; // [mA]
-      count=0;
-      do{
-	readback=daqReadback("vana", vana, getIdFromIdx(iroc), fParReadback);
-	LOG(logDEBUG)<<"CalibrateIa: daqReadback attempt #"<<count++<<", ROC "<<iroc<<", vana "<<(int)vana<<", readback "<<(int)readback[getIdFromIdx(iroc)];
-      }  while(readback.size()<1 && count<10);
-      if(10==count){
-	LOG(logINFO)<<"ERROR: no readback data received after "<<count<<" attempts. Aborting readback calibration";
-	return;
+    vanas.push_back((uint8_t)ivana*pace);
+  }
+
+  for(unsigned int iroc = 0; iroc < rocIds.size(); iroc++){
+    LOG(logDEBUG)<<"Vana scan for ROC "<<getIdFromIdx(iroc);
+    // -- readback of all vana points of this ROC in one DAQ session, the other ROCs at vana = 0
+    fApi->setDAC("vana", 0);
+    vector<vector<uint8_t> > rbScan;
+    bool complete(false);
+    count=0;
+    do{
+      rbScan=daqReadbackScan("vana", vanas, getIdFromIdx(iroc), fParReadback);
+      complete = (rbScan.size() == vanas.size());
+      for(unsigned int i=0; i<rbScan.size(); i++){
+	if(static_cast<int>(rbScan[i].size()) <= getIdFromIdx(iroc)) complete = false;
       }
+      LOG(logDEBUG)<<"CalibrateIa: daqReadbackScan attempt #"<<count++<<", ROC "<<iroc;
+    }  while(!complete && count<10);
+    if(!complete){
+      LOG(logINFO)<<"ERROR: no readback data received after "<<count<<" attempts. Aborting readback calibration";
+      return;
+    }
+
+    for(int ivana=0; ivana<npoints; ivana++){
+      vana = vanas[ivana];
+      readback=rbScan[ivana];
       rbIa[vana][getIdFromIdx(iroc)]=readback[getIdFromIdx(iroc)];
       fApi->setDAC("vana", vana, getIdFromIdx(iroc));
       sw.Start(kTRUE); // reset
@@ -750,19 +763,24 @@ void PixTestReadback::readbackVbg(){
   bool okRb=true;
   int sumRb=0;
   
-  for(int i=0; i<10; i++){
+  // -- the ten measurements in one DAQ session, vd stays at VdMin from the dry run above
+  LOG(logDEBUG)<<"/****:::::: READBACK VBG :::::****/";
+  LOG(logDEBUG)<<"Digital voltage is set to: "<<VdMin;
+  vector<vector<uint8_t> > rbScan;
+  count=0;
+  do{ 
+    rbScan = daqReadbackScan("", vector<uint8_t>(10, 0), -1, fParReadback);
+    count++;
+  }  while((rbScan.size()<1 || rbScan[0].size()<1) && count<10);
+  if(rbScan.size()<1 || rbScan[0].size()<1){
+    LOG(logINFO)<<"ERROR: no readback data received after "<<count<<" attempts. Aborting readback calibration";
+    return;
+  }
+
+  for(unsigned int i=0; i<rbScan.size(); i++){
     sumRb=0;
-    LOG(logDEBUG)<<"/****:::::: READBACK VBG :::::****/";
-    LOG(logDEBUG)<<"Digital voltage will be set to: "<<VdMin;
-    count=0;
-    do{ 
-      readback = daqReadback("vd", VdMin, fParReadback);
-      count++;
-    }  while(readback.size()<1 && count<10);
-    if(10==count){
-      LOG(logINFO)<<"ERROR: no readback data received after "<<count<<" attempts. Aborting readback calibration";
-      return;
-    }
+    readback = rbScan[i];
+    readback.resize(avReadback.size(), 0);
     for(unsigned int iroc=0; iroc < rocIds.size(); iroc++){
       sumRb+=readback[getIdFromIdx(iroc)];
     }
@@ -1121,6 +1139,36 @@ std::vector<uint8_t> PixTestReadback::daqReadbackIa(){
   return rb_val;
 }
 
+std::vector<std::vector<uint8_t> > PixTestReadback::daqReadbackScan(string dac, vector<uint8_t> values, int roc, int8_t parReadback){
+
+  PixTest::update();
+  fDirectory->cd();
+  if(fHistList.size() == 0) setHistos();
+
+  vector<pair<uint8_t, uint8_t> > settings;
+  for(unsigned int i=0; i<values.size(); i++){
+    settings.push_back(make_pair(values[i], static_cast<uint8_t>(parReadback)));
+  }
+
+  std::vector<std::vector<uint16_t> > rb;
+  if (roc < 0) {
+    rb = fApi->daqReadbackScan(dac, settings, 32, fParPeriod);
+  } else {
+    rb = fApi->daqReadbackScan(dac, static_cast<uint8_t>(roc), settings, 32, fParPeriod);
+  }
+
+  std::vector<std::vector<uint8_t> > rb_val;
+  for(unsigned int i=0; i<rb.size(); i++){
+    std::vector<uint8_t> v;
+    for(unsigned int j=0; j<rb[i].size(); j++){
+      v.push_back(rb[i][j]&0xff);
+    }
+    rb_val.push_back(v);
+  }
+
+  return rb_val;
+}
+
 void PixTestReadback::setVana() {
   cacheDacs();
   fDirectory->cd();
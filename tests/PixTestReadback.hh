@@ -29,6 +29,8 @@ public:
   std::vector<uint8_t> daqReadback(std::string dac, uint8_t vana, unsigned int roc, int8_t parReadback);
   std::vector<uint8_t> daqReadback(std::string dac, double vana, int8_t parReadback);
   std::vector<uint8_t> daqReadbackIa();
+  /// readback for all DAC values in one DAQ session, result[ivalue][roc]; dac = "" only repeats the readback
+  std::vector<std::vector<uint8_t> > daqReadbackScan(std::string dac, std::vector<uint8_t> values, int roc, int8_t parReadback);
   void CalibrateIa();
   void CalibrateVd();
   void CalibrateVa();
@@ -1,6 +1,8 @@
 #include <iostream>
+#include <fstream>
 #include <bitset>
 #include <stdlib.h>
+#include <cstdio>
 #include <algorithm>
 
 #include <TStopwatch.h>
@@ -11,6 +13,7 @@
 
 #include "PixTestTiming.hh"
 #include "PixUtil.hh"
+#include "TimingWindowSearch.hh"
 #include "timer.h"
 #include "log.h"
 #include "helper.h"
@@ -22,8 +25,53 @@ using namespace pxar;
 
 ClassImp(PixTestTiming)
 
+namespace {
+  // Probes one timing setting for the phase scan. The outer setting combines the TBM
+  // 160/400 MHz phase register and the token header/trailer delay as phase | delay,
+  // x and y are the ROC port 0 and port 1 phases:
+  class phaseProbe : public TimingWindowSearch::probe {
+  public:
+    phaseProbe(PixTestTiming *test, pxarCore *api, int ntrig, int buffer, int ntokenchains) :
+      fTest(test), fApi(api), fNTrig(ntrig), fBuffer(buffer), fNTokenChains(ntokenchains), fRunning(false), fPhase(0) {}
+    ~phaseProbe() { stop(); }
+
+    bool operator()(int outer, int x, int y) {
+      uint8_t delaysetting = outer & 0xfc;
+      int ithtdelay = outer & 3;
+      if (!fRunning || delaysetting != fPhase) {
+        stop();
+        fApi->setTbmReg("basee", delaysetting, 0); //Set TBM 160-400 MHz Clock Phase
+        fApi->daqStart();
+        fRunning = true;
+        fPhase = delaysetting;
+      }
+      int ROCDelay = (ithtdelay << 6) | (y << 3) | x;
+      LOG(logDEBUG) << "TBM Phase " << bitset<8>(delaysetting).to_string() << " Token Header/Trailer Delay: " << bitset<2>(ithtdelay).to_string() << " ROC Port1: " << y << " ROC Port0: " << x;
+      for (size_t itbm = 0; itbm<fApi->_dut->getNTbms(); itbm++) fApi->setTbmReg("basea", ROCDelay, itbm);
+      TLogLevel UserReportingLevel = Log::ReportingLevel();
+      Log::ReportingLevel() = Log::FromString("QUIET");
+      statistics results = fTest->getEvents(fNTrig, 200, fBuffer);
+      Log::ReportingLevel() = UserReportingLevel;
+      int NEvents = (results.info_events_empty()+results.info_events_valid())/fNTokenChains;
+      return (NEvents==fNTrig);
+    }
+
+    void stop() {
+      if (fRunning) fApi->daqStop();
+      fRunning = false;
+    }
+
+  private:
+    PixTestTiming *fTest;
+    pxarCore *fApi;
+    int fNTrig, fBuffer, fNTokenChains;
+    bool fRunning;
+    uint8_t fPhase;
+  };
+}
+
 //------------------------------------------------------------------------------
-PixTestTiming::PixTestTiming(PixSetup *a, std::string name) : PixTest(a, name)
+PixTestTiming::PixTestTiming(PixSetup *a, std::string name) : PixTest(a, name), fWindowWidth(3), fFullPhaseScan(false)
 {
   PixTest::init();
   init();
@@ -54,6 +102,16 @@ bool PixTestTiming::setParameter(string parName, string sval) {
         fNTrig = atoi(sval.c_str());
         LOG(logDEBUG) << "PixTestTiming::PixTest() ntrig = " << fNTrig;
       }
+      if (!parName.compare("windowwidth")) {
+        fWindowWidth = atoi(sval.c_str());
+        LOG(logDEBUG) << "PixTestTiming::PixTest() windowwidth = " << fWindowWidth;
+      }
+      if (!parName.compare("fullphasescan")) {
+        PixUtil::replaceAll(sval, "checkbox(", "");
+        PixUtil::replaceAll(sval, ")", "");
+        fFullPhaseScan = atoi(sval.c_str());
+        LOG(logDEBUG) << "fFullPhaseScan: " << fFullPhaseScan;
+      }
       break;
     }
   }
@@ -221,6 +279,11 @@ void PixTestTiming::ClkSdaScan() {
 //------------------------------------------------------------------------------
 void PixTestTiming::PhaseScan() {
 
+  if (fFullPhaseScan) {
+    FullPhaseScan();
+    return;
+  }
+
   // Start test timer
   timer t;
 
@@ -230,6 +293,174 @@ void PixTestTiming::PhaseScan() {
   banner(Form("PixTestTiming::PhaseScan()"));
   cacheTBMDacs();
 
+  size_t nTBMs = fApi->_dut->getNTbms();
+  int nTokenChains = 0;
+  std::vector<tbmConfig> enabledTBMs = fApi->_dut->getEnabledTbms();
+  for(std::vector<tbmConfig>::iterator enabledTBM = enabledTBMs.begin(); enabledTBM != enabledTBMs.end(); enabledTBM++) nTokenChains += enabledTBM->tokenchains.size();
+
+  //Search order: TBM phases on a coarse grid first, then the ones in between
+  vector<int> settings;
+  for (int pass = 0; pass < 2; pass++) {
+    for (int iclk160 = 0; iclk160 < 8; iclk160++) {
+      for (int iclk400 = 0; iclk400 < 8; iclk400++) {
+        if ((iclk160%2==0 && iclk400%2==0) != (pass==0)) continue;
+        for (int ithtdelay = 0; ithtdelay < 4; ithtdelay++) {
+          if (ithtdelay==2) continue;
+          settings.push_back(iclk160<<5 | iclk400<<2 | ithtdelay);
+        }
+      }
+    }
+  }
+
+  //Last good windows, as TBM core -> (TBM phase, ROC delays)
+  map<size_t, pair<uint8_t, uint8_t> > lastWindows = readTimingWindows();
+  map<size_t, pair<uint8_t, uint8_t> > goodWindows;
+
+  vector<int> NFunctionalTimings;
+  vector<int> NFunctionalTBMPhases;
+  vector<int> NTimings;
+
+  TH2D *h1(0);
+  TH2D *h2(0);
+  vector<TH2D*> tbmhists;
+  vector<TH2D*> rocdelayhists;
+
+  for (size_t itbm = 0; itbm<nTBMs; itbm++) {
+    h1 = bookTH2D(Form("TBMPhaseScan_%zu",itbm),Form("Phase Scan for TBM Core %zu",itbm), 8, -0.5, 7.5, 8, -0.5, 7.5);
+    h1->SetDirectory(fDirectory);
+    setTitles(h1, "160MHz Phase", "400 MHz Phase");
+    h1->SetMinimum(0);
+    tbmhists.push_back(h1);
+    if (fNoTokenPass) {
+      for (size_t itbm = 0; itbm<nTBMs; itbm++) {
+        uint8_t NewTBMSettingBase0 = GetTBMSetting("base0", itbm) | 64;
+        fApi->setTbmReg("base0", NewTBMSettingBase0, itbm); //Disable Token Pass
+      }
+    } else {
+      for (size_t jtbm = 0; jtbm<nTBMs; jtbm++) {
+        if (itbm==jtbm) {
+          uint8_t NewTBMSettingBase0 = GetTBMSetting("base0", jtbm) & 191;
+          fApi->setTbmReg("base0", NewTBMSettingBase0, jtbm); //Enable Token Pass
+        } else {
+          uint8_t NewTBMSettingBase0 = GetTBMSetting("base0", jtbm) | 64;
+          fApi->setTbmReg("base0", NewTBMSettingBase0, jtbm);
+        }
+      }
+    }
+
+    //The TBM phase is shared by all cores: once a window is found, the other cores are only searched at its phase
+    vector<int> coreSettings;
+    for (size_t isetting = 0; isetting < settings.size(); isetting++) {
+      if (goodWindows.empty() || (settings[isetting] & 0xfc) == goodWindows.begin()->second.first) coreSettings.push_back(settings[isetting]);
+    }
+
+    //Start from the last good window of this core, or from the one just found for the previous core
+    TimingWindowSearch search(coreSettings, 8, 8, fWindowWidth);
+    if (lastWindows.count(itbm) || !goodWindows.empty()) {
+      pair<uint8_t, uint8_t> start = lastWindows.count(itbm) ? lastWindows[itbm] : goodWindows.rbegin()->second;
+      if (!goodWindows.empty()) start.first = goodWindows.begin()->second.first;
+      search.setStart(start.first | (start.second >> 6), start.second & 7, (start.second >> 3) & 7);
+    }
+
+    phaseProbe probe(this, fApi, fNTrig, fTrigBuffer, nTokenChains);
+    bool found = search.run(probe);
+    probe.stop();
+
+    //Fill the histograms with all probed settings
+    NFunctionalTimings.push_back(0);
+    NFunctionalTBMPhases.push_back(0);
+    NTimings.push_back(search.nTested());
+    map<int, int> NFunctionalROCPhases;
+    for (size_t iouter = 0; iouter < search.nOuter(); iouter++) {
+      if (search.nValid(iouter)==0) continue;
+      int delaysetting = search.outerSetting(iouter) & 0xfc;
+      int ithtdelay = search.outerSetting(iouter) & 3;
+      h2 = bookTH2D(Form("ROCDelayScan_TBMCore_%zu_%d_%d",itbm,delaysetting/4,ithtdelay),Form("TBM Core: %zu ROC Delay Scan: 160MHz Phase = %d 400MHz Phase = %d THT Delay = %d",itbm,delaysetting>>5,(delaysetting>>2)&7,ithtdelay), 8, -0.5, 7.5, 8, -0.5, 7.5);
+      h2->SetDirectory(fDirectory);
+      setTitles(h2, "ROC Port 0 Delay", "ROC Port 1 Delay");
+      h2->SetMinimum(0);
+      for (int irocphaseport1 = 0; irocphaseport1 < 8; irocphaseport1++) {
+        for (int irocphaseport0 = 0; irocphaseport0 < 8; irocphaseport0++) {
+          if (search.state(iouter, irocphaseport0, irocphaseport1)==TimingWindowSearch::VALID) h2->Fill(irocphaseport0,irocphaseport1);
+        }
+      }
+      rocdelayhists.push_back(h2);
+      NFunctionalTimings[itbm] += search.nValid(iouter);
+      NFunctionalROCPhases[delaysetting] += search.nValid(iouter);
+    }
+    for (map<int, int>::iterator iphase = NFunctionalROCPhases.begin(); iphase != NFunctionalROCPhases.end(); ++iphase) {
+      NFunctionalTBMPhases[itbm]++;
+      h1->Fill(iphase->first>>5,(iphase->first>>2)&7,iphase->second);
+    }
+
+    if (found) {
+      uint8_t delaysetting = search.outer() & 0xfc;
+      uint8_t ROCDelay = ((search.outer() & 3) << 6) | (search.y() << 3) | search.x();
+      goodWindows[itbm] = make_pair(delaysetting, ROCDelay);
+      LOG(logINFO) << "TBM Core " << itbm << ": timing window of width " << fWindowWidth << " found after " << search.nTested() << " settings, TBM Phase: " << bitset<8>(delaysetting).to_string() << " ROC Phase: " << bitset<8>(ROCDelay).to_string();
+    } else {
+      LOG(logERROR) << "TBM Core " << itbm << ": no timing window of width " << fWindowWidth << " found!";
+    }
+    if (fNoTokenPass) break;
+  }
+
+  //Draw the plots
+  for (size_t ihist = 0; ihist < rocdelayhists.size(); ihist++) {
+    rocdelayhists[ihist]->Draw("colz");
+    fHistList.push_back(rocdelayhists[ihist]);
+    fHistOptions.insert(make_pair(rocdelayhists[ihist], "colz"));
+  }
+
+  for (size_t itbm=0; itbm<tbmhists.size(); itbm++) {
+    tbmhists[itbm]->Draw("colz");
+    fHistList.push_back(tbmhists[itbm]);
+    fHistOptions.insert(make_pair(tbmhists[itbm], "colz"));
+    fDisplayedHist = find(fHistList.begin(), fHistList.end(), tbmhists[itbm]);
+    PixTest::update();
+  }
+
+  restoreTBMDacs();
+
+  //Apply the windows found, all of them at the same TBM phase
+  if (!goodWindows.empty()) {
+    uint8_t delaysetting = goodWindows.begin()->second.first;
+    fApi->setTbmReg("basee", delaysetting, 0);
+    fPixSetup->getConfigParameters()->setTbmDac("basee", delaysetting, 0);
+    for (size_t itbm = 0; itbm<nTBMs; itbm++) {
+      map<size_t, pair<uint8_t, uint8_t> >::iterator window = goodWindows.find(fNoTokenPass ? 0 : itbm);
+      if (window == goodWindows.end()) continue;
+      fApi->setTbmReg("basea", window->second.second, itbm);
+      fPixSetup->getConfigParameters()->setTbmDac("basea", window->second.second, itbm);
+    }
+    writeTimingWindows(goodWindows);
+  }
+
+  LOG(logINFO) << "   ----------------------------------------------------------------------";
+  for (size_t itbm=0; itbm<NFunctionalTimings.size(); itbm++) {
+    LOG(logINFO) << "   Results for TBM Core: " << itbm;
+    LOG(logINFO) << Form("   The fraction of probed functioning timings is %4.2f%%: %d/%d", float(NFunctionalTimings[itbm])/NTimings[itbm]*100, NFunctionalTimings[itbm], NTimings[itbm]);
+    LOG(logINFO) << Form("   The number of functioning TBM Phases found is %d/%d", NFunctionalTBMPhases[itbm], 64);
+  }
+  LOG(logINFO) << "   ----------------------------------------------------------------------";
+
+  // Print timer value:
+  LOG(logINFO) << "Test took " << t << " ms.";
+  LOG(logINFO) << "PixTestTiming::PhaseScan() done.";
+  dutCalibrateOff();
+}
+
+//------------------------------------------------------------------------------
+void PixTestTiming::FullPhaseScan() {
+
+  // Start test timer
+  timer t;
+
+  fApi->_dut->testAllPixels(false);
+  fApi->_dut->maskAllPixels(true);
+
+  banner(Form("PixTestTiming::FullPhaseScan()"));
+  cacheTBMDacs();
+
   TLogLevel UserReportingLevel = Log::ReportingLevel();
   size_t nTBMs = fApi->_dut->getNTbms();
   int nTokenChains = 0;
@@ -342,7 +573,7 @@ void PixTestTiming::PhaseScan() {
 
   // Print timer value:
   LOG(logINFO) << "Test took " << t << " ms.";
-  LOG(logINFO) << "PixTestTiming::PhaseScan() done.";
+  LOG(logINFO) << "PixTestTiming::FullPhaseScan() done.";
   dutCalibrateOff();
 }
 
@@ -703,6 +934,39 @@ pair <int, int> PixTestTiming::getGoodRegion(TH2D* hist, int hits) {
 
 }
 
+// ----------------------------------------------------------------------
+map<size_t, pair<uint8_t, uint8_t> > PixTestTiming::readTimingWindows() {
+  map<size_t, pair<uint8_t, uint8_t> > windows;
+  string filename = fPixSetup->getConfigParameters()->getDirectory() + "/timingWindows.dat";
+  ifstream is(filename.c_str());
+  string line;
+  while (getline(is, line)) {
+    if (line.empty() || line[0]=='#') continue;
+    unsigned int core, delaysetting, ROCDelay;
+    if (sscanf(line.c_str(), "%u %x %x", &core, &delaysetting, &ROCDelay)==3) windows[core] = make_pair(delaysetting, ROCDelay);
+  }
+  return windows;
+}
+
+// ----------------------------------------------------------------------
+void PixTestTiming::writeTimingWindows(map<size_t, pair<uint8_t, uint8_t> > windows) {
+  //Keep the windows of cores not scanned this time
+  map<size_t, pair<uint8_t, uint8_t> > allWindows = readTimingWindows();
+  for (map<size_t, pair<uint8_t, uint8_t> >::iterator iw = windows.begin(); iw != windows.end(); ++iw) allWindows[iw->first] = iw->second;
+
+  string filename = fPixSetup->getConfigParameters()->getDirectory() + "/timingWindows.dat";
+  ofstream os(filename.c_str());
+  if (!os) {
+    LOG(logWARNING) << "Could not write " << filename;
+    return;
+  }
+  LOG(logINFO) << "PixTestTiming:: Write timing windows to " << filename;
+  os << "# Last good timing window per TBM core: core basee basea" << endl;
+  for (map<size_t, pair<uint8_t, uint8_t> >::iterator iw = allWindows.begin(); iw != allWindows.end(); ++iw) {
+    os << iw->first << Form(" 0x%02x 0x%02x", iw->second.first, iw->second.second) << endl;
+  }
+}
+
 // ----------------------------------------------------------------------
 void PixTestTiming::saveParameters() {
   LOG(logINFO) << "PixTestTiming:: Write Tbm parameters to file.";
@@ -16,6 +16,7 @@ public:
 
     void ClkSdaScan();
     void PhaseScan();
+    void FullPhaseScan();
     void TBMPhaseScan();
     void ROCDelayScan();
 	void doTest();
@@ -26,6 +27,8 @@ public:
     pxar::statistics getEvents(int NEvents, int period, int buffer);
 	std::vector<std::pair<std::string,uint8_t> > getDelays(uint8_t , uint8_t);
     std::pair<int, int> getGoodRegion(TH2D*, int);
+    std::map<size_t, std::pair<uint8_t, uint8_t> > readTimingWindows();
+    void writeTimingWindows(std::map<size_t, std::pair<uint8_t, uint8_t> > windows);
 
 private:
 
@@ -33,6 +36,8 @@ private:
     int     fNTrig;
     int     fTrigBuffer;
     bool    fNoTokenPass;
+    int     fWindowWidth;
+    bool    fFullPhaseScan;
 
 	ClassDef(PixTestTiming, 1)
 
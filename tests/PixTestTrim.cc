@@ -113,6 +113,12 @@ void PixTestTrim::doTest() {
   PixTest::update(); 
   bigBanner(Form("PixTestTrim::doTest()"));
 
+  if (cachedResult()) {
+    LOG(logINFO) << "PixTestTrim::doTest() skipped, trim bits and DACs unchanged since the last trimming";
+    return;
+  }
+  uint64_t stateBefore = fPixSetup->getConfigurationHash();
+
   fProblem = false; 
   trimTest(); 
   if (fProblem) {
@@ -133,6 +139,11 @@ void PixTestTrim::doTest() {
   h1->Draw(getHistOption(h1).c_str());
   PixTest::update(); 
 
+  vector<string> outputs = rocFileNames(fPixSetup->getConfigParameters()->getDACParameterFileName());
+  vector<string> trimFiles = rocFileNames(fPixSetup->getConfigParameters()->getTrimParameterFileName());
+  outputs.insert(outputs.end(), trimFiles.begin(), trimFiles.end());
+  cacheResult(stateBefore, outputs);
+
   int seconds = t.RealTime(); 
   LOG(logINFO) << "PixTestTrim::doTest() done, duration: " << seconds << " seconds";
 }
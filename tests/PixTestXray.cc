@@ -9,6 +9,7 @@
 #include <TStyle.h>
 
 #include "PixUtil.hh"
+#include "HitAccumulator.hh"
 
 #include <TH2.h>
 #include <TMath.h>
@@ -28,6 +29,7 @@ PixTestXray::PixTestXray(PixSetup *a, std::string name) : PixTest(a, name),
   LOG(logDEBUG) << "PixTestXray ctor(PixSetup &a, string, TGTab *)";
 
   fTree = 0; 
+  fPhCal.setLookupTable(true);
   fPhCal.setPHParameters(fPixSetup->getConfigParameters()->getGainPedestalParameters());
   fPhCalOK = fPhCal.initialized();
 
@@ -683,6 +685,7 @@ void PixTestXray::readData() {
   try { daqdat = fApi->daqGetEventBuffer(); }
   catch(pxar::DataNoEvent &) {}
   
+  HitAccumulator acc(fHitMap.size()); 
   for (std::vector<pxar::Event>::iterator it = daqdat.begin(); it != daqdat.end(); ++it) {
     pixCnt += it->pixels.size();
 
@@ -695,22 +698,12 @@ void PixTestXray::readData() {
 
     int idx(0); 
     double q(0.);
+    vector<double> vq(it->pixels.size(), 0.); 
+    if (fPhCalOK && vq.size() > 0) fPhCal.vcal(&it->pixels[0], vq.size(), &vq[0]); 
     for (unsigned int ipix = 0; ipix < it->pixels.size(); ++ipix) {   
       idx = getIdxFromId(it->pixels[ipix].roc());
-      if (fPhCalOK) {
-	q = fPhCal.vcal(it->pixels[ipix].roc(), 
-			it->pixels[ipix].column(), 
-			it->pixels[ipix].row(), 
-			it->pixels[ipix].value());
-      } else {
-	q = 0;
-      }
-      fHitMap[idx]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row());
-      fQ[idx]->Fill(q);
-      fQmap[idx]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row(), q);
-
-      fPHmap[idx]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row(), it->pixels[ipix].value());
-      fPH[idx]->Fill(it->pixels[ipix].value());
+      q = vq[ipix]; 
+      acc.fill(idx, it->pixels[ipix].column(), it->pixels[ipix].row(), it->pixels[ipix].value(), q); 
 	
       if (fParFillTree && ipix < 20000) {
 	++fTreeEvent.npix;
@@ -725,6 +718,13 @@ void PixTestXray::readData() {
     if (fParFillTree) fTree->Fill();
     
   }
+  for (unsigned int i = 0; i < fHitMap.size(); ++i) {
+    if (i < fQ.size()) {
+      acc.flush(i, fHitMap[i], fQmap[i], fPHmap[i], fQ[i], fPH[i]); 
+    } else {
+      acc.flush(i, fHitMap[i]); 
+    }
+  }
   LOG(logDEBUG) << "Processing Data: " << daqdat.size() << " events with " << pixCnt << " pixels";
 }
 
@@ -758,6 +758,7 @@ void PixTestXray::processData(uint16_t numevents) {
   
   int idx(-1); 
   uint16_t q; 
+  HitAccumulator acc(fHmap.size()); 
   for (std::vector<pxar::Event>::iterator it = daqdat.begin(); it != daqdat.end(); ++it) {
     ++evtCnt;
     pixCnt += it->pixels.size(); 
@@ -770,6 +771,8 @@ void PixTestXray::processData(uint16_t numevents) {
       fTreeEvent.trailer          = it->trailer; 
     }
 
+    vector<double> vq(it->pixels.size(), 0.); 
+    if (fPhCalOK && vq.size() > 0) fPhCal.vcal(&it->pixels[0], vq.size(), &vq[0]); 
     for (unsigned int ipix = 0; ipix < it->pixels.size(); ++ipix) {   
       idx = getIdxFromId(it->pixels[ipix].roc());
 
@@ -777,20 +780,8 @@ void PixTestXray::processData(uint16_t numevents) {
       fHitsVsColumn[idx]->Fill(it->pixels[ipix].column()); 
       fHitsVsEvtCol[idx]->Fill(evtCnt, it->pixels[ipix].column()); 
 
-      if (fPhCalOK) {
-	q = fPhCal.vcal(it->pixels[ipix].roc(), 
-			it->pixels[ipix].column(), 
-			it->pixels[ipix].row(), 
-			it->pixels[ipix].value());
-      } else {
-	q = 0;
-      }
-      fHmap[idx]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row());
-      fQ[idx]->Fill(q);
-      fQmap[idx]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row(), q);
-
-      fPHmap[idx]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row(), it->pixels[ipix].value());
-      fPH[idx]->Fill(it->pixels[ipix].value());
+      q = static_cast<uint16_t>(vq[ipix]); 
+      acc.fill(idx, it->pixels[ipix].column(), it->pixels[ipix].row(), it->pixels[ipix].value(), q); 
 	
       if (fParFillTree && ipix < 20000) {
 	++fTreeEvent.npix;
@@ -804,6 +795,7 @@ void PixTestXray::processData(uint16_t numevents) {
     
     if (fParFillTree) fTree->Fill();
   }
+  for (unsigned int i = 0; i < fHmap.size(); ++i) acc.flush(i, fHmap[i], fQmap[i], fPHmap[i], fQ[i], fPH[i]); 
   
   LOG(logDEBUG) << Form(" # events read: %6ld, pixels seen in all events: %3d", daqdat.size(), pixCnt);
   
@@ -0,0 +1,202 @@
+/**
+ * pxar trigger condensation benchmark
+ * generates the raw data of a MultiRocAllPixels* calibration with the DTB
+ * emulator's data generator, decodes it and condenses it with
+ * hal::condenseTriggers and with the former std::map/find_if implementation.
+ * Prints both timings and checks that the results are identical.
+ */
+
+#include "hal.h"
+#include "generator.h"
+#include "datasource_evt.h"
+#include "exceptions.h"
+#include "helper.h"
+#include "log.h"
+#include "timer.h"
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <stdlib.h>
+
+using namespace pxar;
+
+namespace pxar {
+
+  // Access to the private hal::condenseTriggers, granted by hal:
+  class condenseBench {
+  public:
+    static std::vector<Event> condenseTriggers(hal & h, std::vector<Event> &data, uint16_t nTriggers, bool efficiency) {
+      return h.condenseTriggers(data, nTriggers, efficiency);
+    }
+  };
+}
+
+namespace {
+
+  // The implementation of hal::condenseTriggers before the dense lookup table, kept as reference:
+  std::vector<Event> condenseReference(std::vector<Event> &data, uint16_t nTriggers, bool efficiency) {
+
+    std::vector<Event> packed;
+
+    for(std::vector<Event>::iterator Eventit = data.begin(); Eventit!= data.end(); Eventit += nTriggers) {
+
+      Event evt;
+      std::map<pixel,uint16_t> pxcount = std::map<pixel,uint16_t>();
+      std::map<pixel,double> pxmean = std::map<pixel,double>();
+      std::map<pixel,double> pxm2 = std::map<pixel,double>();
+
+      for(std::vector<Event>::iterator it = Eventit; it != Eventit+nTriggers; ++it) {
+	for(std::vector<pixel>::iterator pixit = (it)->pixels.begin(); pixit != (it)->pixels.end(); ++pixit) {
+	  std::vector<pixel>::iterator px = std::find_if(evt.pixels.begin(),
+							 evt.pixels.end(),
+							 findPixelXY(pixit->column(), pixit->row(), pixit->roc()));
+	  if(px != evt.pixels.end()) {
+	    if(efficiency) { px->setValue(px->value()+1); }
+	    else {
+	      double delta = pixit->value() - pxmean[*px];
+	      pxmean[*px] += delta/pxcount[*px];
+	      pxm2[*px] += delta*(pixit->value() - pxmean[*px]);
+	      pxcount[*px]++;
+	    }
+	  }
+	  else {
+	    if(efficiency) { pixit->setValue(1); }
+	    else {
+	      pxcount.insert(std::make_pair(*pixit,1));
+	      pxmean.insert(std::make_pair(*pixit,pixit->value()));
+	      pxm2.insert(std::make_pair(*pixit,0));
+	    }
+	    evt.pixels.push_back(*pixit);
+	  }
+	}
+      }
+
+      if(!efficiency) {
+	for(std::vector<pixel>::iterator px = evt.pixels.begin(); px != evt.pixels.end(); ++px) {
+	  px->setValue(pxmean[*px]);
+	  px->setVariance(pxm2[*px]/(pxcount[*px] - 1));
+	}
+      }
+      packed.push_back(evt);
+    }
+
+    data.clear();
+    return packed;
+  }
+
+  // Raw data of a test pulse on every pixel, nTriggers times, as the emulator sends it for a module:
+  std::vector<Event> generate(uint8_t nrocs, uint16_t nTriggers, size_t npixels) {
+
+    std::vector<uint16_t> raw;
+    uint32_t event = 0;
+    for(size_t i = 0; i < npixels; i++) {
+      for(uint16_t k = 0; k < nTriggers; k++) {
+	fillRawData(event++, raw, TBM_08B, nrocs, false, false, i/ROC_NUMROWS, i%ROC_NUMROWS,
+		    std::vector<uint16_t>(), FLAG_FORCE_UNMASKED);
+      }
+    }
+
+    evtSource src(0, nrocs, 0, TBM_08B, ROC_PSI46DIGV21RESPIN);
+    dtbEventSplitter splitter;
+    dtbEventDecoder decoder;
+    dataSink<Event*> Eventpump;
+    src >> splitter >> decoder >> Eventpump;
+    src.AddData(raw);
+
+    std::vector<Event> data;
+    data.reserve(event);
+    try {
+      while(1) { data.push_back(*Eventpump.Get()); }
+    }
+    catch(dsBufferEmpty &) {}
+    return data;
+  }
+
+  bool identical(std::vector<Event> &a, std::vector<Event> &b) {
+    if(a.size() != b.size()) return false;
+    for(size_t i = 0; i < a.size(); i++) {
+      if(a[i].pixels.size() != b[i].pixels.size()) return false;
+      for(size_t j = 0; j < a[i].pixels.size(); j++) {
+	pixel & pa = a[i].pixels[j];
+	pixel & pb = b[i].pixels[j];
+	if(pa.roc() != pb.roc() || pa.column() != pb.column() || pa.row() != pb.row()
+	   || pa.value() != pb.value() || pa.variance() != pb.variance()) return false;
+      }
+    }
+    return true;
+  }
+}
+
+int main(int argc, char* argv[]) {
+
+  int nrocs = 16;
+  uint16_t nTriggers = 10;
+  size_t npixels = ROC_NUMCOLS*ROC_NUMROWS;
+
+  // Quick and hacky cli arguments reading:
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i],"-h")) {
+      std::cout << "Help:" << std::endl;
+      std::cout << "-r nrocs       number of ROCs, default 16" << std::endl;
+      std::cout << "-t triggers    number of triggers per pixel, default 10" << std::endl;
+      std::cout << "-p pixels      number of pixels pulsed per ROC, default 4160" << std::endl;
+      return 0;
+    }
+    else if (!strcmp(argv[i],"-r")) { nrocs = atoi(argv[++i]); }
+    else if (!strcmp(argv[i],"-t")) { nTriggers = static_cast<uint16_t>(atoi(argv[++i])); }
+    else if (!strcmp(argv[i],"-p")) { npixels = static_cast<size_t>(atoi(argv[++i])); }
+    else {
+      std::cout << "Unrecognized command line option " << argv[i] << std::endl;
+    }
+  }
+
+  if(nrocs < 1 || nrocs > MOD_NUMROCS || nTriggers < 1 || npixels < 1 || npixels > ROC_NUMCOLS*ROC_NUMROWS) {
+    std::cout << "Invalid settings." << std::endl;
+    return -1;
+  }
+
+  Log::ReportingLevel() = Log::FromString("WARNING");
+  srand(42);
+
+  try {
+    hal * _hal = new hal("*");
+    bool ok = true;
+
+    for(int efficiency = 1; efficiency >= 0; efficiency--) {
+      timer t;
+      std::vector<Event> reference = generate(static_cast<uint8_t>(nrocs), nTriggers, npixels);
+      std::vector<Event> condensed = reference;
+      size_t nevents = reference.size(), nhits = 0;
+      for(size_t i = 0; i < reference.size(); i++) { nhits += reference[i].pixels.size(); }
+      std::cout << (efficiency ? "Efficiency" : "Pulse height") << ": " << nevents << " events with "
+		<< nhits << " hits generated and decoded (" << t.get() << "ms)." << std::endl;
+      if(nevents%nTriggers != 0) {
+	std::cout << "Decoded " << nevents << " events, not a multiple of " << nTriggers << " triggers." << std::endl;
+	return -1;
+      }
+
+      timer tref;
+      std::vector<Event> packedReference = condenseReference(reference, nTriggers, efficiency);
+      uint32_t msref = tref.get();
+
+      timer tnew;
+      std::vector<Event> packed = condenseBench::condenseTriggers(*_hal, condensed, nTriggers, efficiency);
+      uint32_t msnew = tnew.get();
+
+      bool same = identical(packedReference, packed);
+      ok = ok && same;
+      std::cout << "  std::map/find_if: " << msref << "ms, hal::condenseTriggers: " << msnew << "ms, results "
+		<< (same ? "identical" : "DIFFER") << "." << std::endl;
+    }
+
+    delete _hal;
+    return (ok ? 0 : -1);
+  }
+  catch(std::exception &e) {
+    std::cout << "exception: " << e.what() << std::endl;
+    return -1;
+  }
+}
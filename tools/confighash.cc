@@ -0,0 +1,167 @@
+/**
+ * pxar check of PixSetup::getConfigurationHash on an emulated module
+ * disables single ROCs of a 16-ROC module and changes one DAC of every ROC in
+ * turn. The hash has to change for every enabled ROC, also for the ones behind
+ * a disabled ROC, and must not change for the disabled ROC itself. Otherwise
+ * the result cache could return a result for a configuration that was never
+ * tested.
+ */
+
+#include "api.h"
+#include "log.h"
+#include "PixSetup.hh"
+#include "ConfigParameters.hh"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <stdlib.h>
+
+using namespace pxar;
+
+namespace {
+
+  pxarCore * initModule(int nrocs) {
+
+    std::vector<std::pair<std::string,uint8_t> > sig_delays;
+    sig_delays.push_back(std::make_pair("clk",2));
+    sig_delays.push_back(std::make_pair("ctr",2));
+    sig_delays.push_back(std::make_pair("sda",17));
+    sig_delays.push_back(std::make_pair("tin",7));
+    sig_delays.push_back(std::make_pair("deser160phase",4));
+
+    std::vector<std::pair<std::string,double> > power_settings;
+    power_settings.push_back(std::make_pair("va",1.9));
+    power_settings.push_back(std::make_pair("vd",2.6));
+    power_settings.push_back(std::make_pair("ia",1.190));
+    power_settings.push_back(std::make_pair("id",1.10));
+
+    std::vector<std::pair<std::string,uint8_t> > pg_setup;
+    pg_setup.push_back(std::make_pair("resettbm",25));
+    pg_setup.push_back(std::make_pair("calibrate",106));
+    pg_setup.push_back(std::make_pair("trigger;sync",0));
+
+    std::vector<std::pair<std::string,uint8_t> > regs;
+    regs.push_back(std::make_pair("base0",0x81));
+    regs.push_back(std::make_pair("base2",0xC0));
+    regs.push_back(std::make_pair("base4",0xF0));
+    regs.push_back(std::make_pair("base8",0x10));
+    regs.push_back(std::make_pair("basea",0x49));
+    regs.push_back(std::make_pair("basec",0x00));
+    regs.push_back(std::make_pair("basee",0x84));
+    std::vector<std::vector<std::pair<std::string,uint8_t> > > tbmDACs(2, regs);
+
+    std::vector<std::pair<std::string,uint8_t> > dacs;
+    dacs.push_back(std::make_pair("Vdig",8));
+    dacs.push_back(std::make_pair("Vana",78));
+    dacs.push_back(std::make_pair("Vsf",80));
+    dacs.push_back(std::make_pair("Vcomp",12));
+    dacs.push_back(std::make_pair("VwllPr",150));
+    dacs.push_back(std::make_pair("VwllSh",150));
+    dacs.push_back(std::make_pair("VhldDel",117));
+    dacs.push_back(std::make_pair("Vtrim",152));
+    dacs.push_back(std::make_pair("VthrComp",89));
+    dacs.push_back(std::make_pair("VIBias_Bus",30));
+    dacs.push_back(std::make_pair("Vbias_sf",6));
+    dacs.push_back(std::make_pair("VoffsetOp",60));
+    dacs.push_back(std::make_pair("VOffsetRO",225));
+    dacs.push_back(std::make_pair("VIon",45));
+    dacs.push_back(std::make_pair("Vcomp_ADC",10));
+    dacs.push_back(std::make_pair("VIref_ADC",70));
+    dacs.push_back(std::make_pair("VIbias_roc",150));
+    dacs.push_back(std::make_pair("VIColOr",99));
+    dacs.push_back(std::make_pair("Vcal",199));
+    dacs.push_back(std::make_pair("CalDel",140));
+    dacs.push_back(std::make_pair("CtrlReg",0));
+    dacs.push_back(std::make_pair("WBC",100));
+
+    std::vector<pixelConfig> pixels;
+    for(int col = 0; col < 52; col++) {
+      for(int row = 0; row < 80; row++) { pixels.push_back(pixelConfig(col,row,15)); }
+    }
+
+    std::vector<std::vector<std::pair<std::string,uint8_t> > > rocDACs(nrocs, dacs);
+    std::vector<std::vector<pixelConfig> > rocPixels(nrocs, pixels);
+
+    pxarCore * api = new pxarCore("*", "WARNING");
+    if(!api->initTestboard(sig_delays, power_settings, pg_setup)
+       || !api->initDUT(31, "tbm08c", tbmDACs, "psi46digv21respin", rocDACs, rocPixels)) {
+      delete api;
+      throw InvalidConfig("Could not initialize the DUT.");
+    }
+    return api;
+  }
+
+  // Changes one DAC of every ROC in turn, returns the number of wrong hashes:
+  int checkDacChanges(PixSetup & setup, int nrocs, int disabled) {
+
+    pxarCore * api = setup.getApi();
+    for(int iroc = 0; iroc < nrocs; iroc++) { api->_dut->setROCEnable(iroc, iroc != disabled); }
+
+    int nfailed = 0;
+    uint64_t reference = setup.getConfigurationHash();
+    for(int iroc = 0; iroc < nrocs; iroc++) {
+      uint8_t vana = api->_dut->getDAC(iroc, "vana");
+      api->setDAC("vana", vana + 1, iroc);
+      bool changed = (setup.getConfigurationHash() != reference);
+      api->setDAC("vana", vana, iroc);
+
+      if(changed == (iroc == disabled)) {
+	std::cout << "ROC " << disabled << " disabled: a changed DAC of ROC " << iroc
+		  << (changed ? " changes" : " does not change") << " the configuration hash." << std::endl;
+	nfailed++;
+      }
+    }
+    if(setup.getConfigurationHash() != reference) {
+      std::cout << "ROC " << disabled << " disabled: hash differs after restoring the DACs." << std::endl;
+      nfailed++;
+    }
+    return nfailed;
+  }
+}
+
+int main(int argc, char* argv[]) {
+
+  int nrocs = 16;
+
+  // Quick and hacky cli arguments reading:
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i],"-h")) {
+      std::cout << "Help:" << std::endl;
+      std::cout << "-r nrocs       number of ROCs, default 16" << std::endl;
+      return 0;
+    }
+    else if (!strcmp(argv[i],"-r")) { nrocs = atoi(argv[++i]); }
+    else {
+      std::cout << "Unrecognized command line option " << argv[i] << std::endl;
+    }
+  }
+
+  if(nrocs < 2 || nrocs > 16) {
+    std::cout << "Invalid settings." << std::endl;
+    return -1;
+  }
+
+  try {
+    pxarCore * api = initModule(nrocs);
+    // The result cache file goes to the configuration directory, the current one here:
+    ConfigParameters * config = new ConfigParameters();
+    config->setDirectory(".");
+    PixSetup * setup = new PixSetup(api, 0, config);
+
+    // No ROC disabled, then each one in turn:
+    int nfailed = 0;
+    for(int disabled = -1; disabled < nrocs; disabled++) { nfailed += checkDacChanges(*setup, nrocs, disabled); }
+    std::cout << "Configuration hash: " << nfailed << " wrong results for " << (nrocs + 1)*nrocs
+	      << " DAC changes - " << (nfailed ? "FAILED" : "ok") << std::endl;
+
+    delete setup;
+    delete config;
+    delete api;
+    return (nfailed ? -1 : 0);
+  }
+  catch(std::exception &e) {
+    std::cout << "exception: " << e.what() << std::endl;
+    return -1;
+  }
+}
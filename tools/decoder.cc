@@ -1,9 +1,15 @@
+#include "api.h"
 #include "datasource_evt.h"
+#include "exceptions.h"
+#include "helper.h"
 #include "log.h"
 #include "constants.h"
 #include <stdlib.h>
+#include <algorithm>
+#include <cmath>
 #include <iomanip>
 #include <iostream>
+#include <map>
 #include <string>
 #include <cstring>
 #include <cstdio>
@@ -116,6 +122,288 @@ void test_readback_reset() {
   LOG(logINFO) << "End Readback Reset test." << std::endl << std::endl;
 }
 
+void test_pixel_decoding() {
+
+  Log::ReportingLevel() = Log::FromString("INFO");
+  LOG(logINFO) << std::endl << std::endl << "Start Pixel Decoding test...";
+
+  // Compare the lookup table pixel decoding with the pixel constructor for
+  // all possible pixel addresses and a selection of pulse heights:
+  uint8_t pulseheights[] = { 0x00, 0x0f, 0x10, 0x2f, 0xe0, 0xef, 0xff };
+  size_t mismatches = 0, compared = 0;
+
+  for(int invert = 0; invert < 2; invert++) {
+    for(uint32_t address = 0; address < (1 << 15); address++) {
+      for(size_t ph = 0; ph < sizeof(pulseheights); ph++) {
+	uint32_t raw = (address << 9) | pulseheights[ph];
+	compared++;
+
+	pixelDecodingStatus expected = PIXEL_VALID;
+	pixel reference;
+	try { reference = pixel(raw,3,invert); }
+	catch(DataInvalidAddressError &) { expected = PIXEL_INVALID_ADDRESS; }
+	catch(DataInvalidPulseheightError &) { expected = PIXEL_INVALID_PULSEHEIGHT; }
+	catch(DataCorruptBufferError &) { expected = PIXEL_BUFFER_CORRUPT; }
+
+	pixel pix;
+	pixelDecodingStatus status = dtbEventDecoder::decodePixel(raw,3,invert,pix);
+	if(status != expected
+	   || (status == PIXEL_VALID && !(pix == reference && pix.value() == reference.value()))) {
+	  LOG(logERROR) << "Mismatch for raw value 0x" << std::hex << raw << std::dec
+			<< (invert ? " (inverted)" : "") << ": " << reference << " vs. " << pix;
+	  mismatches++;
+	}
+      }
+    }
+  }
+
+  LOG(logINFO) << "Compared " << compared << " raw values, found " << mismatches << " mismatches.";
+  LOG(logINFO) << "End Pixel Decoding test." << std::endl << std::endl;
+}
+
+// The threshold search of pxarCore::repackThresholdMapData before the dense per-pixel
+// state, kept as reference. Takes the data packed by DAC value:
+std::vector<pixel> referenceThresholdMap(std::vector<std::pair<uint8_t,std::vector<pixel> > > packed_dac, uint8_t dacMin, uint8_t dacMax, uint16_t threshold, uint16_t flags) {
+
+  std::vector<pixel> result;
+  std::vector<pixel> found;
+  std::map<pixel,uint8_t> oldvalue;
+
+  std::vector<std::pair<uint8_t,std::vector<pixel> > >::iterator it_start;
+  std::vector<std::pair<uint8_t,std::vector<pixel> > >::iterator it_end;
+  int increase_op;
+  if((flags&FLAG_RISING_EDGE) != 0) { it_start = packed_dac.begin(); it_end = packed_dac.end(); increase_op = 1; }
+  else { it_start = packed_dac.end()-1; it_end = packed_dac.begin()-1; increase_op = -1;  }
+
+  for(std::vector<std::pair<uint8_t,std::vector<pixel> > >::iterator it = it_start; it != it_end; it += increase_op) {
+    for(std::vector<pixel>::iterator pixit = it->second.begin(); pixit != it->second.end(); ++pixit) {
+      std::vector<pixel>::iterator px_found = std::find_if(found.begin(), found.end(),
+							   findPixelXY(pixit->column(), pixit->row(), pixit->roc()));
+      if(px_found != found.end()) continue;
+
+      std::vector<pixel>::iterator px = std::find_if(result.begin(), result.end(),
+						     findPixelXY(pixit->column(), pixit->row(), pixit->roc()));
+      if(px != result.end()) {
+	uint8_t delta_old = abs(oldvalue[*px] - threshold);
+	uint8_t delta_new = abs(static_cast<uint8_t>(pixit->value()) - threshold);
+	bool positive_slope = (static_cast<uint8_t>(pixit->value()) - oldvalue[*px] > 0 ? true : false);
+	if(positive_slope && !(delta_new < delta_old)) {
+	  found.push_back(*pixit);
+	  continue;
+	}
+	px->setValue(it->first);
+	oldvalue[*px] = static_cast<uint8_t>(pixit->value());
+      }
+      else {
+	if(pixit->value() >= threshold) { found.push_back(*pixit); }
+	oldvalue.insert(std::make_pair(*pixit,pixit->value()));
+	pixit->setValue(it->first);
+	result.push_back(*pixit);
+      }
+    }
+  }
+
+  for(std::vector<pixel>::iterator px = result.begin(); px != result.end(); ++px) {
+    std::vector<pixel>::iterator px_found = std::find_if(found.begin(), found.end(),
+							 findPixelXY(px->column(), px->row(), px->roc()));
+    if(px_found != found.end()) continue;
+    if((flags&FLAG_RISING_EDGE) != 0) { px->setValue(dacMax); }
+    else { px->setValue(dacMin); }
+  }
+
+  if((flags&FLAG_NOSORT) == 0) { std::sort(result.begin(),result.end()); }
+  return result;
+}
+
+// The same for pxarCore::repackThresholdDacScanData, takes the data packed by DAC1/DAC2 value:
+std::vector<std::pair<uint8_t,std::vector<pixel> > > referenceThresholdDacScan(std::vector<std::pair<uint8_t,std::pair<uint8_t,std::vector<pixel> > > > packed_dacdac, uint8_t dac2min, uint8_t dac2max, uint16_t threshold, uint16_t flags) {
+
+  std::vector<std::pair<uint8_t,std::vector<pixel> > > result;
+  std::map<uint8_t,std::vector<pixel> > found;
+  std::map<uint8_t,std::map<pixel,uint8_t> > oldvalue;
+
+  std::vector<std::pair<uint8_t,std::pair<uint8_t,std::vector<pixel> > > >::iterator it_start;
+  std::vector<std::pair<uint8_t,std::pair<uint8_t,std::vector<pixel> > > >::iterator it_end;
+  int increase_op;
+  if((flags&FLAG_RISING_EDGE) != 0) { it_start = packed_dacdac.begin(); it_end = packed_dacdac.end(); increase_op = 1; }
+  else { it_start = packed_dacdac.end()-1; it_end = packed_dacdac.begin()-1; increase_op = -1;  }
+
+  for(std::vector<std::pair<uint8_t,std::pair<uint8_t,std::vector<pixel> > > >::iterator it = it_start; it != it_end; it += increase_op) {
+    for(std::vector<pixel>::iterator pixit = it->second.second.begin(); pixit != it->second.second.end(); ++pixit) {
+      std::vector<std::pair<uint8_t, std::vector<pixel> > >::iterator dac;
+      for(dac = result.begin(); dac != result.end(); ++dac) { if(it->second.first == dac->first) break; }
+      if(dac == result.end()) {
+	result.push_back(std::make_pair(it->second.first,std::vector<pixel>()));
+	dac = result.end() - 1;
+	found.insert(std::make_pair(it->second.first,std::vector<pixel>()));
+	oldvalue.insert(std::make_pair(it->second.first,std::map<pixel,uint8_t>()));
+      }
+
+      std::vector<pixel>::iterator px_found = std::find_if(found[dac->first].begin(), found[dac->first].end(),
+							   findPixelXY(pixit->column(), pixit->row(), pixit->roc()));
+      if(px_found != found[dac->first].end()) continue;
+
+      std::vector<pixel>::iterator px = std::find_if(dac->second.begin(), dac->second.end(),
+						     findPixelXY(pixit->column(), pixit->row(), pixit->roc()));
+      if(px != dac->second.end()) {
+	uint8_t delta_old = abs(oldvalue[dac->first][*px] - threshold);
+	uint8_t delta_new = abs(static_cast<uint8_t>(pixit->value()) - threshold);
+	bool positive_slope = (static_cast<uint8_t>(pixit->value()) - oldvalue[dac->first][*px] > 0 ? true : false);
+	if(positive_slope && !(delta_new < delta_old)) {
+	  found[dac->first].push_back(*pixit);
+	  continue;
+	}
+	px->setValue(it->first);
+	oldvalue[dac->first][*px] = static_cast<uint8_t>(pixit->value());
+      }
+      else {
+	if(pixit->value() >= threshold) { found[dac->first].push_back(*pixit); }
+	oldvalue[dac->first].insert(std::make_pair(*pixit,pixit->value()));
+	pixit->setValue(it->first);
+	dac->second.push_back(*pixit);
+      }
+    }
+  }
+
+  for(std::vector<std::pair<uint8_t,std::vector<pixel> > >::iterator dac = result.begin(); dac != result.end(); ++dac) {
+    for(std::vector<pixel>::iterator px = dac->second.begin(); px != dac->second.end(); px++) {
+      std::vector<pixel>::iterator px_found = std::find_if(found[dac->first].begin(), found[dac->first].end(),
+							   findPixelXY(px->column(), px->row(), px->roc()));
+      if(px_found != found[dac->first].end()) continue;
+      if((flags&FLAG_RISING_EDGE) != 0) { px->setValue(dac2max); }
+      else { px->setValue(dac2min); }
+    }
+  }
+
+  if((flags&FLAG_NOSORT) == 0) { std::sort(result.begin(),result.end()); }
+  return result;
+}
+
+// Efficiency of a pixel with an s-curve at "threshold", with some ripple:
+uint16_t syntheticEfficiency(int dac, int threshold, int width, bool rising, uint16_t nTriggers) {
+  double x = static_cast<double>(rising ? dac - threshold : threshold - dac)/width;
+  int eff = static_cast<int>(nTriggers/(1 + exp(-x))) + rand()%3 - 1;
+  return static_cast<uint16_t>(std::max(0, std::min(static_cast<int>(nTriggers), eff)));
+}
+
+// Synthetic scan data: one event per DAC setting (DAC2 running fastest for DAC/DAC scans), for
+// several rounds, with missing pixels, pixels without threshold and background hits:
+std::vector<Event> syntheticScan(size_t nsettings, size_t rounds, std::vector<pixel> & pixels, std::vector<int> & thresholds, int width, bool rising, uint16_t nTriggers) {
+  std::vector<Event> data;
+  for(size_t r = 0; r < rounds; r++) {
+    for(size_t s = 0; s < nsettings; s++) {
+      Event evt;
+      for(size_t i = 0; i < pixels.size(); i++) {
+	uint16_t eff = syntheticEfficiency(static_cast<int>(s), thresholds[i], width, rising, nTriggers);
+	if(eff == 0 || rand()%10 == 0) continue;
+	evt.pixels.push_back(pixel(pixels[i].roc(), pixels[i].column(), pixels[i].row(), eff));
+      }
+      if(rand()%4 == 0) { evt.pixels.push_back(pixel(rand()%4, rand()%52, rand()%80, rand()%(nTriggers+1))); }
+      std::random_shuffle(evt.pixels.begin(), evt.pixels.end());
+      data.push_back(evt);
+    }
+  }
+  return data;
+}
+
+bool identicalPixels(std::vector<pixel> & a, std::vector<pixel> & b) {
+  if(a.size() != b.size()) return false;
+  for(size_t i = 0; i < a.size(); i++) {
+    if(a[i].roc() != b[i].roc() || a[i].column() != b[i].column() || a[i].row() != b[i].row()
+       || a[i].value() != b[i].value() || a[i].variance() != b[i].variance()) return false;
+  }
+  return true;
+}
+
+void test_threshold_repacking() {
+
+  Log::ReportingLevel() = Log::FromString("INFO");
+  LOG(logINFO) << std::endl << std::endl << "Start Threshold Repacking test...";
+  // The many "No threshold found" warnings are expected here:
+  Log::ReportingLevel() = Log::FromString("ERROR");
+
+  srand(4711);
+  size_t mismatches = 0, compared = 0, notfound = 0;
+  for(int test = 0; test < 200; test++) {
+    uint16_t flags = ((test&1) ? FLAG_RISING_EDGE : 0) | ((test&2) ? FLAG_NOSORT : 0);
+    bool rising = ((flags&FLAG_RISING_EDGE) != 0);
+    uint16_t nTriggers = static_cast<uint16_t>(rand()%20 + 1);
+    uint8_t thresholdlevel = static_cast<uint8_t>(rand()%90 + 10);
+    uint16_t threshold = static_cast<uint16_t>(ceil(static_cast<float>(nTriggers)*thresholdlevel/100));
+    uint8_t dacStep = static_cast<uint8_t>(rand()%4 + 1);
+    uint8_t dacMin = static_cast<uint8_t>(rand()%50);
+    size_t nsteps = rand()%30 + 2;
+    uint8_t dacMax = static_cast<uint8_t>(dacMin + dacStep*(nsteps-1));
+    size_t rounds = rand()%2 + 1;
+
+    // Pixels on up to three ROCs, some of them with the threshold outside of the range:
+    std::vector<pixel> pixels;
+    std::vector<int> thresholds;
+    size_t npixels = rand()%40 + 1;
+    for(size_t i = 0; i < npixels; i++) {
+      pixels.push_back(pixel(rand()%3, rand()%52, rand()%80, 0));
+      thresholds.push_back(rand()%(nsteps + 10) - 5);
+    }
+    int width = rand()%3 + 1;
+
+    if(test%4 < 2 || test >= 100) {
+      // Threshold map:
+      std::vector<Event> data = syntheticScan(nsteps, rounds, pixels, thresholds, width, rising, nTriggers);
+      std::vector<std::pair<uint8_t,std::vector<pixel> > > packed;
+      for(size_t s = 0; s < nsteps; s++) { packed.push_back(std::make_pair(dacMin + s*dacStep, std::vector<pixel>())); }
+      for(size_t e = 0; e < data.size(); e++) {
+	packed[e%nsteps].second.insert(packed[e%nsteps].second.end(), data[e].pixels.begin(), data[e].pixels.end());
+      }
+
+      std::vector<pixel> reference = referenceThresholdMap(packed, dacMin, dacMax, threshold, flags);
+      std::vector<pixel> result = pxarCore::repackThresholdMapData(data, dacStep, dacMin, dacMax, thresholdlevel, nTriggers, flags);
+      compared++;
+      for(size_t i = 0; i < reference.size(); i++) {
+	if(reference[i].value() == (rising ? dacMax : dacMin)) notfound++;
+      }
+      if(!identicalPixels(reference, result)) {
+	LOG(logERROR) << "Threshold map mismatch in test " << test << ": " << reference.size() << " vs. " << result.size() << " pixels.";
+	mismatches++;
+      }
+    }
+    if(test%4 >= 2 || test >= 100) {
+      // Threshold vs. DAC1, DAC2 running fastest:
+      uint8_t dac1step = static_cast<uint8_t>(rand()%3 + 1);
+      uint8_t dac1min = static_cast<uint8_t>(rand()%20);
+      size_t n1 = rand()%5 + 1;
+      uint8_t dac1max = static_cast<uint8_t>(dac1min + dac1step*(n1-1));
+      // The s-curves run along DAC2 and are repeated for every DAC1 value:
+      std::vector<Event> data = syntheticScan(nsteps, rounds*n1, pixels, thresholds, width, rising, nTriggers);
+      std::vector<std::pair<uint8_t,std::pair<uint8_t,std::vector<pixel> > > > packed;
+      for(size_t d1 = 0; d1 < n1; d1++) {
+	for(size_t d2 = 0; d2 < nsteps; d2++) {
+	  packed.push_back(std::make_pair(dac1min + d1*dac1step, std::make_pair(dacMin + d2*dacStep, std::vector<pixel>())));
+	}
+      }
+      for(size_t e = 0; e < data.size(); e++) {
+	std::vector<pixel> & target = packed[e%(n1*nsteps)].second.second;
+	target.insert(target.end(), data[e].pixels.begin(), data[e].pixels.end());
+      }
+
+      std::vector<std::pair<uint8_t,std::vector<pixel> > > reference = referenceThresholdDacScan(packed, dacMin, dacMax, threshold, flags);
+      std::vector<std::pair<uint8_t,std::vector<pixel> > > result = pxarCore::repackThresholdDacScanData(data, dac1step, dac1min, dac1max, dacStep, dacMin, dacMax, thresholdlevel, nTriggers, flags);
+      compared++;
+      bool same = (reference.size() == result.size());
+      for(size_t i = 0; same && i < reference.size(); i++) {
+	same = (reference[i].first == result[i].first && identicalPixels(reference[i].second, result[i].second));
+      }
+      if(!same) {
+	LOG(logERROR) << "Threshold DAC scan mismatch in test " << test << ": " << reference.size() << " vs. " << result.size() << " DAC values.";
+	mismatches++;
+      }
+    }
+  }
+
+  Log::ReportingLevel() = Log::FromString("INFO");
+  LOG(logINFO) << "Compared " << compared << " threshold scans (" << notfound << " pixels without threshold), found " << mismatches << " mismatches.";
+  LOG(logINFO) << "End Threshold Repacking test." << std::endl << std::endl;
+}
+
 int main(int argc, char* argv[]) {
   try {
 
@@ -247,6 +535,8 @@ int main(int argc, char* argv[]) {
     decoder.getStatistics().dump();
 
     test_readback_reset();
+    test_pixel_decoding();
+    test_threshold_repacking();
   }
   catch (std::exception &e){
     std::cout << "exception: " << e.what() << std::endl;
@@ -0,0 +1,345 @@
+/**
+ * pxar comparison of the native fitters with the ROOT fits they replace
+ * fits the same generated curves with the native fitter and with TH1::Fit and
+ * the PixInitFunc start values, as the tests did before:
+ *  - s-curves (shist256) with ScurveFitter and PixTest::threshold()
+ *  - pulse height vs. vcal curves with GainPedestalFitter and the ERR and TANH
+ *    fits of PixTestGainPedestal::fit()
+ * A native result agrees if its parameters are within the stated tolerance of
+ * the ROOT result, or if its chi2 is not larger than the one of the ROOT result.
+ * The latter happens if the minimum is not unique (e.g. the width of a step-like
+ * curve) or if Minuit stopped early. Fails if more than 0.1% of the curves do
+ * not agree.
+ */
+
+#include "GainPedestalFitter.hh"
+#include "PixInitFunc.hh"
+#include "PixUtil.hh"
+#include "ScurveFitter.hh"
+#include "shist256.hh"
+
+#include <TH1D.h>
+#include <TF1.h>
+#include <TMath.h>
+
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <vector>
+#include <cstring>
+#include <stdlib.h>
+
+using namespace std;
+
+namespace {
+
+  // -- tolerances, in DAC units
+  const double THRESHOLD_TOLERANCE(0.05);
+  const double SIGMA_TOLERANCE(0.05);
+  // -- gain/pedestal tolerance, in units of the ROOT parameter errors
+  const double PARAMETER_TOLERANCE(0.1);
+  // -- fraction of curves allowed to disagree
+  const double OUTLIER_FRACTION(0.001);
+  // -- a native chi2 up to this much larger counts as the same minimum
+  const double CHI2_TOLERANCE(1.e-6);
+
+  double uniform() {return rand()/(RAND_MAX + 1.);}
+
+  // The ROOT path of PixTest::threshold(), kept as reference. Returns the fit range in lo, hi:
+  ScurveFitter::result rootThreshold(TH1 *h, PixInitFunc &pif, double &lo, double &hi) {
+    ScurveFitter::result r = {0., 0., 0., 0., 0., false, false};
+    TF1 *f = pif.errScurve(h);
+    f->GetRange(lo, hi);
+    r.thresholdN = h->FindLastBinAbove(0.5*h->GetMaximum());
+    if (pif.doNotFit()) {
+      r.threshold  = f->GetParameter(0);
+      r.thresholdE = 0.3;
+      return r;
+    }
+    h->Fit(f, "qr", "", lo, hi);
+    r.threshold  = f->GetParameter(0);
+    r.thresholdE = f->GetParError(0);
+    r.sigma      = 1./(TMath::Sqrt(2.)/f->GetParameter(1));
+    r.sigmaE     = r.sigma * f->GetParError(1) / f->GetParameter(1);
+    if (r.threshold < h->GetBinLowEdge(1)) {
+      r.threshold = r.thresholdE = r.sigma = r.sigmaE = r.thresholdN = -2.;
+      return r;
+    }
+    if (r.threshold > h->GetBinLowEdge(h->GetNbinsX())) {
+      r.threshold  = h->GetBinLowEdge(h->GetNbinsX());
+      r.thresholdE = r.sigma = r.sigmaE = -1.;
+      r.thresholdN = r.threshold;
+      return r;
+    }
+    r.ok = true;
+    return r;
+  }
+
+  // chi2 of the errScurve() model with fixed plateau, on the points TH1::Fit() uses:
+  double scurveChi2(TH1 *h, double lo, double hi, double threshold, double sigma) {
+    double plateau = 0.5*h->GetMaximum();
+    double chi2(0.);
+    for (int ib = 1; ib <= h->GetNbinsX(); ++ib) {
+      double x = h->GetBinCenter(ib);
+      double e = h->GetBinError(ib);
+      if (x < lo || x > hi || e <= 0.) continue;
+      double r = (h->GetBinContent(ib) - plateau*(erf((x - threshold)/(sqrt(2.)*sigma)) + 1.))/e;
+      chi2 += r*r;
+    }
+    return chi2;
+  }
+
+  // s-curves of ntrig triggers per DAC value, with some empty, step-like and noisy ones:
+  void generateScurves(shist256 *block, int n, int ntrig) {
+    for (int i = 0; i < n; ++i) {
+      if (i%500 == 7) continue;
+      double thr   = (i%250 == 3 ? 250.*uniform() : 20. + 200.*uniform());
+      double sigma = (i%100 == 5 ? 0.05 : 0.3 + 4.*uniform());
+      for (int dac = 0; dac < 256; ++dac) {
+	double p = 0.5*(1. + erf((dac - thr)/(sqrt(2.)*sigma)));
+	int k(0);
+	for (int t = 0; t < ntrig; ++t) if (uniform() < p) ++k;
+	if (i%50 == 11 && dac < thr - 10. && uniform() < 0.02) k = 1;
+	if (k > 0) block[i].fill(dac, k);
+      }
+    }
+  }
+
+  bool test_scurve_fits(int n, int ntrig) {
+    shist256 *block = new shist256[n];
+    vector<shist256*> maps;
+    for (int i = 0; i < n; ++i) maps.push_back(&block[i]);
+    generateScurves(block, n, ntrig);
+
+    ScurveFitter fitter(ntrig);
+    vector<ScurveFitter::result> fits;
+    fitter.fit(maps, fits);
+
+    // -- the histogram of PixTest::scurveAna()
+    PixInitFunc pif;
+    TH1D *h1 = new TH1D("h1", "h1", 256, 0., 256.);
+    h1->Sumw2();
+
+    int nfitted(0), nflags(0), nflat(0), noutside(0);
+    double maxThr(0.), maxSig(0.);
+    for (int i = 0; i < n; ++i) {
+      if (fits[i].empty) continue;
+      h1->Reset();
+      for (int ib = 1; ib <= 256; ++ib) {
+	h1->SetBinContent(ib, maps[i]->get(ib));
+	h1->SetBinError(ib, ntrig*PixUtil::dBinomial(static_cast<int>(maps[i]->get(ib)), ntrig));
+      }
+      double lo, hi;
+      ScurveFitter::result root = rootThreshold(h1, pif, lo, hi);
+      ++nfitted;
+
+      if (root.ok != fits[i].ok || root.thresholdN != fits[i].thresholdN) {
+	if (nflags++ < 5) cout << "  curve " << i << ": ROOT ok = " << root.ok << " thrN = " << root.thresholdN
+			       << ", native ok = " << fits[i].ok << " thrN = " << fits[i].thresholdN << endl;
+	continue;
+      }
+      double dthr = fabs(root.threshold - fits[i].threshold);
+      double dsig = fabs(root.sigma - fits[i].sigma);
+      if (dthr <= THRESHOLD_TOLERANCE && dsig <= SIGMA_TOLERANCE) {
+	if (dthr > maxThr) maxThr = dthr;
+	if (dsig > maxSig) maxSig = dsig;
+	continue;
+      }
+      double chi2Root = scurveChi2(h1, lo, hi, root.threshold, root.sigma);
+      double chi2Native = scurveChi2(h1, lo, hi, fits[i].threshold, fits[i].sigma);
+      if (root.ok && chi2Native <= chi2Root*(1. + CHI2_TOLERANCE) + CHI2_TOLERANCE) {
+	++nflat;
+	continue;
+      }
+      if (noutside++ < 5) cout << "  curve " << i << ": ROOT thr = " << root.threshold << " sig = " << root.sigma << " chi2 = " << chi2Root
+			       << ", native thr = " << fits[i].threshold << " sig = " << fits[i].sigma << " chi2 = " << chi2Native << endl;
+    }
+    delete h1;
+    delete[] block;
+
+    int nbad = nflags + noutside;
+    bool ok = (nbad <= OUTLIER_FRACTION*nfitted);
+    cout << "s-curves: " << nfitted << " fitted, " << nfitted - nflags - nflat - noutside << " within |dthr| <= "
+	 << THRESHOLD_TOLERANCE << " and |dsig| <= " << SIGMA_TOLERANCE << " (max " << maxThr << ", " << maxSig << "), "
+	 << nflat << " outside with a native chi2 not larger, " << noutside << " worse, " << nflags
+	 << " with different flags - " << (ok ? "ok" : "FAILED") << endl;
+    return ok;
+  }
+
+  double gauss() {
+    double u1 = uniform(), u2 = uniform();
+    return sqrt(-2.*log(1. - u1))*cos(2.*TMath::Pi()*u2);
+  }
+
+  // chi2 of f with parameters p on the points TH1::Fit() uses in the range of f:
+  double functionChi2(TH1 *h, TF1 *f, const double *p) {
+    double lo, hi;
+    f->GetRange(lo, hi);
+    f->SetParameters(p);
+    double chi2(0.);
+    for (int ib = 1; ib <= h->GetNbinsX(); ++ib) {
+      double x = h->GetBinCenter(ib);
+      double e = h->GetBinError(ib);
+      if (x < lo || x > hi || e <= 0.) continue;
+      double r = (h->GetBinContent(ib) - f->Eval(x))/e;
+      chi2 += r*r;
+    }
+    return chi2;
+  }
+
+  // pulse heights at the low and high range vcal points of PixTestGainPedestal::measure()
+  // (vcal step 10, extended), with dead pixels and no hits below the pixel threshold:
+  void generateGainPedestal(int mode, int n, vector<int> &lpoints, vector<int> &hpoints,
+			    vector<vector<double> > &lph, vector<vector<double> > &hph) {
+    lpoints.clear();
+    for (int value = 10; value <= 255; value += 10) lpoints.push_back(value);
+    int h[] = {10, 17, 24, 30, 50, 70, 90, 120, 200};
+    hpoints.assign(h, h + sizeof(h)/sizeof(h[0]));
+
+    lph.assign(n, vector<double>(lpoints.size(), 0.));
+    hph.assign(n, vector<double>(hpoints.size(), 0.));
+    for (int i = 0; i < n; ++i) {
+      if (i%500 == 7) continue;
+      double p[4];
+      if (0 == mode) {
+	p[0] = 100. + 300.*uniform();
+	p[1] = 300. + 400.*uniform();
+	p[2] = 1.0 + 0.4*uniform();
+	p[3] = 50. + 50.*uniform();
+      } else {
+	p[0] = 1.2e-3 + 0.6e-3*uniform();
+	p[1] = 0.3 + 1.2*uniform();
+	p[2] = 60. + 40.*uniform();
+	p[3] = 100. + 50.*uniform();
+      }
+      double thr = 15. + 30.*uniform();
+      for (unsigned int k = 0; k < lpoints.size() + hpoints.size(); ++k) {
+	bool low = (k < lpoints.size());
+	double x = (low ? lpoints[k] : 7*hpoints[k - lpoints.size()]);
+	if (x < thr) continue;
+	double y = (0 == mode ? p[3]*(erf((x - p[0])/p[1]) + p[2]) : p[3] + p[2]*tanh(p[0]*x - p[1]));
+	y += gauss();
+	if (y < 0.) y = 0.;
+	if (y > 255.) y = 255.;
+	if (low) lph[i][k] = y;
+	else hph[i][k - lpoints.size()] = y;
+      }
+    }
+  }
+
+  bool test_gainpedestal_fits(int mode, int n) {
+    vector<int> lpoints, hpoints;
+    vector<vector<double> > lph, hph;
+    generateGainPedestal(mode, n, lpoints, hpoints, lph, hph);
+    double fracErr(0.05);
+
+    // -- the curves of PixTestGainPedestal::fit()
+    vector<GainPedestalFitter::curve> curves;
+    for (int i = 0; i < n; ++i) {
+      map<int, double> bins;
+      for (unsigned int ib = 0; ib < lpoints.size(); ++ib) bins[lpoints[ib]] = lph[i][ib];
+      for (unsigned int ib = 0; ib < hpoints.size(); ++ib) bins[7*hpoints[ib]] = hph[i][ib];
+      GainPedestalFitter::curve c;
+      for (map<int, double>::iterator it = bins.begin(); it != bins.end(); ++it) {
+	c.add(it->first + 0.5, it->second, fracErr*it->second);
+      }
+      curves.push_back(c);
+    }
+    GainPedestalFitter fitter(mode);
+    vector<GainPedestalFitter::result> fits;
+    fitter.fit(curves, fits);
+
+    // -- the histogram and ROOT fit of PixTestGainPedestal::fit()
+    PixInitFunc pif;
+    TH1D *h1 = new TH1D("h1", "h1", 1800, 0., 1800.);
+
+    int nfitted(0), nflags(0), nflat(0), noutside(0);
+    double maxPull(0.);
+    for (int i = 0; i < n; ++i) {
+      h1->Reset();
+      for (unsigned int ib = 0; ib < lpoints.size(); ++ib) {
+	h1->SetBinContent(lpoints[ib]+1, lph[i][ib]);
+	h1->SetBinError(lpoints[ib]+1, fracErr*lph[i][ib]);
+      }
+      for (unsigned int ib = 0; ib < hpoints.size(); ++ib) {
+	h1->SetBinContent(7*hpoints[ib]+1, hph[i][ib]);
+	h1->SetBinError(7*hpoints[ib]+1, fracErr*hph[i][ib]);
+      }
+      TF1 *f = (0 == mode ? pif.gpErr(h1) : pif.gpTanH(h1));
+      if (h1->Integral() < 1) continue;
+      h1->Fit(f, "rq");
+      ++nfitted;
+
+      double root[4], rootE[4];
+      for (int k = 0; k < 4; ++k) {
+	root[k]  = f->GetParameter(k);
+	rootE[k] = f->GetParError(k);
+      }
+      if (!fits[i].fitted) {
+	if (nflags++ < 5) cout << "  curve " << i << ": not fitted by GainPedestalFitter" << endl;
+	continue;
+      }
+      bool within(true);
+      for (int k = 0; k < 4; ++k) {
+	double dp = fabs(fits[i].p[k] - root[k]);
+	if (dp > PARAMETER_TOLERANCE*rootE[k] + 1.e-6*fabs(root[k])) within = false;
+	if (rootE[k] > 0. && dp/rootE[k] > maxPull) maxPull = dp/rootE[k];
+      }
+      if (within) continue;
+      double chi2Root = functionChi2(h1, f, root);
+      double chi2Native = functionChi2(h1, f, fits[i].p);
+      if (chi2Native <= chi2Root*(1. + CHI2_TOLERANCE) + CHI2_TOLERANCE) {
+	++nflat;
+	continue;
+      }
+      if (noutside++ < 5) {
+	cout << "  curve " << i << ": ROOT";
+	for (int k = 0; k < 4; ++k) cout << " " << root[k] << " +/- " << rootE[k];
+	cout << " chi2 = " << chi2Root << ", native";
+	for (int k = 0; k < 4; ++k) cout << " " << fits[i].p[k];
+	cout << " chi2 = " << chi2Native << endl;
+      }
+    }
+    delete h1;
+
+    int nbad = nflags + noutside;
+    bool ok = (nbad <= OUTLIER_FRACTION*nfitted);
+    cout << (0 == mode ? "gain/pedestal ERR: " : "gain/pedestal TANH: ") << nfitted << " fitted, "
+	 << nfitted - nflags - nflat - noutside << " within " << PARAMETER_TOLERANCE
+	 << " parameter errors (max " << maxPull << "), " << nflat << " outside with a native chi2 not larger, "
+	 << noutside << " worse, " << nflags << " not fitted - " << (ok ? "ok" : "FAILED") << endl;
+    return ok;
+  }
+}
+
+int main(int argc, char* argv[]) {
+
+  int n = 4160;
+  int ntrig = 10;
+
+  // Quick and hacky cli arguments reading:
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i],"-h")) {
+      cout << "Help:" << endl;
+      cout << "-n curves      number of curves per fit type, default 4160" << endl;
+      cout << "-t triggers    number of triggers of the s-curves, default 10" << endl;
+      return 0;
+    }
+    else if (!strcmp(argv[i],"-n")) { n = atoi(argv[++i]); }
+    else if (!strcmp(argv[i],"-t")) { ntrig = atoi(argv[++i]); }
+    else {
+      cout << "Unrecognized command line option " << argv[i] << endl;
+    }
+  }
+
+  if (n < 1 || ntrig < 1) {
+    cout << "Invalid settings." << endl;
+    return -1;
+  }
+
+  srand(4711);
+  bool ok = test_scurve_fits(n, ntrig);
+  ok = test_gainpedestal_fits(0, n) && ok;
+  ok = test_gainpedestal_fits(1, n) && ok;
+  return (ok ? 0 : -1);
+}
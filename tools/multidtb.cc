@@ -0,0 +1,302 @@
+#ifndef WIN32
+#include <pthread.h>
+#endif
+
+#include "api.h"
+#include "log.h"
+#include "timer.h"
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+#include <stdlib.h>
+
+// Runs the same test sequence on several testboards at the same time, one
+// pxarCore and one thread per DTB. With the emulator, every instance is a
+// testboard of its own.
+
+struct station {
+  // --- settings
+  std::string usbId;
+  std::string name;
+  std::string verbosity;
+  std::string logfile;
+  int nrocs;
+  uint16_t ntrig;
+
+  // --- results
+  bool ok;
+  std::string error;
+  double ia, id;
+  size_t efficient, pixels;
+  double meanPh;
+  size_t events;
+  uint32_t errors;
+  uint32_t duration;
+};
+
+void setup(station & s,
+	   std::vector<std::pair<std::string,uint8_t> > & sig_delays,
+	   std::vector<std::pair<std::string,double> > & power_settings,
+	   std::vector<std::pair<std::string,uint8_t> > & pg_setup,
+	   std::vector<std::vector<std::pair<std::string,uint8_t> > > & tbmDACs,
+	   std::vector<std::vector<std::pair<std::string,uint8_t> > > & rocDACs,
+	   std::vector<std::vector<pxar::pixelConfig> > & rocPixels) {
+
+  // DTB delays
+  sig_delays.push_back(std::make_pair("clk",2));
+  sig_delays.push_back(std::make_pair("ctr",2));
+  sig_delays.push_back(std::make_pair("sda",17));
+  sig_delays.push_back(std::make_pair("tin",7));
+  sig_delays.push_back(std::make_pair("deser160phase",4));
+
+  // Power settings:
+  power_settings.push_back(std::make_pair("va",1.9));
+  power_settings.push_back(std::make_pair("vd",2.6));
+  power_settings.push_back(std::make_pair("ia",1.190));
+  power_settings.push_back(std::make_pair("id",1.10));
+
+  // Pattern Generator for test pulses:
+  if(s.nrocs > 1) { pg_setup.push_back(std::make_pair("resettbm",25)); }
+  else { pg_setup.push_back(std::make_pair("resetroc",25)); }
+  pg_setup.push_back(std::make_pair("calibrate",106));
+  if(s.nrocs > 1) { pg_setup.push_back(std::make_pair("trigger;sync",0)); }
+  else {
+    pg_setup.push_back(std::make_pair("trigger",16));
+    pg_setup.push_back(std::make_pair("token",0));
+  }
+
+  // A module is read out through a TBM:
+  if(s.nrocs > 1) {
+    std::vector<std::pair<std::string,uint8_t> > regs;
+    regs.push_back(std::make_pair("clear",0xF0));
+    regs.push_back(std::make_pair("mode",0xC0));
+    tbmDACs.push_back(regs);
+  }
+
+  std::vector<std::pair<std::string,uint8_t> > dacs;
+  dacs.push_back(std::make_pair("Vdig",8));
+  dacs.push_back(std::make_pair("Vana",78));
+  dacs.push_back(std::make_pair("Vsf",80));
+  dacs.push_back(std::make_pair("Vcomp",12));
+  dacs.push_back(std::make_pair("VwllPr",150));
+  dacs.push_back(std::make_pair("VwllSh",150));
+  dacs.push_back(std::make_pair("VhldDel",117));
+  dacs.push_back(std::make_pair("Vtrim",152));
+  dacs.push_back(std::make_pair("VthrComp",89));
+  dacs.push_back(std::make_pair("VIBias_Bus",30));
+  dacs.push_back(std::make_pair("Vbias_sf",6));
+  dacs.push_back(std::make_pair("VoffsetOp",60));
+  dacs.push_back(std::make_pair("VOffsetRO",225));
+  dacs.push_back(std::make_pair("VIon",45));
+  dacs.push_back(std::make_pair("Vcomp_ADC",10));
+  dacs.push_back(std::make_pair("VIref_ADC",70));
+  dacs.push_back(std::make_pair("VIbias_roc",150));
+  dacs.push_back(std::make_pair("VIColOr",99));
+  dacs.push_back(std::make_pair("Vcal",199));
+  dacs.push_back(std::make_pair("CalDel",140));
+  dacs.push_back(std::make_pair("CtrlReg",0));
+  dacs.push_back(std::make_pair("WBC",100));
+
+  std::vector<pxar::pixelConfig> pixels;
+  for(int col = 0; col < 52; col++) {
+    for(int row = 0; row < 80; row++) {
+      pixels.push_back(pxar::pixelConfig(col,row,15));
+    }
+  }
+
+  for(int i = 0; i < s.nrocs; i++) {
+    rocDACs.push_back(dacs);
+    rocPixels.push_back(pixels);
+  }
+}
+
+// The test sequence, executed by one thread per station:
+void * run(void * arg) {
+  station & s = *static_cast<station*>(arg);
+  pxar::timer t;
+
+  // Messages of this thread, also from outside the pxarCore calls, carry the station name.
+  // With a level of its own, the pxarCore constructor sets this level instead of the
+  // process-wide one shared with the other stations:
+  FILE * stream = NULL;
+  if(s.logfile != "") { stream = fopen(s.logfile.c_str(), "w"); }
+  pxar::logContext context;
+  context.name = s.name;
+  context.ownLevel = true;
+  context.level = pxar::Log::FromString(s.verbosity);
+  context.stream = stream;
+  pxar::logContextGuard log(&context);
+
+  std::vector<std::pair<std::string,uint8_t> > sig_delays, pg_setup;
+  std::vector<std::pair<std::string,double> > power_settings;
+  std::vector<std::vector<std::pair<std::string,uint8_t> > > tbmDACs, rocDACs;
+  std::vector<std::vector<pxar::pixelConfig> > rocPixels;
+  setup(s, sig_delays, power_settings, pg_setup, tbmDACs, rocDACs, rocPixels);
+
+  pxar::pxarCore * api = NULL;
+  try {
+    api = new pxar::pxarCore(s.usbId, s.verbosity);
+    api->setLogContext(s.name, s.verbosity, stream);
+
+    if(!api->initTestboard(sig_delays, power_settings, pg_setup)) { throw std::runtime_error("initTestboard failed"); }
+    if(!api->initDUT(31, "tbm08", tbmDACs, "psi46digv21", rocDACs, rocPixels)) {
+      throw std::runtime_error("initDUT failed");
+    }
+
+    s.ia = api->getTBia();
+    s.id = api->getTBid();
+
+    // Maps of all pixels:
+    api->_dut->testAllPixels(true);
+    api->_dut->maskAllPixels(false);
+    std::vector<pxar::pixel> map = api->getEfficiencyMap(0, s.ntrig);
+    s.pixels = map.size();
+    for(size_t i = 0; i < map.size(); i++) { if(map[i].value() >= s.ntrig) s.efficient++; }
+
+    map = api->getPulseheightMap(0, s.ntrig);
+    double sum = 0;
+    for(size_t i = 0; i < map.size(); i++) { sum += map[i].value(); }
+    if(!map.empty()) s.meanPh = sum/map.size();
+
+    // Triggers with test pulses on a few pixels:
+    api->_dut->testAllPixels(false);
+    for(int i = 0; i < 3; i++) { api->_dut->testPixel(i,5,true); }
+    api->daqStart();
+    api->daqTrigger(10*s.ntrig);
+    std::vector<pxar::Event> events = api->daqGetEventBuffer();
+    api->daqStop();
+    s.events = events.size();
+    s.errors = api->getStatistics().errors();
+
+    s.ok = true;
+  }
+  catch(std::exception & e) {
+    s.error = e.what();
+    LOG(pxar::logERROR) << "Test sequence failed: " << s.error;
+  }
+  catch(...) {
+    s.error = "unknown exception";
+    LOG(pxar::logERROR) << "Test sequence failed.";
+  }
+
+  delete api;
+  s.duration = t.get();
+  if(stream) { fclose(stream); }
+  return NULL;
+}
+
+int main(int argc, char* argv[]) {
+
+  std::vector<std::string> names;
+  std::string verbosity = "WARNING";
+  std::string logprefix;
+  int ninstances = 0;
+  int nrocs = 1;
+  uint16_t ntrig = 10;
+  bool serial = false;
+
+  // Quick and hacky cli arguments reading:
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i],"-h")) {
+      std::cout << "Help:" << std::endl;
+      std::cout << "-d name        DTB to use, can be given several times" << std::endl;
+      std::cout << "-n number      number of DTBs, all opened as \"*\" (for the emulator)" << std::endl;
+      std::cout << "-r nrocs       1 for a single ROC (default), 16 for a module" << std::endl;
+      std::cout << "-t triggers    number of triggers per pixel, default 10" << std::endl;
+      std::cout << "-v verbosity   verbosity level, default WARNING" << std::endl;
+      std::cout << "-l prefix      log of each DTB into the file prefix_<name>.log" << std::endl;
+      std::cout << "-s             run the DTBs one after the other" << std::endl;
+      return 0;
+    }
+    else if (!strcmp(argv[i],"-d")) { names.push_back(std::string(argv[++i])); }
+    else if (!strcmp(argv[i],"-n")) { ninstances = atoi(argv[++i]); }
+    else if (!strcmp(argv[i],"-r")) { nrocs = atoi(argv[++i]); }
+    else if (!strcmp(argv[i],"-t")) { ntrig = static_cast<uint16_t>(atoi(argv[++i])); }
+    else if (!strcmp(argv[i],"-v")) { verbosity = std::string(argv[++i]); }
+    else if (!strcmp(argv[i],"-l")) { logprefix = std::string(argv[++i]); }
+    else if (!strcmp(argv[i],"-s")) { serial = true; }
+    else {
+      std::cout << "Unrecognized command line option " << argv[i] << std::endl;
+    }
+  }
+
+  // The token chains of the TBM are set up for full modules only:
+  if(nrocs != 1 && nrocs != 16) {
+    std::cout << "Number of ROCs must be 1 (single ROC) or 16 (module)." << std::endl;
+    return -1;
+  }
+
+  std::vector<station> stations;
+  size_t n = (names.empty() ? static_cast<size_t>(ninstances > 0 ? ninstances : 1) : names.size());
+  for(size_t i = 0; i < n; i++) {
+    station s;
+    s.usbId = (names.empty() ? "*" : names.at(i));
+    std::stringstream name;
+    if(names.empty()) { name << "dtb" << i; }
+    else { name << names.at(i); }
+    s.name = name.str();
+    s.verbosity = verbosity;
+    if(logprefix != "") { s.logfile = logprefix + "_" + s.name + ".log"; }
+    s.nrocs = nrocs;
+    s.ntrig = ntrig;
+    s.ok = false;
+    s.ia = s.id = 0;
+    s.efficient = s.pixels = 0;
+    s.meanPh = 0;
+    s.events = 0;
+    s.errors = 0;
+    s.duration = 0;
+    stations.push_back(s);
+  }
+
+  std::cout << "Running the test sequence on " << stations.size() << " DTB(s)"
+	    << (serial ? " one after the other." : " in parallel.") << std::endl;
+  pxar::timer t;
+
+#ifndef WIN32
+  if(!serial) {
+    std::vector<pthread_t> threads(stations.size());
+    std::vector<bool> started(stations.size(), false);
+    for(size_t i = 0; i < stations.size(); i++) {
+      started[i] = (pthread_create(&threads[i], NULL, run, &stations[i]) == 0);
+      if(!started[i]) { run(&stations[i]); }
+    }
+    for(size_t i = 0; i < stations.size(); i++) {
+      if(started[i]) { pthread_join(threads[i], NULL); }
+    }
+  }
+  else
+#endif
+  for(size_t i = 0; i < stations.size(); i++) { run(&stations[i]); }
+
+  uint32_t wall = t.get();
+
+  // Summary, one line per DTB:
+  int failed = 0;
+  std::cout << std::setw(12) << "DTB" << std::setw(9) << "ia/mA" << std::setw(9) << "id/mA"
+	    << std::setw(16) << "efficient" << std::setw(9) << "mean PH" << std::setw(9) << "events"
+	    << std::setw(8) << "errors" << std::setw(10) << "time/ms" << std::endl;
+  for(size_t i = 0; i < stations.size(); i++) {
+    station & s = stations.at(i);
+    std::cout << std::setw(12) << s.name;
+    if(!s.ok) {
+      std::cout << "  FAILED: " << s.error << std::endl;
+      failed++;
+      continue;
+    }
+    std::stringstream eff;
+    eff << s.efficient << "/" << s.pixels;
+    std::cout << std::fixed << std::setprecision(1)
+	      << std::setw(9) << s.ia*1000 << std::setw(9) << s.id*1000
+	      << std::setw(16) << eff.str() << std::setw(9) << s.meanPh << std::setw(9) << s.events
+	      << std::setw(8) << s.errors << std::setw(10) << s.duration << std::endl;
+  }
+  std::cout << "Total time: " << wall << "ms" << std::endl;
+
+  return (failed > 0 ? -1 : 0);
+}
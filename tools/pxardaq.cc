@@ -6,6 +6,7 @@
 
 #include "pxar.h"
 #include "timer.h"
+#include "eventfile.h"
 #include <iomanip>
 #include <iostream>
 #include <fstream>
@@ -47,11 +48,12 @@ int getspill() {
 int main(int argc, char* argv[]) {
 
   std::cout << argc << " arguments provided." << std::endl;
-  std::string verbosity, filename;
+  std::string verbosity, filename, eventfilename;
   uint32_t triggers = 0;
   bool testpulses = false;
   bool spills = false;
   bool oos = false;
+  bool keepraw = false;
 
   uint8_t hubid = 31;
 
@@ -60,6 +62,8 @@ int main(int argc, char* argv[]) {
     if (!strcmp(argv[i],"-h")) {
       std::cout << "Help:" << std::endl;
       std::cout << "-f filename    file to store DAQ data in" << std::endl;
+      std::cout << "-e filename    store decoded events in a pxar event file instead" << std::endl;
+      std::cout << "-raw           keep the raw data in the event file for re-decoding" << std::endl;
       std::cout << "-n triggers    number of triggers to be sent" << std::endl;
       std::cout << "-v verbosity   verbosity level, default INFO" << std::endl;
       std::cout << "-sp            lock on accelerator spills" << std::endl;
@@ -72,6 +76,15 @@ int main(int argc, char* argv[]) {
       std::cout << "Writing to file " << filename << std::endl;
       continue;
     }
+    else if (!strcmp(argv[i],"-e")) {
+      eventfilename = std::string(argv[++i]);
+      std::cout << "Writing decoded events to file " << eventfilename << std::endl;
+      continue;
+    }
+    else if (!strcmp(argv[i],"-raw")) {
+      keepraw = true;
+      continue;
+    }
     else if (!strcmp(argv[i],"-n")) {
       triggers = atoi(argv[++i]);
       std::cout << "Sending " << triggers << " triggers" << std::endl;
@@ -204,6 +217,9 @@ int main(int argc, char* argv[]) {
   rocDACs.push_back(dacs);
   rocPixels.push_back(pixels);
 
+  // Event file, written block by block while taking data:
+  pxar::eventFileWriter * eventfile = NULL;
+
   // Create new API instance:
   try {
     _api = new pxar::pxarCore("*",verbosity != "" ? verbosity : "INFO");
@@ -254,6 +270,8 @@ int main(int argc, char* argv[]) {
     int oldspillnumber = 0;
     pxar::timer * spillruntime = new pxar::timer();
 
+    if(eventfilename != "") { eventfile = new pxar::eventFileWriter(eventfilename); }
+
     // Wait for next spill until we start the DAQ:
     if(spills) {
       oldspillnumber = getspill();
@@ -317,6 +335,19 @@ int main(int argc, char* argv[]) {
       // Stop the DAQ:
       _api->daqStop();
 
+      // Decode the data and append it to the event file as a new block:
+      if(eventfile) {
+	std::cout << "Start reading and decoding data from DTB RAM." << std::endl;
+	std::vector<pxar::rawEvent> rawdat;
+	std::vector<pxar::Event> evtdat;
+	try { evtdat = keepraw ? _api->daqGetEventBuffer(rawdat) : _api->daqGetEventBuffer(); }
+	catch(pxar::DataNoEvent &) {}
+	eventfile->writeBlock(evtdat, _api->getStatistics(), keepraw ? &rawdat : NULL);
+	std::cout << "Wrote " << evtdat.size() << " events to file " << eventfilename
+		  << " (" << eventfile->events() << " in total)" << std::endl;
+	continue;
+      }
+
       // And read out the full buffer:
       std::cout << "Start reading data from DTB RAM." << std::endl;
       std::vector<uint16_t> daqdat = _api->daqGetBuffer();
@@ -341,6 +372,7 @@ int main(int argc, char* argv[]) {
     } // End of DAQ loop
 
     delete spillruntime;
+    delete eventfile;
     _api->HVoff();
 
     // And end that whole thing correcly:
@@ -349,6 +381,7 @@ int main(int argc, char* argv[]) {
   }
   catch (...) {
     std::cout << "pxar takedata mode caught an exception. Exiting." << std::endl;
+    delete eventfile;
     delete _api;
     return -1;
   }
@@ -0,0 +1,419 @@
+/**
+ * pxar offline raw data decoder
+ * decodes raw DAQ data dumps as written by pxardaq and stores the decoded
+ * events in a pxar event file. The dump is memory-mapped and cut into chunks
+ * at event boundaries, the chunks are decoded in parallel.
+ */
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "datapipe.h"
+#include "dictionaries.h"
+#include "eventfile.h"
+#include "exceptions.h"
+#include "log.h"
+#include "timer.h"
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <stdlib.h>
+
+using namespace pxar;
+
+namespace {
+
+  // Number of event boundaries a chunk decoder starts ahead of its chunk. The events
+  // decoded in this warm-up are dropped, it only serves to bring the splitter and the
+  // decoder (event ID and readback checks) into the state a serial decoding would have:
+  const size_t warmupEvents = 64;
+
+  // Data source handing out the words of a memory region, i.e. of the mapped file:
+  class memorySource : public dataSource<uint16_t> {
+    const uint16_t * begin;
+    const uint16_t * end;
+    const uint16_t * pos;
+    uint16_t lastSample;
+    uint8_t channel;
+    uint8_t chainlength;
+    uint8_t chainlengthOffset;
+    uint8_t envelopetype;
+    uint8_t devicetype;
+
+    uint16_t Read() {
+      if(pos == end) throw dsBufferEmpty();
+      return lastSample = *pos++;
+    }
+    const uint16_t* ReadBlock(size_t &count) {
+      if(pos == end) throw dsBufferEmpty();
+      count = end - pos;
+      return pos;
+    }
+    void ReadAdvance(size_t count) {
+      pos += count;
+      lastSample = *(pos-1);
+    }
+    uint16_t ReadLast() { return lastSample; }
+    uint8_t ReadChannel() { return channel; }
+    uint16_t ReadFlags() { return 0; }
+    uint8_t ReadTokenChainLength() { return chainlength; }
+    uint8_t ReadTokenChainOffset() { return chainlengthOffset; }
+    uint8_t ReadEnvelopeType() { return envelopetype; }
+    uint8_t ReadDeviceType() { return devicetype; }
+  public:
+  memorySource(const uint16_t * first, const uint16_t * last, uint8_t daqchannel, uint8_t tokenChainLength, uint8_t offset, uint8_t tbmtype, uint8_t roctype)
+    : begin(first), end(last), pos(first), lastSample(0x4000), channel(daqchannel), chainlength(tokenChainLength), chainlengthOffset(offset), envelopetype(tbmtype), devicetype(roctype) {}
+    // Number of words consumed so far:
+    size_t Position() { return pos - begin; }
+  };
+
+  // Returns true if a serial dtbEventSplitter starts a new event at word i, i.e. the
+  // previous word is an event end marker and word i an event start marker:
+  bool isEventStart(const uint16_t * data, size_t i, uint8_t tbmtype) {
+    if(i == 0) return true;
+    if(tbmtype == TBM_NONE) return (data[i-1] & 0x4000) && (data[i] & 0x8000);
+    if(tbmtype == TBM_EMU) return (data[i-1] & 0xef00) == 0xc000 && (data[i] & 0xe000) == 0xa000;
+    return (data[i-1] & 0xe000) == 0xc000 && (data[i] & 0xe000) == 0xa000;
+  }
+
+  // One chunk of the raw data. Events are assigned to the chunk by the position of
+  // their last word, the chunk owns all events ending in (begin, end]. Decoding
+  // starts at warmup to catch up with the state of a serial decoding:
+  struct decodeChunk {
+    decodeChunk() : warmup(0), begin(0), end(0), events(), raw(), stats(), done(false), error() {}
+    size_t warmup;
+    size_t begin;
+    size_t end;
+    std::vector<Event> events;
+    std::vector<rawEvent> raw;
+    statistics stats;
+    bool done;
+    std::string error;
+  };
+
+  struct decodeJob {
+    const uint16_t * data;
+    size_t size;
+    uint8_t channel;
+    uint8_t chainlength;
+    uint8_t offset;
+    uint8_t tbmtype;
+    uint8_t roctype;
+    bool keepraw;
+    std::vector<decodeChunk> chunks;
+#ifndef WIN32
+    // Chunks are handed out in order, at most window chunks ahead of the writer:
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    size_t next;
+    size_t written;
+    size_t window;
+#endif
+  };
+
+  void decode(decodeJob & job, decodeChunk & chunk) {
+    memorySource src(job.data + chunk.warmup, job.data + job.size, job.channel, job.chainlength, job.offset, job.tbmtype, job.roctype);
+    dtbEventSplitter splitter;
+    dtbEventDecoder decoder;
+    dataSink<Event*> Eventpump;
+    src >> splitter >> decoder >> Eventpump;
+
+    try {
+      while(1) {
+	Event * evt = Eventpump.Get();
+	size_t pos = chunk.warmup + src.Position();
+	// Statistics are collected event by event to drop the ones of foreign events:
+	statistics stats = decoder.getStatistics();
+	if(pos <= chunk.begin) continue;
+	if(pos > chunk.end) break;
+
+	chunk.stats += stats;
+	chunk.events.push_back(*evt);
+	if(job.keepraw) { chunk.raw.push_back(*decoder.GetLast()); }
+	if(pos == chunk.end) break;
+      }
+    }
+    // An incomplete event at the end of the file is dropped, as in a serial decoding:
+    catch(dsBufferEmpty &) {}
+    catch(dataPipeException &e) { chunk.error = e.what(); }
+    // Decoding errors abort the decoding, keep the statistics of the failing event:
+    catch(pxarException &e) {
+      chunk.error = e.what();
+      chunk.stats += decoder.getStatistics();
+    }
+  }
+
+#ifndef WIN32
+  void * decodeWorker(void * arg) {
+    decodeJob * job = static_cast<decodeJob*>(arg);
+    while(1) {
+      pthread_mutex_lock(&job->lock);
+      while(job->next < job->chunks.size() && job->next >= job->written + job->window) {
+	pthread_cond_wait(&job->wakeup, &job->lock);
+      }
+      if(job->next >= job->chunks.size()) {
+	pthread_mutex_unlock(&job->lock);
+	break;
+      }
+      decodeChunk & chunk = job->chunks.at(job->next++);
+      pthread_mutex_unlock(&job->lock);
+
+      decode(*job, chunk);
+
+      pthread_mutex_lock(&job->lock);
+      chunk.done = true;
+      pthread_cond_broadcast(&job->wakeup);
+      pthread_mutex_unlock(&job->lock);
+    }
+    return NULL;
+  }
+#endif
+
+  // Cut the data into chunks of roughly chunksize words at event boundaries:
+  void prepareChunks(decodeJob & job, size_t chunksize) {
+    std::vector<size_t> cuts(1, 0);
+    size_t i = chunksize;
+    while(i < job.size) {
+      while(i < job.size && !isEventStart(job.data, i, job.tbmtype)) { i++; }
+      if(i >= job.size) break;
+      cuts.push_back(i);
+      i += chunksize;
+    }
+    cuts.push_back(job.size);
+
+    for(size_t c = 0; c + 1 < cuts.size(); c++) {
+      decodeChunk chunk;
+      chunk.begin = cuts.at(c);
+      chunk.end = cuts.at(c+1);
+      // Step back over the warm-up events:
+      chunk.warmup = chunk.begin;
+      for(size_t n = 0; n < warmupEvents && chunk.warmup > 0; n++) {
+	do { chunk.warmup--; } while(!isEventStart(job.data, chunk.warmup, job.tbmtype));
+      }
+      job.chunks.push_back(chunk);
+    }
+  }
+}
+
+int main(int argc, char* argv[]) {
+
+  std::string infile, outfile, verbosity = "INFO";
+  std::string tbmtype = "tbm08c", roctype = "psi46digv21respin";
+  int channel = 0, chainlength = 8, offset = 0;
+  size_t chunksize = 1 << 22;
+  size_t nthreads = 1;
+  bool keepraw = false;
+#ifndef WIN32
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  if(cores > 0) { nthreads = static_cast<size_t>(cores); }
+#endif
+
+  // Quick and hacky cli arguments reading:
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i],"-h")) {
+      std::cout << "Help:" << std::endl;
+      std::cout << "-f filename    raw data file as written by pxardaq -f" << std::endl;
+      std::cout << "-o filename    pxar event file to store the decoded events in" << std::endl;
+      std::cout << "-raw           keep the raw data in the event file" << std::endl;
+      std::cout << "-tbm type      TBM type of the data, default " << tbmtype << std::endl;
+      std::cout << "-roc type      ROC type of the data, default " << roctype << std::endl;
+      std::cout << "-c channel     DAQ channel the data was read from, default " << channel << std::endl;
+      std::cout << "-n rocs        number of ROCs in the token chain, default " << chainlength << std::endl;
+      std::cout << "-offset id     ID of the first ROC in the token chain, default " << offset << std::endl;
+      std::cout << "-j threads     number of decoding threads, default " << nthreads << std::endl;
+      std::cout << "-chunk words   number of words decoded per chunk, default " << chunksize << std::endl;
+      std::cout << "-v verbosity   verbosity level, default " << verbosity << std::endl;
+      std::cout << "The data of all DAQ channels is decoded with the same settings." << std::endl;
+      return 0;
+    }
+    else if (!strcmp(argv[i],"-f")) { infile = std::string(argv[++i]); }
+    else if (!strcmp(argv[i],"-o")) { outfile = std::string(argv[++i]); }
+    else if (!strcmp(argv[i],"-raw")) { keepraw = true; }
+    else if (!strcmp(argv[i],"-tbm")) { tbmtype = std::string(argv[++i]); }
+    else if (!strcmp(argv[i],"-roc")) { roctype = std::string(argv[++i]); }
+    else if (!strcmp(argv[i],"-c")) { channel = atoi(argv[++i]); }
+    else if (!strcmp(argv[i],"-n")) { chainlength = atoi(argv[++i]); }
+    else if (!strcmp(argv[i],"-offset")) { offset = atoi(argv[++i]); }
+    else if (!strcmp(argv[i],"-j")) { nthreads = std::max(1, atoi(argv[++i])); }
+    else if (!strcmp(argv[i],"-chunk")) { chunksize = std::max(1, atoi(argv[++i])); }
+    else if (!strcmp(argv[i],"-v")) { verbosity = std::string(argv[++i]); }
+    else {
+      std::cout << "Unrecognized command line option " << argv[i] << std::endl;
+    }
+  }
+
+  Log::ReportingLevel() = Log::FromString(verbosity);
+
+  if(infile == "") {
+    std::cout << "No input file given, see -h." << std::endl;
+    return -1;
+  }
+
+  std::transform(tbmtype.begin(), tbmtype.end(), tbmtype.begin(), ::tolower);
+  std::transform(roctype.begin(), roctype.end(), roctype.begin(), ::tolower);
+  uint8_t tbmcode = DeviceDictionary::getInstance()->getDevCode(tbmtype);
+  uint8_t roccode = DeviceDictionary::getInstance()->getDevCode(roctype);
+  if(tbmcode < TBM_NONE || roccode == ROC_NONE || roccode >= TBM_NONE) {
+    std::cout << "Unknown TBM type " << tbmtype << " or ROC type " << roctype << std::endl;
+    return -1;
+  }
+
+  // Map the raw data file:
+  const uint16_t * data = NULL;
+  size_t size = 0;
+#ifndef WIN32
+  int fd = open(infile.c_str(), O_RDONLY);
+  struct stat st;
+  if(fd < 0 || fstat(fd, &st) != 0) {
+    std::cout << "Could not open raw data file " << infile << std::endl;
+    if(fd >= 0) { close(fd); }
+    return -1;
+  }
+  size = st.st_size/sizeof(uint16_t);
+  if(size > 0) {
+    void * mapped = mmap(NULL, size*sizeof(uint16_t), PROT_READ, MAP_PRIVATE, fd, 0);
+    if(mapped == MAP_FAILED) {
+      std::cout << "Could not map raw data file " << infile << std::endl;
+      close(fd);
+      return -1;
+    }
+    // The file is read front to back by every decoder:
+    madvise(mapped, size*sizeof(uint16_t), MADV_SEQUENTIAL);
+    data = static_cast<const uint16_t*>(mapped);
+  }
+  close(fd);
+#else
+  std::vector<uint16_t> buffer;
+  std::ifstream file(infile.c_str(), std::ios::in | std::ios::binary);
+  if(!file) {
+    std::cout << "Could not open raw data file " << infile << std::endl;
+    return -1;
+  }
+  file.seekg(0, std::ios::end);
+  buffer.resize(static_cast<size_t>(file.tellg())/sizeof(uint16_t));
+  file.seekg(0, std::ios::beg);
+  if(!buffer.empty()) { file.read(reinterpret_cast<char*>(&buffer[0]), buffer.size()*sizeof(uint16_t)); }
+  size = buffer.size();
+  data = (size > 0 ? &buffer[0] : NULL);
+#endif
+
+  decodeJob job;
+  job.data = data;
+  job.size = size;
+  job.channel = static_cast<uint8_t>(channel);
+  job.chainlength = static_cast<uint8_t>(chainlength);
+  job.offset = static_cast<uint8_t>(offset);
+  job.tbmtype = tbmcode;
+  job.roctype = roccode;
+  job.keepraw = keepraw;
+
+  timer t;
+  prepareChunks(job, chunksize);
+  std::cout << "Decoding " << size << " words from " << infile << " in " << job.chunks.size()
+	    << " chunks with " << nthreads << " threads." << std::endl;
+
+  int status = 0;
+  eventFileWriter * eventfile = NULL;
+  statistics total;
+  uint64_t nevents = 0;
+  if(outfile != "") {
+    try { eventfile = new eventFileWriter(outfile); }
+    catch(EventFileError &e) {
+      std::cout << e.what() << std::endl;
+      return -1;
+    }
+  }
+
+#ifndef WIN32
+  pthread_mutex_init(&job.lock, NULL);
+  pthread_cond_init(&job.wakeup, NULL);
+  job.next = 0;
+  job.written = 0;
+  job.window = 2*nthreads;
+  std::vector<pthread_t> threads;
+  for(size_t i = 0; i < nthreads && i < job.chunks.size(); i++) {
+    pthread_t thread;
+    if(pthread_create(&thread, NULL, decodeWorker, &job) == 0) { threads.push_back(thread); }
+  }
+  if(threads.empty()) {
+    std::cout << "Could not start decoding threads, decoding serially." << std::endl;
+    job.window = job.chunks.size();
+    decodeWorker(&job);
+  }
+#endif
+
+  // Collect the chunks in order and append each one as block to the event file:
+  for(size_t c = 0; c < job.chunks.size(); c++) {
+    decodeChunk & chunk = job.chunks.at(c);
+#ifndef WIN32
+    pthread_mutex_lock(&job.lock);
+    while(!chunk.done) { pthread_cond_wait(&job.wakeup, &job.lock); }
+    pthread_mutex_unlock(&job.lock);
+#else
+    decode(job, chunk);
+#endif
+    nevents += chunk.events.size();
+    total += chunk.stats;
+    if(eventfile) {
+      // Keep collecting the chunks to let the decoding threads finish:
+      try { eventfile->writeBlock(chunk.events, chunk.stats, keepraw ? &chunk.raw : NULL); }
+      catch(EventFileError &e) {
+	std::cout << e.what() << std::endl;
+	delete eventfile;
+	eventfile = NULL;
+	status = -1;
+      }
+    }
+
+    // Release the memory of the chunk:
+    std::vector<Event>().swap(chunk.events);
+    std::vector<rawEvent>().swap(chunk.raw);
+
+    // Like a serial decoding, stop at the first error. Events up to the error are kept:
+    bool failed = !chunk.error.empty();
+    if(failed) {
+      std::cout << "Error decoding words " << chunk.begin << " to " << chunk.end << ": " << chunk.error << std::endl;
+      status = -1;
+    }
+#ifndef WIN32
+    pthread_mutex_lock(&job.lock);
+    job.written = c + 1;
+    // Hand out no further chunks:
+    if(failed) { job.next = job.chunks.size(); }
+    pthread_cond_broadcast(&job.wakeup);
+    pthread_mutex_unlock(&job.lock);
+#endif
+    if(failed) break;
+  }
+
+#ifndef WIN32
+  for(size_t i = 0; i < threads.size(); i++) { pthread_join(threads.at(i), NULL); }
+  pthread_cond_destroy(&job.wakeup);
+  pthread_mutex_destroy(&job.lock);
+#endif
+
+  if(eventfile) {
+    try { eventfile->close(); }
+    catch(EventFileError &e) {
+      std::cout << e.what() << std::endl;
+      status = -1;
+    }
+    delete eventfile;
+  }
+
+#ifndef WIN32
+  if(data) { munmap(const_cast<uint16_t*>(data), size*sizeof(uint16_t)); }
+#endif
+
+  std::cout << "Decoded " << nevents << " events in " << t.get() << "ms." << std::endl;
+  total.dump();
+  return status;
+}
@@ -0,0 +1,184 @@
+/**
+ * pxar DTB emulator check of the TBM command register
+ * writes the clear/inject register (base4) of an emulated module repeatedly
+ * with the same value and counts the TBM register writes reaching the
+ * testboard. Every command has to be sent, while repeated writes of an
+ * unchanged setting are still skipped by the HAL.
+ */
+
+#include "api.h"
+#include "log.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <stdlib.h>
+
+using namespace pxar;
+
+namespace {
+
+  pxarCore * initModule() {
+
+    std::vector<std::pair<std::string,uint8_t> > sig_delays;
+    sig_delays.push_back(std::make_pair("clk",2));
+    sig_delays.push_back(std::make_pair("ctr",2));
+    sig_delays.push_back(std::make_pair("sda",17));
+    sig_delays.push_back(std::make_pair("tin",7));
+    sig_delays.push_back(std::make_pair("deser160phase",4));
+
+    std::vector<std::pair<std::string,double> > power_settings;
+    power_settings.push_back(std::make_pair("va",1.9));
+    power_settings.push_back(std::make_pair("vd",2.6));
+    power_settings.push_back(std::make_pair("ia",1.190));
+    power_settings.push_back(std::make_pair("id",1.10));
+
+    std::vector<std::pair<std::string,uint8_t> > pg_setup;
+    pg_setup.push_back(std::make_pair("resettbm",25));
+    pg_setup.push_back(std::make_pair("calibrate",106));
+    pg_setup.push_back(std::make_pair("trigger;sync",0));
+
+    std::vector<std::pair<std::string,uint8_t> > regs;
+    regs.push_back(std::make_pair("base0",0x81));
+    regs.push_back(std::make_pair("base2",0xC0));
+    regs.push_back(std::make_pair("base4",0xF0));
+    regs.push_back(std::make_pair("base8",0x10));
+    regs.push_back(std::make_pair("basea",0x49));
+    regs.push_back(std::make_pair("basec",0x00));
+    regs.push_back(std::make_pair("basee",0x84));
+    std::vector<std::vector<std::pair<std::string,uint8_t> > > tbmDACs(2, regs);
+
+    std::vector<std::pair<std::string,uint8_t> > dacs;
+    dacs.push_back(std::make_pair("Vdig",8));
+    dacs.push_back(std::make_pair("Vana",78));
+    dacs.push_back(std::make_pair("Vsf",80));
+    dacs.push_back(std::make_pair("Vcomp",12));
+    dacs.push_back(std::make_pair("VwllPr",150));
+    dacs.push_back(std::make_pair("VwllSh",150));
+    dacs.push_back(std::make_pair("VhldDel",117));
+    dacs.push_back(std::make_pair("Vtrim",152));
+    dacs.push_back(std::make_pair("VthrComp",89));
+    dacs.push_back(std::make_pair("VIBias_Bus",30));
+    dacs.push_back(std::make_pair("Vbias_sf",6));
+    dacs.push_back(std::make_pair("VoffsetOp",60));
+    dacs.push_back(std::make_pair("VOffsetRO",225));
+    dacs.push_back(std::make_pair("VIon",45));
+    dacs.push_back(std::make_pair("Vcomp_ADC",10));
+    dacs.push_back(std::make_pair("VIref_ADC",70));
+    dacs.push_back(std::make_pair("VIbias_roc",150));
+    dacs.push_back(std::make_pair("VIColOr",99));
+    dacs.push_back(std::make_pair("Vcal",199));
+    dacs.push_back(std::make_pair("CalDel",140));
+    dacs.push_back(std::make_pair("CtrlReg",0));
+    dacs.push_back(std::make_pair("WBC",100));
+
+    std::vector<pixelConfig> pixels;
+    for(int col = 0; col < 52; col++) {
+      for(int row = 0; row < 80; row++) { pixels.push_back(pixelConfig(col,row,15)); }
+    }
+
+    std::vector<std::vector<std::pair<std::string,uint8_t> > > rocDACs(16, dacs);
+    std::vector<std::vector<pixelConfig> > rocPixels(16, pixels);
+
+    pxarCore * api = new pxarCore("*", "WARNING");
+    if(!api->initTestboard(sig_delays, power_settings, pg_setup)
+       || !api->initDUT(31, "tbm08c", tbmDACs, "psi46digv21respin", rocDACs, rocPixels)) {
+      delete api;
+      throw InvalidConfig("Could not initialize the DUT.");
+    }
+    return api;
+  }
+
+  // The emulator logs every TBM register write at DEBUGRPC level, count them while the log goes to a file:
+  class writeCounter {
+    FILE * fLog;
+    FILE * fPrevious;
+    TLogLevel fLevel;
+  public:
+    writeCounter() : fLog(tmpfile()), fPrevious(SetLogOutput::Stream()), fLevel(Log::ReportingLevel()) {
+      SetLogOutput::Stream() = fLog;
+      Log::ReportingLevel() = logDEBUGRPC;
+    }
+    ~writeCounter() { if(fLog) fclose(fLog); }
+    size_t count() {
+      Log::ReportingLevel() = fLevel;
+      SetLogOutput::Stream() = fPrevious;
+      size_t n = 0;
+      if(!fLog) return n;
+      rewind(fLog);
+      char line[1024];
+      while(fgets(line, sizeof(line), fLog)) {
+	if(strstr(line, "\"tbm_Set\"") && strstr(line, "called.")) n++;
+      }
+      return n;
+    }
+  };
+
+  bool check(const std::string & name, size_t writes, size_t expected) {
+    bool passed = (writes == expected);
+    std::cout << name << ": " << writes << " TBM register writes, expected " << expected
+	      << " - " << (passed ? "ok" : "FAILED") << std::endl;
+    return passed;
+  }
+}
+
+int main(int argc, char* argv[]) {
+
+  int nCommands = 2;
+
+  // Quick and hacky cli arguments reading:
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i],"-h")) {
+      std::cout << "Help:" << std::endl;
+      std::cout << "-n commands    number of identical commands, default 2" << std::endl;
+      return 0;
+    }
+    else if (!strcmp(argv[i],"-n")) { nCommands = atoi(argv[++i]); }
+    else {
+      std::cout << "Unrecognized command line option " << argv[i] << std::endl;
+    }
+  }
+
+  if(nCommands < 2) {
+    std::cout << "Invalid settings." << std::endl;
+    return -1;
+  }
+
+  try {
+    pxarCore * api = initModule();
+    bool ok = true;
+
+    // The ROC reset of PixTestPretest and PixTestCmd, sent repeatedly to one core:
+    writeCounter resets;
+    for(int i = 0; i < nCommands; i++) { api->setTbmReg("base4", 0x80, 0); }
+    ok = check("identical base4 writes", resets.count(), nCommands) && ok;
+
+    // Trigger injection on all cores, by its register name:
+    writeCounter injects;
+    for(int i = 0; i < nCommands; i++) { api->setTbmReg("inject", 0x04); }
+    ok = check("identical inject writes on both cores", injects.count(), 2*nCommands) && ok;
+
+    // Settings are still programmed only when they change:
+    writeCounter settings;
+    for(int i = 0; i < nCommands; i++) { api->setTbmReg("base0", 0x81, 0); }
+    ok = check("unchanged base0 writes", settings.count(), 0) && ok;
+
+    // A transaction combines repeated commands, but still sends them:
+    writeCounter transaction;
+    api->startDACTransaction();
+    for(int i = 0; i < nCommands; i++) {
+      api->setTbmReg("base0", 0x81, 0);
+      api->setTbmReg("base4", 0x80, 0);
+    }
+    api->commitDACTransaction();
+    ok = check("base4 in a transaction", transaction.count(), 1) && ok;
+
+    delete api;
+    return (ok ? 0 : -1);
+  }
+  catch(std::exception &e) {
+    std::cout << "exception: " << e.what() << std::endl;
+    return -1;
+  }
+}
@@ -0,0 +1,177 @@
+/**
+ * pxar DTB emulator check of the default TBM settings
+ * programs a 16-ROC module with the TBM registers main/mkConfig writes for
+ * every TBM type, sends triggers and checks that the data decodes without
+ * errors. A setting inside the emulator's synthetic bad timing region is
+ * checked as well, it has to produce decoder errors.
+ */
+
+#include "api.h"
+#include "log.h"
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <stdlib.h>
+
+using namespace pxar;
+
+namespace {
+
+  struct tbmDefaults {
+    std::string name;
+    std::string type;
+    bool hasBasee;
+    uint8_t basea;
+    uint8_t basee;
+    bool bad;
+  };
+
+  std::vector<std::pair<std::string,uint8_t> > tbmCore(const tbmDefaults & tbm, uint8_t base0, uint8_t basee) {
+    std::vector<std::pair<std::string,uint8_t> > regs;
+    regs.push_back(std::make_pair("base0",base0));
+    regs.push_back(std::make_pair("base2",0xC0));
+    regs.push_back(std::make_pair("base4",0xF0));
+    regs.push_back(std::make_pair("base8",0x10));
+    regs.push_back(std::make_pair("basea",tbm.basea));
+    regs.push_back(std::make_pair("basec",0x00));
+    if(tbm.hasBasee) regs.push_back(std::make_pair("basee",basee));
+    return regs;
+  }
+
+  // Returns the number of decoder errors of nTriggers triggers on a module with these TBM settings:
+  uint32_t check(const tbmDefaults & tbm, uint16_t nTriggers, size_t & nevents) {
+
+    std::vector<std::pair<std::string,uint8_t> > sig_delays;
+    sig_delays.push_back(std::make_pair("clk",2));
+    sig_delays.push_back(std::make_pair("ctr",2));
+    sig_delays.push_back(std::make_pair("sda",17));
+    sig_delays.push_back(std::make_pair("tin",7));
+    sig_delays.push_back(std::make_pair("deser160phase",4));
+
+    std::vector<std::pair<std::string,double> > power_settings;
+    power_settings.push_back(std::make_pair("va",1.9));
+    power_settings.push_back(std::make_pair("vd",2.6));
+    power_settings.push_back(std::make_pair("ia",1.190));
+    power_settings.push_back(std::make_pair("id",1.10));
+
+    std::vector<std::pair<std::string,uint8_t> > pg_setup;
+    pg_setup.push_back(std::make_pair("resettbm",25));
+    pg_setup.push_back(std::make_pair("calibrate",106));
+    pg_setup.push_back(std::make_pair("trigger;sync",0));
+
+    // As in tbmParameters_C0a.dat and tbmParameters_C0b.dat, the second core has basee 0x00:
+    uint8_t base0 = (tbm.type == "tbm08" ? 0x01 : 0x81);
+    std::vector<std::vector<std::pair<std::string,uint8_t> > > tbmDACs;
+    tbmDACs.push_back(tbmCore(tbm, base0, tbm.basee));
+    tbmDACs.push_back(tbmCore(tbm, base0, 0x00));
+
+    std::vector<std::pair<std::string,uint8_t> > dacs;
+    dacs.push_back(std::make_pair("Vdig",8));
+    dacs.push_back(std::make_pair("Vana",78));
+    dacs.push_back(std::make_pair("Vsf",80));
+    dacs.push_back(std::make_pair("Vcomp",12));
+    dacs.push_back(std::make_pair("VwllPr",150));
+    dacs.push_back(std::make_pair("VwllSh",150));
+    dacs.push_back(std::make_pair("VhldDel",117));
+    dacs.push_back(std::make_pair("Vtrim",152));
+    dacs.push_back(std::make_pair("VthrComp",89));
+    dacs.push_back(std::make_pair("VIBias_Bus",30));
+    dacs.push_back(std::make_pair("Vbias_sf",6));
+    dacs.push_back(std::make_pair("VoffsetOp",60));
+    dacs.push_back(std::make_pair("VOffsetRO",225));
+    dacs.push_back(std::make_pair("VIon",45));
+    dacs.push_back(std::make_pair("Vcomp_ADC",10));
+    dacs.push_back(std::make_pair("VIref_ADC",70));
+    dacs.push_back(std::make_pair("VIbias_roc",150));
+    dacs.push_back(std::make_pair("VIColOr",99));
+    dacs.push_back(std::make_pair("Vcal",199));
+    dacs.push_back(std::make_pair("CalDel",140));
+    dacs.push_back(std::make_pair("CtrlReg",0));
+    dacs.push_back(std::make_pair("WBC",100));
+
+    std::vector<pixelConfig> pixels;
+    for(int col = 0; col < 52; col++) {
+      for(int row = 0; row < 80; row++) { pixels.push_back(pixelConfig(col,row,15)); }
+    }
+
+    std::vector<std::vector<std::pair<std::string,uint8_t> > > rocDACs;
+    std::vector<std::vector<pixelConfig> > rocPixels;
+    for(int i = 0; i < 16; i++) {
+      rocDACs.push_back(dacs);
+      rocPixels.push_back(pixels);
+    }
+
+    pxarCore * api = new pxarCore("*", "WARNING");
+    if(!api->initTestboard(sig_delays, power_settings, pg_setup)
+       || !api->initDUT(31, tbm.type, tbmDACs, "psi46digv21respin", rocDACs, rocPixels)) {
+      delete api;
+      throw InvalidConfig("Could not initialize the DUT.");
+    }
+
+    api->daqStart();
+    api->daqTrigger(nTriggers);
+    std::vector<Event> events = api->daqGetEventBuffer();
+    api->daqStop();
+    nevents = events.size();
+    uint32_t errors = api->getStatistics().errors();
+
+    delete api;
+    return errors;
+  }
+}
+
+int main(int argc, char* argv[]) {
+
+  uint16_t nTriggers = 20;
+
+  // Quick and hacky cli arguments reading:
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i],"-h")) {
+      std::cout << "Help:" << std::endl;
+      std::cout << "-t triggers    number of triggers per TBM type, default 20" << std::endl;
+      return 0;
+    }
+    else if (!strcmp(argv[i],"-t")) { nTriggers = static_cast<uint16_t>(atoi(argv[++i])); }
+    else {
+      std::cout << "Unrecognized command line option " << argv[i] << std::endl;
+    }
+  }
+
+  if(nTriggers < 1) {
+    std::cout << "Invalid settings." << std::endl;
+    return -1;
+  }
+
+  // The settings of main/mkConfig, and one with a bad TBM phase difference (clk400 - clk160 = 6):
+  tbmDefaults tbms[] = {
+    { "TBM08",        "tbm08",  false, 0x00, 0x00, false },
+    { "TBM08B",       "tbm08b", true,  0x49, 0x84, false },
+    { "TBM08B_FPIX",  "tbm08b", true,  0x00, 0x20, false },
+    { "TBM08C",       "tbm08c", true,  0x49, 0x84, false },
+    { "TBM09",        "tbm09",  true,  0x64, 0x34, false },
+    { "TBM09C",       "tbm09c", true,  0x64, 0x34, false },
+    { "TBM09C (bad)", "tbm09c", true,  0x64, 0x18, true  }
+  };
+
+  try {
+    bool ok = true;
+    for(size_t i = 0; i < sizeof(tbms)/sizeof(tbms[0]); i++) {
+      size_t nevents = 0;
+      uint32_t errors = check(tbms[i], nTriggers, nevents);
+      bool passed = (tbms[i].bad ? errors > 0 : (errors == 0 && nevents == nTriggers));
+      ok = ok && passed;
+      std::cout << std::setw(14) << std::left << tbms[i].name << std::right << " basea 0x" << std::hex
+		<< std::setw(2) << std::setfill('0') << static_cast<int>(tbms[i].basea) << " basee 0x"
+		<< std::setw(2) << static_cast<int>(tbms[i].basee) << std::dec << std::setfill(' ')
+		<< ": " << std::setw(4) << nevents << " events, " << std::setw(4) << errors << " errors - "
+		<< (passed ? "ok" : "FAILED") << std::endl;
+    }
+    return (ok ? 0 : -1);
+  }
+  catch(std::exception &e) {
+    std::cout << "exception: " << e.what() << std::endl;
+    return -1;
+  }
+}
@@ -7,8 +7,16 @@
 #include <bitset>
 
 #include <cstdlib>
+#include <cstring>
 #include <stdio.h>
 
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "dictionaries.h"
 #include "log.h"
 
@@ -20,6 +28,197 @@ using namespace pxar;
 
 ConfigParameters * ConfigParameters::fInstance = 0;
 
+namespace {
+  // -- read-only view of a complete file, memory-mapped where possible
+  class textFile {
+  public:
+    textFile(const string &fname) : fData(0), fSize(0), fGood(false) {
+#ifndef WIN32
+      int fd = open(fname.c_str(), O_RDONLY);
+      if (fd < 0) return;
+      struct stat st;
+      if (0 == fstat(fd, &st)) {
+	fSize = st.st_size;
+	fGood = true;
+	if (fSize > 0) {
+	  void *data = mmap(NULL, fSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	  if (MAP_FAILED == data) {
+	    fSize = 0;
+	    fGood = false;
+	  } else {
+	    fData = static_cast<const char*>(data);
+	  }
+	}
+      }
+      ::close(fd);
+#else
+      ifstream is(fname.c_str(), ios::in | ios::binary);
+      if (!is) return;
+      is.seekg(0, ios::end);
+      fBuffer.resize(static_cast<size_t>(is.tellg()));
+      is.seekg(0, ios::beg);
+      if (!fBuffer.empty()) is.read(&fBuffer[0], fBuffer.size());
+      fSize = fBuffer.size();
+      fData = (fSize > 0 ? &fBuffer[0] : 0);
+      fGood = true;
+#endif
+    }
+    ~textFile() {
+#ifndef WIN32
+      if (fData) munmap(const_cast<char*>(fData), fSize);
+#endif
+    }
+    bool good() const {return fGood;}
+    const char* begin() const {return fData;}
+    const char* end() const {return fData + fSize;}
+    size_t size() const {return fSize;}
+
+  private:
+    textFile(const textFile&);
+    textFile& operator=(const textFile&);
+    const char *fData;
+    size_t fSize;
+    bool fGood;
+#ifdef WIN32
+    vector<char> fBuffer;
+#endif
+  };
+
+  // -- tokens of one line, up to a '#' or the end of the line. The file is not null-terminated, so
+  //    the numbers are converted from [begin, end) by hand instead of with strtol().
+  struct token {
+    const char *b, *e;
+    string str() const {return string(b, e);}
+    bool is(const char *s) const {
+      const char *p = b;
+      for (; p != e && *s; ++p, ++s) if (*p != *s) return false;
+      return (p == e && 0 == *s);
+    }
+  };
+
+  // -- split the line starting at p into at most ntok tokens, returns the number of tokens (also
+  //    those beyond ntok) and moves p to the start of the next line
+  int tokenize(const char *&p, const char *end, token *tok, int ntok, const char *&lineEnd) {
+    const char *b = p;
+    while (p != end && '\n' != *p) ++p;
+    lineEnd = p;
+    if (p != end) ++p;
+    int n(0);
+    bool comment(false);
+    while (b != lineEnd && !comment) {
+      while (b != lineEnd && (' ' == *b || '\t' == *b || '\r' == *b)) ++b;
+      if (b == lineEnd) break;
+      if ('#' == *b) break;
+      const char *e = b;
+      while (e != lineEnd && ' ' != *e && '\t' != *e && '\r' != *e) {
+	if ('#' == *e) {
+	  comment = true;
+	  break;
+	}
+	++e;
+      }
+      if (e == b) break;
+      if (n < ntok) {
+	tok[n].b = b;
+	tok[n].e = e;
+      }
+      ++n;
+      b = e;
+    }
+    return n;
+  }
+
+  // -- as atoi(), or as sscanf(.., "%x", ..) if the token contains "0x"
+  long toLong(const token &t) {
+    const char *p = t.b;
+    for (const char *q = t.b; q + 1 < t.e; ++q) {
+      if ('0' == q[0] && 'x' == q[1]) {
+	long val(0);
+	for (p = q + 2; p != t.e; ++p) {
+	  int d(-1);
+	  if (*p >= '0' && *p <= '9') d = *p - '0';
+	  else if (*p >= 'a' && *p <= 'f') d = *p - 'a' + 10;
+	  else if (*p >= 'A' && *p <= 'F') d = *p - 'A' + 10;
+	  if (d < 0) break;
+	  val = 16*val + d;
+	}
+	return val;
+      }
+    }
+    bool neg(false);
+    if (p != t.e && ('-' == *p || '+' == *p)) neg = ('-' == *p++);
+    long val(0);
+    for (; p != t.e && *p >= '0' && *p <= '9'; ++p) val = 10*val + (*p - '0');
+    return (neg ? -val : val);
+  }
+
+  uint32_t adler32(const char *p, size_t n) {
+    uint32_t a(1), b(0);
+    while (n > 0) {
+      // -- 5552 is the largest block without overflow of b
+      size_t nb = (n < 5552 ? n : 5552);
+      n -= nb;
+      while (nb--) {
+	a += static_cast<unsigned char>(*p++);
+	b += a;
+      }
+      a %= 65521;
+      b %= 65521;
+    }
+    return (b << 16) | a;
+  }
+
+  // -- binary sidecar of a trim file: header, then one trim value per pixel index (0xff: not in the text file)
+  struct trimCacheHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t checksum;   ///< adler32 of the text file
+    uint32_t textSize;
+    uint32_t npix;
+  };
+  const char     TRIMCACHEMAGIC[8] = {'p', 'x', 'a', 'r', 't', 'r', 'i', 'm'};
+  const uint32_t TRIMCACHEVERSION(1);
+  const uint8_t  TRIMNOTSET(0xff);
+
+  string trimCacheName(const string &fname) {
+    string::size_type s = fname.rfind(".dat");
+    if (string::npos != s && s + 4 == fname.size()) return fname.substr(0, s) + ".bin";
+    return fname + ".bin";
+  }
+
+  bool readTrimCache(const string &fname, uint32_t checksum, uint32_t textSize, vector<uint8_t> &trims) {
+    FILE *file = fopen(fname.c_str(), "rb");
+    if (!file) return false;
+    trimCacheHeader h;
+    bool ok = (1 == fread(&h, sizeof(h), 1, file))
+      && 0 == memcmp(h.magic, TRIMCACHEMAGIC, sizeof(h.magic))
+      && TRIMCACHEVERSION == h.version && checksum == h.checksum && textSize == h.textSize
+      && trims.size() == h.npix
+      && (0 == h.npix || 1 == fread(&trims[0], h.npix, 1, file));
+    fclose(file);
+    return ok;
+  }
+
+  void writeTrimCache(const string &fname, uint32_t checksum, uint32_t textSize, const vector<uint8_t> &trims) {
+    FILE *file = fopen(fname.c_str(), "wb");
+    if (!file) {
+      LOG(logDEBUG) << "could not write trim cache " << fname;
+      return;
+    }
+    trimCacheHeader h;
+    memcpy(h.magic, TRIMCACHEMAGIC, sizeof(h.magic));
+    h.version  = TRIMCACHEVERSION;
+    h.checksum = checksum;
+    h.textSize = textSize;
+    h.npix     = trims.size();
+    bool ok = (1 == fwrite(&h, sizeof(h), 1, file)) && (trims.empty() || 1 == fwrite(&trims[0], trims.size(), 1, file));
+    if (0 != fclose(file) || !ok) {
+      LOG(logDEBUG) << "could not write trim cache " << fname;
+      remove(fname.c_str());
+    }
+  }
+}
+
 // ----------------------------------------------------------------------
 ConfigParameters::ConfigParameters() {
   initialize();
@@ -49,6 +248,8 @@ void ConfigParameters::initialize() {
   fTbmEmulator = false;
   fKeithleyRemote = false;
   fGuiMode = false;
+  fTrimCache = false;
+  fMonitorInterval = 1000;
   fTbmChannel = 0;
   fHalfModule = 0;
 
@@ -87,6 +288,8 @@ void ConfigParameters::initialize() {
   fTBName = "*"; 
 
   fMaskedPixels.clear(); 
+  fMaskedPixelMap.clear(); 
+  fnMaskedPixels = 0; 
 }
 
 
@@ -157,6 +360,8 @@ bool ConfigParameters::readConfigParameterFile(string file) {
       else if (0 == _name.compare("rootFileName")) { setRootFileName(_value); }
       else if (0 == _name.compare("trimParameters")) { setTrimParameterFileName(_value); }
       else if (0 == _name.compare("maskFile")) { setMaskFileName(_value); }
+      else if (0 == _name.compare("trimCache")) { fTrimCache                 = (_ivalue>0); }
+      else if (0 == _name.compare("monitorInterval")) { fMonitorInterval          = _ivalue; }
       else if (0 == _name.compare("gainPedestalParameters")) {fGainPedestalParameterFileName = _value;}
 
       else if (0 == _name.compare("nModules")) { fnModules                  = _ivalue; }
@@ -208,48 +413,31 @@ bool ConfigParameters::readConfigParameterFile(string file) {
 vector<pair<string, uint8_t> > ConfigParameters::readDacFile(string fname) {
   vector<pair<string, uint8_t> > rocDacs; 
 
-  // -- read in file
-  vector<string> lines; 
-  char  buffer[5000];
-  ifstream is(fname.c_str());
-  while (is.getline(buffer, 200, '\n')) {
-    lines.push_back(string(buffer));
-  }
-  is.close();
-
-  // -- parse lines
-  unsigned int ival(0); 
-  uint8_t uval(0); 
-  //  unsigned char uval(0); 
-  
-  string::size_type s1, s2; 
-  string str1, str2, str3;
-  for (unsigned int i = 0; i < lines.size(); ++i) {
-    //    cout << lines[i] << endl;   
-    // -- remove tabs, adjacent spaces, leading and trailing spaces, and everything after (and including) a #
-    cleanupString(lines[i]);
-    if (lines[i].length() < 2) continue;
-    s1 = lines[i].find(" "); 
-    s2 = lines[i].rfind(" "); 
-    if (s1 != s2) {
+  textFile is(fname);
+  if (!is.good()) return rocDacs;
+
+  // -- one pass over the file: [register number] name value, everything after (and including) a # is ignored
+  const int NTOK(8);
+  token tok[NTOK];
+  const char *p = is.begin(), *lineEnd(0);
+  while (p != is.end()) {
+    int n = tokenize(p, is.end(), tok, NTOK, lineEnd);
+    if (0 == n) continue;
+    if (1 == n && tok[0].e - tok[0].b < 2) continue;
+    if (n > NTOK) {
+      LOG(logINFO) << "could not read line -->" << string(tok[0].b, lineEnd) << "<--";
+      continue;
+    }
+    string name; 
+    if (n > 2) {
       // -- with register number 
-      str1 = lines[i].substr(0, s1); 
-      str2 = lines[i].substr(s1+1, s2-s1-1); 
-      str3 = lines[i].substr(s2+1); 
+      name = string(tok[1].b, tok[n-2].e);
     } else {
       // -- without register number 
-      str2 = lines[i].substr(0, s1); 
-      str3 = lines[i].substr(s1+1); 
+      name = tok[0].str();
     }
-    
-    if (string::npos != str3.find("0x")) {
-      sscanf(str3.c_str(), "%x", &ival);  
-    } else {
-      ival = atoi(str3.c_str()); 
-    }
-    uval = ival;
-    rocDacs.push_back(make_pair(str2, uval)); 
-
+    uint8_t uval = static_cast<uint8_t>(toLong(tok[n-1]));
+    rocDacs.push_back(make_pair(name, uval)); 
   }
 
   return rocDacs; 
@@ -363,15 +551,19 @@ void ConfigParameters::readRocPixelConfig() {
   for (unsigned int i = 0; i < fnRocs; ++i) rocmasked.push_back(false); 
   
   fMaskedPixels = readMaskFile(filename); 
+  fMaskedPixelMap.assign(fMaskedPixels.size(), bitset<ROC_NUMCOLS*ROC_NUMROWS>()); 
+  fnMaskedPixels = 0; 
 
   for (unsigned int i = 0; i < fMaskedPixels.size(); ++i) {
-    vector<pair<int, int> > v = fMaskedPixels[i]; 
+    const vector<pair<int, int> > &v = fMaskedPixels[i]; 
     if (v.size() > 0) {
       rocmasked[i] = true; 
       for (unsigned int j = 0; j < v.size(); ++j) {
 	LOG(logINFO) << "MASKED Roc " << i << " col/row: " << v[j].first << " " << v[j].second;
+	fMaskedPixelMap[i].set(v[j].first*ROC_NUMROWS + v[j].second);
       }
     }
+    fnMaskedPixels += fMaskedPixelMap[i].count(); 
   }
   
   // -- read all trim files and create pixelconfig vector
@@ -386,18 +578,16 @@ void ConfigParameters::readRocPixelConfig() {
       for (uint8_t ir = 0; ir < fnRow; ++ir) {
 	//	pxar::pixelConfig a(ic,ir,0,false,true); 
 	pxar::pixelConfig a(ic,ir,0,false,false); 
-	if (rocmasked[i]) {
-	  vector<pair<int, int> > v = fMaskedPixels[i]; 
-	  for (unsigned int j = 0; j < v.size(); ++j) {
-	    if (v[j].first == ic && v[j].second == ir) {
-	      LOG(logINFO) << "  masking Roc " << i << " col/row: " << v[j].first << " " << v[j].second;
-	      a.setMask(true);
-	    }
-	  }
-	}
 	v.push_back(a); 
       }
     }
+    if (rocmasked[i]) {
+      const vector<pair<int, int> > &m = fMaskedPixels[i]; 
+      for (unsigned int j = 0; j < m.size(); ++j) {
+	LOG(logINFO) << "  masking Roc " << i << " col/row: " << m[j].first << " " << m[j].second;
+	v[m[j].first*fnRow + m[j].second].setMask(true);
+      }
+    }
     std::stringstream fname;
     fname << fDirectory << "/" << fTrimParametersFileName << fTrimVcalSuffix << "_C" << i << ".dat"; 
     readTrimFile(fname.str(), v); 
@@ -411,53 +601,55 @@ void ConfigParameters::readRocPixelConfig() {
 // ----------------------------------------------------------------------
 void ConfigParameters::readTrimFile(string fname, vector<pxar::pixelConfig> &v) {
   
-  // -- read in file
-  vector<string> lines; 
-  char  buffer[5000];
-  ifstream is(fname.c_str());
-  while (is.getline(buffer, 200, '\n')) {
-    lines.push_back(string(buffer));
+  textFile is(fname);
+  if (!is.good()) return;
+
+  // -- trim value per pixel index, from the binary sidecar if it belongs to this text file
+  vector<uint8_t> trims(v.size(), TRIMNOTSET);
+  uint32_t checksum(0); 
+  string cacheName; 
+  if (fTrimCache) {
+    checksum = adler32(is.begin(), is.size());
+    cacheName = trimCacheName(fname);
+    if (readTrimCache(cacheName, checksum, is.size(), trims)) {
+      for (unsigned int i = 0; i < trims.size(); ++i) {
+	if (TRIMNOTSET != trims[i]) v[i].setTrim(trims[i]);
+      }
+      return;
+    }
   }
-  is.close();
-  
-  // -- parse lines
-  unsigned int ival(0), irow(0), icol(0); 
-  uint8_t uval(0); 
-  
-  string::size_type s1, s2; 
-  string str1, str2, str3;
-  for (unsigned int i = 0; i < lines.size(); ++i) {
-    // -- remove tabs, adjacent spaces, leading and trailing spaces
-    replaceAll(lines[i], "\t", " "); 
-    replaceAll(lines[i], "Pix", " "); 
-    string::iterator new_end = unique(lines[i].begin(), lines[i].end(), bothAreSpaces);
-    lines[i].erase(new_end, lines[i].end()); 
-    if (0 == lines[i].length()) continue;
-    if (lines[i].substr(0, 1) == string(" ")) lines[i].erase(0, 1); 
-    if (lines[i].substr(lines[i].length()-1, 1) == string(" ")) lines[i].erase(lines[i].length()-1, 1); 
-    s1 = lines[i].find(" "); 
-    s2 = lines[i].rfind(" "); 
-    if (s1 != s2) {
-      str1 = lines[i].substr(0, s1); 
-      str2 = lines[i].substr(s1+1, s2-s1); 
-      str3 = lines[i].substr(s2+1); 
-    } else {
-      LOG(logINFO) << "could not read line -->" << lines[i] << "<--";
+
+  // -- one pass over the file: trim Pix col row
+  const int NTOK(4);
+  token tok[NTOK];
+  const char *p = is.begin(), *lineEnd(0), *lineBegin(0);
+  while (p != is.end()) {
+    lineBegin = p;
+    int n = tokenize(p, is.end(), tok, NTOK, lineEnd);
+    if (0 == n) continue;
+    if (n > 1 && tok[1].is("Pix")) {
+      if (n > 2) tok[1] = tok[2];
+      if (n > 3) tok[2] = tok[3];
+      --n;
+    }
+    if (3 != n) {
+      LOG(logINFO) << "could not read line -->" << string(lineBegin, lineEnd) << "<--";
+      continue;
     }
     
-    ival = atoi(str1.c_str()); 
-    icol = atoi(str2.c_str()); 
-    irow = atoi(str3.c_str()); 
-    uval = ival;
-    unsigned int index = icol*80+irow; 
-    if (index <= v.size()) {
+    uint8_t uval = static_cast<uint8_t>(toLong(tok[0])); 
+    long icol = toLong(tok[1]); 
+    long irow = toLong(tok[2]); 
+    long index = icol*80+irow; 
+    if (icol >= 0 && irow >= 0 && index < static_cast<long>(v.size())) {
       v[index].setTrim(uval);
+      trims[index] = uval;
     } else {
       LOG(logINFO) << " not matching entry in trim vector found for row/col = " << irow << "/" << icol;
     }
   }
 
-
+  if (fTrimCache) writeTrimCache(cacheName, checksum, is.size(), trims);
 }
 
 
@@ -470,92 +662,66 @@ vector<vector<pair<int, int> > > ConfigParameters::readMaskFile(string fname) {
     v.push_back(a); 
   }
 
-  // -- read in file
-  vector<string> lines; 
-  char  buffer[5000];
   LOG(logINFO) << "readMaskFile: " << fname;
-  ifstream is(fname.c_str());
-  while (is.getline(buffer, 200, '\n')) {
-    lines.push_back(string(buffer));
-  }
-  is.close();
+  textFile is(fname);
+  if (!is.good()) return v;
   
-  // -- parse lines
-  unsigned int iroc(0), irow(0), icol(0); 
-  
-  string::size_type s1, s2, s3; 
-  string str1, str2, str3;
-  for (unsigned int i = 0; i < lines.size(); ++i) {
-    //    cout << lines[i] << endl;   
-    if (lines[i].substr(0, 1) == string("#")) continue;
-    // -- remove tabs, adjacent spaces, leading and trailing spaces
-    cleanupString(lines[i]); 
-    if (0 == lines[i].length()) continue;
-
-    s1 = lines[i].find("roc"); 
-    if (string::npos != s1) {
-      str3 = lines[i].substr(s1+4); 
-      iroc = atoi(str3.c_str()); 
-      //      cout << "masking all pixels for ROC " << iroc << endl;
-      if (iroc < fnRocs) {
+  // -- one pass over the file: roc iroc | row iroc irow | col iroc icol | pix iroc icol irow
+  const int NTOK(5);
+  token tok[NTOK];
+  const char *p = is.begin(), *lineEnd(0), *lineBegin(0);
+  long iroc(0), irow(0), icol(0); 
+  for (unsigned int i = 0; p != is.end(); ++i) {
+    lineBegin = p;
+    int n = tokenize(p, is.end(), tok, NTOK, lineEnd);
+    if (0 == n) continue;
+    if (n > 1) iroc = toLong(tok[1]); 
+
+    if (tok[0].is("roc")) {
+      if (n > 1 && iroc >= 0 && iroc < static_cast<long>(fnRocs)) {
 	for (uint8_t ic = 0; ic < fnCol; ++ic) {
 	  for (uint8_t ir = 0; ir < fnRow; ++ir) {
 	    v[iroc].push_back(make_pair(ic, ir)); 
 	  }
 	}  
       } else {
-	LOG(logINFO) << "illegal ROC coordinates in line " << i << ": " << lines[i];
+	LOG(logINFO) << "illegal ROC coordinates in line " << i << ": " << string(lineBegin, lineEnd);
       }
       continue;
     }
     
-    s1 = lines[i].find("row"); 
-    if (string::npos != s1) {
-      s1 += 4; 
-      s2 = lines[i].find(" ", s1) + 1; 
-      iroc = atoi(lines[i].substr(s1, s2-s1-1).c_str()); 
-      irow = atoi(lines[i].substr(s2).c_str()); 
-      //      cout << "-> MASKING ROC " << iroc << " row " << irow << endl;
-      if (iroc < fnRocs && irow < fnRow) {
+    if (tok[0].is("row")) {
+      irow = (n > 2 ? toLong(tok[2]) : -1); 
+      if (iroc >= 0 && iroc < static_cast<long>(fnRocs) && irow >= 0 && irow < static_cast<long>(fnRow)) {
 	for (unsigned int ic = 0; ic < fnCol; ++ic) {
 	  v[iroc].push_back(make_pair(ic, irow)); 
 	}  
       } else {
-	LOG(logINFO) << "illegal ROC/row coordinates in line " << i << ": " << lines[i];
+	LOG(logINFO) << "illegal ROC/row coordinates in line " << i << ": " << string(lineBegin, lineEnd);
       }
       continue;
     }
 
-    s1 = lines[i].find("col"); 
-    if (string::npos != s1) {
-      s1 += 4; 
-      s2 = lines[i].find(" ", s1) + 1; 
-      iroc = atoi(lines[i].substr(s1, s2-s1-1).c_str()); 
-      icol = atoi(lines[i].substr(s2).c_str()); 
-      //      cout << "-> MASKING ROC " << iroc << " col " << icol << endl;
-      if (iroc < fnRocs && icol < fnCol) {
+    if (tok[0].is("col")) {
+      icol = (n > 2 ? toLong(tok[2]) : -1); 
+      if (iroc >= 0 && iroc < static_cast<long>(fnRocs) && icol >= 0 && icol < static_cast<long>(fnCol)) {
 	for (unsigned int ir = 0; ir < fnRow; ++ir) {
 	  v[iroc].push_back(make_pair(icol, ir)); 
 	}  
       } else {
-	LOG(logINFO) << "illegal ROC/col coordinates in line " << i << ": " << lines[i];
+	LOG(logINFO) << "illegal ROC/col coordinates in line " << i << ": " << string(lineBegin, lineEnd);
       }
       continue;
     }
 
-    s1 = lines[i].find("pix"); 
-    if (string::npos != s1) {
-      s1 += 4; 
-      s2 = lines[i].find(" ", s1) + 1; 
-      s3 = lines[i].find(" ", s2) + 1; 
-      iroc = atoi(lines[i].substr(s1, s2-s1-1).c_str()); 
-      icol = atoi(lines[i].substr(s2, s3-s2-1).c_str()); 
-      irow = atoi(lines[i].substr(s3).c_str()); 
-      //      cout << "-> MASKING ROC " << iroc << " col " << icol << " row " << irow << endl;
-      if (iroc < fnRocs && icol < fnCol && irow < fnRow) {
+    if (tok[0].is("pix")) {
+      icol = (n > 3 ? toLong(tok[2]) : -1); 
+      irow = (n > 3 ? toLong(tok[3]) : -1); 
+      if (iroc >= 0 && iroc < static_cast<long>(fnRocs) && icol >= 0 && icol < static_cast<long>(fnCol) 
+	  && irow >= 0 && irow < static_cast<long>(fnRow)) {
 	v[iroc].push_back(make_pair(icol, irow)); 
       } else {
-	LOG(logINFO) << "illegal ROC/row/col coordinates in line " << i << ": " << lines[i];
+	LOG(logINFO) << "illegal ROC/row/col coordinates in line " << i << ": " << string(lineBegin, lineEnd);
       }
       continue;
     }
@@ -783,6 +949,8 @@ bool ConfigParameters::writeConfigParameterFile() {
   fprintf(file, "tbmParameters %s\n",  fTbmParametersFileName.c_str());
   fprintf(file, "trimParameters %s\n", fTrimParametersFileName.c_str());
   fprintf(file, "maskFile %s\n",       fMaskFileName.c_str());
+  if (fTrimCache) fprintf(file, "trimCache %i\n", fTrimCache);
+  if (1000 != fMonitorInterval) fprintf(file, "monitorInterval %i\n", fMonitorInterval);
   fprintf(file, "testParameters %s\n", fTestParametersFileName.c_str());
   fprintf(file, "rootFileName %s\n\n", fRootFileName.c_str());
 
@@ -1250,16 +1418,3 @@ void ConfigParameters::setTrimVcalSuffix(string name, bool nocheck) {
   }
   InputFile.close();
 }
-
-
-// ----------------------------------------------------------------------
-bool ConfigParameters::isMaskedPixel(int roc, int col, int row) {
-  vector<pair<int, int> > v = fMaskedPixels[roc]; 
-  for (unsigned int j = 0; j < v.size(); ++j) {
-    if (v[j].first == col && v[j].second == row) {
-      return true; 
-    }
-  }
-  return false;
-}
-
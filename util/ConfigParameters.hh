@@ -23,6 +23,7 @@ typedef char int8_t;
 #include <string>
 #include <sstream>
 #include <vector>
+#include <bitset>
 
 #include "api.h"
 
@@ -61,6 +62,7 @@ public:
   bool writeReadbackFile(int iroc, std::vector<std::pair<std::string, double> > v);
   bool writeMaskFile(std::vector<std::vector<std::pair<int, int> > > v, std::string name = ""); 
 
+  /** the instance of pXar; with several DUTs in one process each PixSetup has its own ConfigParameters */
   static ConfigParameters* Singleton();
 
   std::string getTBParameterFileName()    {return fTBParametersFileName;}
@@ -95,8 +97,14 @@ public:
 
   std::vector<std::vector<std::pair<int, int> > > readMaskFile(std::string fname);
   std::vector<std::vector<std::pair<int, int> > > getMaskedPixels() {return fMaskedPixels;} 
-  int nMaskedPixels() {return fMaskedPixels.size();} 
-  bool isMaskedPixel(int roc, int col, int row); 
+  /** number of masked pixels of all ROCs */
+  int nMaskedPixels() {return fnMaskedPixels;} 
+  bool isMaskedPixel(int roc, int col, int row) {
+    return (roc >= 0 && roc < static_cast<int>(fMaskedPixelMap.size()) && col >= 0 && col < ROC_NUMCOLS && row >= 0 && row < ROC_NUMROWS 
+	    && fMaskedPixelMap[roc].test(col*ROC_NUMROWS + row));
+  }
+  /** masked pixels of ROC index roc, indexed by col*ROC_NUMROWS + row as in pxar::dut::maskPixels() */
+  const std::bitset<ROC_NUMCOLS*ROC_NUMROWS>& getMaskedPixelMap(int roc) {return fMaskedPixelMap.at(roc);}
 
   std::vector<std::vector<pxar::pixelConfig> > getRocPixelConfig();
   std::vector<pxar::pixelConfig> getRocPixelConfig(int i);
@@ -125,6 +133,12 @@ public:
   void setDirectory(std::string dirname) {fDirectory = dirname;}
 
   void setGuiMode(bool a) {fGuiMode = a;}
+  /** keep a binary copy (.bin) next to each trim file, used instead of parsing the text file as long as its checksum matches */
+  void setTrimCache(bool a) {fTrimCache = a;}
+  bool getTrimCache() {return fTrimCache;}
+  /** interval in ms at which the PixMonitor thread samples currents and decoder statistics */
+  void setMonitorInterval(int a) {fMonitorInterval = a;}
+  int getMonitorInterval() {return fMonitorInterval;}
 
   unsigned int getNrocs() {return fnRocs;}
   unsigned int getNtbms() {return fnTbms;}
@@ -165,17 +179,20 @@ private:
   std::vector<std::vector<gainPedestalParameters> > fGainPedestalParameters;
 
   std::vector<std::vector<std::pair<int, int> > > fMaskedPixels;
+  std::vector<std::bitset<ROC_NUMCOLS*ROC_NUMROWS> > fMaskedPixelMap;
+  int fnMaskedPixels;
 
   unsigned int fnCol, fnRow, fnRocs, fnTbms, fnModules, fHubId;
   int fHalfModule;
   std::vector<uint8_t> fI2cAddresses; 
   int fEmptyReadoutLength, fEmptyReadoutLengthADC, fEmptyReadoutLengthADCDual, fTbmChannel;
+  int fMonitorInterval;
   float ia, id, va, vd;
   float rocZeroAnalogCurrent;
   std::string fRocType, fTbmType, fHdiType;
   std::string fDirectory;
   std::string fTBName;
-  bool fHvOn, fTbmEnable, fTbmEmulator, fKeithleyRemote, fGuiMode;
+  bool fHvOn, fTbmEnable, fTbmEmulator, fKeithleyRemote, fGuiMode, fTrimCache;
   std::string fProbeA1,fProbeA2, fProbeD1, fProbeD2;
 
   std::string fTBParametersFileName;
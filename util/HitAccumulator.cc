@@ -0,0 +1,163 @@
+#include <algorithm>
+
+#include <TH1.h>
+#include <TH2.h>
+#include <TProfile2D.h>
+
+#include "HitAccumulator.hh"
+
+using namespace std;
+
+const int HitAccumulator::NROC;
+const int HitAccumulator::NCOL;
+const int HitAccumulator::NROW;
+const int HitAccumulator::NPIX;
+const int HitAccumulator::NPH;
+
+namespace {
+  // -- add n entries with sum and sum of squares to one bin of a profile, as n calls of TProfile2D::Fill()
+  void addToProfile(TProfile2D *p, int icol, int irow, double n, double sum, double sum2) {
+    int bin = p->GetBin(icol+1, irow+1);
+    p->SetBinEntries(bin, p->GetBinEntries(bin) + n);
+    p->GetArray()[bin] += sum;
+    p->GetSumw2()->GetArray()[bin] += sum2;
+    if (p->GetBinSumw2()->GetSize() > 0) p->GetBinSumw2()->GetArray()[bin] += n;
+  }
+}
+
+// ----------------------------------------------------------------------
+HitAccumulator::HitAccumulator(int nrocs, int nshards, int nqbins, double qlo, double qhi) :
+  fNrocs(nrocs), fNshards(nshards), fNq(nqbins), fQlo(qlo), fQhi(qhi) {
+  if (fNrocs < 1) fNrocs = 1;
+  if (fNshards < 1) fNshards = 1;
+  if (fNq < 1) fNq = 1;
+  fQscale = (fQhi > fQlo ? fNq/(fQhi - fQlo) : 1.);
+
+  int n = fNshards*fNrocs*NPIX;
+  fHits.resize(n);
+  fPhSum.resize(n);
+  fPhSum2.resize(n);
+  fQSum.resize(n);
+  fQSum2.resize(n);
+  fPhSpectrum.resize(fNshards*fNrocs*(NPH+2));
+  fQSpectrum.resize(fNshards*fNrocs*(fNq+2));
+  clear();
+}
+
+// ----------------------------------------------------------------------
+HitAccumulator::~HitAccumulator() {
+}
+
+// ----------------------------------------------------------------------
+void HitAccumulator::clear() {
+  fill_n(fHits.begin(), fHits.size(), 0);
+  fill_n(fPhSum.begin(), fPhSum.size(), 0.);
+  fill_n(fPhSum2.begin(), fPhSum2.size(), 0.);
+  fill_n(fQSum.begin(), fQSum.size(), 0.);
+  fill_n(fQSum2.begin(), fQSum2.size(), 0.);
+  fill_n(fPhSpectrum.begin(), fPhSpectrum.size(), 0);
+  fill_n(fQSpectrum.begin(), fQSpectrum.size(), 0);
+}
+
+// ----------------------------------------------------------------------
+void HitAccumulator::merge() {
+  for (int iroc = 0; iroc < fNrocs; ++iroc) merge(iroc);
+}
+
+// ----------------------------------------------------------------------
+void HitAccumulator::merge(int iroc) {
+  for (int is = 1; is < fNshards; ++is) {
+    int i0 = iroc*NPIX;
+    int j0 = (is*fNrocs + iroc)*NPIX;
+    for (int i = 0; i < NPIX; ++i) {
+      int j = j0 + i;
+      fHits[i0+i]   += fHits[j];   fHits[j] = 0;
+      fPhSum[i0+i]  += fPhSum[j];  fPhSum[j] = 0.;
+      fPhSum2[i0+i] += fPhSum2[j]; fPhSum2[j] = 0.;
+      fQSum[i0+i]   += fQSum[j];   fQSum[j] = 0.;
+      fQSum2[i0+i]  += fQSum2[j];  fQSum2[j] = 0.;
+    }
+    i0 = iroc*(NPH+2);
+    j0 = (is*fNrocs + iroc)*(NPH+2);
+    for (int i = 0; i < NPH+2; ++i) {
+      fPhSpectrum[i0+i] += fPhSpectrum[j0+i];
+      fPhSpectrum[j0+i] = 0;
+    }
+    i0 = iroc*(fNq+2);
+    j0 = (is*fNrocs + iroc)*(fNq+2);
+    for (int i = 0; i < fNq+2; ++i) {
+      fQSpectrum[i0+i] += fQSpectrum[j0+i];
+      fQSpectrum[j0+i] = 0;
+    }
+  }
+}
+
+// ----------------------------------------------------------------------
+uint64_t HitAccumulator::getNhits(int iroc) {
+  uint64_t n(0);
+  if (iroc < 0 || iroc >= fNrocs) return n;
+  for (int i = 0; i < NPIX; ++i) n += fHits[iroc*NPIX + i];
+  return n;
+}
+
+// ----------------------------------------------------------------------
+void HitAccumulator::flush(int iroc, TH2D *hits, TProfile2D *qmap, TProfile2D *phmap, TH1D *q, TH1D *ph) {
+  if (iroc < 0 || iroc >= fNrocs) return;
+  merge(iroc);
+
+  // -- the histograms are changed bin by bin, the statistics are recomputed at the end
+  double entries = static_cast<double>(getNhits(iroc));
+  double hitsEntries  = (hits  ? hits->GetEntries()  : 0.);
+  double qmapEntries  = (qmap  ? qmap->GetEntries()  : 0.);
+  double phmapEntries = (phmap ? phmap->GetEntries() : 0.);
+
+  for (int i = 0; i < NPIX; ++i) {
+    int ipix = iroc*NPIX + i;
+    if (0 == fHits[ipix]) continue;
+    int icol = i/NROW;
+    int irow = i%NROW;
+    double n = fHits[ipix];
+    if (hits)  hits->AddBinContent(hits->GetBin(icol+1, irow+1), n);
+    if (qmap)  addToProfile(qmap, icol, irow, n, fQSum[ipix], fQSum2[ipix]);
+    if (phmap) addToProfile(phmap, icol, irow, n, fPhSum[ipix], fPhSum2[ipix]);
+    fHits[ipix]   = 0;
+    fPhSum[ipix]  = fPhSum2[ipix] = 0.;
+    fQSum[ipix]   = fQSum2[ipix]  = 0.;
+  }
+  if (hits) {
+    hits->ResetStats();
+    hits->SetEntries(hitsEntries + entries);
+  }
+  if (qmap) {
+    qmap->ResetStats();
+    qmap->SetEntries(qmapEntries + entries);
+  }
+  if (phmap) {
+    phmap->ResetStats();
+    phmap->SetEntries(phmapEntries + entries);
+  }
+
+  double spectrumEntries(0.);
+  if (ph) {
+    spectrumEntries = ph->GetEntries();
+    for (int ib = 0; ib < NPH+2; ++ib) {
+      double n = fPhSpectrum[iroc*(NPH+2) + ib];
+      if (n > 0.) ph->AddBinContent(ib, n);
+      spectrumEntries += n;
+    }
+    ph->ResetStats();
+    ph->SetEntries(spectrumEntries);
+  }
+  if (q) {
+    spectrumEntries = q->GetEntries();
+    for (int ib = 0; ib < fNq+2; ++ib) {
+      double n = fQSpectrum[iroc*(fNq+2) + ib];
+      if (n > 0.) q->AddBinContent(ib, n);
+      spectrumEntries += n;
+    }
+    q->ResetStats();
+    q->SetEntries(spectrumEntries);
+  }
+  fill_n(fPhSpectrum.begin() + iroc*(NPH+2), NPH+2, 0);
+  fill_n(fQSpectrum.begin() + iroc*(fNq+2), fNq+2, 0);
+}
@@ -0,0 +1,90 @@
+#ifndef HITACCUMULATOR_H
+#define HITACCUMULATOR_H
+
+#include "pxardllexport.h"
+
+#include <vector>
+#include <stdint.h>
+
+class TH1D;
+class TH2D;
+class TProfile2D;
+
+/** Fixed-geometry accumulator of pixel hits for the high-rate tests.
+ *
+ *  Keeps per pixel the number of hits and the sums of PH, PH^2, Q and Q^2, and per
+ *  ROC the PH spectrum (256 bins) and the Q spectrum, with plain array indexing. The
+ *  contents are added to the ROOT histograms with flush(), i.e. once per readout
+ *  instead of once per hit. Each shard has its own arrays, threads filling
+ *  different shards do not need a lock; flush() adds all shards.
+ */
+class DLLEXPORT HitAccumulator {
+public:
+  static const int NROC = 16, NCOL = 52, NROW = 80, NPIX = NCOL*NROW, NPH = 256;
+
+  /** the Q spectrum has nqbins between qlo and qhi, as the TH1D it is flushed into */
+  HitAccumulator(int nrocs = NROC, int nshards = 1, int nqbins = 2000, double qlo = 0., double qhi = 2000.);
+  ~HitAccumulator();
+
+  /** iroc is the index of the ROC (0 .. nrocs-1), not its ID; hits outside of the ROC are ignored */
+  void fill(int iroc, int icol, int irow, double ph, double q, int shard = 0) {
+    if (iroc < 0 || iroc >= fNrocs || icol < 0 || icol >= NCOL || irow < 0 || irow >= NROW) return;
+    if (shard < 0 || shard >= fNshards) shard = 0;
+    int ipix = (shard*fNrocs + iroc)*NPIX + icol*NROW + irow;
+    ++fHits[ipix];
+    fPhSum[ipix]  += ph;
+    fPhSum2[ipix] += ph*ph;
+    fQSum[ipix]   += q;
+    fQSum2[ipix]  += q*q;
+    int iph = static_cast<int>(ph);
+    int ibin = (ph < 0. ? 0 : (iph >= NPH ? NPH+1 : iph+1));
+    ++fPhSpectrum[(shard*fNrocs + iroc)*(NPH+2) + ibin];
+    // -- as TAxis::FindBin(), NaN goes into the overflow
+    if (q < fQlo) {
+      ibin = 0;
+    } else if (!(q < fQhi)) {
+      ibin = fNq + 1;
+    } else {
+      ibin = static_cast<int>((q - fQlo)*fQscale) + 1;
+      if (ibin > fNq) ibin = fNq;
+    }
+    ++fQSpectrum[(shard*fNrocs + iroc)*(fNq+2) + ibin];
+  }
+
+  /** hit only, without PH and Q */
+  void fill(int iroc, int icol, int irow, int shard = 0) {
+    if (iroc < 0 || iroc >= fNrocs || icol < 0 || icol >= NCOL || irow < 0 || irow >= NROW) return;
+    if (shard < 0 || shard >= fNshards) shard = 0;
+    ++fHits[(shard*fNrocs + iroc)*NPIX + icol*NROW + irow];
+  }
+
+  void clear();
+  /** add all shards to shard 0 */
+  void merge();
+
+  /** add the contents for ROC index iroc to the histograms (zero pointers are skipped) and clear them.
+   *  The 2D histograms must have 52 x 80 bins, the spectra the binning of this accumulator.
+   */
+  void flush(int iroc, TH2D *hits, TProfile2D *qmap = 0, TProfile2D *phmap = 0, TH1D *q = 0, TH1D *ph = 0);
+
+  /** after merge() */
+  uint32_t getHits(int iroc, int icol, int irow) {return fHits[iroc*NPIX + icol*NROW + irow];}
+  uint64_t getNhits(int iroc);
+  int      getNrocs() {return fNrocs;}
+  int      getNshards() {return fNshards;}
+
+private:
+  void merge(int iroc);
+
+  int fNrocs, fNshards;
+  int fNq;
+  double fQlo, fQhi, fQscale;
+
+  // -- [shard][roc][pixel], pixel = icol*80 + irow
+  std::vector<uint32_t> fHits;
+  std::vector<double>   fPhSum, fPhSum2, fQSum, fQSum2;
+  // -- [shard][roc][bin], bin 0 = underflow, bin n+1 = overflow
+  std::vector<uint32_t> fPhSpectrum, fQSpectrum;
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include <iostream>
 #include "PixMonitor.hh"
+#include "PixMonitorService.hh"
 #include "log.h"
 #include <cstdlib>
 
@@ -16,11 +17,13 @@ using namespace pxar;
 
 // ----------------------------------------------------------------------
 PixMonitor::PixMonitor(pxarCore *a): fApi(a), fIana(0.), fIdig(0.) {
+  fService = new PixMonitorService(a);
 }
 
 // ----------------------------------------------------------------------
 PixMonitor::~PixMonitor() {
   LOG(logDEBUG) << "PixMonitor dtor"; 
+  delete fService;
 }
 
 // ----------------------------------------------------------------------
@@ -28,13 +31,26 @@ void PixMonitor::init() {
   LOG(logDEBUG) << "PixMonitor init"; 
 }
 
+// ----------------------------------------------------------------------
+bool PixMonitor::startService(int interval) {
+  fService->setInterval(interval);
+  return fService->start();
+}
+
+// ----------------------------------------------------------------------
+void PixMonitor::stopService() {
+  fService->stop();
+}
+
 // ----------------------------------------------------------------------
 void PixMonitor::dumpSummaries() {
   gFile->cd();
   LOG(logDEBUG) << "PixMonitor::dumpSummaries"; 
-  if (fMeasurements.size() < 1) return;
-  ULong_t begSec = fMeasurements[0].first;
-  ULong_t endSec = fMeasurements[fMeasurements.size()-1].first+1;
+  vector<PixMonitorService::sample> samples;
+  fService->getSamples(samples);
+  if (samples.size() < 1) return;
+  ULong_t begSec = samples[0].sec;
+  ULong_t endSec = samples[samples.size()-1].sec+1;
   TTimeStamp ts(begSec); 
   //  cout << "begSec: " << begSec << " endSec: " << endSec << " endSec-begSec: " << endSec-begSec << " nbins: " << endSec-begSec << endl;
   TH1D *ha = new TH1D("HA", Form("analog current measurements, start: %s / sec:%ld", ts.AsString("lc"), begSec), endSec-begSec, 0., endSec-begSec);
@@ -47,10 +63,10 @@ void PixMonitor::dumpSummaries() {
   hd->SetTitleSize(0.03, "X");
   hd->SetTitleOffset(1.5, "X");
 
-  for (unsigned int i = 0; i < fMeasurements.size(); ++i) {
-    int ibin = fMeasurements[i].first - begSec;
-    ha->SetBinContent(ibin+1, fMeasurements[i].second.first);
-    hd->SetBinContent(ibin+1, fMeasurements[i].second.second);
+  for (unsigned int i = 0; i < samples.size(); ++i) {
+    int ibin = samples[i].sec - begSec;
+    ha->SetBinContent(ibin+1, samples[i].ia);
+    hd->SetBinContent(ibin+1, samples[i].id);
   }
   
   ha->Draw();
@@ -61,16 +77,45 @@ void PixMonitor::dumpSummaries() {
 
   hd->SetDirectory(gFile); 
   hd->Write();
+
+  // -- long-term history: mean and rms of each summary
+  vector<PixMonitorService::summary> summaries;
+  fService->getSummaries(summaries);
+  if (summaries.size() < 1) return;
+  ts = TTimeStamp(summaries[0].begSec);
+  int nsum = summaries.size();
+  TH1D *has = new TH1D("HAS", Form("analog current, mean of %u samples, start: %s / sec:%u", summaries[0].n, ts.AsString("lc"), summaries[0].begSec), 
+		       nsum, 0., nsum);
+  has->SetXTitle(Form("summaries after %s", ts.AsString("lc"))); 
+  TH1D *hds = new TH1D("HDS", Form("digital current, mean of %u samples, start: %s / sec:%u", summaries[0].n, ts.AsString("lc"), summaries[0].begSec), 
+		       nsum, 0., nsum);
+  hds->SetXTitle(Form("summaries after %s", ts.AsString("lc"))); 
+  for (int i = 0; i < nsum; ++i) {
+    has->SetBinContent(i+1, summaries[i].iaMean);
+    has->SetBinError(i+1, summaries[i].iaRms);
+    hds->SetBinContent(i+1, summaries[i].idMean);
+    hds->SetBinError(i+1, summaries[i].idRms);
+  }
+
+  has->SetDirectory(gFile); 
+  has->Write();
+
+  hds->SetDirectory(gFile); 
+  hds->Write();
 }
 
 // ----------------------------------------------------------------------
 void PixMonitor::update() {
   int NBINS(10); 
-  fIana = fApi->getTBia();
-  fIdig = fApi->getTBid();
+  // -- without the sampling thread (WIN32), the sample is taken here
+  if (!fService->isRunning()) fService->poll();
+  PixMonitorService::sample last;
+  if (!fService->lastSample(last)) return;
+  fIana = last.ia;
+  fIdig = last.id;
   
-  TTimeStamp ts; 
-  ULong_t seconds  = ts.GetSec();
+  ULong_t seconds  = last.sec;
+  TTimeStamp ts(seconds); 
   
   TH1D *ha = (TH1D*)gDirectory->Get("ha"); 
   if (0 == ha) {
@@ -94,17 +139,16 @@ void PixMonitor::update() {
   }
   if (ibin > hd->GetNbinsX()) hd = extendHist(hd, ibin); 
   hd->SetBinContent(ibin+1, fIdig); 
-
-  fMeasurements.push_back(make_pair(seconds, make_pair(fIana, fIdig))); 
-  
-
 }
 
 // ----------------------------------------------------------------------
 void PixMonitor::drawHist(string hname) {
+  vector<PixMonitorService::sample> samples;
+  fService->getSamples(samples);
+  if (samples.size() < 1) return;
 
-  ULong_t begSec = fMeasurements[0].first;
-  ULong_t endSec = fMeasurements[fMeasurements.size()-1].first+1;
+  ULong_t begSec = samples[0].sec;
+  ULong_t endSec = samples[samples.size()-1].sec+1;
   TTimeStamp ts(begSec); 
 
   string title;
@@ -123,16 +167,16 @@ void PixMonitor::drawHist(string hname) {
 
 
   if (hname == "iana") {
-    for (unsigned int i = 0; i < fMeasurements.size(); ++i) {
-      int ibin = fMeasurements[i].first - begSec;
-      ha->SetBinContent(ibin+1, fMeasurements[i].second.first);
+    for (unsigned int i = 0; i < samples.size(); ++i) {
+      int ibin = samples[i].sec - begSec;
+      ha->SetBinContent(ibin+1, samples[i].ia);
     }
   }
 
   if (hname == "idig") {
-    for (unsigned int i = 0; i < fMeasurements.size(); ++i) {
-      int ibin = fMeasurements[i].first - begSec;
-      ha->SetBinContent(ibin+1, fMeasurements[i].second.second);
+    for (unsigned int i = 0; i < samples.size(); ++i) {
+      int ibin = samples[i].sec - begSec;
+      ha->SetBinContent(ibin+1, samples[i].id);
     }
   }
 
@@ -17,12 +17,20 @@ typedef char int8_t;
 
 #include "api.h"
 
+class PixMonitorService;
+
 class DLLEXPORT PixMonitor: public TQObject {
 public:
   PixMonitor(pxar::pxarCore *); 
   ~PixMonitor();
   void init(); 
 
+  /** start the sampling thread of the monitoring service, interval in ms (must be stopped before the pxarCore is deleted) */
+  bool startService(int interval = 1000);
+  void stopService();
+  PixMonitorService* getService() {return fService;}
+
+  /** latest sample from the service (taken here if its thread is not running) into the "ha" and "hd" histograms */
   void update(); 
   double getIana() {return fIana;}
   double getIdig() {return fIdig;}
@@ -37,7 +45,7 @@ private:
   pxar::pxarCore  *fApi; 
   double           fIana, fIdig;
 
-  std::vector<std::pair<UInt_t, std::pair<double, double> > > fMeasurements;
+  PixMonitorService *fService; //! samples are kept by the service only
 
   ClassDef(PixMonitor, 1); // testing PixMonitor
 
@@ -0,0 +1,127 @@
+#include <cmath>
+#include <ctime>
+
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include "PixMonitorService.hh"
+#include "api.h"
+#include "log.h"
+
+using namespace std;
+using namespace pxar;
+
+// ----------------------------------------------------------------------
+PixMonitorService::PixMonitorService(pxarCore *a, int interval, unsigned int nsamples,
+				     unsigned int nsummary, unsigned int nsummaries) :
+  fApi(a), fInterval(interval > 0 ? interval : 1), fNsummary(nsummary > 0 ? nsummary : 1),
+  fSamples(nsamples), fSummaries(nsummaries), fN(0), fBegSec(0),
+  fIaSum(0.), fIaSum2(0.), fIaMin(0.), fIaMax(0.), fIdSum(0.), fIdSum2(0.), fIdMin(0.), fIdMax(0.),
+  fRunning(false), fStop(false) {
+}
+
+// ----------------------------------------------------------------------
+PixMonitorService::~PixMonitorService() {
+  stop();
+}
+
+// ----------------------------------------------------------------------
+bool PixMonitorService::start() {
+  if (fRunning) return true;
+  if (0 == fApi) return false;
+#ifndef WIN32
+  fStop = false;
+  if (0 != pthread_create(&fThread, NULL, &PixMonitorService::run, this)) {
+    LOG(logWARNING) << "PixMonitorService: could not start the monitoring thread";
+    return false;
+  }
+  fRunning = true;
+  LOG(logDEBUG) << "PixMonitorService: sampling every " << fInterval << " ms";
+  return true;
+#else
+  return false;
+#endif
+}
+
+// ----------------------------------------------------------------------
+void PixMonitorService::stop() {
+  if (!fRunning) return;
+#ifndef WIN32
+  fStop = true;
+  pthread_join(fThread, NULL);
+#endif
+  fRunning = false;
+  LOG(logDEBUG) << "PixMonitorService: stopped after " << fSamples.written() << " samples";
+}
+
+// ----------------------------------------------------------------------
+void* PixMonitorService::run(void *p) {
+  PixMonitorService *self = static_cast<PixMonitorService*>(p);
+#ifndef WIN32
+  while (!self->fStop) {
+    self->poll();
+    // -- sleep in short steps to react to stop() in time
+    for (int slept = 0; slept < self->fInterval && !self->fStop; slept += 50) {
+      int ms = self->fInterval - slept;
+      usleep(1000*(ms < 50 ? ms : 50));
+    }
+  }
+#endif
+  return 0;
+}
+
+// ----------------------------------------------------------------------
+void PixMonitorService::poll() {
+  if (0 == fApi) return;
+  sample s = {static_cast<uint32_t>(time(0)), 0., 0., 0., 0., 0, 0};
+  // -- all values with one round trip, peekStatistics() does not reset the counters of the running test
+  vector<pair<string, double> > power = fApi->getTBpower();
+  for (unsigned int i = 0; i < power.size(); ++i) {
+    if (power[i].first == "ia") s.ia = power[i].second;
+    if (power[i].first == "id") s.id = power[i].second;
+    if (power[i].first == "va") s.va = power[i].second;
+    if (power[i].first == "vd") s.vd = power[i].second;
+  }
+  statistics stats = fApi->peekStatistics();
+  s.events = stats.info_events_total();
+  s.errors = stats.errors();
+
+  fSamples.push(s);
+  addToSummary(s);
+}
+
+// ----------------------------------------------------------------------
+void PixMonitorService::addToSummary(const sample &s) {
+  if (0 == fN) {
+    fBegSec = s.sec;
+    fIaSum = fIaSum2 = fIdSum = fIdSum2 = 0.;
+    fIaMin = fIaMax = s.ia;
+    fIdMin = fIdMax = s.id;
+  }
+  ++fN;
+  fIaSum  += s.ia;
+  fIaSum2 += s.ia*s.ia;
+  fIdSum  += s.id;
+  fIdSum2 += s.id*s.id;
+  if (s.ia < fIaMin) fIaMin = s.ia;
+  if (s.ia > fIaMax) fIaMax = s.ia;
+  if (s.id < fIdMin) fIdMin = s.id;
+  if (s.id > fIdMax) fIdMax = s.id;
+  if (fN < fNsummary) return;
+
+  summary sum;
+  sum.begSec = fBegSec;
+  sum.endSec = s.sec;
+  sum.n      = fN;
+  sum.iaMean = fIaSum/fN;
+  sum.iaRms  = sqrt(fabs(fIaSum2/fN - sum.iaMean*sum.iaMean));
+  sum.iaMin  = fIaMin;
+  sum.iaMax  = fIaMax;
+  sum.idMean = fIdSum/fN;
+  sum.idRms  = sqrt(fabs(fIdSum2/fN - sum.idMean*sum.idMean));
+  sum.idMin  = fIdMin;
+  sum.idMax  = fIdMax;
+  fSummaries.push(sum);
+  fN = 0;
+}
@@ -0,0 +1,145 @@
+#ifndef PIXMONITORSERVICE_H
+#define PIXMONITORSERVICE_H
+
+#include "pxardllexport.h"
+
+#include <vector>
+#include <stdint.h>
+
+#ifndef WIN32
+#include <pthread.h>
+#endif
+
+namespace pxar {
+  class pxarCore;
+}
+
+/** Ring of the last N entries, written by one thread and read by any number of threads without a lock.
+ *
+ *  The writer fills the slot of entry k (k%N) and only then publishes it by incrementing the write
+ *  counter. A reader copies the published entries and checks the counter again afterwards: all
+ *  entries which the writer may have overwritten in the meantime are dropped from the copy.
+ */
+template <class T> class PixMonitorRing {
+public:
+  PixMonitorRing(unsigned int n = 1) : fSlots(n > 0 ? n : 1), fWritten(0) {}
+
+  /** writer only */
+  void push(const T &t) {
+    uint32_t k = fWritten;
+    fSlots[k % fSlots.size()] = t;
+    barrier();
+    fWritten = k + 1;
+  }
+
+  /** total number of entries pushed */
+  uint32_t written() const {return fWritten;}
+  unsigned int size() const {return fSlots.size();}
+
+  /** copy of the entries still in the ring, oldest first */
+  void copy(std::vector<T> &v) const {
+    uint32_t n = fSlots.size();
+    uint32_t w1 = fWritten;
+    barrier();
+    uint32_t first = (w1 > n ? w1 - n : 0);
+    v.clear();
+    v.reserve(w1 - first);
+    for (uint32_t k = first; k < w1; ++k) v.push_back(fSlots[k % n]);
+    barrier();
+    // -- entry w2 may be in the writing, it overwrites entry w2-n
+    uint32_t w2 = fWritten;
+    if (w2 + 1 > first + n) {
+      uint32_t ndrop = w2 + 1 - n - first;
+      v.erase(v.begin(), v.begin() + (ndrop < v.size() ? ndrop : v.size()));
+    }
+  }
+
+  /** the newest entry, false if there is none */
+  bool last(T &t) const {
+    uint32_t w1 = fWritten;
+    if (0 == w1) return false;
+    barrier();
+    t = fSlots[(w1 - 1) % fSlots.size()];
+    barrier();
+    return (fWritten + 1 <= w1 - 1 + fSlots.size());
+  }
+
+private:
+  static void barrier() {
+#ifdef __GNUC__
+    __sync_synchronize();
+#endif
+  }
+
+  std::vector<T>    fSlots;
+  volatile uint32_t fWritten;
+};
+
+
+/** Monitoring of the testboard on a thread of its own.
+ *
+ *  Samples currents, voltages and the decoder statistics of the running DAQ session every
+ *  interval ms and keeps them in a fixed-size ring. Every nsummary samples are condensed into
+ *  one summary (mean, rms, minimum and maximum of the currents), kept in a second ring for the
+ *  long-term history. All testboard access goes through pxarCore, whose testboard lock keeps
+ *  the sampling out of the call sequence of a running test; readers only copy from the rings.
+ *  Without pthreads (WIN32) start() fails and the owner has to call poll() itself.
+ */
+class DLLEXPORT PixMonitorService {
+public:
+  struct sample {
+    uint32_t sec;            ///< unix time
+    double   ia, id, va, vd;
+    uint32_t events, errors; ///< decoder statistics of the current DAQ session
+  };
+
+  struct summary {
+    uint32_t     begSec, endSec;
+    unsigned int n;
+    double       iaMean, iaRms, iaMin, iaMax;
+    double       idMean, idRms, idMin, idMax;
+  };
+
+  PixMonitorService(pxar::pxarCore *a, int interval = 1000, unsigned int nsamples = 3600,
+		    unsigned int nsummary = 60, unsigned int nsummaries = 1440);
+  ~PixMonitorService();
+
+  /** start the sampling thread, false if it could not be started */
+  bool start();
+  /** stop and join the sampling thread; must be called before the pxarCore is deleted */
+  void stop();
+  bool isRunning() {return fRunning;}
+
+  /** take one sample on the calling thread (the writer of the rings: only while the thread is not running) */
+  void poll();
+
+  void setInterval(int ms) {fInterval = (ms > 0 ? ms : 1);}
+  int  getInterval() {return fInterval;}
+
+  bool lastSample(sample &s) const {return fSamples.last(s);}
+  void getSamples(std::vector<sample> &v) const {fSamples.copy(v);}
+  void getSummaries(std::vector<summary> &v) const {fSummaries.copy(v);}
+  uint32_t getNSamples() const {return fSamples.written();}
+
+private:
+  static void* run(void *);
+  void addToSummary(const sample &s);
+
+  pxar::pxarCore *fApi;
+  volatile int    fInterval;
+  unsigned int    fNsummary;
+
+  PixMonitorRing<sample>  fSamples;
+  PixMonitorRing<summary> fSummaries;
+  // -- running sums of the summary in progress, writer only
+  unsigned int fN;
+  uint32_t     fBegSec;
+  double       fIaSum, fIaSum2, fIaMin, fIaMax, fIdSum, fIdSum2, fIdMin, fIdMax;
+
+  volatile bool fRunning, fStop;
+#ifndef WIN32
+  pthread_t fThread;
+#endif
+};
+
+#endif
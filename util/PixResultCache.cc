@@ -0,0 +1,196 @@
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <ctime>
+
+#include "PixResultCache.hh"
+#include "log.h"
+
+using namespace std;
+using namespace pxar;
+
+const uint64_t PixResultCache::OFFSET;
+const unsigned int PixResultCache::MAXENTRIES;
+
+// ----------------------------------------------------------------------
+PixResultCache::PixResultCache(string directory) {
+  fFileName = directory + "/resultCache.dat";
+  fForce    = false;
+
+  // -- only unique within this process tree, which is all that is needed
+  uint64_t h = hashValue(static_cast<uint64_t>(time(0)));
+  h = hashValue(static_cast<uint64_t>(clock()), h);
+  h = hashValue(reinterpret_cast<uintptr_t>(this), h);
+  char buffer[40];
+  sprintf(buffer, "%lx-%04x", static_cast<unsigned long>(time(0)), static_cast<unsigned int>(h & 0xffff));
+  fSession = buffer;
+
+  readFile();
+}
+
+// ----------------------------------------------------------------------
+uint64_t PixResultCache::hashString(const string &s, uint64_t h) {
+  for (string::const_iterator it = s.begin(); it != s.end(); ++it) {
+    h ^= static_cast<unsigned char>(*it);
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+// ----------------------------------------------------------------------
+uint64_t PixResultCache::hashValue(uint64_t v, uint64_t h) {
+  for (int i = 0; i < 8; ++i) {
+    h ^= (v >> (8*i)) & 0xff;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+// ----------------------------------------------------------------------
+uint64_t PixResultCache::hashFile(const string &filename) {
+  ifstream is(filename.c_str(), ios::binary);
+  if (!is.is_open()) return 0;
+  ostringstream content;
+  content << is.rdbuf();
+  return hashString(content.str());
+}
+
+// ----------------------------------------------------------------------
+uint64_t PixResultCache::hashParameters(const vector<pair<string, string> > &v) {
+  uint64_t h(OFFSET);
+  for (unsigned int i = 0; i < v.size(); ++i) {
+    h = hashString(v[i].first, h);
+    h = hashString("=", h);
+    h = hashString(v[i].second, h);
+    h = hashString(";", h);
+  }
+  return h;
+}
+
+// ----------------------------------------------------------------------
+bool PixResultCache::lookup(string test, uint64_t parameters, uint64_t state) {
+  if (fForce) {
+    LOG(logDEBUG) << "PixResultCache: force set, ignoring cached results for " << test;
+    return false;
+  }
+
+  // -- the latest run which left the DUT in this state
+  int ilast(-1);
+  for (int i = static_cast<int>(fEntries.size()) - 1; i >= 0; --i) {
+    if (fEntries[i].stateAfter == state) {
+      ilast = i;
+      break;
+    }
+  }
+  if (ilast < 0) {
+    LOG(logDEBUG) << "PixResultCache: no run of any test left the current configuration";
+    return false;
+  }
+
+  // -- did this test run in the same session up to that point?
+  string session = fEntries[ilast].session;
+  for (int i = ilast; i >= 0; --i) {
+    entry &e = fEntries[i];
+    if (e.session != session) continue;
+    if (e.test != test || e.parameters != parameters) continue;
+
+    string dir = fFileName.substr(0, fFileName.rfind('/') + 1);
+    for (unsigned int j = 0; j < e.outputs.size(); ++j) {
+      if (hashFile(dir + e.outputs[j].first) != e.outputs[j].second) {
+        LOG(logINFO) << "PixResultCache: output file " << e.outputs[j].first << " of " << test << " changed";
+        return false;
+      }
+    }
+    char buffer[40];
+    time_t t = e.time;
+    strftime(buffer, sizeof(buffer), "%Y/%m/%d %H:%M:%S", localtime(&t));
+    LOG(logINFO) << "PixResultCache: valid result for " << test << " from " << buffer;
+    return true;
+  }
+  LOG(logDEBUG) << "PixResultCache: no result for " << test << " with these parameters";
+  return false;
+}
+
+// ----------------------------------------------------------------------
+void PixResultCache::record(string test, uint64_t parameters, uint64_t stateBefore, uint64_t stateAfter,
+                            const vector<string> &outputs) {
+  entry e;
+  e.test        = test;
+  e.session     = fSession;
+  e.parameters  = parameters;
+  e.stateBefore = stateBefore;
+  e.stateAfter  = stateAfter;
+  e.time        = static_cast<long>(time(0));
+  string dir = fFileName.substr(0, fFileName.rfind('/') + 1);
+  for (unsigned int i = 0; i < outputs.size(); ++i) {
+    e.outputs.push_back(make_pair(outputs[i], hashFile(dir + outputs[i])));
+  }
+  fEntries.push_back(e);
+  if (fEntries.size() > MAXENTRIES) fEntries.erase(fEntries.begin(), fEntries.end() - MAXENTRIES);
+  writeFile();
+}
+
+// ----------------------------------------------------------------------
+void PixResultCache::invalidate(string test) {
+  if (test.empty()) {
+    fEntries.clear();
+  } else {
+    vector<entry> keep;
+    for (unsigned int i = 0; i < fEntries.size(); ++i) {
+      if (fEntries[i].test != test) keep.push_back(fEntries[i]);
+    }
+    fEntries.swap(keep);
+  }
+  LOG(logINFO) << "PixResultCache: invalidated " << (test.empty() ? string("all results") : test);
+  writeFile();
+}
+
+// ----------------------------------------------------------------------
+void PixResultCache::readFile() {
+  fEntries.clear();
+  ifstream is(fFileName.c_str());
+  if (!is.is_open()) return;
+
+  string line;
+  while (getline(is, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    istringstream ls(line);
+    entry e;
+    unsigned int nout(0);
+    ls >> e.test >> e.session >> e.time
+       >> hex >> e.parameters >> e.stateBefore >> e.stateAfter
+       >> dec >> nout;
+    for (unsigned int i = 0; i < nout && ls; ++i) {
+      string name;
+      uint64_t h(0);
+      ls >> name >> hex >> h >> dec;
+      e.outputs.push_back(make_pair(name, h));
+    }
+    if (ls.fail()) {
+      LOG(logWARNING) << "PixResultCache: ignoring corrupt line in " << fFileName;
+      continue;
+    }
+    fEntries.push_back(e);
+  }
+  LOG(logDEBUG) << "PixResultCache: read " << fEntries.size() << " entries from " << fFileName;
+}
+
+// ----------------------------------------------------------------------
+void PixResultCache::writeFile() {
+  ofstream os(fFileName.c_str());
+  if (!os.is_open()) {
+    LOG(logWARNING) << "PixResultCache: could not write " << fFileName;
+    return;
+  }
+  os << "# test session time parameters stateBefore stateAfter noutputs [output hash]" << endl;
+  for (unsigned int i = 0; i < fEntries.size(); ++i) {
+    entry &e = fEntries[i];
+    os << e.test << " " << e.session << " " << e.time
+       << hex << " " << e.parameters << " " << e.stateBefore << " " << e.stateAfter
+       << dec << " " << e.outputs.size();
+    for (unsigned int j = 0; j < e.outputs.size(); ++j) {
+      os << " " << e.outputs[j].first << " " << hex << e.outputs[j].second << dec;
+    }
+    os << endl;
+  }
+}
@@ -0,0 +1,68 @@
+#ifndef PIXRESULTCACHE_H
+#define PIXRESULTCACHE_H
+
+#include "pxardllexport.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <utility>
+
+/** Cache of completed test runs, kept in resultCache.dat in the config directory.
+ *
+ *  Every completed test is recorded with a hash of its test parameters, hashes of
+ *  the DUT configuration before and after the test, and hashes of the output files
+ *  it wrote. A test has a valid cached result if the current configuration is the
+ *  one left behind by a session in which this test ran with the same parameters,
+ *  and if its output files are unchanged. Every new pXar session gets its own
+ *  session id, so results of earlier tests in a session stay valid as long as the
+ *  configuration is the one this session wrote.
+ */
+class DLLEXPORT PixResultCache {
+public:
+  PixResultCache(std::string directory);
+
+  /** 64 bit FNV-1a hashes (hal::GetHashForString is too short to key results) */
+  static uint64_t hashString(const std::string &s, uint64_t h = OFFSET);
+  static uint64_t hashValue(uint64_t v, uint64_t h = OFFSET);
+  /** returns 0 if the file cannot be read */
+  static uint64_t hashFile(const std::string &filename);
+  static uint64_t hashParameters(const std::vector<std::pair<std::string, std::string> > &v);
+
+  /** returns true if test has a valid result for configuration state and parameters */
+  bool lookup(std::string test, uint64_t parameters, uint64_t state);
+  /** record a completed test run */
+  void record(std::string test, uint64_t parameters, uint64_t stateBefore, uint64_t stateAfter,
+              const std::vector<std::string> &outputs);
+
+  /** drop all entries of test (or all entries if empty) */
+  void invalidate(std::string test = "");
+
+  /** ignore cached results (new results are still recorded) */
+  void setForce(bool x) {fForce = x;}
+  bool force() {return fForce;}
+
+  int  getNEntries() {return static_cast<int>(fEntries.size());}
+  std::string getFileName() {return fFileName;}
+
+  static const uint64_t OFFSET = 14695981039346656037ULL;
+
+private:
+  struct entry {
+    std::string test, session;
+    uint64_t    parameters, stateBefore, stateAfter;
+    long        time;
+    std::vector<std::pair<std::string, uint64_t> > outputs;
+  };
+
+  void readFile();
+  void writeFile();
+
+  std::string        fFileName, fSession;
+  std::vector<entry> fEntries;
+  bool               fForce;
+
+  static const unsigned int MAXENTRIES = 100;
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include <iostream>
 #include "PixSetup.hh"
+#include "PixResultCache.hh"
 #include "log.h"
 #include <cstdlib>
 
@@ -15,6 +16,7 @@ PixSetup::PixSetup(pxarCore *a, PixTestParameters *tp, ConfigParameters *cp) {
   fPixTestParameters = tp; 
   fConfigParameters  = cp; 
   fPixMonitor        = new PixMonitor(a);
+  fResultCache       = new PixResultCache(cp->getDirectory());
   fDoAnalysisOnly    = false; 
   fDoUpdateRootFile  = false;
   fGuiActive         = false;
@@ -26,6 +28,7 @@ PixSetup::PixSetup(pxarCore *a, PixTestParameters *tp, ConfigParameters *cp) {
 PixSetup::PixSetup(string verbosity, PixTestParameters *tp, ConfigParameters *cp) {
   fPixTestParameters = tp; 
   fConfigParameters  = cp; 
+  fResultCache       = new PixResultCache(cp->getDirectory());
   fDoAnalysisOnly    = false; 
   fDoUpdateRootFile  = false;
   fGuiActive         = false;
@@ -58,6 +61,7 @@ PixSetup::PixSetup() {
   fPixTestParameters = 0; 
   fConfigParameters  = 0; 
   fPixMonitor        = 0;
+  fResultCache       = 0;
   fDoAnalysisOnly    = false; 
   init(); 
   LOG(logDEBUG) << "PixSetup ctor()";
@@ -67,6 +71,7 @@ PixSetup::PixSetup() {
 PixSetup::~PixSetup() {
   LOG(logDEBUG) << "PixSetup free fPxarMemory";
   free(fPxarMemory);
+  delete fResultCache;
 }
 
 
@@ -140,3 +145,42 @@ void PixSetup::writeTbmParameterFiles() {
     fConfigParameters->writeTbmParameterFile(itbm, fApi->_dut->getTbmDACs(itbm), fApi->_dut->getTbmChainLengths(itbm), fApi->_dut->getTbmDACs(itbm+1), fApi->_dut->getTbmChainLengths(itbm+1));
   }
 }
+
+// ----------------------------------------------------------------------
+uint64_t PixSetup::getConfigurationHash() {
+  uint64_t h(PixResultCache::OFFSET);
+  if (0 == fApi || 0 == fConfigParameters) return h;
+
+  // -- DUT: ROC DACs and trim bits, TBM registers
+  h = PixResultCache::hashString(fConfigParameters->getTrimVcalSufix(), h);
+  vector<uint8_t> rocs = fApi->_dut->getEnabledRocIDs(); 
+  for (unsigned int iroc = 0; iroc < rocs.size(); ++iroc) {
+    h = PixResultCache::hashValue(rocs[iroc], h);
+    vector<pair<string, uint8_t> > dacs = fApi->_dut->getDACs(rocs[iroc]);
+    for (unsigned int i = 0; i < dacs.size(); ++i) {
+      h = PixResultCache::hashString(dacs[i].first, h);
+      h = PixResultCache::hashValue(dacs[i].second, h);
+    }
+    for (uint8_t icol = 0; icol < 52; ++icol) {
+      for (uint8_t irow = 0; irow < 80; ++irow) {
+	h = PixResultCache::hashValue(fApi->_dut->getPixelConfig(rocs[iroc], icol, irow).trim(), h);
+      }
+    }
+  }
+  for (unsigned int itbm = 0; itbm < fApi->_dut->getNTbms(); ++itbm) {
+    vector<pair<string, uint8_t> > regs = fApi->_dut->getTbmDACs(itbm);
+    for (unsigned int i = 0; i < regs.size(); ++i) {
+      h = PixResultCache::hashString(regs[i].first, h);
+      h = PixResultCache::hashValue(regs[i].second, h);
+    }
+  }
+
+  // -- testboard: parameters and the mask file (not part of the DUT state in memory)
+  vector<pair<string, uint8_t> > tb = fConfigParameters->getTbParameters();
+  for (unsigned int i = 0; i < tb.size(); ++i) {
+    h = PixResultCache::hashString(tb[i].first, h);
+    h = PixResultCache::hashValue(tb[i].second, h);
+  }
+  h = PixResultCache::hashValue(PixResultCache::hashFile(fConfigParameters->getDirectory() + "/" + fConfigParameters->getMaskFileName()), h);
+  return h;
+}
@@ -10,6 +10,8 @@
 #include "ConfigParameters.hh"
 #include "PixMonitor.hh"
 
+class PixResultCache;
+
 class DLLEXPORT PixSetup {
 public:
   PixSetup(pxar::pxarCore *, PixTestParameters *, ConfigParameters *);
@@ -22,6 +24,9 @@ public:
   ConfigParameters * getConfigParameters()  {return fConfigParameters;}
   pxar::pxarCore*    getApi() {return fApi;}
   PixMonitor*        getPixMonitor() {return fPixMonitor;}
+  PixResultCache*    getResultCache() {return fResultCache;}
+  /// hash of the DUT and testboard configuration as currently programmed
+  uint64_t           getConfigurationHash();
   bool               doAnalysisOnly() {return fDoAnalysisOnly;}
   void               setDoAnalysisOnly(bool x) {fDoAnalysisOnly = x;}
   bool               useRootLogon() {return fUseRootLogon;} 
@@ -49,6 +54,7 @@ private:
   PixTestParameters *fPixTestParameters; 
   ConfigParameters  *fConfigParameters;   
   PixMonitor        *fPixMonitor; 
+  PixResultCache    *fResultCache;
 
 };
 
@@ -0,0 +1,225 @@
+#include <cmath>
+#include <cstdlib>
+
+#include "ScurveFitter.hh"
+#include "shist256.hh"
+#include "PixUtil.hh"
+
+using namespace std;
+
+namespace {
+  // -- binning of the TH1D in PixTest::scurveAna(): 256 bins from 0 to 256
+  const int NBINS(256);
+  const int BLOCK(64);
+
+  double lowEdge(int bin) {return bin - 1.;}
+  double center(int bin) {return bin - 0.5;}
+
+  int findLastBinAbove(const double *y, double threshold) {
+    for (int i = NBINS; i >= 1; --i) {
+      if (y[i] > threshold) return i;
+    }
+    return -1;
+  }
+
+  // -- chi2 of plateau*(erf((x-p0)/p1) + 1), with derivatives if jtj != 0
+  double chi2(const vector<double> &x, const vector<double> &y, const vector<double> &w, double plateau,
+	      double p0, double p1, double *jtj = 0, double *jtr = 0) {
+    const double c = 1.1283791670955126; // 2/sqrt(pi)
+    double sum(0.);
+    if (jtj) {
+      jtj[0] = jtj[1] = jtj[2] = 0.;
+      jtr[0] = jtr[1] = 0.;
+    }
+    for (unsigned int i = 0; i < x.size(); ++i) {
+      double u = (x[i] - p0)/p1;
+      double r = y[i] - plateau*(erf(u) + 1.);
+      sum += w[i]*r*r;
+      if (jtj) {
+	double g  = plateau*c*exp(-u*u)/p1;
+	double d0 = -g;
+	double d1 = -g*u;
+	jtj[0] += w[i]*d0*d0;
+	jtj[1] += w[i]*d0*d1;
+	jtj[2] += w[i]*d1*d1;
+	jtr[0] += w[i]*d0*r;
+	jtr[1] += w[i]*d1*r;
+      }
+    }
+    return sum;
+  }
+}
+
+// ----------------------------------------------------------------------
+ScurveFitter::ScurveFitter(int ntrig, int nthreads) :
+  fNtrig(ntrig), fThreads(nthreads, BLOCK), fMaps(0), fResults(0) {
+}
+
+// ----------------------------------------------------------------------
+ScurveFitter::~ScurveFitter() {
+}
+
+// ----------------------------------------------------------------------
+ScurveFitter::result ScurveFitter::fit(const double *y) {
+  result r = {0., 0., 0., 0., 0., false, false};
+
+  // -- start of the function range and step function detection of PixInitFunc::errScurve()
+  int STARTBIN(2);
+  int ibin(-1), jbin(-1);
+  double hmax(y[1]);
+  for (int i = 2; i <= NBINS; ++i) if (y[i] > hmax) hmax = y[i];
+  for (int i = STARTBIN; i <= NBINS; ++i) {
+    if (y[i] > 0) {
+      ibin = i;
+      break;
+    }
+  }
+  for (int i = STARTBIN; i < NBINS; ++i) {
+    if (y[i] > 0.9*hmax && y[i+1] > 0.9*hmax) {
+      jbin = i;
+      break;
+    }
+  }
+
+  int plateauWidth = findLastBinAbove(y, 0.9*hmax) - jbin;
+  double hi = lowEdge(static_cast<int>(jbin + 0.7*plateauWidth));
+
+  double lo = lowEdge(1);
+  int foundLo(-1);
+  for (int i = 3; i < NBINS; ++i) {
+    if (lowEdge(i-2) > hi) break;
+    if (y[i-2] < 1 && y[i-1] < 1 && y[i] < 1) {
+      lo = lowEdge(i-2);
+      foundLo = i-2;
+      break;
+    }
+  }
+  if (foundLo > -1) {
+    lo = lo + 0.6*(lowEdge(ibin) - lo);
+  }
+
+  r.thresholdN = findLastBinAbove(y, 0.5*hmax);
+
+  if (jbin == ibin) {
+    r.threshold  = center(jbin);
+    r.thresholdE = 0.3;
+    return r;
+  }
+
+  // -- fit points, with the bin errors of PixTest::scurveAna()
+  vector<double> vx, vy, vw;
+  for (int i = 1; i <= NBINS; ++i) {
+    if (center(i) < lo || center(i) > hi) continue;
+    double e = fNtrig*PixUtil::dBinomial(static_cast<int>(y[i]), fNtrig);
+    if (e <= 0.) continue;
+    vx.push_back(center(i));
+    vy.push_back(y[i]);
+    vw.push_back(1./(e*e));
+  }
+
+  // -- start at the 50% crossing
+  double plateau = 0.5*hmax;
+  double p0 = center(static_cast<int>(0.5*(ibin+jbin)));
+  for (int i = (ibin > 1 ? ibin : 2); i <= NBINS; ++i) {
+    if (y[i] >= plateau) {
+      double dy = y[i] - y[i-1];
+      p0 = center(i-1) + (dy > 0. ? (plateau - y[i-1])/dy : 0.);
+      break;
+    }
+  }
+  double p1 = 0.25*(lowEdge(jbin) - lowEdge(ibin));
+  if (p1 <= 0.) p1 = 1.;
+
+  // -- Levenberg-Marquardt
+  double jtj[3], jtr[2];
+  double lambda(1.e-3);
+  double c2 = chi2(vx, vy, vw, plateau, p0, p1, jtj, jtr);
+  for (int iter = 0; iter < 200 && vx.size() > 2; ++iter) {
+    bool improved(false);
+    double c2new(c2);
+    while (lambda < 1.e10) {
+      double a00 = jtj[0]*(1. + lambda), a01 = jtj[1], a11 = jtj[2]*(1. + lambda);
+      double det = a00*a11 - a01*a01;
+      if (det == 0.) {
+	lambda *= 10.;
+	continue;
+      }
+      double q0 = p0 + ( a11*jtr[0] - a01*jtr[1])/det;
+      double q1 = p1 + (-a01*jtr[0] + a00*jtr[1])/det;
+      if (q1 != 0.) c2new = chi2(vx, vy, vw, plateau, q0, q1);
+      if (q1 != 0. && c2new < c2) {
+	p0 = q0;
+	p1 = q1;
+	lambda *= 0.1;
+	improved = true;
+	break;
+      }
+      lambda *= 10.;
+    }
+    if (!improved) break;
+    bool converged = (c2 - c2new < 1.e-9*c2 + 1.e-12);
+    c2 = chi2(vx, vy, vw, plateau, p0, p1, jtj, jtr);
+    if (converged) break;
+  }
+
+  // -- parabolic errors (chi2 + 1) from the inverse of the curvature matrix
+  double e0(0.), e1(0.);
+  double det = jtj[0]*jtj[2] - jtj[1]*jtj[1];
+  if (vx.size() > 2 && det > 0.) {
+    e0 = sqrt(jtj[2]/det);
+    e1 = sqrt(jtj[0]/det);
+  }
+
+  r.threshold  = p0;
+  r.thresholdE = e0;
+  r.sigma      = p1/sqrt(2.);
+  r.sigmaE     = r.sigma*e1/p1;
+
+  if (r.threshold < lowEdge(1)) {
+    r.threshold  = -2.;
+    r.thresholdE = -2.;
+    r.sigma      = -2.;
+    r.sigmaE     = -2.;
+    r.thresholdN = -2.;
+    return r;
+  }
+
+  if (r.threshold > lowEdge(NBINS)) {
+    r.threshold  = lowEdge(NBINS);
+    r.thresholdE = -1.;
+    r.sigma      = -1.;
+    r.sigmaE     = -1.;
+    r.thresholdN = r.threshold;
+    return r;
+  }
+
+  r.ok = true;
+  return r;
+}
+
+// ----------------------------------------------------------------------
+void ScurveFitter::fit(const vector<shist256*> &maps, vector<result> &results) {
+  results.resize(maps.size());
+  fMaps    = &maps;
+  fResults = &results;
+  fThreads.run(*this, maps.size());
+  fMaps    = 0;
+  fResults = 0;
+}
+
+// ----------------------------------------------------------------------
+void ScurveFitter::run(unsigned int first, unsigned int last) {
+  const vector<shist256*> &maps = *fMaps;
+  vector<result> &results = *fResults;
+  double y[NBINS+1];
+  y[0] = 0.;
+  for (unsigned int i = first; i < last; ++i) {
+    if (maps[i]->getSumOfWeights() < 1) {
+      result r = {0., 0., 0., 0., 0., false, true};
+      results[i] = r;
+      continue;
+    }
+    for (int ib = 1; ib <= NBINS; ++ib) y[ib] = maps[i]->get(ib);
+    results[i] = fit(y);
+  }
+}
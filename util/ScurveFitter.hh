@@ -0,0 +1,54 @@
+#ifndef SCURVEFITTER_H
+#define SCURVEFITTER_H
+
+#include "pxardllexport.h"
+
+#include <vector>
+
+#include "FitThreads.hh"
+
+class shist256;
+
+/** Error function fit of s-curves without ROOT.
+ *
+ *  Reproduces PixTest::threshold() with PixInitFunc::errScurve() on the TH1D filled
+ *  in PixTest::scurveAna(): bin ib (1..256) holds shist256::get(ib), the bin errors
+ *  are ntrig*PixUtil::dBinomial(), the model is
+ *    plateau*(erf((x-step)/slope) + 1),  plateau = 0.5*maximum (fixed)
+ *  and the fit range and step-function detection are those of errScurve(). The
+ *  chi2 is minimized with Levenberg-Marquardt and analytic derivatives, starting
+ *  from the 50% crossing. Many s-curves are fitted in parallel on a pool of threads.
+ *  tools/fitcheck compares the results with the ROOT fit: threshold and sigma agree
+ *  within 0.05 DAC, or the native chi2 is not larger.
+ */
+class DLLEXPORT ScurveFitter : private FitThreads::task {
+public:
+  struct result {
+    double threshold, thresholdE, sigma, sigmaE, thresholdN;
+    bool   ok;    ///< return value of PixTest::threshold()
+    bool   empty; ///< no entries, not fitted
+  };
+
+  /** nthreads = 0: one thread per online CPU */
+  ScurveFitter(int ntrig, int nthreads = 0);
+  ~ScurveFitter();
+
+  /** fit a single s-curve, y[0] is unused and y[1..256] are the bin contents */
+  result fit(const double *y);
+  /** fit all maps, results in the same order */
+  void fit(const std::vector<shist256*> &maps, std::vector<result> &results);
+
+  int getNThreads() {return fThreads.getNThreads();}
+
+private:
+  void run(unsigned int first, unsigned int last);
+
+  int fNtrig;
+  FitThreads fThreads;
+
+  // -- the maps and results of the current fit()
+  const std::vector<shist256*> *fMaps;
+  std::vector<result>          *fResults;
+};
+
+#endif
@@ -0,0 +1,122 @@
+#include "TimingWindowSearch.hh"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+
+namespace {
+  // Order window offsets by their distance from the window center:
+  struct centerDistance {
+    int center;
+    centerDistance(int c) : center(c) {}
+    bool operator()(int a, int b) const { return abs(a - center) < abs(b - center); }
+  };
+}
+
+// ----------------------------------------------------------------------
+TimingWindowSearch::TimingWindowSearch(const vector<int> & outer, int nx, int ny, int width) :
+  fOuter(outer), fNx(nx), fNy(ny), fWidth(width), fState(outer.size(), vector<int>(nx*ny, UNTESTED)),
+  fOffsets(), fHasStart(false), fStartX(0), fStartY(0),
+  fFound(false), fWindowOuter(0), fWindowX(0), fWindowY(0) {
+
+  fWidth = max(1, min(fWidth, min(fNx, fNy)));
+  for (int i = 0; i < fWidth; ++i) fOffsets.push_back(i);
+  stable_sort(fOffsets.begin(), fOffsets.end(), centerDistance((fWidth-1)/2));
+}
+
+// ----------------------------------------------------------------------
+void TimingWindowSearch::setStart(int outer, int x, int y) {
+  vector<int>::iterator it = find(fOuter.begin(), fOuter.end(), outer);
+  if (it == fOuter.end()) return;
+  // Move the outer setting to the front, the order of the others is kept:
+  rotate(fOuter.begin(), it, it + 1);
+  fHasStart = true;
+  fStartX = ((x % fNx) + fNx) % fNx;
+  fStartY = ((y % fNy) + fNy) % fNy;
+}
+
+// ----------------------------------------------------------------------
+bool TimingWindowSearch::run(probe & p) {
+  fFound = false;
+  for (size_t iouter = 0; iouter < fOuter.size() && !fFound; ++iouter) {
+    if (iouter == 0 && fHasStart) fFound = searchPlane(p, iouter, fStartX, fStartY);
+    else fFound = searchPlane(p, iouter, -1, -1);
+  }
+  return fFound;
+}
+
+// ----------------------------------------------------------------------
+bool TimingWindowSearch::test(probe & p, size_t iouter, int x, int y) {
+  int & s = fState[iouter][y*fNx + x];
+  if (s == UNTESTED) s = (p(fOuter[iouter], x, y) ? VALID : INVALID);
+  return (s == VALID);
+}
+
+// ----------------------------------------------------------------------
+bool TimingWindowSearch::testWindow(probe & p, size_t iouter, int x0, int y0) {
+  // Check the settings already known first, then probe the rest:
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int dy = 0; dy < fWidth; ++dy) {
+      for (int dx = 0; dx < fWidth; ++dx) {
+        int x = (x0 + dx) % fNx;
+        int y = (y0 + dy) % fNy;
+        int s = fState[iouter][y*fNx + x];
+        if (s == INVALID) return false;
+        if (pass == 1 && !test(p, iouter, x, y)) return false;
+      }
+    }
+  }
+
+  fWindowOuter = fOuter[iouter];
+  fWindowX = (x0 + (fWidth-1)/2) % fNx;
+  fWindowY = (y0 + (fWidth-1)/2) % fNy;
+  return true;
+}
+
+// ----------------------------------------------------------------------
+bool TimingWindowSearch::searchPlane(probe & p, size_t iouter, int startx, int starty) {
+  // Try the window around the start point first:
+  if (startx >= 0 && test(p, iouter, startx, starty)) {
+    int c = (fWidth-1)/2;
+    if (testWindow(p, iouter, (startx - c + fNx) % fNx, (starty - c + fNy) % fNy)) return true;
+  }
+
+  // Coarse grid:
+  vector<pair<int, int> > seeds;
+  for (int y = 0; y < fNy; y += fWidth) {
+    for (int x = 0; x < fNx; x += fWidth) {
+      if (test(p, iouter, x, y)) seeds.push_back(make_pair(x, y));
+    }
+  }
+  if (startx >= 0 && fState[iouter][starty*fNx + startx] == VALID) seeds.insert(seeds.begin(), make_pair(startx, starty));
+
+  // Refine around the valid grid points, every window containing them is a candidate:
+  for (size_t iseed = 0; iseed < seeds.size(); ++iseed) {
+    for (size_t iy = 0; iy < fOffsets.size(); ++iy) {
+      for (size_t ix = 0; ix < fOffsets.size(); ++ix) {
+        int x0 = (seeds[iseed].first - fOffsets[ix] + fNx) % fNx;
+        int y0 = (seeds[iseed].second - fOffsets[iy] + fNy) % fNy;
+        if (testWindow(p, iouter, x0, y0)) return true;
+      }
+    }
+  }
+  return false;
+}
+
+// ----------------------------------------------------------------------
+int TimingWindowSearch::nValid(size_t iouter) {
+  return count(fState[iouter].begin(), fState[iouter].end(), static_cast<int>(VALID));
+}
+
+// ----------------------------------------------------------------------
+int TimingWindowSearch::nTested(size_t iouter) {
+  return fNx*fNy - count(fState[iouter].begin(), fState[iouter].end(), static_cast<int>(UNTESTED));
+}
+
+// ----------------------------------------------------------------------
+int TimingWindowSearch::nTested() {
+  int n(0);
+  for (size_t iouter = 0; iouter < fOuter.size(); ++iouter) n += nTested(iouter);
+  return n;
+}
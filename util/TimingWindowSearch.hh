@@ -0,0 +1,75 @@
+#ifndef TIMINGWINDOWSEARCH_H
+#define TIMINGWINDOWSEARCH_H
+
+#include "pxardllexport.h"
+
+#include <cstddef>
+#include <vector>
+
+/** Search for a stable window of working timing settings.
+ *
+ *  The settings consist of a list of "outer" settings (e.g. TBM phases), each of
+ *  which spans a cyclic nx x ny plane of "inner" settings (e.g. the two ROC port
+ *  phases). A window is a width x width square of inner settings which all give a
+ *  valid readout.
+ *
+ *  The outer settings are searched in the given order. For each of them the plane is
+ *  first probed on a coarse grid with a spacing of width, so every window contains at
+ *  least one grid point. Only the windows around valid grid points are then probed in
+ *  full. The search stops at the first complete window. Every setting is probed at
+ *  most once, so the worst case is the full scan.
+ */
+class DLLEXPORT TimingWindowSearch {
+public:
+  /** Probe one setting, returns true if the readout is valid */
+  class probe {
+  public:
+    virtual ~probe() {}
+    virtual bool operator()(int outer, int x, int y) = 0;
+  };
+
+  enum { UNTESTED = 0, VALID, INVALID };
+
+  TimingWindowSearch(const std::vector<int> & outer, int nx, int ny, int width);
+
+  /** Window center known to work before, e.g. from a previous run. Its outer setting
+   *  is searched first, starting with the window around (x, y).
+   */
+  void setStart(int outer, int x, int y);
+
+  /** Run the search, returns true if a window was found */
+  bool run(probe & p);
+
+  bool found() {return fFound;}
+  /** Outer setting and center of the window found */
+  int outer() {return fWindowOuter;}
+  int x() {return fWindowX;}
+  int y() {return fWindowY;}
+
+  /** Probing results, outer settings in the order they were searched */
+  size_t nOuter() {return fOuter.size();}
+  int outerSetting(size_t iouter) {return fOuter[iouter];}
+  int state(size_t iouter, int x, int y) {return fState[iouter][y*fNx + x];}
+  int nValid(size_t iouter);
+  int nTested(size_t iouter);
+  int nTested();
+
+private:
+  bool test(probe & p, size_t iouter, int x, int y);
+  bool testWindow(probe & p, size_t iouter, int x0, int y0);
+  bool searchPlane(probe & p, size_t iouter, int startx, int starty);
+
+  std::vector<int> fOuter;
+  int fNx, fNy, fWidth;
+  std::vector<std::vector<int> > fState;
+  // Window offsets relative to a valid grid point, most central first:
+  std::vector<int> fOffsets;
+
+  bool fHasStart;
+  int fStartX, fStartY;
+
+  bool fFound;
+  int fWindowOuter, fWindowX, fWindowY;
+};
+
+#endif